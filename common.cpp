@@ -13,3 +13,25 @@ char *sign_mode_to_str(SignMode sign_mode) {
   }
   return "SIGN_MODE_UNKNOWN";
 }
+
+char *boot_stage_to_str(BootStage stage) {
+  switch (stage) {
+    case BOOT_STAGE_DISPLAY:
+      return "display";
+    case BOOT_STAGE_TASKS:
+      return "tasks";
+    case BOOT_STAGE_FIRST_FRAME:
+      return "first_frame";
+    case BOOT_STAGE_WIFI:
+      return "wifi";
+    case BOOT_STAGE_TIME:
+      return "time";
+    case BOOT_STAGE_TLS:
+      return "tls";
+    case BOOT_STAGE_PROVIDER:
+      return "provider";
+    case BOOT_STAGE_MAX:
+      break;
+  }
+  return "unknown";
+}
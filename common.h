@@ -20,6 +20,8 @@
 #define SIGN_MODE_BUTTON_PIN 32
 
 #define SIGN_MODE_KEY "sign-mode-key"
+// 1 to stream MBTA predictions over a connection that stays open
+#define MBTA_STREAMING_KEY "mbta-stream-key"
 #define DEFAULT_SIGN_MODE SIGN_MODE_MBTA
 
 enum SignMode {
@@ -34,14 +36,42 @@ enum UIMessageType {
   UI_MESSAGE_TYPE_MODE_CHANGE,  // change to a specified sign mode
   UI_MESSAGE_TYPE_MODE_SHIFT,   // shift to the next available sign mode
   UI_MESSAGE_TYPE_MBTA_CHANGE_STATION,
+  UI_MESSAGE_TYPE_MBTA_SET_STREAMING,
 };
 
 struct UIMessage {
   UIMessageType type;
   SignMode next_sign_mode;
   TrainStation next_station;
+  bool mbta_streaming;
+};
+
+// What the sign has brought up since power on, in the order it usually does
+enum BootStage {
+  BOOT_STAGE_DISPLAY,      // the panel is driven
+  BOOT_STAGE_TASKS,        // the render and system tasks run
+  BOOT_STAGE_FIRST_FRAME,  // the first frame is on the panel
+  BOOT_STAGE_WIFI,         // associated
+  BOOT_STAGE_TIME,         // synced with NTP
+  BOOT_STAGE_TLS,          // connected to the provider's API, or gave up
+  BOOT_STAGE_PROVIDER,     // the provider of the sign mode started
+  BOOT_STAGE_MAX
+};
+
+// When each boot stage was reached, in millis since power on
+struct BootStats {
+  uint32_t at_ms[BOOT_STAGE_MAX];
+  bool reached[BOOT_STAGE_MAX];
+};
+
+// Sign mode switches since boot, and how long they took, in millis
+struct ModeSwitchStats {
+  uint32_t switches;
+  uint32_t last_ms;
+  uint32_t max_ms;
 };
 
 char *sign_mode_to_str(SignMode sign_mode);
+char *boot_stage_to_str(BootStage stage);
 
 #endif /* COMMON_DEFS_H */
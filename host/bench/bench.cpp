@@ -0,0 +1,73 @@
+// sign-bench: render and parse cost of the sign firmware on the host.
+//
+//   sign-bench [filter]
+//
+// Absolute numbers are host numbers and say little about the esp32; compare
+// them between revisions, together with the counters each benchmark prints.
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "host.h"
+#include "../routes.h"
+
+namespace lms_bench {
+
+namespace {
+
+struct Entry {
+  const char *name;
+  BenchFunction function;
+};
+
+int failures = 0;
+
+std::vector<Entry> &registry() {
+  static std::vector<Entry> entries;
+  return entries;
+}
+
+}  // namespace
+
+Registrar::Registrar(const char *name, BenchFunction function) {
+  registry().push_back({name, function});
+}
+
+void report(const char *name, int iterations, double ns_per_op,
+            const char *extra) {
+  printf("%-36s %8d %12.0f ns/op  %s\n", name, iterations, ns_per_op, extra);
+  fflush(stdout);
+}
+
+void fail(const char *name, const char *message) {
+  printf("%-36s FAILED: %s\n", name, message);
+  fflush(stdout);
+  failures++;
+}
+
+int failure_count() { return failures; }
+
+}  // namespace lms_bench
+
+int main(int argc, char **argv) {
+  const char *filter = argc > 1 ? argv[1] : "";
+  // the MBTA timestamps are compared against local time
+  setenv("TZ", "EST5EDT,M3.2.0,M11.1.0", 1);
+  tzset();
+  if (!lms_host::install_fixture_routes()) return 1;
+
+  printf("%-36s %8s %15s\n", "benchmark", "iters", "time");
+  for (const lms_bench::Entry &e : lms_bench::registry()) {
+    if (strstr(e.name, filter)) e.function();
+  }
+  fflush(stdout);
+  // timer and task threads may still be running
+  _Exit(lms_bench::failure_count() ? 1 : 0);
+}
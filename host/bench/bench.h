@@ -0,0 +1,55 @@
+// A small benchmark harness for the host build.
+//
+// Benchmarks register themselves with LMS_BENCH and are run by sign-bench,
+// optionally filtered by a substring of their name. Each one reports the time
+// per operation and whatever counters it cares about, e.g. panel pixel writes.
+
+#ifndef LMS_BENCH_H
+#define LMS_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+
+namespace lms_bench {
+
+typedef void (*BenchFunction)();
+
+struct Registrar {
+  Registrar(const char *name, BenchFunction function);
+};
+
+#define LMS_BENCH(name)                                          \
+  static void bench_##name();                                    \
+  static lms_bench::Registrar bench_##name##_registrar(#name,    \
+                                                       bench_##name); \
+  static void bench_##name()
+
+// Runs f iterations times after a short warm up, returns nanoseconds per call.
+template <typename F>
+double time_per_op_ns(int iterations, F f) {
+  for (int i = 0; i < iterations / 10 + 1; i++) f();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+// Prints one result line. extra is free form, e.g. "pixels/op 5120".
+void report(const char *name, int iterations, double ns_per_op,
+            const char *extra = "");
+
+// Highest number of bytes held through operator new since the last reset, on
+// top of what was held at the reset, over all threads. sign-bench replaces the
+// global operator new to count them.
+void reset_heap_peak();
+size_t heap_peak();
+
+// Records a failed check. sign-bench exits with an error if there was one.
+void fail(const char *name, const char *message);
+
+}  // namespace lms_bench
+
+#endif /* LMS_BENCH_H */
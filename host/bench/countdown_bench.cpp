@@ -0,0 +1,70 @@
+// The MBTA countdown over half an hour of the recorded Park Street response,
+// one provider tick per second. The sign requests predictions only when
+// MBTA decides a poll is due and works the countdown out locally in between.
+// Every second its display must match what a fresh response would show, while
+// making far fewer requests than polling every 5 seconds, as it used to.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/mbta/mbta.h"
+#include "bench.h"
+#include "host.h"
+
+LMS_BENCH(mbta_countdown) {
+  const int seconds = 30 * 60;
+  const int fixed_interval = 5;
+  static MBTA sign;
+  static MBTA reference;
+  sign.setup();
+  sign.set_station(TRAIN_STATION_PARK_STREET);
+  reference.setup();
+  reference.set_station(TRAIN_STATION_PARK_STREET);
+
+  time_t start = time(NULL);
+  int second = 0;
+  int mismatches = 0;
+  int changes = 0;
+  uint32_t requests = 0;
+  Prediction shown[2] = {};
+  double ns = lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second++);
+    Prediction predictions[2];
+    uint32_t before = lms_host::http_stats().requests;
+    sign.get_predictions_both_directions(predictions);
+    requests += lms_host::http_stats().requests - before;
+
+    // setting the station makes the next call request predictions again
+    Prediction expected[2];
+    reference.set_station(TRAIN_STATION_PARK_STREET);
+    reference.get_predictions_both_directions(expected);
+    for (int i = 0; i < 2; i++) {
+      if (strcmp(predictions[i].label, expected[i].label) != 0 ||
+          strcmp(predictions[i].value, expected[i].value) != 0) {
+        mismatches++;
+      }
+      if (strcmp(predictions[i].value, shown[i].value) != 0) {
+        changes++;
+      }
+      shown[i] = predictions[i];
+    }
+  });
+  lms_host::set_wall_clock(0);
+
+  if (mismatches > 0) {
+    char message[96];
+    snprintf(message, sizeof(message),
+             "%d of %d displayed predictions differ from a fresh response",
+             mismatches, 2 * second);
+    lms_bench::fail("mbta_countdown", message);
+    return;
+  }
+  uint32_t fixed_requests = second / fixed_interval;
+  char extra[128];
+  snprintf(extra, sizeof(extra),
+           "%u requests in %d s (every %d s: %u), %.1fx fewer, %d countdown "
+           "changes",
+           requests, second, fixed_interval, fixed_requests,
+           (double)fixed_requests / requests, changes);
+  lms_bench::report("mbta_countdown", seconds, ns, extra);
+}
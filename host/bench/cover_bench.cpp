@@ -0,0 +1,237 @@
+// Album cover transitions over forty minutes of the looping host playlist,
+// one provider tick per second, as the music provider and the cover loader
+// handle them. The provider only queues cover requests, so a song change is
+// rendered right away. With the cover of the next song decoded into the back
+// image ahead of time, the loader only publishes it on the change. Without,
+// as before, the cover is fetched and decoded once the new song is seen. The
+// album image CDN answers after cdn_latency_ms, as a real one would.
+//
+// The loader runs after each provider tick, as the cover task would while the
+// provider sleeps. After every change the render task must draw the new
+// song's cover.
+//
+// The playlist comes round again every 16 minutes, so its covers are fetched
+// and decoded over and over unless they are kept in the cover cache.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "../../src/display/display.h"
+#include "../../src/spotify/cover-cache.h"
+#include "../../src/spotify/cover-loader.h"
+#include "../../src/spotify/spotify.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t cdn_latency_ms = 100;
+
+struct CoverRun {
+  bool prefetch;
+  CoverCache *cache = nullptr;
+  int fetches = 0;  // covers fetched and decoded
+  int changes = 0;
+  int prefetched = 0;
+  int mismatched = 0;
+  double provider_us = 0;  // from seeing a new song to rendering it
+  double max_provider_us = 0;
+  double change_us = 0;  // from seeing a new song to its cover being ready
+  double ns = 0;
+};
+
+double us_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+// Whether the render task draws the cover of song, as decoded afresh.
+bool shows_cover(Spotify *spotify, Display *display, CurrentlyPlaying *song) {
+  static GFXcanvas16 fresh(32, 32);
+  MusicRenderContent music{SPOTIFY_RESPONSE_OK, *song};
+  display->render_music_content(music);
+  const AlbumImage &image = display->get_image();
+  if (strcmp(image.url, song->cover.url) != 0 ||
+      spotify->get_album_cover(&song->cover, &fresh) != SPOTIFY_RESPONSE_OK) {
+    return false;
+  }
+  return memcmp(fresh.getBuffer(), image.image.getBuffer(),
+                32 * 32 * sizeof(uint16_t)) == 0;
+}
+
+void run_covers(Spotify *spotify, Display *display, int seconds,
+                CoverRun *run) {
+  static CoverLoader loader;
+  spotify->setup();
+  loader.setup(spotify, run->cache, display);
+  time_t start = time(NULL);
+  uint32_t start_ms = lms_host::now_ms();
+  int second = 0;
+  char prefetched_cover[sizeof(AlbumCover::url)] = "";
+  run->ns = lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second);
+    uint32_t now_ms = start_ms + second++ * 1000;
+    if (!spotify->is_poll_due(now_ms)) {
+      return;
+    }
+    CurrentlyPlaying song;
+    if (spotify->get_currently_playing(&song, now_ms) != SPOTIFY_RESPONSE_OK) {
+      return;
+    }
+    bool changed = spotify->is_current_song_new(&song);
+    bool first = changed && loader.get_stats().requests == 0;
+    Clock::time_point change = Clock::now();
+    if (changed) {
+      loader.request(COVER_REQUEST_SHOW, song.cover);
+    }
+    spotify->update_current_song(&song);
+    double provider_us = us_since(change);
+    uint32_t published = loader.get_stats().published;
+    while (loader.process(0)) {
+    }
+    if (changed && !first &&
+        loader.get_stats().published > published) {
+      run->changes++;
+      run->prefetched += strcmp(song.cover.url, prefetched_cover) == 0;
+      run->provider_us += provider_us;
+      run->max_provider_us = std::max(run->max_provider_us, provider_us);
+      run->change_us += us_since(change);
+      if (!shows_cover(spotify, display, &song)) {
+        run->mismatched++;
+      }
+    }
+    CurrentlyPlaying next_song;
+    if (run->prefetch && spotify->is_next_song_due(now_ms) &&
+        spotify->get_next_song(&next_song) == SPOTIFY_RESPONSE_OK) {
+      loader.request(COVER_REQUEST_PREFETCH, next_song.cover);
+      strcpy(prefetched_cover, next_song.cover.url);
+      while (loader.process(0)) {
+      }
+    }
+  });
+  lms_host::set_wall_clock(0);
+  CoverLoaderStats stats = loader.get_stats();
+  run->fetches = stats.loaded;
+  if (run->cache) {
+    CoverCacheStats cached = run->cache->get_stats();
+    run->fetches -= cached.hits + cached.flash_hits;
+  }
+}
+
+}  // namespace
+
+LMS_BENCH(spotify_cover_prefetch) {
+  const int seconds = 40 * 60;
+  if (lms_host::make_test_jpeg(64, 64, 0).empty()) {
+    printf("spotify_cover_prefetch: skipped, no JPEG encoder\n");
+    return;
+  }
+  lms_host::http_route("https://i.scdn.co/image/",
+                       [](const lms_host::HttpRequest &request) {
+                         std::this_thread::sleep_for(
+                             std::chrono::milliseconds(cdn_latency_ms));
+                         uint32_t seed =
+                             (uint32_t)std::hash<std::string>()(request.url);
+                         return lms_host::HttpResponse{
+                             200, lms_host::make_test_jpeg(64, 64, seed),
+                             "image/jpeg"};
+                       });
+  static Display display;
+  display.setup();
+  static Spotify fetching;
+  static Spotify prefetching;
+  CoverRun fetched;
+  fetched.prefetch = false;
+  run_covers(&fetching, &display, seconds, &fetched);
+  CoverRun prefetched;
+  prefetched.prefetch = true;
+  run_covers(&prefetching, &display, seconds, &prefetched);
+  lms_host::install_fixture_routes();
+
+  char extra[224];
+  if (fetched.mismatched + prefetched.mismatched > 0 ||
+      prefetched.prefetched != prefetched.changes) {
+    snprintf(extra, sizeof(extra),
+             "%d of %d covers wrong after the change, %d prefetched",
+             fetched.mismatched + prefetched.mismatched,
+             fetched.changes + prefetched.changes, prefetched.prefetched);
+    lms_bench::fail("spotify_cover_prefetch", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%d song changes, song rendered %.1f us (max %.1f) and cover "
+           "ready %.1f us after the change (fetched then: %.0f us), %d of "
+           "%d prefetched",
+           prefetched.changes, prefetched.provider_us / prefetched.changes,
+           std::max(prefetched.max_provider_us, fetched.max_provider_us),
+           prefetched.change_us / prefetched.changes,
+           fetched.change_us / fetched.changes, prefetched.prefetched,
+           prefetched.changes);
+  lms_bench::report("spotify_cover_prefetch", seconds, prefetched.ns, extra);
+}
+
+// Two hours of the playlist, without the cache, with the default RAM budget,
+// and with room for only two covers in RAM and the rest in flash.
+LMS_BENCH(spotify_cover_cache) {
+  const int seconds = 2 * 60 * 60;
+  if (lms_host::make_test_jpeg(64, 64, 0).empty()) {
+    printf("spotify_cover_cache: skipped, no JPEG encoder\n");
+    return;
+  }
+  static Display display;
+  display.setup();
+  static Spotify uncached_spotify;
+  static Spotify ram_spotify;
+  static Spotify flash_spotify;
+  static CoverCache ram;
+  static CoverCache flash;
+  ram.setup();
+  flash.setup(2 * COVER_BYTES, 8);
+
+  CoverRun uncached;
+  uncached.prefetch = true;
+  run_covers(&uncached_spotify, &display, seconds, &uncached);
+  CoverRun ram_cached;
+  ram_cached.prefetch = true;
+  ram_cached.cache = &ram;
+  run_covers(&ram_spotify, &display, seconds, &ram_cached);
+  CoverRun flash_cached;
+  flash_cached.prefetch = true;
+  flash_cached.cache = &flash;
+  run_covers(&flash_spotify, &display, seconds, &flash_cached);
+
+  CoverCacheStats ram_stats = ram.get_stats();
+  CoverCacheStats flash_stats = flash.get_stats();
+  char extra[192];
+  int mismatched = uncached.mismatched + ram_cached.mismatched +
+                   flash_cached.mismatched;
+  // the playlist has four covers
+  if (mismatched > 0 || ram_cached.fetches > 4 || flash_cached.fetches > 4) {
+    snprintf(extra, sizeof(extra),
+             "%d covers wrong after the change, %d and %d covers fetched",
+             mismatched, ram_cached.fetches, flash_cached.fetches);
+    lms_bench::fail("spotify_cover_cache", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%d song changes, %d covers fetched (uncached: %d), %u hits, %u "
+           "misses",
+           ram_cached.changes, ram_cached.fetches, uncached.fetches,
+           ram_stats.hits, ram_stats.misses);
+  lms_bench::report("spotify_cover_cache", seconds, ram_cached.ns, extra);
+  snprintf(extra, sizeof(extra),
+           "%d covers fetched, %u hits, %u from flash, %u misses, %u "
+           "evictions",
+           flash_cached.fetches, flash_stats.hits, flash_stats.flash_hits,
+           flash_stats.misses, flash_stats.evictions);
+  lms_bench::report("spotify_cover_cache_flash", seconds, flash_cached.ns,
+                    extra);
+}
@@ -0,0 +1,179 @@
+// Provider dispatch: the provider queue the tasks used to share, against
+// notifications sent straight to the task a timer is for.
+//
+// Each design runs a provider task woken by its timer every tick_ms, for
+// run_ms, in two shapes: the network task, which polled the queue between
+// 100 ms engine polls, and the clock task, which peeked at the queue every
+// frame. Latency is from the timer firing to the task running the tick.
+// Idle wakeups are the times the task woke and found nothing to do; with
+// notifications there must be none.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+
+#include "../../common.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+const uint32_t tick_ms = 250;
+const uint32_t run_ms = 2000;
+const uint32_t tick_event = 1 << 0;
+
+struct Request {
+  SignMode sign_mode;
+};
+
+// What the running design shares with its task and timer
+QueueHandle_t queue;
+TaskHandle_t task;
+std::atomic<bool> stopping;
+std::atomic<bool> ended;
+std::atomic<uint64_t> fired_at_us;
+uint32_t ticks;
+uint64_t total_latency_us;
+uint64_t max_latency_us;
+
+void run_tick() {
+  uint64_t latency_us = lms_host::now_us() - fired_at_us;
+  ticks++;
+  total_latency_us += latency_us;
+  max_latency_us = std::max(max_latency_us, latency_us);
+}
+
+void end_task() {
+  ended = true;
+  vTaskDelete(NULL);
+}
+
+// network_task before: a request taken without waiting, then the engine
+// poll, which with nothing in flight sleeps its timeout
+void queue_network_task(void *params) {
+  while (!stopping) {
+    Request request;
+    if (xQueueReceive(queue, &request, 0) &&
+        request.sign_mode == SIGN_MODE_MBTA) {
+      run_tick();
+    }
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+  }
+  end_task();
+}
+
+// clock_provider_task before: a frame's wait, then a peek at the queue
+void queue_clock_task(void *params) {
+  TickType_t last_wake_time = xTaskGetTickCount();
+  while (!stopping) {
+    vTaskDelayUntil(&last_wake_time, REFRESH_RATE);
+    Request request;
+    if (xQueuePeek(queue, &request, TEN_MILLIS) &&
+        request.sign_mode == SIGN_MODE_CLOCK) {
+      xQueueReceive(queue, &request, TEN_MILLIS);
+      run_tick();
+    }
+  }
+  end_task();
+}
+
+void queue_timer(TimerHandle_t timer) {
+  Request request{*(SignMode *)pvTimerGetTimerID(timer)};
+  fired_at_us = lms_host::now_us();
+  xQueueSend(queue, &request, TEN_MILLIS);
+}
+
+// Both tasks now: asleep until their timer or the stop wakes them
+void notified_task(void *params) {
+  while (!stopping) {
+    uint32_t events = 0;
+    if (xTaskNotifyWait(0, tick_event, &events, portMAX_DELAY) &&
+        (events & tick_event)) {
+      run_tick();
+    }
+  }
+  end_task();
+}
+
+void notify_timer(TimerHandle_t timer) {
+  fired_at_us = lms_host::now_us();
+  xTaskNotify(task, tick_event, eSetBits);
+}
+
+void run(const char *name, TaskFunction_t function,
+         TimerCallbackFunction_t callback, SignMode sign_mode,
+         double *avg_latency_us, double *idle_per_sec) {
+  queue = xQueueCreate(32, sizeof(Request));
+  stopping = false;
+  ended = false;
+  ticks = 0;
+  total_latency_us = 0;
+  max_latency_us = 0;
+  xTaskCreate(function, name, 4096, NULL, 1, &task);
+  TimerHandle_t timer = xTimerCreate(name, pdMS_TO_TICKS(tick_ms), true,
+                                     &sign_mode, callback);
+  xTimerStart(timer, 0);
+  vTaskDelay(run_ms);
+  xTimerDelete(timer, 0);
+  // counted before the stop wakes the task
+  uint32_t wakeups = 0;
+  for (const lms_host::TaskStats &stats : lms_host::task_stats()) {
+    if (strcmp(stats.name, name) == 0) {
+      wakeups = stats.wakeups;
+    }
+  }
+  stopping = true;
+  xTaskNotify(task, 0, eNoAction);
+  while (!ended) {
+    vTaskDelay(1);
+  }
+  vQueueDelete(queue);
+
+  *avg_latency_us = ticks ? (double)total_latency_us / ticks : 0;
+  *idle_per_sec = (wakeups - std::min(wakeups, ticks)) * 1000.0 / run_ms;
+  char extra[160];
+  snprintf(extra, sizeof(extra),
+           "%u ticks, latency avg %.0f us max %llu us, %.1f idle wakeups/s",
+           ticks, *avg_latency_us, (unsigned long long)max_latency_us,
+           *idle_per_sec);
+  lms_bench::report(name, ticks, *avg_latency_us * 1000, extra);
+}
+
+// queued and notified name the tasks too, which outlive the run
+void compare(const char *queued, const char *notified,
+             TaskFunction_t queue_task, SignMode sign_mode) {
+  double queue_latency_us;
+  double queue_idle;
+  double notify_latency_us;
+  double notify_idle;
+  run(queued, queue_task, queue_timer, sign_mode, &queue_latency_us,
+      &queue_idle);
+  run(notified, notified_task, notify_timer, sign_mode,
+      &notify_latency_us, &notify_idle);
+  if (notify_idle > 0 || notify_latency_us >= queue_latency_us) {
+    char extra[128];
+    snprintf(extra, sizeof(extra),
+             "notified: %.0f us, %.1f idle wakeups/s; queued: %.0f us",
+             notify_latency_us, notify_idle, queue_latency_us);
+    lms_bench::fail(notified, extra);
+  }
+}
+
+}  // namespace
+
+LMS_BENCH(dispatch_network) {
+  compare("dispatch_network_queue", "dispatch_network_notify",
+          queue_network_task, SIGN_MODE_MBTA);
+}
+
+LMS_BENCH(dispatch_clock) {
+  compare("dispatch_clock_queue", "dispatch_clock_notify", queue_clock_task,
+          SIGN_MODE_CLOCK);
+}
@@ -0,0 +1,379 @@
+// The providers as coroutines on one executor, against a task each.
+//
+// executor_footprint spawns the coroutines each sign mode runs, with the
+// stack their tasks had, and reports the stack the executor's one task
+// needs against the stacks of a task each. The cover task of the music mode
+// is not a coroutine, its stack is counted besides. all_sources runs every
+// provider at once, as the sign could with more data sources.
+//
+// executor_wake runs a coroutine woken by a timer, one sleeping on a
+// deadline and one waiting for what the first produces, on one task. Each
+// must run as often as it is woken, without the task waking for nothing,
+// and stop() must end the task. executor_wake_in_flight runs the timer's
+// coroutine again while a request is in flight, so that the task waits on
+// the engine's connections: each wake must still be seen at once.
+//
+// executor_cover_load runs the music tick, woken by its timer, while album
+// covers are downloaded from a slow CDN and decoded, first on the cover task
+// as the sign does, then on the executor itself for comparison. On the cover
+// task the ticks must come as often as the timer fires, none held up by a
+// cover.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+
+#include "../../src/display/display.h"
+#include "../../src/executor/executor.h"
+#include "../../src/spotify/cover-loader.h"
+#include "../../src/spotify/spotify.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+struct Spawn {
+  const char *name;
+  uint32_t stack_size;
+};
+
+struct Mode {
+  const char *name;
+  Spawn spawns[EXECUTOR_MAX_COROUTINES];
+  int count;
+  uint32_t task_stack_size;  // of the tasks run besides the executor
+};
+
+// as in led-matrix-sign.ino
+const Mode modes[] = {
+    {"test", {{"test", 2048}}, 1, 0},
+    {"mbta", {{"network", 8192}}, 1, 0},
+    {"clock", {{"clock", 2048}}, 1, 0},
+    {"music", {{"network", 8192}}, 1, COVER_LOADER_STACK_SIZE},
+    {"all_sources",
+     {{"mbta", 8192}, {"music", 8192}, {"clock", 2048}},
+     3,
+     COVER_LOADER_STACK_SIZE},
+};
+
+const uint32_t tick_ms = 50;
+const uint32_t sleep_ms = 100;
+const uint32_t run_ms = 1000;
+
+bool idle(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  CO_WAIT_EVENTS(co, 0);
+  CO_END(co);
+}
+
+lms::Executor executor;
+lms::Coroutine *ticker_handle;
+uint32_t ticks;
+uint32_t sleeps;
+uint32_t consumed;
+uint32_t produced;
+uint64_t fired_at_us;
+uint64_t total_latency_us;
+uint64_t max_tick_latency_us;
+uint64_t total_late_us;
+uint64_t slept_from_us;
+
+bool ticker(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    CO_WAIT_EVENTS(co, co->event);
+    ticks++;
+    produced++;
+    total_latency_us += lms_host::now_us() - fired_at_us;
+    max_tick_latency_us =
+        std::max(max_tick_latency_us, lms_host::now_us() - fired_at_us);
+  }
+  CO_END(co);
+}
+
+bool sleeper(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    slept_from_us = lms_host::now_us();
+    CO_SLEEP(co, sleep_ms);
+    sleeps++;
+    // the deadline is in millis, so the sleep may end a little early
+    total_late_us += std::max<int64_t>(
+        lms_host::now_us() - slept_from_us - sleep_ms * 1000, 0);
+  }
+  CO_END(co);
+}
+
+bool has_produced() { return consumed < produced; }
+
+bool consumer(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    CO_WAIT_READY(co, has_produced);
+    consumed++;
+  }
+  CO_END(co);
+}
+
+void tick_timer(TimerHandle_t timer) {
+  fired_at_us = lms_host::now_us();
+  executor.wake(ticker_handle);
+}
+
+const uint32_t cdn_latency_ms = 200;
+const int covers = 4;
+
+Display cover_display;
+Spotify cover_spotify;
+CoverLoader loader;
+TaskHandle_t loader_task_handle;
+volatile bool loader_stopping;
+uint64_t last_tick_us;
+uint64_t max_gap_us;
+
+// The music tick, which only notes how long it went without running
+bool music_ticker(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    CO_WAIT_EVENTS(co, co->event);
+    ticks++;
+    if (last_tick_us != 0) {
+      max_gap_us = std::max(max_gap_us, lms_host::now_us() - last_tick_us);
+    }
+    last_tick_us = lms_host::now_us();
+  }
+  CO_END(co);
+}
+
+// As cover_task in led-matrix-sign.ino
+void loader_task(void *params) {
+  while (!loader_stopping) {
+    loader.process(portMAX_DELAY);
+  }
+  loader_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+
+// Loads the covers on the executor, between the ticks
+bool loader_coroutine(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    CO_SLEEP(co, 1);
+    loader.process(0);
+  }
+  CO_END(co);
+}
+
+// Loads uncached covers while the music tick runs. Returns the longest
+// between two ticks, in micros, and sets ticked to the ticks run, 0 if not
+// every cover was loaded.
+uint64_t run_cover_load(bool on_task, int run, uint32_t *ticked) {
+  loader.setup(&cover_spotify, NULL, &cover_display);
+  executor.setup(NULL);
+  ticks = 0;
+  last_tick_us = 0;
+  max_gap_us = 0;
+  ticker_handle = executor.spawn("music", music_ticker, 8192);
+  if (!on_task) {
+    executor.spawn("cover", loader_coroutine, COVER_LOADER_STACK_SIZE);
+  }
+  executor.start("executor_cover_load", 1, tskNO_AFFINITY);
+  if (on_task) {
+    xTaskCreatePinnedToCore(loader_task, "loader_task",
+                            COVER_LOADER_STACK_SIZE, NULL, 1,
+                            &loader_task_handle, tskNO_AFFINITY);
+  }
+  TimerHandle_t timer =
+      xTimerCreate("executor_cover_load", pdMS_TO_TICKS(tick_ms), true, NULL,
+                   tick_timer);
+  xTimerStart(timer, 0);
+  for (int i = 0; i < covers; i++) {
+    AlbumCover cover = {};
+    snprintf(cover.url, sizeof(cover.url),
+             "https://i.scdn.co/image/load-%d-%d", run, i);
+    loader.request(COVER_REQUEST_SHOW, cover);
+  }
+  uint32_t deadline_ms = lms_host::now_ms() + covers * cdn_latency_ms * 4;
+  while (loader.get_stats().published < covers &&
+         lms_host::now_ms() < deadline_ms) {
+    vTaskDelay(tick_ms);
+  }
+  xTimerDelete(timer, 0);
+  executor.stop();
+  if (on_task) {
+    loader_stopping = true;
+    loader.wake();
+    while (loader_task_handle != NULL) {
+      vTaskDelay(1);
+    }
+    loader_stopping = false;
+  }
+  *ticked = loader.get_stats().published == covers ? ticks : 0;
+  return max_gap_us;
+}
+
+}  // namespace
+
+LMS_BENCH(executor_footprint) {
+  for (const Mode &mode : modes) {
+    lms::Executor executor;
+    executor.setup(NULL);
+    for (int i = 0; i < mode.count; i++) {
+      executor.spawn(mode.spawns[i].name, idle, mode.spawns[i].stack_size);
+    }
+    lms::ExecutorFootprint footprint = executor.get_footprint();
+    char name[64];
+    char extra[192];
+    snprintf(name, sizeof(name), "executor_footprint_%s", mode.name);
+    snprintf(extra, sizeof(extra),
+             "%u coroutines: %u B of stack and %u B of state, against %u B "
+             "of stack as a task each (%d B saved), + %u B cover task",
+             footprint.coroutines, footprint.stack_bytes,
+             footprint.state_bytes, footprint.task_stack_bytes,
+             (int)(footprint.task_stack_bytes - footprint.stack_bytes -
+                   footprint.state_bytes),
+             mode.task_stack_size);
+    if (footprint.stack_bytes > footprint.task_stack_bytes) {
+      lms_bench::fail(name, extra);
+      continue;
+    }
+    lms_bench::report(name, 1, 0, extra);
+  }
+}
+
+LMS_BENCH(executor_wake) {
+  executor.setup(NULL);
+  ticks = sleeps = consumed = produced = 0;
+  total_latency_us = total_late_us = 0;
+  ticker_handle = executor.spawn("ticker", ticker, 2048);
+  executor.spawn("sleeper", sleeper, 2048);
+  executor.spawn("consumer", consumer, 2048);
+  executor.start("executor_wake", 1, tskNO_AFFINITY);
+  TimerHandle_t timer =
+      xTimerCreate("executor_wake", pdMS_TO_TICKS(tick_ms), true, NULL,
+                   tick_timer);
+  xTimerStart(timer, 0);
+  vTaskDelay(run_ms);
+  xTimerDelete(timer, 0);
+  vTaskDelay(tick_ms);
+  lms::ExecutorStats stats = executor.get_stats();
+  executor.stop();
+
+  // a tick and a sleep may wake the task at once, never more than both
+  uint32_t expected_ticks = run_ms / tick_ms;
+  uint32_t expected_sleeps = run_ms / sleep_ms;
+  char extra[192];
+  snprintf(extra, sizeof(extra),
+           "%u ticks (latency avg %.0f us), %u sleeps (late avg %.0f us), "
+           "%u consumed, %u wakeups for %u resumes",
+           ticks, ticks ? (double)total_latency_us / ticks : 0.0, sleeps,
+           sleeps ? (double)total_late_us / sleeps : 0.0, consumed,
+           stats.wakeups, stats.resumes);
+  if (ticks < expected_ticks - 2 || ticks > expected_ticks + 1 ||
+      sleeps < expected_sleeps - 1 || sleeps > expected_sleeps ||
+      consumed != produced || stats.wakeups > ticks + sleeps + 1 ||
+      executor.is_running()) {
+    lms_bench::fail("executor_wake", extra);
+    return;
+  }
+  lms_bench::report("executor_wake", stats.resumes,
+                    ticks ? (double)total_latency_us * 1000 / ticks : 0,
+                    extra);
+}
+
+LMS_BENCH(executor_cover_load) {
+  if (lms_host::make_test_jpeg(64, 64, 0).empty()) {
+    printf("executor_cover_load: skipped, no JPEG encoder\n");
+    return;
+  }
+  lms_host::http_route("https://i.scdn.co/image/",
+                       [](const lms_host::HttpRequest &request) {
+                         std::this_thread::sleep_for(
+                             std::chrono::milliseconds(cdn_latency_ms));
+                         uint32_t seed =
+                             (uint32_t)std::hash<std::string>()(request.url);
+                         return lms_host::HttpResponse{
+                             200, lms_host::make_test_jpeg(64, 64, seed),
+                             "image/jpeg"};
+                       });
+  cover_display.setup();
+  cover_spotify.setup();
+  uint32_t task_ticks;
+  uint32_t executor_ticks;
+  uint64_t task_us = run_cover_load(true, 0, &task_ticks);
+  uint64_t executor_us = run_cover_load(false, 1, &executor_ticks);
+  lms_host::install_fixture_routes();
+
+  char extra[192];
+  snprintf(extra, sizeof(extra),
+           "%d covers loaded with the tick every %u ms: on the cover task "
+           "%u ticks, %.1f ms apart at most; on the executor %u ticks, "
+           "%.1f ms apart at most",
+           covers, tick_ms, task_ticks, task_us / 1000.0, executor_ticks,
+           executor_us / 1000.0);
+  // no tick may wait for a cover
+  if (task_ticks == 0 || task_us > tick_ms * 1000 * 3 / 2) {
+    lms_bench::fail("executor_cover_load", extra);
+    return;
+  }
+  lms_bench::report("executor_cover_load", task_ticks, task_us * 1000.0,
+                    extra);
+}
+
+LMS_BENCH(executor_wake_in_flight) {
+  // answers once the run is over
+  lms_host::http_route("https://executor.bench/slow",
+                       [](const lms_host::HttpRequest &request) {
+                         std::this_thread::sleep_for(
+                             std::chrono::milliseconds(run_ms + tick_ms));
+                         return lms_host::HttpResponse{200, "", "text/plain"};
+                       });
+  static lms::HttpEngine engine;
+  lms::HttpEngineRequest request = {
+      "GET", "https://executor.bench/slow", NULL, NULL, NULL,
+      lms::HTTP_PRIORITY_NORMAL, run_ms * 4};
+  bool answered = false;
+  engine.submit(request,
+                [&answered](int code, Stream &body) { answered = true; });
+  executor.setup(&engine);
+  ticks = produced = 0;
+  total_latency_us = max_tick_latency_us = 0;
+  ticker_handle = executor.spawn("ticker", ticker, 2048);
+  executor.start("executor_wake_in_flight", 1, tskNO_AFFINITY);
+  TimerHandle_t timer =
+      xTimerCreate("executor_wake_in_flight", pdMS_TO_TICKS(tick_ms), true,
+                   NULL, tick_timer);
+  xTimerStart(timer, 0);
+  vTaskDelay(run_ms);
+  xTimerDelete(timer, 0);
+  bool in_flight = engine.pending() > 0;
+  executor.stop();
+  engine.cancel();
+  lms_host::install_fixture_routes();
+
+  uint32_t expected_ticks = run_ms / tick_ms;
+  lms::HttpEngineStats stats = engine.get_stats();
+  char extra[192];
+  snprintf(extra, sizeof(extra),
+           "%u ticks with a request in flight, latency avg %.0f us, max "
+           "%.0f us (engine poll slice %u ms), %u polls woken",
+           ticks, ticks ? (double)total_latency_us / ticks : 0.0,
+           (double)max_tick_latency_us, EXECUTOR_ENGINE_POLL_MS,
+           stats.wakes);
+  // a wake may not wait for the poll slice to run out
+  if (!in_flight || answered || ticks < expected_ticks - 2 ||
+      max_tick_latency_us > EXECUTOR_ENGINE_POLL_MS * 1000 / 10) {
+    lms_bench::fail("executor_wake_in_flight", extra);
+    return;
+  }
+  lms_bench::report("executor_wake_in_flight", ticks,
+                    (double)total_latency_us * 1000 / ticks, extra);
+}
@@ -0,0 +1,273 @@
+// The MBTA predictions and what Spotify is playing, gzipped as the servers
+// send them when asked, against the plain JSON the clients used to get. Both
+// are read through a ResponseBody into the JSON extractor, which must find
+// the same values either way.
+//
+// The bodies arrive over a link of link_bytes_per_sec in TCP segments, slow
+// as the sign's 2.4 GHz WiFi is when it is busy. Download is from the
+// request to the last value found. Inflate is the cost of reading the body
+// from memory, gzipped against plain.
+//
+// The body is never held whole: the heap peak while reading the predictions
+// and a body many times their size must be the same, the inflater's window
+// and tables.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/client/json.h"
+#include "../../src/client/response-body.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int link_bytes_per_sec = 64 * 1024;
+const int segment_size = 1436;
+const int runs = 5;
+// copies of the predictions in the large body
+const int large_copies = 16;
+
+const char *const mbta_fields[] = {
+    "data[].attributes.arrival_time",
+    "data[].attributes.departure_time",
+    "data[].attributes.direction_id",
+    "data[].attributes.status",
+    "data[].relationships.trip.data.id",
+    "included[].id",
+    "included[].attributes.headsign",
+};
+
+const char *const spotify_fields[] = {
+    "item.name",
+    "item.artists[].name",
+    "item.duration_ms",
+    "progress_ms",
+    "item.album.images[].url",
+    "item.album.images[].width",
+    "item.album.images[].height",
+};
+
+const char *const large_fields[] = {
+    "pages[].data[].id",
+};
+
+// A response body that arrives a segment at a time from when it is created.
+// readBytes waits for the first of the bytes asked for, as a socket does.
+class ArrivingStream : public Stream {
+  const std::string &body;
+  size_t pos = 0;
+  Clock::time_point start = Clock::now();
+
+  size_t arrived() {
+    double sec = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t segments = (size_t)(sec * link_bytes_per_sec / segment_size);
+    return std::min(body.size(), segments * segment_size);
+  }
+
+ public:
+  explicit ArrivingStream(const std::string &body) : body(body) {}
+
+  int available() override { return arrived() - pos; }
+  int read() override {
+    uint8_t c;
+    return this->readBytes(&c, 1) ? c : -1;
+  }
+  int peek() override { return -1; }
+  size_t readBytes(uint8_t *buffer, size_t length) override {
+    if (pos == body.size()) {
+      return 0;
+    }
+    while (arrived() == pos) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    size_t n = std::min(length, arrived() - pos);
+    memcpy(buffer, body.data() + pos, n);
+    pos += n;
+    return n;
+  }
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 0; }
+};
+
+class MemoryStream : public Stream {
+  const std::string &body;
+  size_t pos = 0;
+
+ public:
+  explicit MemoryStream(const std::string &body) : body(body) {}
+
+  int available() override { return body.size() - pos; }
+  int read() override { return pos < body.size() ? body[pos++] : -1; }
+  int peek() override { return pos < body.size() ? body[pos] : -1; }
+  size_t readBytes(uint8_t *buffer, size_t length) override {
+    size_t n = std::min(length, body.size() - pos);
+    memcpy(buffer, body.data() + pos, n);
+    pos += n;
+    return n;
+  }
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 0; }
+};
+
+struct Read {
+  lms::JsonStatus status;
+  std::vector<std::string> values;
+};
+
+// Reads body as the clients do, keeping the values found
+Read read_body(Stream &stream, bool gzipped, const char *const *fields,
+               int num_fields, EncodingStats *stats) {
+  Read read;
+  lms::ResponseBody body(stream, gzipped, stats);
+  lms::JsonExtractor extractor(fields, num_fields);
+  read.status =
+      extractor.extract(body, [&read](int field, const lms::JsonValue &value) {
+        read.values.push_back(std::to_string(field) + "/" +
+                              std::to_string(value.index) + "=" + value.text);
+      });
+  return read;
+}
+
+double download_ms(const std::string &body, bool gzipped,
+                   const char *const *fields, int num_fields) {
+  std::vector<double> times;
+  for (int i = 0; i < runs; i++) {
+    EncodingStats stats = {};
+    Clock::time_point start = Clock::now();
+    ArrivingStream stream(body);
+    read_body(stream, gzipped, fields, num_fields, &stats);
+    times.push_back(
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count());
+  }
+  std::sort(times.begin(), times.end());
+  return times[runs / 2];
+}
+
+void compare(const char *name, const std::string &payload,
+             const char *const *fields, int num_fields) {
+  std::string gzipped = lms_host::gzip(payload);
+  char extra[192];
+  if (gzipped.empty()) {
+    lms_bench::report(name, 0, 0, "skipped, the host build has no zlib");
+    return;
+  }
+
+  EncodingStats plain_stats = {};
+  EncodingStats gzip_stats = {};
+  MemoryStream plain_stream(payload);
+  MemoryStream gzip_stream(gzipped);
+  Read plain =
+      read_body(plain_stream, false, fields, num_fields, &plain_stats);
+  Read inflated =
+      read_body(gzip_stream, true, fields, num_fields, &gzip_stats);
+  if (plain.status != lms::JSON_STATUS_OK ||
+      inflated.status != lms::JSON_STATUS_OK || plain.values.empty() ||
+      inflated.values != plain.values || gzip_stats.failed > 0 ||
+      gzip_stats.wire_bytes != gzipped.size() ||
+      gzip_stats.decoded_bytes != payload.size()) {
+    snprintf(extra, sizeof(extra),
+             "%s: %zu values, plain %zu; read %u of %zu bytes, decoded %u "
+             "of %zu",
+             lms::json_status_to_str(inflated.status), inflated.values.size(),
+             plain.values.size(), gzip_stats.wire_bytes, gzipped.size(),
+             gzip_stats.decoded_bytes, payload.size());
+    lms_bench::fail(name, extra);
+    return;
+  }
+
+  double plain_download = download_ms(payload, false, fields, num_fields);
+  double gzip_download = download_ms(gzipped, true, fields, num_fields);
+  EncodingStats stats = {};
+  double plain_ns = lms_bench::time_per_op_ns(300, [&] {
+    MemoryStream stream(payload);
+    read_body(stream, false, fields, num_fields, &stats);
+  });
+  double gzip_ns = lms_bench::time_per_op_ns(300, [&] {
+    MemoryStream stream(gzipped);
+    read_body(stream, true, fields, num_fields, &stats);
+  });
+  snprintf(extra, sizeof(extra),
+           "%zu bytes on the wire for %zu (%.1fx), download %.0f ms (plain "
+           "%.0f ms), inflate %.0f us (plain %.0f us)",
+           gzipped.size(), payload.size(),
+           (double)payload.size() / gzipped.size(), gzip_download,
+           plain_download, gzip_ns / 1e3, plain_ns / 1e3);
+  lms_bench::report(name, 300, gzip_ns, extra);
+}
+
+}  // namespace
+
+LMS_BENCH(gzip_mbta_predictions) {
+  compare("gzip_mbta_predictions", lms_host::mbta_fixture(), mbta_fields,
+          sizeof(mbta_fields) / sizeof(mbta_fields[0]));
+}
+
+LMS_BENCH(gzip_spotify_playing) {
+  compare("gzip_spotify_playing", lms_host::spotify_fixture(), spotify_fields,
+          sizeof(spotify_fields) / sizeof(spotify_fields[0]));
+}
+
+LMS_BENCH(gzip_window) {
+  const std::string &small = lms_host::mbta_fixture();
+  std::string large = "{\"pages\":[";
+  for (int i = 0; i < large_copies; i++) {
+    large += (i ? "," : "") + small;
+  }
+  large += "]}";
+  std::string small_gzipped = lms_host::gzip(small);
+  std::string large_gzipped = lms_host::gzip(large);
+  if (small_gzipped.empty()) {
+    lms_bench::report("gzip_window", 0, 0,
+                      "skipped, the host build has no zlib");
+    return;
+  }
+
+  EncodingStats stats = {};
+  MemoryStream small_stream(small_gzipped);
+  lms_bench::reset_heap_peak();
+  {
+    lms::ResponseBody body(small_stream, true, &stats);
+    lms::JsonExtractor extractor(mbta_fields, 1);
+    extractor.extract(body, [](int, const lms::JsonValue &) {});
+  }
+  size_t small_heap = lms_bench::heap_peak();
+
+  MemoryStream large_stream(large_gzipped);
+  size_t found = 0;
+  lms_bench::reset_heap_peak();
+  lms::JsonStatus status;
+  {
+    lms::ResponseBody body(large_stream, true, &stats);
+    lms::JsonExtractor extractor(large_fields, 1);
+    status = extractor.extract(
+        body, [&found](int, const lms::JsonValue &) { found++; });
+  }
+  size_t large_heap = lms_bench::heap_peak();
+
+  char extra[160];
+  if (status != lms::JSON_STATUS_OK || found == 0 ||
+      large_heap != small_heap || large_heap >= large.size()) {
+    snprintf(extra, sizeof(extra),
+             "%s, %zu values; heap peak %zu B for %zu bytes, %zu B for %zu",
+             lms::json_status_to_str(status), found, small_heap, small.size(),
+             large_heap, large.size());
+    lms_bench::fail("gzip_window", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "heap peak %zu B reading %zu bytes and %zu bytes (device: %u B "
+           "window and 11 KB of tables)",
+           large_heap, small.size(), large.size(), TINFL_LZ_DICT_SIZE);
+  lms_bench::report("gzip_window", 1, 0, extra);
+}
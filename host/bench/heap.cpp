@@ -0,0 +1,57 @@
+// Counts the bytes held through operator new, for lms_bench::heap_peak().
+// Every block carries its size in a header in front of it.
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include "bench.h"
+
+namespace {
+
+const size_t header_size = alignof(std::max_align_t);
+
+std::atomic<size_t> in_use{0};
+std::atomic<size_t> peak{0};
+std::atomic<size_t> baseline{0};
+
+void *allocate(size_t size) {
+  char *block = (char *)malloc(size + header_size);
+  if (!block) throw std::bad_alloc();
+  *(size_t *)block = size;
+  size_t now = in_use += size;
+  size_t seen = peak;
+  while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+  }
+  return block + header_size;
+}
+
+void deallocate(void *ptr) {
+  if (!ptr) return;
+  char *block = (char *)ptr - header_size;
+  in_use -= *(size_t *)block;
+  free(block);
+}
+
+}  // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, size_t) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { deallocate(ptr); }
+
+namespace lms_bench {
+
+void reset_heap_peak() {
+  baseline = in_use.load();
+  peak = baseline.load();
+}
+
+size_t heap_peak() { return peak - baseline; }
+
+}  // namespace lms_bench
@@ -0,0 +1,299 @@
+// The requests of a provider tick made one after the other, as the blocking
+// clients make them, against the same requests through the HTTP engine, with
+// the stand-in server answering every request after latency_ms.
+//
+// The MBTA predictions, what Spotify is playing and the next song in its
+// queue used to take three round trips one after the other. Through the
+// engine they are in flight at once, and must be read the same.
+//
+// Then a burst of more requests than the engine has connections, some of them
+// urgent, and one that cannot make its deadline: the urgent ones must be
+// answered before the others that were queued, and the late one must time
+// out without holding up the rest.
+//
+// Last, requests to hosts that take dns_latency_ms to look up: poll() must
+// keep returning every few millis meanwhile, where the lookup used to block
+// it, a host must only be looked up once, and one that does not resolve must
+// fail its request.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "../../src/client/http-engine.h"
+#include "../../src/mbta/mbta.h"
+#include "../../src/spotify/spotify.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t latency_ms = 150;
+const uint32_t dns_latency_ms = 200;
+const int runs = 5;
+
+struct Tick {
+  Prediction predictions[2];
+  SpotifyResponse playing_status;
+  CurrentlyPlaying playing;
+  SpotifyResponse next_status;
+  CurrentlyPlaying next;
+  double ms;
+};
+
+double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+Tick blocking_tick(MBTA *mbta, Spotify *spotify) {
+  Tick tick;
+  Clock::time_point start = Clock::now();
+  mbta->set_station(TRAIN_STATION_PARK_STREET);
+  mbta->get_predictions_both_directions(tick.predictions);
+  tick.playing_status =
+      spotify->get_currently_playing(&tick.playing, lms_host::now_ms());
+  tick.next_status = spotify->get_next_song(&tick.next);
+  tick.ms = ms_since(start);
+  return tick;
+}
+
+Tick engine_tick(lms::HttpEngine *engine, MBTA *mbta, Spotify *spotify) {
+  Tick tick;
+  Clock::time_point start = Clock::now();
+  mbta->set_station(TRAIN_STATION_PARK_STREET);
+  mbta->get_predictions_both_directions(tick.predictions);
+  spotify->request_currently_playing(
+      [&tick](SpotifyResponse status, CurrentlyPlaying *song) {
+        tick.playing_status = status;
+        tick.playing = *song;
+      });
+  spotify->request_next_song(
+      [&tick](SpotifyResponse status, CurrentlyPlaying *song) {
+        tick.next_status = status;
+        tick.next = *song;
+      });
+  while (engine->pending() > 0) {
+    engine->poll(1000);
+  }
+  mbta->get_predictions_both_directions(tick.predictions);
+  tick.ms = ms_since(start);
+  return tick;
+}
+
+bool same_tick(const Tick &a, const Tick &b) {
+  for (int i = 0; i < 2; i++) {
+    if (strcmp(a.predictions[i].label, b.predictions[i].label) != 0 ||
+        strcmp(a.predictions[i].value, b.predictions[i].value) != 0) {
+      return false;
+    }
+  }
+  return a.playing_status == b.playing_status &&
+         strcmp(a.playing.title, b.playing.title) == 0 &&
+         strcmp(a.playing.cover.url, b.playing.cover.url) == 0 &&
+         a.next_status == b.next_status &&
+         strcmp(a.next.title, b.next.title) == 0;
+}
+
+double median_ms(Tick *ticks) {
+  std::sort(ticks, ticks + runs,
+            [](const Tick &a, const Tick &b) { return a.ms < b.ms; });
+  return ticks[runs / 2].ms;
+}
+
+}  // namespace
+
+LMS_BENCH(http_engine_overlap) {
+  static MBTA blocking_mbta;
+  static Spotify blocking_spotify;
+  static MBTA engine_mbta;
+  static Spotify engine_spotify;
+  static lms::HttpEngine engine;
+  blocking_mbta.setup();
+  blocking_spotify.setup();
+  engine_mbta.setup();
+  engine_spotify.setup();
+  engine_mbta.use_engine(&engine);
+  engine_spotify.use_engine(&engine);
+
+  // both ticks of a run must see the same countdowns
+  lms_host::set_wall_clock(time(nullptr));
+  lms_host::http_set_latency_ms(latency_ms);
+  Tick blocking[runs];
+  Tick engined[runs];
+  for (int i = 0; i < runs; i++) {
+    blocking[i] = blocking_tick(&blocking_mbta, &blocking_spotify);
+    engined[i] = engine_tick(&engine, &engine_mbta, &engine_spotify);
+  }
+  lms_host::http_set_latency_ms(0);
+  lms_host::set_wall_clock(0);
+
+  char extra[192];
+  for (int i = 0; i < runs; i++) {
+    if (engined[i].playing_status != SPOTIFY_RESPONSE_OK ||
+        !same_tick(blocking[i], engined[i])) {
+      snprintf(extra, sizeof(extra),
+               "tick %d read differently through the engine (playing %d, "
+               "next %d)",
+               i, engined[i].playing_status, engined[i].next_status);
+      lms_bench::fail("http_engine_overlap", extra);
+      return;
+    }
+  }
+  double blocking_ms = median_ms(blocking);
+  double engine_ms = median_ms(engined);
+  lms::HttpEngineStats stats = engine.get_stats();
+  snprintf(extra, sizeof(extra),
+           "3 requests at %u ms: %.0f ms (one after the other: %.0f ms), "
+           "%u connections opened, %u reused, %u in flight",
+           latency_ms, engine_ms, blocking_ms, stats.connections_opened,
+           stats.connections_reused, stats.max_in_flight);
+  lms_bench::report("http_engine_overlap", runs, engine_ms * 1e6, extra);
+}
+
+LMS_BENCH(http_engine_priority) {
+  // answers after the number of millis in the url
+  lms_host::http_route("https://engine.bench/",
+                       [](const lms_host::HttpRequest &request) {
+                         const char *ms = strrchr(request.url.c_str(), '/');
+                         std::this_thread::sleep_for(
+                             std::chrono::milliseconds(atoi(ms + 1)));
+                         return lms_host::HttpResponse{200, request.url,
+                                                       "text/plain"};
+                       });
+  static lms::HttpEngine engine;
+  struct Burst {
+    const char *url;
+    lms::HttpPriority priority;
+    uint32_t timeout_ms;
+  };
+  // The first three take the connections before the rest are queued. In the
+  // order they came, the urgent one would only go once c or d is done.
+  const Burst burst[] = {
+      {"https://engine.bench/a/100", lms::HTTP_PRIORITY_LOW, 5000},
+      {"https://engine.bench/b/100", lms::HTTP_PRIORITY_LOW, 5000},
+      {"https://engine.bench/late/1000", lms::HTTP_PRIORITY_NORMAL, 200},
+      {"https://engine.bench/c/100", lms::HTTP_PRIORITY_LOW, 5000},
+      {"https://engine.bench/d/100", lms::HTTP_PRIORITY_LOW, 5000},
+      {"https://engine.bench/urgent/10", lms::HTTP_PRIORITY_HIGH, 5000},
+  };
+  const int count = sizeof(burst) / sizeof(burst[0]);
+  int codes[count];
+  double done_ms[count];
+  int order[count];
+  int finished = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; i++) {
+    lms::HttpEngineRequest request = {"GET", burst[i].url, NULL,
+                                      NULL,  NULL,         burst[i].priority,
+                                      burst[i].timeout_ms};
+    engine.submit(request, [&, i](int code, Stream &body) {
+      codes[i] = code;
+      done_ms[i] = ms_since(start);
+      order[finished++] = i;
+    });
+    if (i == 2) {
+      engine.poll(0);
+    }
+  }
+  while (engine.pending() > 0) {
+    engine.poll(1000);
+  }
+  lms_host::install_fixture_routes();
+
+  const int urgent = 5;
+  const int late = 2;
+  int urgent_at = std::find(order, order + count, urgent) - order;
+  int queued_before = 0;
+  for (int i = 0; i < urgent_at; i++) {
+    queued_before += order[i] == 3 || order[i] == 4;
+  }
+  char extra[160];
+  bool answered = true;
+  for (int i = 0; i < count; i++) {
+    answered &= i == late || codes[i] == 200;
+  }
+  if (!answered || codes[late] != HTTPC_ERROR_READ_TIMEOUT ||
+      queued_before > 0 || done_ms[late] > 400) {
+    snprintf(extra, sizeof(extra),
+             "late request ended with %d after %.0f ms, %d queued requests "
+             "answered before the urgent one",
+             codes[late], done_ms[late], queued_before);
+    lms_bench::fail("http_engine_priority", extra);
+    return;
+  }
+  double all_ms = *std::max_element(done_ms, done_ms + count);
+  snprintf(extra, sizeof(extra),
+           "%d requests on %d connections in %.0f ms, urgent answered after "
+           "%.0f ms, late one timed out after %.0f ms",
+           count, HTTP_ENGINE_MAX_CONNECTIONS, all_ms, done_ms[urgent],
+           done_ms[late]);
+  lms_bench::report("http_engine_priority", count, all_ms * 1e6 / count,
+                    extra);
+}
+
+LMS_BENCH(http_engine_dns) {
+  lms_host::http_route("https://dns.bench/",
+                       [](const lms_host::HttpRequest &request) {
+                         return lms_host::HttpResponse{200, request.url,
+                                                       "text/plain"};
+                       });
+  static lms::HttpEngine engine;
+  lms_host::dns_set_latency_ms(dns_latency_ms);
+  uint32_t lookups_before = lms_host::dns_stats().lookups;
+  const char *urls[] = {"https://dns.bench/first", "https://nowhere.invalid/",
+                        "https://dns.bench/second"};
+  const int count = sizeof(urls) / sizeof(urls[0]);
+  int codes[count];
+  double done_ms[count];
+  double longest_poll_ms = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; i++) {
+    if (i == count - 1) {
+      // the first connection is closed on its next request, and the one
+      // opened in its place uses the address kept
+      lms_host::http_drop_connections();
+    }
+    lms::HttpEngineRequest request = {"GET", urls[i], NULL, NULL, NULL,
+                                      lms::HTTP_PRIORITY_NORMAL, 5000};
+    codes[i] = 0;
+    engine.submit(request, [&, i](int code, Stream &body) {
+      codes[i] = code;
+      done_ms[i] = ms_since(start);
+    });
+    while (engine.pending() > 0) {
+      Clock::time_point poll_start = Clock::now();
+      engine.poll(1000);
+      longest_poll_ms = std::max(longest_poll_ms, ms_since(poll_start));
+    }
+  }
+  lms_host::dns_set_latency_ms(0);
+  lms_host::install_fixture_routes();
+
+  lms::HttpEngineStats stats = engine.get_stats();
+  uint32_t lookups = lms_host::dns_stats().lookups - lookups_before;
+  char extra[192];
+  if (codes[0] != 200 || codes[1] != HTTPC_ERROR_CONNECTION_REFUSED ||
+      codes[2] != 200 || lookups != 2 || stats.lookups != 2 ||
+      longest_poll_ms > 5 * HTTP_ENGINE_RESOLVE_POLL_MS) {
+    snprintf(extra, sizeof(extra),
+             "requests ended with %d, %d and %d, %u lookups, a poll took up "
+             "to %.0f ms",
+             codes[0], codes[1], codes[2], lookups, longest_poll_ms);
+    lms_bench::fail("http_engine_dns", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "lookups of %u ms: answered after %.0f ms, a poll took up to "
+           "%.0f ms (blocking: %u ms), %u lookups for %u connections",
+           dns_latency_ms, done_ms[0], longest_poll_ms, dns_latency_ms,
+           lookups, stats.connections_opened);
+  lms_bench::report("http_engine_dns", count, done_ms[0] * 1e6, extra);
+}
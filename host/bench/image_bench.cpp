@@ -0,0 +1,121 @@
+// Album covers handed from the cover loader to the render task while both run,
+// on threads of their own. The loader draws covers of one color each, pixel
+// by pixel as the JPEG decoder does, and publishes them; the render task
+// draws whatever cover it has on every frame. A frame is torn if the cover it
+// draws has pixels of two covers.
+//
+// The two images flipped in place, as before, let the loader draw into the
+// image the render task was still drawing from. The triple buffer must never
+// tear.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../../src/display/display.h"
+#include "../../src/display/triple-buffer.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+const int covers = 20000;
+
+uint16_t cover_color(int i) { return (uint16_t)(i % 0xFFFF + 1); }
+
+void draw_cover(AlbumImage *image, int i) {
+  image->url[0] = '\0';
+  for (int y = 0; y < 32; y++) {
+    for (int x = 0; x < 32; x++) {
+      image->image.drawPixel(x, y, cover_color(i));
+    }
+  }
+  snprintf(image->url, sizeof(image->url), "%d", i);
+}
+
+// Draws image onto frame as the render task does, then checks that every
+// pixel is of one cover.
+bool draw_frame(const AlbumImage &image, GFXcanvas16 *frame) {
+  frame->drawRGBBitmap(0, 0, image.image.getBuffer(), 32, 32);
+  const uint16_t *pixels = frame->getBuffer();
+  for (int i = 1; i < 32 * 32; i++) {
+    if (pixels[i] != pixels[0]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Handoff {
+  int frames = 0;
+  int torn = 0;
+  double ns = 0;  // per cover
+};
+
+// Runs draw and publish on a loader thread and frame on this one until every
+// cover is published.
+template <typename Draw, typename Frame>
+Handoff run_handoff(Draw draw, Frame frame) {
+  Handoff result;
+  std::atomic<bool> done(false);
+  auto start = std::chrono::steady_clock::now();
+  std::thread loader([&] {
+    for (int i = 0; i < covers; i++) {
+      draw(i);
+    }
+    done = true;
+  });
+  static GFXcanvas16 canvas(32, 32);
+  while (!done) {
+    result.frames++;
+    if (!frame(&canvas)) {
+      result.torn++;
+    }
+  }
+  loader.join();
+  result.ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() /
+              covers;
+  return result;
+}
+
+}  // namespace
+
+LMS_BENCH(album_image_handoff) {
+  static AlbumImage flipped[2];
+  std::atomic<uint8_t> shown(0);
+  Handoff flip = run_handoff(
+      [&](int i) {
+        draw_cover(&flipped[1 - shown], i);
+        shown = 1 - shown;
+      },
+      [&](GFXcanvas16 *canvas) {
+        return draw_frame(flipped[shown], canvas);
+      });
+
+  static TripleBuffer<AlbumImage> images;
+  Handoff triple = run_handoff(
+      [&](int i) {
+        draw_cover(&images.get_back(), i);
+        images.publish();
+      },
+      [&](GFXcanvas16 *canvas) {
+        images.update();
+        return draw_frame(images.get_front(), canvas);
+      });
+
+  char extra[128];
+  if (triple.torn > 0) {
+    snprintf(extra, sizeof(extra), "%d of %d frames torn", triple.torn,
+             triple.frames);
+    lms_bench::fail("album_image_handoff", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra), "%d frames, %d torn (flipped: %d of %d)",
+           triple.frames, triple.torn, flip.torn, flip.frames);
+  lms_bench::report("album_image_handoff", covers, triple.ns, extra);
+}
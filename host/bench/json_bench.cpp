@@ -0,0 +1,222 @@
+// The streaming JSON extractor against the filtered document the clients used
+// before, on the recorded Park Street and Spotify payloads. Both must find the
+// same values; the extractor should parse faster and hold no heap.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <ArduinoJson.h>
+#include <WiFiClient.h>
+
+#include "../../src/client/json.h"
+#include "../routes.h"
+#include "bench.h"
+
+namespace {
+
+const char *const mbta_fields[] = {
+    "data[].attributes.arrival_time",
+    "data[].attributes.departure_time",
+    "data[].attributes.direction_id",
+    "data[].attributes.status",
+    "data[].relationships.trip.data.id",
+    "included[].id",
+    "included[].attributes.headsign",
+};
+
+const char *const spotify_fields[] = {
+    "item.name",
+    "item.artists[].name",
+    "item.duration_ms",
+    "progress_ms",
+    "item.album.images[].url",
+    "item.album.images[].width",
+    "item.album.images[].height",
+};
+
+// A value as field/index=text, so both paths can be compared as sets
+typedef std::vector<std::string> Values;
+
+std::string format_value(int field, int index, const std::string &text) {
+  return std::to_string(field) + "/" + std::to_string(index) + "=" + text;
+}
+
+// The path split at dots, with a trailing [] marking arrays.
+std::vector<std::string> split_path(const char *path) {
+  std::vector<std::string> keys;
+  std::string key;
+  for (const char *c = path; *c; c++) {
+    if (*c == '.') {
+      keys.push_back(key);
+      key.clear();
+    } else {
+      key += *c;
+    }
+  }
+  keys.push_back(key);
+  return keys;
+}
+
+bool is_array_key(const std::string &key) {
+  return key.size() > 2 && key.compare(key.size() - 2, 2, "[]") == 0;
+}
+
+std::string node_text(const lms_host_json::Node *node) {
+  switch (node->type) {
+    case lms_host_json::Node::Str:
+      return node->s;
+    case lms_host_json::Node::Int:
+      return std::to_string(node->i);
+    case lms_host_json::Node::Bool:
+      return node->b ? "true" : "false";
+    case lms_host_json::Node::Float: {
+      char text[32];
+      snprintf(text, sizeof(text), "%g", node->f);
+      return text;
+    }
+    default:
+      return "null";
+  }
+}
+
+// Calls f(index, node) for every scalar at keys[pos..] below node.
+template <typename F>
+void walk(lms_host_json::Node *node, const std::vector<std::string> &keys,
+          size_t pos, int index, F &f) {
+  if (!node) return;
+  if (pos == keys.size()) {
+    if (node->type != lms_host_json::Node::Object &&
+        node->type != lms_host_json::Node::Array) {
+      f(index, node);
+    }
+    return;
+  }
+  const std::string &key = keys[pos];
+  if (!is_array_key(key)) {
+    walk(node->member(key.c_str(), false), keys, pos + 1, index, f);
+    return;
+  }
+  lms_host_json::Node *array =
+      node->member(key.substr(0, key.size() - 2).c_str(), false);
+  if (!array || array->type != lms_host_json::Node::Array) return;
+  for (size_t i = 0; i < array->items.size(); i++) {
+    walk(array->items[i].get(), keys, pos + 1, (int)i, f);
+  }
+}
+
+// The filtered document path, as the clients had it: build the filter,
+// deserialize into a document, then look up every field.
+template <typename F>
+void parse_document(WiFiClient &stream, const char *const *fields,
+                    int num_fields, F f) {
+  StaticJsonDocument<1024> filter;
+  for (int i = 0; i < num_fields; i++) {
+    JsonVariant v = filter;
+    for (const std::string &key : split_path(fields[i])) {
+      v = is_array_key(key) ? v[key.substr(0, key.size() - 2)][0] : v[key];
+    }
+    v = true;
+  }
+  DynamicJsonDocument doc(8192);
+  if (deserializeJson(doc, stream, DeserializationOption::Filter(filter))) {
+    return;
+  }
+  for (int i = 0; i < num_fields; i++) {
+    auto found = [&](int index, const lms_host_json::Node *node) {
+      f(i, index, node);
+    };
+    walk(doc.host_root(), split_path(fields[i]), 0, -1, found);
+  }
+}
+
+lms::JsonStatus parse_stream(WiFiClient &stream, const char *const *fields,
+                             int num_fields,
+                             const lms::JsonFieldHandler &handler) {
+  lms::JsonExtractor extractor(fields, num_fields);
+  return extractor.extract(stream, handler);
+}
+
+void compare(const char *name, const std::string &payload,
+             const char *const *fields, int num_fields,
+             const char *device_document) {
+  // the payload is copied into the connection before the heap is counted
+  WiFiClient stream;
+  Values expected;
+  stream.host_receive(payload);
+  parse_document(stream, fields, num_fields,
+                 [&](int field, int index, const lms_host_json::Node *node) {
+                   expected.push_back(
+                       format_value(field, index, node_text(node)));
+                 });
+  Values found;
+  stream.host_receive(payload);
+  lms::JsonStatus status = parse_stream(
+      stream, fields, num_fields,
+      [&](int field, const lms::JsonValue &value) {
+        found.push_back(format_value(field, value.index, value.text));
+      });
+  std::sort(expected.begin(), expected.end());
+  std::sort(found.begin(), found.end());
+  char label[64];
+  char extra[128];
+  if (status != lms::JSON_STATUS_OK || expected.empty() || found != expected) {
+    snprintf(extra, sizeof(extra), "%s, %zu values, document found %zu",
+             lms::json_status_to_str(status), found.size(), expected.size());
+    lms_bench::fail(name, extra);
+    return;
+  }
+
+  // the values are only counted while timing, so that collecting them costs
+  // next to nothing on both paths
+  size_t count = 0;
+  stream.host_receive(payload);
+  lms_bench::reset_heap_peak();
+  parse_document(stream, fields, num_fields,
+                 [&](int, int, const lms_host_json::Node *) { count++; });
+  size_t document_heap = lms_bench::heap_peak();
+  double document_ns = lms_bench::time_per_op_ns(300, [&] {
+    stream.host_receive(payload);
+    parse_document(stream, fields, num_fields,
+                   [&](int, int, const lms_host_json::Node *) { count++; });
+  });
+  snprintf(label, sizeof(label), "%s_document", name);
+  snprintf(extra, sizeof(extra), "%zu values, heap peak %zu B (device: %s)",
+           expected.size(), document_heap, device_document);
+  lms_bench::report(label, 300, document_ns, extra);
+
+  lms::JsonFieldHandler counter = [&](int, const lms::JsonValue &) {
+    count++;
+  };
+  stream.host_receive(payload);
+  lms_bench::reset_heap_peak();
+  parse_stream(stream, fields, num_fields, counter);
+  size_t stream_heap = lms_bench::heap_peak();
+  double stream_ns = lms_bench::time_per_op_ns(300, [&] {
+    stream.host_receive(payload);
+    parse_stream(stream, fields, num_fields, counter);
+  });
+  snprintf(label, sizeof(label), "%s_stream", name);
+  snprintf(extra, sizeof(extra),
+           "%zu values, heap peak %zu B (device: %zu B extractor on the "
+           "stack), %.1fx",
+           found.size(), stream_heap, sizeof(lms::JsonExtractor),
+           document_ns / stream_ns);
+  lms_bench::report(label, 300, stream_ns, extra);
+  if (stream_heap >= document_heap) {
+    lms_bench::fail(label, "extractor used as much heap as the document");
+  }
+}
+
+}  // namespace
+
+LMS_BENCH(json_extract) {
+  compare("json_mbta", lms_host::mbta_fixture(), mbta_fields,
+          sizeof(mbta_fields) / sizeof(mbta_fields[0]),
+          "8192 B document, 1024 B filter on the stack");
+  compare("json_spotify", lms_host::spotify_fixture(),
+          spotify_fields, sizeof(spotify_fields) / sizeof(spotify_fields[0]),
+          "2048 B document, 1024 B filter on the stack");
+}
@@ -0,0 +1,199 @@
+// What the sign last showed, saved to NVS and read back at boot.
+//
+// last_known_round_trip saves predictions, a song and its cover, and reads
+// them back through a fresh LastKnown, as after a restart. Records of
+// another version, another station or older than their maximum age must not
+// come back.
+//
+// last_known_write_rate runs an hour of the sign: new predictions every
+// second and a new song every three minutes, its cover two seconds later.
+// Flash must see a record at most once per LAST_KNOWN_WRITE_INTERVAL,
+// whatever the sign shows, and the song on it must come with its cover.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <Preferences.h>
+
+#include "../../src/storage/last-known.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+const int hour_sec = 60 * 60;
+const int song_sec = 3 * 60;
+
+void fill_cover(GFXcanvas16 *canvas, uint16_t seed) {
+  uint16_t *pixels = canvas->getBuffer();
+  for (int i = 0; i < canvas->width() * canvas->height(); i++) {
+    pixels[i] = seed + i * 31;
+  }
+}
+
+CurrentlyPlaying make_song(int n) {
+  CurrentlyPlaying song = {};
+  snprintf(song.title, sizeof(song.title), "Song %d", n);
+  snprintf(song.artist, sizeof(song.artist), "Artist %d", n);
+  song.duration_ms = 180000 + n;
+  song.progress_ms = 1000 * n;
+  song.is_playing = true;
+  snprintf(song.cover.url, sizeof(song.cover.url),
+           "https://i.scdn.co/image/cover-%d", n);
+  song.cover.width = 64;
+  song.cover.height = 64;
+  return song;
+}
+
+// A predictions record as LastKnown writes it, saved at saved_at
+void put_predictions_record(uint8_t version, uint32_t saved_at,
+                            TrainStation station) {
+  uint8_t data[32];
+  size_t n = 0;
+  data[n++] = version;
+  memcpy(data + n, &saved_at, 4);
+  n += 4;
+  data[n++] = station;
+  const char *fields[] = {"Ashmont", "3 min", "Alewife", "5 min"};
+  for (const char *field : fields) {
+    data[n++] = strlen(field);
+    memcpy(data + n, field, strlen(field));
+    n += strlen(field);
+  }
+  Preferences flash;
+  flash.begin(LAST_KNOWN_NAMESPACE);
+  flash.putBytes("lk-predictions", data, n);
+}
+
+}  // namespace
+
+LMS_BENCH(last_known_round_trip) {
+  Prediction predictions[2] = {{"Ashmont", "3 min"}, {"Alewife", "Arriving"}};
+  CurrentlyPlaying song = make_song(7);
+  GFXcanvas16 cover(32, 32);
+  fill_cover(&cover, 7);
+
+  LastKnown saving;
+  saving.setup();
+  saving.save_predictions(TRAIN_STATION_HARVARD, predictions);
+  saving.save_song(song);
+  saving.save_cover(song.cover.url, &cover);
+  saving.flush(0, true);
+  LastKnownStats stats = saving.get_stats();
+
+  LastKnown booting;
+  booting.setup();
+  Prediction read_predictions[2];
+  CurrentlyPlaying read_song;
+  GFXcanvas16 read_cover(32, 32);
+  bool ok = booting.get_predictions(TRAIN_STATION_HARVARD, read_predictions) &&
+            booting.get_song(&read_song) &&
+            booting.get_cover(song.cover.url, &read_cover);
+  for (int i = 0; ok && i < 2; i++) {
+    ok = strcmp(read_predictions[i].label, predictions[i].label) == 0 &&
+         strcmp(read_predictions[i].value, predictions[i].value) == 0;
+  }
+  ok = ok && strcmp(read_song.title, song.title) == 0 &&
+       strcmp(read_song.artist, song.artist) == 0 &&
+       strcmp(read_song.cover.url, song.cover.url) == 0 &&
+       read_song.duration_ms == song.duration_ms &&
+       read_song.progress_ms == song.progress_ms &&
+       read_song.cover.width == song.cover.width &&
+       memcmp(read_cover.getBuffer(), cover.getBuffer(), 32 * 32 * 2) == 0;
+  if (!ok) {
+    lms_bench::fail("last_known_round_trip", "saved records read back wrong");
+    return;
+  }
+
+  // another station, another cover, another version or too old: none
+  Prediction ignored[2];
+  const char *wrong = NULL;
+  if (booting.get_predictions(TRAIN_STATION_DAVIS, ignored)) {
+    wrong = "predictions of another station read back";
+  } else if (booting.get_cover("https://i.scdn.co/image/other", &read_cover)) {
+    wrong = "the cover of another song read back";
+  }
+  put_predictions_record(LAST_KNOWN_VERSION + 1, time(NULL),
+                         TRAIN_STATION_HARVARD);
+  if (!wrong && booting.get_predictions(TRAIN_STATION_HARVARD, ignored)) {
+    wrong = "a record of another version read back";
+  }
+  put_predictions_record(LAST_KNOWN_VERSION,
+                         time(NULL) - LAST_KNOWN_PREDICTIONS_MAX_AGE - 60,
+                         TRAIN_STATION_HARVARD);
+  if (!wrong && booting.get_predictions(TRAIN_STATION_HARVARD, ignored)) {
+    wrong = "predictions too old to show read back";
+  }
+  if (wrong) {
+    lms_bench::fail("last_known_round_trip", wrong);
+    return;
+  }
+
+  double ns = lms_bench::time_per_op_ns(1000, [&] {
+    booting.get_predictions(TRAIN_STATION_HARVARD, read_predictions);
+    booting.get_song(&read_song);
+    booting.get_cover(song.cover.url, &read_cover);
+  });
+  char extra[128];
+  snprintf(extra, sizeof(extra),
+           "%u records, %u bytes written (predictions, song and a 32x32 "
+           "cover)",
+           stats.writes, stats.bytes);
+  lms_bench::report("last_known_round_trip", 1000, ns, extra);
+}
+
+LMS_BENCH(last_known_write_rate) {
+  LastKnown last_known;
+  last_known.setup();
+  GFXcanvas16 cover(32, 32);
+  int saves = 0;
+  for (int sec = 0; sec < hour_sec; sec++) {
+    uint32_t now_ms = sec * 1000;
+    Prediction predictions[2] = {{"Ashmont", ""}, {"Alewife", ""}};
+    snprintf(predictions[0].value, sizeof(predictions[0].value), "%d min",
+             10 - sec % 10);
+    snprintf(predictions[1].value, sizeof(predictions[1].value), "%d min",
+             12 - sec % 12);
+    last_known.save_predictions(TRAIN_STATION_HARVARD, predictions);
+    saves++;
+    if (sec % song_sec == 0) {
+      CurrentlyPlaying song = make_song(sec / song_sec);
+      last_known.save_song(song);
+      saves++;
+    } else if (sec % song_sec == 2) {
+      CurrentlyPlaying song = make_song(sec / song_sec);
+      fill_cover(&cover, sec);
+      last_known.save_cover(song.cover.url, &cover);
+      saves++;
+    }
+    last_known.flush(now_ms);
+  }
+  LastKnown booting;
+  booting.setup();
+  CurrentlyPlaying read_song;
+  bool together = booting.get_song(&read_song) &&
+                  booting.get_cover(read_song.cover.url, &cover);
+  last_known.flush(hour_sec * 1000, true);
+
+  LastKnownStats stats = last_known.get_stats();
+  // three records, each written at most once an interval, and once at the
+  // end when forced
+  uint32_t max_writes =
+      3 * (hour_sec * 1000 / LAST_KNOWN_WRITE_INTERVAL + 1) + 2;
+  char extra[160];
+  snprintf(extra, sizeof(extra),
+           "%u writes, %u bytes an hour for %d saves (%u coalesced), at "
+           "most %u",
+           stats.writes, stats.bytes, saves, stats.coalesced, max_writes);
+  if (stats.writes > max_writes || stats.writes == 0) {
+    lms_bench::fail("last_known_write_rate", extra);
+    return;
+  }
+  if (!together) {
+    lms_bench::fail("last_known_write_rate",
+                    "the song written came without its cover");
+    return;
+  }
+  lms_bench::report("last_known_write_rate", saves, 0, extra);
+}
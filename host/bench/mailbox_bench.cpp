@@ -0,0 +1,152 @@
+// The render mailbox under a provider burst: the render task must get the
+// newest frame, everything older must be counted as coalesced, and the
+// content of coalesced frames must go back to the pool.
+//
+// render_message_bytes compares the bytes copied per rendered frame with the
+// content passed through a FIFO by value, as before the pool, against the
+// handles the mailbox passes now.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/display/mailbox.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+// Bytes copied into and out of every queue so far.
+uint64_t queue_bytes() {
+  uint64_t bytes = 0;
+  for (const lms_host::QueueStats &q : lms_host::queue_stats()) {
+    bytes += (uint64_t)q.item_size * (q.sent + q.received);
+  }
+  return bytes;
+}
+
+// The message as it was before the pool: the content itself went through the
+// queue, and the render_*_content functions took it by value.
+struct CopyingRenderMessage {
+  RenderType type;
+  RenderContent content;
+};
+
+volatile int sink;
+
+template <typename Content>
+void render_by_value(Content content) {
+  sink = ((const char *)&content)[sizeof(content) - 1];
+}
+
+template <typename Content>
+void render_by_reference(const Content &content) {
+  sink = ((const char *)&content)[sizeof(content) - 1];
+}
+
+template <typename Content>
+void compare(const char *name, RenderType type,
+             Content RenderContent::*member) {
+  const int frames = 2000;
+  int iterations = frames + frames / 10 + 1;
+  char label[64];
+  char extra[96];
+
+  QueueHandle_t queue = xQueueCreate(32, sizeof(CopyingRenderMessage));
+  vQueueAddToRegistry(queue, "render_queue");
+  CopyingRenderMessage *copying = new CopyingRenderMessage();
+  uint64_t start = queue_bytes();
+  double ns = lms_bench::time_per_op_ns(frames, [&] {
+    copying->type = type;
+    xQueueSend(queue, copying, 0);
+    CopyingRenderMessage received;
+    xQueueReceive(queue, &received, 0);
+    render_by_value(received.content.*member);
+  });
+  double before = (double)(queue_bytes() - start) / iterations +
+                  sizeof(Content);
+  snprintf(label, sizeof(label), "render_message_bytes_%s_before", name);
+  snprintf(extra, sizeof(extra), "%.0f bytes copied/frame", before);
+  lms_bench::report(label, frames, ns, extra);
+  vQueueDelete(queue);
+  delete copying;
+
+  RenderMailbox *mailbox = new RenderMailbox();
+  mailbox->setup();
+  start = queue_bytes();
+  ns = lms_bench::time_per_op_ns(frames, [&] {
+    RenderMessage message;
+    RenderContent *content = mailbox->acquire(type, &message);
+    if (content == NULL) return;
+    mailbox->send(message);
+    RenderMessage received;
+    if (mailbox->receive(type, &received)) {
+      render_by_reference(mailbox->get_content(received).*member);
+      mailbox->release(received);
+    }
+  });
+  double after = (double)(queue_bytes() - start) / iterations;
+  if (mailbox->get_dropped_count() > 0) {
+    snprintf(label, sizeof(label), "render_message_bytes_%s", name);
+    lms_bench::fail(label, "render content pool ran out");
+    return;
+  }
+  snprintf(label, sizeof(label), "render_message_bytes_%s_after", name);
+  snprintf(extra, sizeof(extra), "%.0f bytes copied/frame, %.0fx fewer", after,
+           before / after);
+  lms_bench::report(label, frames, ns, extra);
+  // the mailbox is left alive: its queues stay in the registry
+}
+
+}  // namespace
+
+LMS_BENCH(mailbox_burst) {
+  static RenderMailbox mailbox;
+  mailbox.setup();
+  const int burst = 32;
+  int frame = 0;
+  int stale = 0;
+  double ns = lms_bench::time_per_op_ns(1000, [&] {
+    for (int i = 0; i < burst; i++) {
+      RenderMessage message;
+      RenderContent *content = mailbox.acquire(RENDER_TYPE_MBTA, &message);
+      if (content == NULL) return;
+      content->mbta.status = PREDICTION_STATUS_OK;
+      snprintf(content->mbta.predictions[0].value, 16, "%d", frame++);
+      mailbox.send(message);
+    }
+    RenderMessage received;
+    if (!mailbox.receive(RENDER_TYPE_MBTA, &received)) {
+      stale++;
+      return;
+    }
+    if (atoi(mailbox.get_content(received).mbta.predictions[0].value) !=
+        frame - 1) {
+      stale++;
+    }
+    mailbox.release(received);
+    if (mailbox.receive(RENDER_TYPE_MBTA, &received)) {
+      stale++;
+    }
+  });
+  if (mailbox.get_dropped_count() > 0) {
+    lms_bench::fail("mailbox_burst", "coalesced content was not released");
+    return;
+  }
+  if (stale > 0) {
+    lms_bench::fail("mailbox_burst",
+                    "render side did not get the newest frame");
+    return;
+  }
+  int bursts = 1000 + 1000 / 10 + 1;
+  char extra[96];
+  snprintf(extra, sizeof(extra),
+           "burst of %d, coalesced %u of %d, pool peak %u", burst,
+           mailbox.get_coalesced_count(), bursts * burst,
+           mailbox.get_pool_peak());
+  lms_bench::report("mailbox_burst", 1000, ns, extra);
+}
+
+LMS_BENCH(render_message_bytes) {
+  compare("mbta", RENDER_TYPE_MBTA, &RenderContent::mbta);
+  compare("music", RENDER_TYPE_MUSIC, &RenderContent::music);
+}
@@ -0,0 +1,100 @@
+// Panel::draw_row against the library's per-pixel path: the DMA buffers must
+// come out bit for bit the same, and the row path should be faster.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "../../common.h"
+#include "../../src/display/panel.h"
+#include "bench.h"
+
+namespace {
+
+class InspectablePanel : public Panel {
+ public:
+  using Panel::Panel;
+
+  // Index of the first DMA word that differs from other, or -1.
+  long first_difference(InspectablePanel &other) {
+    long index = 0;
+    for (int row = 0; row < this->dma_buff.rows; row++) {
+      for (int buff = 0; buff < (this->m_cfg.double_buff ? 2 : 1); buff++) {
+        for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+          ESP32_I2S_DMA_STORAGE_TYPE *a =
+              this->dma_buff.rowBits[row]->getDataPtr(d, buff);
+          ESP32_I2S_DMA_STORAGE_TYPE *b =
+              other.dma_buff.rowBits[row]->getDataPtr(d, buff);
+          for (int x = 0; x < this->width(); x++, index++) {
+            if (a[x] != b[x]) return index;
+          }
+        }
+      }
+    }
+    return -1;
+  }
+};
+
+HUB75_I2S_CFG panel_config() {
+  return HUB75_I2S_CFG(PANEL_RES_X, PANEL_RES_Y, PANEL_CHAIN);
+}
+
+}  // namespace
+
+LMS_BENCH(panel_draw_row) {
+  InspectablePanel per_pixel(panel_config());
+  InspectablePanel per_row(panel_config());
+  per_pixel.begin();
+  per_row.begin();
+  const int w = per_pixel.width();
+  const int h = per_pixel.height();
+  std::mt19937 rng(565);
+  std::vector<uint16_t> frame(w * h);
+
+  // every RGB565 value, then random frames and random spans, drawn over each
+  // other so the bit clearing is exercised as well
+  for (int i = 0; i < w * h; i++) frame[i] = (uint16_t)(i * 13);
+  for (int pass = 0; pass < 64; pass++) {
+    if (pass > 0) {
+      for (uint16_t &p : frame) p = (uint16_t)rng();
+    }
+    for (int y = 0; y < h; y++) {
+      per_pixel.drawRGBBitmap(0, y, &frame[y * w], w, 1);
+      per_row.draw_row(0, y, &frame[y * w], w);
+    }
+  }
+  for (int span = 0; span < 20000; span++) {
+    int y = rng() % h;
+    int x = (int)(rng() % (w + 16)) - 8;
+    int len = 1 + rng() % 40;
+    std::vector<uint16_t> pixels(len);
+    for (uint16_t &p : pixels) p = (uint16_t)rng();
+    per_pixel.drawRGBBitmap(x, y, pixels.data(), len, 1);
+    per_row.draw_row(x, y, pixels.data(), len);
+  }
+  long diff = per_row.first_difference(per_pixel);
+  if (diff >= 0) {
+    char message[64];
+    snprintf(message, sizeof(message), "DMA buffers differ at word %ld", diff);
+    lms_bench::fail("panel_draw_row", message);
+    return;
+  }
+
+  double per_pixel_ns = lms_bench::time_per_op_ns(300, [&] {
+    for (int y = 0; y < h; y++) {
+      per_pixel.drawRGBBitmap(0, y, &frame[y * w], w, 1);
+    }
+  });
+  lms_bench::report("panel_full_frame_per_pixel", 300, per_pixel_ns,
+                    "bit exact");
+  double per_row_ns = lms_bench::time_per_op_ns(300, [&] {
+    for (int y = 0; y < h; y++) {
+      per_row.draw_row(0, y, &frame[y * w], w);
+    }
+  });
+  char extra[64];
+  snprintf(extra, sizeof(extra), "bit exact, %.1fx", per_pixel_ns / per_row_ns);
+  lms_bench::report("panel_full_frame_draw_row", 300, per_row_ns, extra);
+}
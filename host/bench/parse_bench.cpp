@@ -0,0 +1,53 @@
+// Cost of fetching and parsing the recorded API payloads, per request.
+
+#include <stdio.h>
+
+#include "../../src/mbta/mbta.h"
+#include "../../src/spotify/spotify.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+template <typename F>
+void run(const char *name, int iterations, size_t payload_bytes, F f) {
+  double ns = lms_bench::time_per_op_ns(iterations, f);
+  char extra[64];
+  snprintf(extra, sizeof(extra), "payload %zu bytes", payload_bytes);
+  lms_bench::report(name, iterations, ns, extra);
+}
+
+}  // namespace
+
+LMS_BENCH(parse_mbta_predictions) {
+  static MBTA mbta;
+  mbta.setup();
+  mbta.set_station(TRAIN_STATION_PARK_STREET);
+  Prediction predictions[2];
+  PredictionStatus status = mbta.get_predictions_both_directions(predictions);
+  if (status == PREDICTION_STATUS_ERROR ||
+      status == PREDICTION_STATUS_ERROR_SHOW_CACHED) {
+    printf("parse_mbta_predictions: request failed (%d)\n", status);
+    return;
+  }
+  // setting the station makes the next call request predictions again
+  run("parse_mbta_predictions", 200, lms_host::mbta_fixture().size(), [&] {
+    mbta.set_station(TRAIN_STATION_PARK_STREET);
+    mbta.get_predictions_both_directions(predictions);
+  });
+}
+
+LMS_BENCH(parse_spotify_currently_playing) {
+  static Spotify spotify;
+  spotify.setup();
+  CurrentlyPlaying playing;
+  if (spotify.get_currently_playing(&playing, lms_host::now_ms()) !=
+      SPOTIFY_RESPONSE_OK) {
+    printf("parse_spotify_currently_playing: request failed\n");
+    return;
+  }
+  run("parse_spotify_currently_playing", 200,
+      lms_host::spotify_fixture().size(),
+      [&] { spotify.get_currently_playing(&playing, lms_host::now_ms()); });
+}
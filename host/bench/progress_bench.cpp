@@ -0,0 +1,66 @@
+// Spotify playback progress over twenty minutes of the looping host playlist,
+// one provider tick per second. The sign polls when Spotify says a poll is
+// due and counts the progress on locally in between. Its time labels must
+// match a fresh response every second, except for the moment after a track
+// ends, while making far fewer requests than polling every second, as it used
+// to.
+
+#include <stdio.h>
+
+#include "../../src/spotify/spotify.h"
+#include "bench.h"
+#include "host.h"
+
+LMS_BENCH(spotify_progress) {
+  const int seconds = 20 * 60;
+  static Spotify sign;
+  static Spotify reference;
+  sign.setup();
+  reference.setup();
+
+  time_t start = time(NULL);
+  uint32_t start_ms = lms_host::now_ms();
+  int second = 0;
+  int behind = 0;
+  int track_ends = 0;
+  uint32_t requests = 0;
+  uint32_t last_progress_ms = 0;
+  CurrentlyPlaying shown = {};
+  double ns = lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second);
+    uint32_t now_ms = start_ms + second++ * 1000;
+    if (sign.is_poll_due(now_ms)) {
+      uint32_t before = lms_host::http_stats().requests;
+      sign.get_currently_playing(&shown, now_ms);
+      requests += lms_host::http_stats().requests - before;
+    }
+
+    CurrentlyPlaying expected;
+    reference.get_currently_playing(&expected, now_ms);
+    if (get_progress_ms(&shown, now_ms) / 1000 != expected.progress_ms / 1000) {
+      behind++;
+    }
+    if (expected.progress_ms < last_progress_ms) {
+      track_ends++;
+    }
+    last_progress_ms = expected.progress_ms;
+  });
+  lms_host::set_wall_clock(0);
+
+  // the sign catches up with the poll made just after the end of the track
+  int allowed = track_ends * (SPOTIFY_END_OF_TRACK_DELAY / 1000 + 1);
+  char extra[128];
+  if (behind > allowed) {
+    snprintf(extra, sizeof(extra),
+             "%d of %d seconds differ from a fresh response, %d track ends",
+             behind, second, track_ends);
+    lms_bench::fail("spotify_progress", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%u requests in %d s (every 1 s: %d), %.1fx fewer, %d s behind at "
+           "%d track ends",
+           requests, second, second, (double)second / requests, behind,
+           track_ends);
+  lms_bench::report("spotify_progress", seconds, ns, extra);
+}
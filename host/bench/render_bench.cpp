@@ -0,0 +1,125 @@
+// Cost of the Display render paths, per frame.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/display/display.h"
+#include "ESP32-HUB75-MatrixPanel-I2S-DMA.h"
+#include "bench.h"
+
+namespace {
+
+Display *shared_display() {
+  static Display *display = nullptr;
+  if (!display) {
+    display = new Display();
+    display->setup();
+  }
+  return display;
+}
+
+CurrentlyPlaying sample_song() {
+  CurrentlyPlaying song = {};
+  strcpy(song.title, "Texas Sun");
+  strcpy(song.artist, "Khruangbin, Leon Bridges");
+  song.duration_ms = 252106;
+  song.progress_ms = 48213;
+  song.timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  strcpy(song.cover.url, "https://i.scdn.co/image/sample");
+  song.cover.width = 64;
+  song.cover.height = 64;
+  return song;
+}
+
+// Runs f and reports the time, the pixels flushed and the panel pixel writes
+// per call.
+template <typename F>
+void run(const char *name, int iterations, F f) {
+  Display *display = shared_display();
+  lms_host::reset_panel_stats();
+  FlushStats before = display->get_flush_stats();
+  double ns = lms_bench::time_per_op_ns(iterations, f);
+  FlushStats after = display->get_flush_stats();
+  lms_host::PanelStats panel = lms_host::panel_stats();
+  int calls = iterations + iterations / 10 + 1;
+  char extra[96];
+  snprintf(extra, sizeof(extra), "flushed/op %llu  panel writes/op %llu",
+           (unsigned long long)((after.total_pixels - before.total_pixels) /
+                                calls),
+           (unsigned long long)(panel.pixel_writes / calls));
+  lms_bench::report(name, iterations, ns, extra);
+}
+
+}  // namespace
+
+LMS_BENCH(render_text) {
+  Display *display = shared_display();
+  TextRenderContent content;
+  strcpy(content.text, "Thursday, May 14 2024\n08:15:00");
+  content.color = display->AMBER;
+  run("render_text", 500, [&] { display->render_text_content(content); });
+}
+
+LMS_BENCH(render_mbta) {
+  Display *display = shared_display();
+  MBTARenderContent content;
+  content.status = PREDICTION_STATUS_OK;
+  strcpy(content.predictions[0].label, "Ashmont");
+  strcpy(content.predictions[0].value, "3 min");
+  strcpy(content.predictions[1].label, "Alewife");
+  strcpy(content.predictions[1].value, "12 min");
+  // the countdown changes every frame, the rest of the board does not
+  int frame = 0;
+  run("render_mbta", 500, [&] {
+    snprintf(content.predictions[0].value, 16, "%d min", 1 + frame++ % 9);
+    display->render_mbta_content(content);
+  });
+}
+
+LMS_BENCH(render_music) {
+  Display *display = shared_display();
+  MusicRenderContent content;
+  content.status = SPOTIFY_RESPONSE_OK;
+  content.data = sample_song();
+  // a new progress value every frame, as if one second went by
+  run("render_music", 500, [&] {
+    content.data.progress_ms =
+        (content.data.progress_ms + 1000) % content.data.duration_ms;
+    display->render_music_content(content);
+  });
+}
+
+// The progress of a playing song on every refresh, as the render task moves
+// it on between polls. Most frames change nothing and flush nothing.
+LMS_BENCH(render_music_progress_frame) {
+  Display *display = shared_display();
+  MusicRenderContent content;
+  content.status = SPOTIFY_RESPONSE_OK;
+  content.data = sample_song();
+  content.data.is_playing = true;
+  display->render_music_content(content);
+  uint32_t now = content.data.timestamp_ms;
+  run("render_music_progress_frame", 300, [&] {
+    display->render_music_progress(now);
+    now += 17;  // REFRESH_RATE
+  });
+}
+
+// One animation frame of the music mode: both marquees and the flush, as the
+// render task draws them on every refresh.
+LMS_BENCH(render_music_animation_frame) {
+  Display *display = shared_display();
+  AnimationRenderContent start;
+  start.action = ANIMATION_ACTION_START_MUSIC;
+  start.song = sample_song();
+  strcpy(start.song.title, "A title long enough that it has to scroll across");
+  display->render_animation_content(start);
+  uint32_t now = start.song.timestamp_ms;
+  run("render_music_animation_frame", 300, [&] {
+    display->render_animations(now);
+    now += 17;  // REFRESH_RATE
+  });
+  AnimationRenderContent stop;
+  stop.action = ANIMATION_ACTION_STOP_MUSIC;
+  display->render_animation_content(stop);
+}
@@ -0,0 +1,254 @@
+// MBTA predictions streamed as events against polling, over ten minutes of
+// the Park Street event log, one provider tick per second. The log has
+// delays, a stopped train, a new train and removals.
+//
+// Polls are served what the log has reached at the time, so a sign that
+// requests predictions every second is the reference: the streaming sign must
+// show the same every second from a single request. The adaptively polling
+// sign is shown for comparison, with the seconds it was behind.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "../../src/mbta/mbta.h"
+#include "../routes.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+struct Usage {
+  uint32_t requests = 0;
+  uint64_t bytes = 0;
+  double ns = 0;
+  double max_ns = 0;
+  int ticks = 0;
+  int differing = 0;
+};
+
+bool same(const Prediction a[2], const Prediction b[2]) {
+  for (int i = 0; i < 2; i++) {
+    if (strcmp(a[i].label, b[i].label) != 0 ||
+        strcmp(a[i].value, b[i].value) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs get_predictions_both_directions, timing it and counting the HTTP
+// traffic it caused.
+PredictionStatus tick(MBTA *mbta, Prediction dst[2], Usage *usage) {
+  lms_host::HttpStats before = lms_host::http_stats();
+  auto start = std::chrono::steady_clock::now();
+  PredictionStatus status = mbta->get_predictions_both_directions(dst);
+  auto end = std::chrono::steady_clock::now();
+  lms_host::HttpStats after = lms_host::http_stats();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  usage->requests += after.requests - before.requests;
+  usage->bytes += after.body_bytes - before.body_bytes;
+  usage->ns += ns;
+  usage->max_ns = std::max(usage->max_ns, ns);
+  usage->ticks++;
+  return status;
+}
+
+}  // namespace
+
+LMS_BENCH(mbta_streaming) {
+  const int seconds = 600;
+  const int fixed_interval = 5;
+  lms_host::http_route("https://api-v3.mbta.com/predictions",
+                       [](const lms_host::HttpRequest &request) {
+                         time_t now = time(nullptr);
+                         if (request.header("Accept") == "text/event-stream") {
+                           return lms_host::mbta_event_stream(now);
+                         }
+                         return lms_host::HttpResponse{
+                             200, lms_host::mbta_event_log_snapshot(now),
+                             "application/vnd.api+json"};
+                       });
+  static MBTA streaming;
+  static MBTA polling;
+  static MBTA reference;
+  streaming.setup();
+  streaming.set_station(TRAIN_STATION_PARK_STREET);
+  streaming.set_streaming(true);
+  polling.setup();
+  polling.set_station(TRAIN_STATION_PARK_STREET);
+  reference.setup();
+
+  time_t start = time(NULL);
+  int second = 0;
+  int changes = 0;
+  Usage streamed;
+  Usage polled;
+  Usage every_second;
+  Prediction shown[2] = {};
+  lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second++);
+    // setting the station makes the next call request predictions again
+    Prediction expected[2];
+    reference.set_station(TRAIN_STATION_PARK_STREET);
+    tick(&reference, expected, &every_second);
+
+    Prediction predictions[2];
+    tick(&polling, predictions, &polled);
+    if (!same(predictions, expected)) {
+      polled.differing++;
+    }
+    tick(&streaming, predictions, &streamed);
+    if (!same(predictions, expected)) {
+      streamed.differing++;
+    }
+    if (!same(predictions, shown)) {
+      changes++;
+      shown[0] = predictions[0];
+      shown[1] = predictions[1];
+    }
+  });
+  lms_host::set_wall_clock(0);
+  lms_host::install_fixture_routes();
+
+  char extra[160];
+  if (streamed.differing > 0 || streamed.requests != 1) {
+    snprintf(extra, sizeof(extra),
+             "%d of %d seconds differ from a fresh response, %u requests",
+             streamed.differing, second, streamed.requests);
+    lms_bench::fail("mbta_streaming", extra);
+    return;
+  }
+  uint32_t fixed_requests = second / fixed_interval;
+  uint64_t fixed_bytes =
+      every_second.bytes / every_second.requests * fixed_requests;
+  // time is per second of the sign
+  snprintf(extra, sizeof(extra), "%u request, %llu B, %d frames in %d s",
+           streamed.requests, (unsigned long long)streamed.bytes, changes,
+           second);
+  lms_bench::report("mbta_streaming", second,
+                    streamed.ns / streamed.ticks, extra);
+  snprintf(extra, sizeof(extra), "%u requests, %llu B, %d s behind",
+           polled.requests, (unsigned long long)polled.bytes,
+           polled.differing);
+  lms_bench::report("mbta_streaming_adaptive_polls", second,
+                    polled.ns / polled.ticks, extra);
+  snprintf(extra, sizeof(extra), "%u requests, %llu B", fixed_requests,
+           (unsigned long long)fixed_bytes);
+  lms_bench::report("mbta_streaming_5s_polls", second,
+                    every_second.ns / every_second.ticks / fixed_interval,
+                    extra);
+}
+
+// The stream cannot be opened for the first half minute, as when the API is
+// down. It must be tried again every MBTA_MIN_POLL_INTERVAL seconds, like a
+// failed poll, not on every tick, and show predictions once it opens.
+LMS_BENCH(mbta_streaming_reopen) {
+  const int seconds = 60;
+  const int down_seconds = 30;
+  static time_t up_at;
+  lms_host::http_route("https://api-v3.mbta.com/predictions",
+                       [](const lms_host::HttpRequest &request) {
+                         time_t now = time(nullptr);
+                         if (now < up_at) {
+                           return lms_host::HttpResponse{503, "", ""};
+                         }
+                         return lms_host::mbta_event_stream(now);
+                       });
+  static MBTA streaming;
+  streaming.setup();
+  streaming.set_station(TRAIN_STATION_PARK_STREET);
+  streaming.set_streaming(true);
+
+  time_t start = time(NULL);
+  up_at = start + down_seconds;
+  int second = 0;
+  int shown_at = -1;
+  Usage streamed;
+  lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second);
+    Prediction predictions[2] = {};
+    tick(&streaming, predictions, &streamed);
+    if (shown_at < 0 && strcmp(predictions[0].value, "") != 0) {
+      shown_at = second;
+    }
+    second++;
+  });
+  lms_host::set_wall_clock(0);
+  lms_host::install_fixture_routes();
+
+  // one attempt at the start, then one per interval until it is up
+  uint32_t expected = down_seconds / MBTA_MIN_POLL_INTERVAL + 1;
+  char extra[160];
+  if (streamed.requests > expected || shown_at < 0 ||
+      shown_at > down_seconds + MBTA_MIN_POLL_INTERVAL) {
+    snprintf(extra, sizeof(extra),
+             "%u requests for at most %u, predictions shown at %d s",
+             streamed.requests, expected, shown_at);
+    lms_bench::fail("mbta_streaming_reopen", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%u requests in %d s down, predictions shown at %d s",
+           streamed.requests, down_seconds, shown_at);
+  lms_bench::report("mbta_streaming_reopen", second,
+                    streamed.ns / streamed.ticks, extra);
+}
+
+// Every event after the reset arrives in two halves, a second apart, as on a
+// slow connection. The half that came in is kept for the next tick: the
+// table must not be dropped, nor the stream opened again, nor a tick held up
+// waiting for the rest.
+LMS_BENCH(mbta_streaming_slow_events) {
+  const int seconds = 120;
+  lms_host::http_route(
+      "https://api-v3.mbta.com/predictions",
+      [](const lms_host::HttpRequest &request) {
+        lms_host::HttpResponse response =
+            lms_host::mbta_event_stream(time(nullptr));
+        std::vector<lms_host::HttpChunk> halves;
+        for (const lms_host::HttpChunk &chunk : response.chunks) {
+          size_t half = chunk.data.size() / 2;
+          halves.push_back({chunk.at, chunk.data.substr(0, half)});
+          halves.push_back({chunk.at + 1, chunk.data.substr(half)});
+        }
+        response.chunks = halves;
+        return response;
+      });
+  static MBTA streaming;
+  streaming.setup();
+  streaming.set_station(TRAIN_STATION_PARK_STREET);
+  streaming.set_streaming(true);
+
+  time_t start = time(NULL);
+  int second = 0;
+  int errors = 0;
+  Usage streamed;
+  lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second++);
+    Prediction predictions[2];
+    PredictionStatus status = tick(&streaming, predictions, &streamed);
+    if (status == PREDICTION_STATUS_ERROR ||
+        status == PREDICTION_STATUS_ERROR_SHOW_CACHED ||
+        status == PREDICTION_STATUS_ERROR_EMPTY) {
+      errors++;
+    }
+  });
+  lms_host::set_wall_clock(0);
+  lms_host::install_fixture_routes();
+
+  char extra[160];
+  if (errors > 0 || streamed.requests != 1 || streamed.max_ns > 50e6) {
+    snprintf(extra, sizeof(extra),
+             "%d seconds in error, %u requests, slowest tick %.1f ms",
+             errors, streamed.requests, streamed.max_ns / 1e6);
+    lms_bench::fail("mbta_streaming_slow_events", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra), "%u request, slowest tick %.2f ms",
+           streamed.requests, streamed.max_ns / 1e6);
+  lms_bench::report("mbta_streaming_slow_events", second,
+                    streamed.ns / streamed.ticks, extra);
+}
@@ -0,0 +1,181 @@
+// TLS handshakes of an MBTA sign and a music sign over two hours, one
+// provider tick per second, against the TLS stand-in server.
+//
+// The music sign closes its API connection with every queue lookup, since
+// the HTTPClient that made it closes it when it goes, and fetches each cover
+// on a new connection. The MBTA sign keeps its connection, but WiFi drops it
+// every drop_interval. Halfway through, the server forgets its sessions, as
+// when it rotates its keys.
+//
+// Every reconnect used to be a full handshake. With the sessions kept by the
+// TLS clients only the first connection to each host, and the first after
+// the server forgot them, may be. The same goes for the requests through the
+// HTTP engine, which keeps sessions of its own.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../../src/client/http-engine.h"
+#include "../../src/display/display.h"
+#include "../../src/mbta/mbta.h"
+#include "../../src/spotify/cover-loader.h"
+#include "../../src/spotify/spotify.h"
+#include "bench.h"
+#include "host.h"
+
+namespace {
+
+const int drop_interval = 5 * 60;
+// accounts.spotify.com, api.spotify.com, i.scdn.co and api-v3.mbta.com
+const uint32_t hosts = 4;
+
+TlsStats add(TlsStats a, TlsStats b) {
+  return {a.full_handshakes + b.full_handshakes,
+          a.resumed_handshakes + b.resumed_handshakes,
+          a.failed_handshakes + b.failed_handshakes};
+}
+
+}  // namespace
+
+LMS_BENCH(tls_resumption) {
+  const int seconds = 2 * 60 * 60;
+  lms_host::TlsServerStats before = lms_host::tls_stats();
+  static Display display;
+  display.setup();
+  static Spotify spotify;
+  static CoverLoader loader;
+  static MBTA mbta;
+  spotify.setup();
+  loader.setup(&spotify, nullptr, &display);
+  mbta.setup();
+  mbta.set_station(TRAIN_STATION_PARK_STREET);
+
+  time_t start = time(NULL);
+  uint32_t start_ms = lms_host::now_ms();
+  int second = 0;
+  double ns = lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second);
+    uint32_t now_ms = start_ms + second * 1000;
+    if (second == seconds / 2) {
+      lms_host::tls_forget_sessions();
+    }
+    if (second > 0 && second % drop_interval == 0) {
+      lms_host::http_drop_connections();
+    }
+    second++;
+
+    Prediction predictions[2];
+    mbta.get_predictions_both_directions(predictions);
+
+    CurrentlyPlaying song;
+    if (spotify.is_poll_due(now_ms) &&
+        spotify.get_currently_playing(&song, now_ms) == SPOTIFY_RESPONSE_OK) {
+      if (spotify.is_current_song_new(&song)) {
+        loader.request(COVER_REQUEST_SHOW, song.cover);
+      }
+      spotify.update_current_song(&song);
+      CurrentlyPlaying next_song;
+      if (spotify.is_next_song_due(now_ms) &&
+          spotify.get_next_song(&next_song) == SPOTIFY_RESPONSE_OK) {
+        loader.request(COVER_REQUEST_PREFETCH, next_song.cover);
+      }
+    }
+    while (loader.process(0)) {
+    }
+  });
+  lms_host::set_wall_clock(0);
+
+  lms_host::TlsServerStats after = lms_host::tls_stats();
+  uint32_t full = after.full_handshakes - before.full_handshakes;
+  uint32_t resumed = after.resumed_handshakes - before.resumed_handshakes;
+  TlsStats clients = add(add(spotify.get_tls_stats(), mbta.get_tls_stats()),
+                         spotify.get_cover_tls_stats());
+  char extra[160];
+  if (full > 2 * hosts || clients.full_handshakes != full ||
+      clients.resumed_handshakes != resumed || clients.failed_handshakes) {
+    snprintf(extra, sizeof(extra),
+             "%u full and %u resumed handshakes, the clients counted %u, %u "
+             "and %u failed",
+             full, resumed, clients.full_handshakes,
+             clients.resumed_handshakes, clients.failed_handshakes);
+    lms_bench::fail("tls_resumption", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%u connections, %u full and %u resumed handshakes (without "
+           "resuming: %u full)",
+           full + resumed, full, resumed, full + resumed);
+  lms_bench::report("tls_resumption", seconds, ns, extra);
+}
+
+// The same two hours with the MBTA and Spotify API requests through the HTTP
+// engine, as the sign makes them: connections stay open between ticks and
+// every one WiFi drops is opened again with the session kept for its host.
+LMS_BENCH(tls_resumption_engine) {
+  const int seconds = 2 * 60 * 60;
+  // api-v3.mbta.com, api.spotify.com and accounts.spotify.com
+  const uint32_t engine_hosts = 3;
+  static lms::HttpEngine engine;
+  static Spotify spotify;
+  static MBTA mbta;
+  spotify.setup();
+  mbta.setup();
+  spotify.use_engine(&engine);
+  mbta.use_engine(&engine);
+  mbta.set_station(TRAIN_STATION_PARK_STREET);
+  lms_host::TlsServerStats before = lms_host::tls_stats();
+
+  time_t start = time(NULL);
+  uint32_t start_ms = lms_host::now_ms();
+  int second = 0;
+  double ns = lms_bench::time_per_op_ns(seconds, [&] {
+    lms_host::set_wall_clock(start + second);
+    uint32_t now_ms = start_ms + second * 1000;
+    if (second == seconds / 2) {
+      lms_host::tls_forget_sessions();
+    }
+    if (second > 0 && second % drop_interval == 0) {
+      lms_host::http_drop_connections();
+    }
+    second++;
+
+    Prediction predictions[2];
+    mbta.get_predictions_both_directions(predictions);
+    if (spotify.is_poll_due(now_ms)) {
+      spotify.request_currently_playing(
+          [&](SpotifyResponse status, CurrentlyPlaying *song) {
+            if (status == SPOTIFY_RESPONSE_OK) {
+              spotify.update_current_song(song);
+            }
+          });
+    }
+    while (engine.pending() > 0) {
+      engine.poll(1000);
+    }
+  });
+  lms_host::set_wall_clock(0);
+  spotify.teardown();
+  mbta.teardown();
+
+  lms_host::TlsServerStats after = lms_host::tls_stats();
+  uint32_t full = after.full_handshakes - before.full_handshakes;
+  uint32_t resumed = after.resumed_handshakes - before.resumed_handshakes;
+  lms::HttpEngineStats stats = engine.get_stats();
+  char extra[160];
+  if (full > 2 * engine_hosts || resumed == 0 ||
+      stats.full_handshakes != full || stats.resumed_handshakes != resumed ||
+      stats.failed_handshakes) {
+    snprintf(extra, sizeof(extra),
+             "%u full and %u resumed handshakes, the engine counted %u, %u "
+             "and %u failed",
+             full, resumed, stats.full_handshakes, stats.resumed_handshakes,
+             stats.failed_handshakes);
+    lms_bench::fail("tls_resumption_engine", extra);
+    return;
+  }
+  snprintf(extra, sizeof(extra),
+           "%u connections, %u full and %u resumed handshakes, %u reused",
+           stats.connections_opened, full, resumed,
+           stats.connections_reused);
+  lms_bench::report("tls_resumption_engine", seconds, ns, extra);
+}
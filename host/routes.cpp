@@ -0,0 +1,343 @@
+#include "routes.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <functional>
+#include <vector>
+
+#include "host.h"
+
+namespace lms_host {
+
+namespace {
+
+std::string mbta_body;
+std::string spotify_body;
+std::string token_body;
+time_t installed_at;
+
+// An event of the MBTA event log, at seconds after the start of the log
+struct LoggedEvent {
+  long at;
+  std::string name;
+  std::string data;
+};
+std::vector<LoggedEvent> mbta_events;
+
+// The songs the Spotify routes play in a loop. The first one is the recorded
+// one, the others are made from it with another title, length and cover.
+struct PlaylistSong {
+  const char *title;
+  uint32_t duration_ms;
+  const char *cover_id;  // the end of the album image urls
+};
+const PlaylistSong playlist[] = {
+    {"Texas Sun", 252106, "6a6f3a3c7b8b8f26a3e9b2d1f7c4e5a6b7c8d9e0"},
+    {"Time (You and I)", 250973, "0c1f4b3e8a2d6f5c7b9e1a3d5f7b9c1e3a5d7f9b"},
+    {"So We Won't Forget", 237426, "9e8d7c6b5a4f3e2d1c0b9a8f7e6d5c4b3a2f1e0d"},
+    {"Evan Finds the Third Room", 242360,
+     "4d2c6e8a0b1f3d5e7c9a2b4d6f8e0a1c3b5d7e9f"},
+};
+const int playlist_length = sizeof(playlist) / sizeof(playlist[0]);
+// Where the recording was, in the first song
+const uint32_t playlist_start_ms = 48213;
+
+// A prediction or trip, as the log has it at some point
+struct LoggedResource {
+  std::string type;
+  std::string id;
+  std::string json;
+};
+
+bool read_fixture(const char *name, std::string *dst) {
+  std::string path = std::string(LMS_HOST_FIXTURES_DIR) + "/" + name;
+  if (!read_file(path, dst)) {
+    fprintf(stderr, "cannot read fixture %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Replaces the number following "key": in a JSON payload.
+void replace_number(std::string *body, const char *key, uint64_t value) {
+  std::string needle = std::string("\"") + key + "\":";
+  size_t pos = body->find(needle);
+  if (pos == std::string::npos) return;
+  pos += needle.size();
+  while (pos < body->size() && (*body)[pos] == ' ') pos++;
+  size_t end = pos;
+  while (end < body->size() && isdigit((unsigned char)(*body)[end])) end++;
+  body->replace(pos, end - pos, std::to_string(value));
+}
+
+// Replaces every occurrence of from in body.
+void replace_all(std::string *body, const std::string &from,
+                 const std::string &to) {
+  for (size_t pos = body->find(from); pos != std::string::npos;
+       pos = body->find(from, pos + to.size())) {
+    body->replace(pos, from.size(), to);
+  }
+}
+
+uint64_t epoch_ms() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Reads the ": at N" comments and the events below them. Every event has its
+// data on a single line.
+bool parse_event_log(const std::string &log, std::vector<LoggedEvent> *dst) {
+  long at = 0;
+  std::string name = "message";
+  size_t pos = 0;
+  while (pos < log.size()) {
+    size_t end = log.find('\n', pos);
+    if (end == std::string::npos) end = log.size();
+    std::string line = log.substr(pos, end - pos);
+    pos = end + 1;
+    if (line.compare(0, 5, ": at ") == 0) {
+      at = atol(line.c_str() + 5);
+    } else if (line.compare(0, 7, "event: ") == 0) {
+      name = line.substr(7);
+    } else if (line.compare(0, 6, "data: ") == 0) {
+      dst->push_back({at, name, line.substr(6)});
+    }
+  }
+  return !dst->empty() && (*dst)[0].name == "reset";
+}
+
+// The end of the JSON object or array starting at pos.
+size_t skip_container(const std::string &json, size_t pos) {
+  int depth = 0;
+  for (; pos < json.size(); pos++) {
+    char c = json[pos];
+    if (c == '"') {
+      for (pos++; pos < json.size() && json[pos] != '"'; pos++) {
+        if (json[pos] == '\\') pos++;
+      }
+    } else if (c == '{' || c == '[') {
+      depth++;
+    } else if ((c == '}' || c == ']') && --depth == 0) {
+      return pos + 1;
+    }
+  }
+  return pos;
+}
+
+// The elements of a JSON array of objects.
+std::vector<std::string> split_array(const std::string &json) {
+  std::vector<std::string> elements;
+  size_t pos = json.find('{');
+  while (pos != std::string::npos) {
+    size_t end = skip_container(json, pos);
+    elements.push_back(json.substr(pos, end - pos));
+    pos = json.find('{', end);
+  }
+  return elements;
+}
+
+// The string value of a key of the outermost object.
+std::string top_level_string(const std::string &json, const char *key) {
+  int depth = 0;
+  bool at_key = false;
+  for (size_t pos = 0; pos < json.size(); pos++) {
+    char c = json[pos];
+    if (c == '"') {
+      size_t end = pos + 1;
+      for (; end < json.size() && json[end] != '"'; end++) {
+        if (json[end] == '\\') end++;
+      }
+      if (at_key && json.compare(pos + 1, end - pos - 1, key) == 0) {
+        size_t value = json.find_first_not_of(" :", end + 1);
+        if (value != std::string::npos && json[value] == '"') {
+          return json.substr(value + 1, json.find('"', value + 1) - value - 1);
+        }
+      }
+      at_key = false;
+      pos = end;
+    } else if (c == '{' || c == '[') {
+      depth++;
+      at_key = c == '{' && depth == 1;
+    } else if (c == '}' || c == ']') {
+      depth--;
+    } else if (c == ',') {
+      at_key = depth == 1;
+    }
+  }
+  return "";
+}
+
+void apply_event(const LoggedEvent &event,
+                 std::vector<LoggedResource> *resources) {
+  std::vector<std::string> elements;
+  if (event.name == "reset") {
+    resources->clear();
+    elements = split_array(event.data);
+  } else {
+    elements.push_back(event.data);
+  }
+  for (const std::string &json : elements) {
+    LoggedResource resource{top_level_string(json, "type"),
+                            top_level_string(json, "id"), json};
+    auto found = resources->begin();
+    while (found != resources->end() &&
+           (found->id != resource.id || found->type != resource.type)) {
+      found++;
+    }
+    if (event.name == "remove") {
+      if (found != resources->end()) resources->erase(found);
+    } else if (found != resources->end()) {
+      *found = resource;
+    } else {
+      resources->push_back(resource);
+    }
+  }
+}
+
+// What the log has reached at now, counted from when the routes were
+// installed.
+// The item of the recorded currently-playing response, as song i of the
+// playlist.
+std::string playlist_item(int i) {
+  size_t start = spotify_body.find('{', spotify_body.find("\"item\""));
+  std::string item =
+      spotify_body.substr(start, skip_container(spotify_body, start) - start);
+  const PlaylistSong &song = playlist[i % playlist_length];
+  replace_all(&item, playlist[0].title, song.title);
+  replace_all(&item, playlist[0].cover_id, song.cover_id);
+  replace_number(&item, "duration_ms", song.duration_ms);
+  return item;
+}
+
+// The song of the playlist that plays at now, and how far into it.
+int playlist_song_at(time_t now, uint32_t *progress_ms) {
+  uint64_t length_ms = 0;
+  for (const PlaylistSong &song : playlist) {
+    length_ms += song.duration_ms;
+  }
+  uint64_t position =
+      (playlist_start_ms + (uint64_t)(now - installed_at) * 1000) % length_ms;
+  int i = 0;
+  while (position >= playlist[i].duration_ms) {
+    position -= playlist[i++].duration_ms;
+  }
+  *progress_ms = (uint32_t)position;
+  return i;
+}
+
+std::vector<LoggedResource> mbta_resources_at(time_t now) {
+  std::vector<LoggedResource> resources;
+  for (const LoggedEvent &event : mbta_events) {
+    if (event.at > now - installed_at) break;
+    apply_event(event, &resources);
+  }
+  return resources;
+}
+
+}  // namespace
+
+HttpResponse mbta_event_stream(time_t now) {
+  long offset = (long)(installed_at - FIXTURE_RECORDED_AT);
+  std::string reset;
+  for (const LoggedResource &resource : mbta_resources_at(now)) {
+    reset += (reset.empty() ? "" : ",") + resource.json;
+  }
+  HttpResponse response{
+      200, shift_timestamps("event: reset\ndata: [" + reset + "]\n\n", offset),
+      "text/event-stream"};
+  for (const LoggedEvent &event : mbta_events) {
+    if (event.at > now - installed_at) {
+      response.chunks.push_back(
+          {installed_at + event.at,
+           shift_timestamps("event: " + event.name + "\ndata: " + event.data +
+                                "\n\n",
+                            offset)});
+    }
+  }
+  return response;
+}
+
+std::string mbta_event_log_snapshot(time_t now) {
+  long offset = (long)(installed_at - FIXTURE_RECORDED_AT);
+  std::string data;
+  std::string included;
+  for (const LoggedResource &resource : mbta_resources_at(now)) {
+    std::string *dst = resource.type == "prediction" ? &data : &included;
+    *dst += (dst->empty() ? "" : ",") + resource.json;
+  }
+  return shift_timestamps(
+      "{\"data\":[" + data + "],\"included\":[" + included + "]}", offset);
+}
+
+bool install_fixture_routes() {
+  std::string mbta_log;
+  if (!read_fixture("mbta-predictions-park-street.json", &mbta_body) ||
+      !read_fixture("mbta-predictions-park-street.events", &mbta_log) ||
+      !read_fixture("spotify-currently-playing.json", &spotify_body) ||
+      !read_fixture("spotify-token.json", &token_body)) {
+    return false;
+  }
+  mbta_events.clear();
+  if (!parse_event_log(mbta_log, &mbta_events)) {
+    fprintf(stderr, "cannot parse the mbta event log\n");
+    return false;
+  }
+  installed_at = time(nullptr);
+
+  // The recording is moved to the time the routes were installed, so the
+  // countdowns run down as the simulation goes on.
+  long offset = (long)(installed_at - FIXTURE_RECORDED_AT);
+  // Streaming clients get the event log instead.
+  http_route("https://api-v3.mbta.com/predictions",
+             [offset](const HttpRequest &request) {
+               if (request.header("Accept") == "text/event-stream") {
+                 return mbta_event_stream(time(nullptr));
+               }
+               return HttpResponse{200, shift_timestamps(mbta_body, offset),
+                                   "application/vnd.api+json"};
+             });
+  http_route("https://accounts.spotify.com/api/token",
+             [](const HttpRequest &request) {
+               return HttpResponse{200, token_body, "application/json"};
+             });
+  http_route("https://api.spotify.com/v1/me/player/currently-playing",
+             [](const HttpRequest &request) {
+               // keep the playlist playing, looping at the end
+               uint32_t progress;
+               int song = playlist_song_at(time(nullptr), &progress);
+               std::string body = spotify_body;
+               size_t start = body.find('{', body.find("\"item\""));
+               body.replace(start, skip_container(body, start) - start,
+                            playlist_item(song));
+               replace_number(&body, "progress_ms", progress);
+               replace_number(&body, "timestamp", epoch_ms());
+               return HttpResponse{200, body, "application/json"};
+             });
+  http_route("https://api.spotify.com/v1/me/player/queue",
+             [](const HttpRequest &request) {
+               // the rest of the playlist, twice over, like a queue that
+               // goes on past the next few songs
+               uint32_t progress;
+               int song = playlist_song_at(time(nullptr), &progress);
+               std::string body =
+                   "{\"currently_playing\":" + playlist_item(song) +
+                   ",\"queue\":[";
+               for (int i = 1; i <= 2 * playlist_length; i++) {
+                 body += (i > 1 ? "," : "") + playlist_item(song + i);
+               }
+               return HttpResponse{200, body + "]}", "application/json"};
+             });
+  http_route("https://i.scdn.co/image/", [](const HttpRequest &request) {
+    uint32_t seed = (uint32_t)std::hash<std::string>()(request.url);
+    return HttpResponse{200, make_test_jpeg(64, 64, seed), "image/jpeg"};
+  });
+  return true;
+}
+
+const std::string &mbta_fixture() { return mbta_body; }
+const std::string &spotify_fixture() { return spotify_body; }
+
+}  // namespace lms_host
@@ -0,0 +1,40 @@
+// Canned API responses for the host build, shared by the simulator and the
+// benchmarks. Payloads are recorded responses from host/fixtures, adjusted on
+// every request so they look current.
+
+#ifndef LMS_HOST_ROUTES_H
+#define LMS_HOST_ROUTES_H
+
+#include <stdint.h>
+
+#include <time.h>
+
+#include <string>
+
+#include "host.h"
+
+namespace lms_host {
+
+// Epoch second at which the fixtures were recorded.
+#define FIXTURE_RECORDED_AT 1715688900  // 2024-05-14T08:15:00-04:00
+
+// Registers routes for the MBTA predictions, polled or streamed, the Spotify
+// token and currently playing endpoints, and the album cover CDN. Returns
+// false if a fixture file cannot be read.
+bool install_fixture_routes();
+
+// The MBTA event log, replayed from when the routes were installed. A
+// streaming request gets a reset with the predictions the log has reached at
+// now, then each later event at its time. The predictions route serves this
+// to requests that accept text/event-stream.
+HttpResponse mbta_event_stream(time_t now);
+// The predictions the event log has reached at now, as a polled response.
+std::string mbta_event_log_snapshot(time_t now);
+
+// The raw fixture payloads, as read from host/fixtures.
+const std::string &mbta_fixture();
+const std::string &spotify_fixture();
+
+}  // namespace lms_host
+
+#endif /* LMS_HOST_ROUTES_H */
@@ -0,0 +1,494 @@
+#include "Adafruit_GFX.h"
+
+// Classic 5x7 font, see glcdfont.cpp
+extern const unsigned char *const font;
+
+#ifndef _swap_int16_t
+#define _swap_int16_t(a, b) \
+  {                         \
+    int16_t t = a;          \
+    a = b;                  \
+    b = t;                  \
+  }
+#endif
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h) {
+  _width = WIDTH;
+  _height = HEIGHT;
+  rotation = 0;
+  cursor_y = cursor_x = 0;
+  textsize_x = textsize_y = 1;
+  textcolor = textbgcolor = 0xFFFF;
+  wrap = true;
+  _cp437 = false;
+  gfxFont = NULL;
+}
+
+void Adafruit_GFX::writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                             uint16_t color) {
+  int16_t steep = abs(y1 - y0) > abs(x1 - x0);
+  if (steep) {
+    _swap_int16_t(x0, y0);
+    _swap_int16_t(x1, y1);
+  }
+  if (x0 > x1) {
+    _swap_int16_t(x0, x1);
+    _swap_int16_t(y0, y1);
+  }
+  int16_t dx = x1 - x0;
+  int16_t dy = abs(y1 - y0);
+  int16_t err = dx / 2;
+  int16_t ystep = (y0 < y1) ? 1 : -1;
+  for (; x0 <= x1; x0++) {
+    if (steep) {
+      writePixel(y0, x0, color);
+    } else {
+      writePixel(x0, y0, color);
+    }
+    err -= dy;
+    if (err < 0) {
+      y0 += ystep;
+      err += dx;
+    }
+  }
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h,
+                                 uint16_t color) {
+  startWrite();
+  writeLine(x, y, x, y + h - 1, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w,
+                                 uint16_t color) {
+  startWrite();
+  writeLine(x, y, x + w - 1, y, color);
+  endWrite();
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                            uint16_t color) {
+  startWrite();
+  for (int16_t i = x; i < x + w; i++) {
+    writeFastVLine(i, y, h, color);
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color) {
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                            uint16_t color) {
+  if (x0 == x1) {
+    if (y0 > y1) _swap_int16_t(y0, y1);
+    drawFastVLine(x0, y0, y1 - y0 + 1, color);
+  } else if (y0 == y1) {
+    if (x0 > x1) _swap_int16_t(x0, x1);
+    drawFastHLine(x0, y0, x1 - x0 + 1, color);
+  } else {
+    startWrite();
+    writeLine(x0, y0, x1, y1, color);
+    endWrite();
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                            uint16_t color) {
+  startWrite();
+  writeFastHLine(x, y, w, color);
+  writeFastHLine(x, y + h - 1, w, color);
+  writeFastVLine(x, y, h, color);
+  writeFastVLine(x + w - 1, y, h, color);
+  endWrite();
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[],
+                              int16_t w, int16_t h, uint16_t color) {
+  int16_t byteWidth = (w + 7) / 8;
+  uint8_t b = 0;
+  startWrite();
+  for (int16_t j = 0; j < h; j++, y++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (i & 7)
+        b <<= 1;
+      else
+        b = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+      if (b & 0x80) writePixel(x + i, y, color);
+    }
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[],
+                              int16_t w, int16_t h, uint16_t color,
+                              uint16_t bg) {
+  int16_t byteWidth = (w + 7) / 8;
+  uint8_t b = 0;
+  startWrite();
+  for (int16_t j = 0; j < h; j++, y++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (i & 7)
+        b <<= 1;
+      else
+        b = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+      writePixel(x + i, y, (b & 0x80) ? color : bg);
+    }
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, const uint16_t bitmap[],
+                                 int16_t w, int16_t h) {
+  startWrite();
+  for (int16_t j = 0; j < h; j++, y++) {
+    for (int16_t i = 0; i < w; i++) {
+      writePixel(x + i, y, pgm_read_word(&bitmap[j * w + i]));
+    }
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawRGBBitmap(int16_t x, int16_t y, const uint16_t bitmap[],
+                                 const uint8_t mask[], int16_t w, int16_t h) {
+  int16_t bw = (w + 7) / 8;
+  uint8_t b = 0;
+  startWrite();
+  for (int16_t j = 0; j < h; j++, y++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (i & 7)
+        b <<= 1;
+      else
+        b = pgm_read_byte(&mask[j * bw + i / 8]);
+      if (b & 0x80) {
+        writePixel(x + i, y, pgm_read_word(&bitmap[j * w + i]));
+      }
+    }
+  }
+  endWrite();
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c,
+                            uint16_t color, uint16_t bg, uint8_t size_x,
+                            uint8_t size_y) {
+  if (!gfxFont) {  // 'Classic' built-in font
+    if ((x >= _width) || (y >= _height) || ((x + 6 * size_x - 1) < 0) ||
+        ((y + 8 * size_y - 1) < 0))
+      return;
+    if (!_cp437 && (c >= 176)) c++;
+    startWrite();
+    for (int8_t i = 0; i < 5; i++) {
+      uint8_t line = pgm_read_byte(&font[c * 5 + i]);
+      for (int8_t j = 0; j < 8; j++, line >>= 1) {
+        if (line & 1) {
+          if (size_x == 1 && size_y == 1)
+            writePixel(x + i, y + j, color);
+          else
+            writeFillRect(x + i * size_x, y + j * size_y, size_x, size_y,
+                          color);
+        } else if (bg != color) {
+          if (size_x == 1 && size_y == 1)
+            writePixel(x + i, y + j, bg);
+          else
+            writeFillRect(x + i * size_x, y + j * size_y, size_x, size_y, bg);
+        }
+      }
+    }
+    if (bg != color) {
+      if (size_x == 1 && size_y == 1)
+        writeFastVLine(x + 5, y, 8, bg);
+      else
+        writeFillRect(x + 5 * size_x, y, size_x, 8 * size_y, bg);
+    }
+    endWrite();
+  } else {  // Custom font
+    c -= (uint8_t)pgm_read_byte(&gfxFont->first);
+    GFXglyph *glyph = gfxFont->glyph + c;
+    uint8_t *bitmap = gfxFont->bitmap;
+
+    uint16_t bo = glyph->bitmapOffset;
+    uint8_t w = glyph->width, h = glyph->height;
+    int8_t xo = glyph->xOffset, yo = glyph->yOffset;
+    uint8_t xx, yy, bits = 0, bit = 0;
+    int16_t xo16 = 0, yo16 = 0;
+
+    if (size_x > 1 || size_y > 1) {
+      xo16 = xo;
+      yo16 = yo;
+    }
+
+    startWrite();
+    for (yy = 0; yy < h; yy++) {
+      for (xx = 0; xx < w; xx++) {
+        if (!(bit++ & 7)) {
+          bits = pgm_read_byte(&bitmap[bo++]);
+        }
+        if (bits & 0x80) {
+          if (size_x == 1 && size_y == 1) {
+            writePixel(x + xo + xx, y + yo + yy, color);
+          } else {
+            writeFillRect(x + (xo16 + xx) * size_x, y + (yo16 + yy) * size_y,
+                          size_x, size_y, color);
+          }
+        }
+        bits <<= 1;
+      }
+    }
+    endWrite();
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (!gfxFont) {  // 'Classic' built-in font
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    } else if (c != '\r') {
+      if (wrap && ((cursor_x + textsize_x * 6) > _width)) {
+        cursor_x = 0;
+        cursor_y += textsize_y * 8;
+      }
+      drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x,
+               textsize_y);
+      cursor_x += textsize_x * 6;
+    }
+  } else {  // Custom font
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y +=
+          (int16_t)textsize_y * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+    } else if (c != '\r') {
+      uint8_t first = pgm_read_byte(&gfxFont->first);
+      if ((c >= first) && (c <= (uint8_t)pgm_read_byte(&gfxFont->last))) {
+        GFXglyph *glyph = gfxFont->glyph + (c - first);
+        uint8_t w = glyph->width, h = glyph->height;
+        if ((w > 0) && (h > 0)) {
+          int16_t xo = (int8_t)glyph->xOffset;
+          if (wrap && ((cursor_x + textsize_x * (xo + w)) > _width)) {
+            cursor_x = 0;
+            cursor_y += (int16_t)textsize_y *
+                        (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+          }
+          drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x,
+                   textsize_y);
+        }
+        cursor_x += (uint8_t)glyph->xAdvance * (int16_t)textsize_x;
+      }
+    }
+  }
+  return 1;
+}
+
+void Adafruit_GFX::setFont(const GFXfont *f) {
+  if (f) {
+    if (!gfxFont) {
+      // Switching from classic to new font behavior: move cursor pos down 6
+      cursor_y += 6;
+    }
+  } else if (gfxFont) {
+    // Switching from new to classic font behavior: move cursor pos up 6
+    cursor_y -= 6;
+  }
+  gfxFont = (GFXfont *)f;
+}
+
+void Adafruit_GFX::charBounds(unsigned char c, int16_t *x, int16_t *y,
+                              int16_t *minx, int16_t *miny, int16_t *maxx,
+                              int16_t *maxy) {
+  if (gfxFont) {
+    if (c == '\n') {
+      *x = 0;
+      *y += textsize_y * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+    } else if (c != '\r') {
+      uint8_t first = pgm_read_byte(&gfxFont->first),
+              last = pgm_read_byte(&gfxFont->last);
+      if ((c >= first) && (c <= last)) {
+        GFXglyph *glyph = gfxFont->glyph + (c - first);
+        uint8_t gw = glyph->width, gh = glyph->height,
+                xa = glyph->xAdvance;
+        int8_t xo = glyph->xOffset, yo = glyph->yOffset;
+        if (wrap && ((*x + (((int16_t)xo + gw) * textsize_x)) > _width)) {
+          *x = 0;
+          *y += textsize_y * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+        }
+        int16_t tsx = (int16_t)textsize_x, tsy = (int16_t)textsize_y,
+                x1 = *x + xo * tsx, y1 = *y + yo * tsy,
+                x2 = x1 + gw * tsx - 1, y2 = y1 + gh * tsy - 1;
+        if (x1 < *minx) *minx = x1;
+        if (y1 < *miny) *miny = y1;
+        if (x2 > *maxx) *maxx = x2;
+        if (y2 > *maxy) *maxy = y2;
+        *x += xa * tsx;
+      }
+    }
+  } else {  // Default font
+    if (c == '\n') {
+      *x = 0;
+      *y += textsize_y * 8;
+    } else if (c != '\r') {
+      if (wrap && ((*x + textsize_x * 6) > _width)) {
+        *x = 0;
+        *y += textsize_y * 8;
+      }
+      int x2 = *x + textsize_x * 6 - 1, y2 = *y + textsize_y * 8 - 1;
+      if (x2 > *maxx) *maxx = x2;
+      if (y2 > *maxy) *maxy = y2;
+      if (*x < *minx) *minx = *x;
+      if (*y < *miny) *miny = *y;
+      *x += textsize_x * 6;
+    }
+  }
+}
+
+void Adafruit_GFX::getTextBounds(const char *str, int16_t x, int16_t y,
+                                 int16_t *x1, int16_t *y1, uint16_t *w,
+                                 uint16_t *h) {
+  uint8_t c;
+  int16_t minx = 0x7FFF, miny = 0x7FFF, maxx = -1, maxy = -1;
+
+  *x1 = x;
+  *y1 = y;
+  *w = *h = 0;
+
+  while ((c = *str++)) {
+    charBounds(c, &x, &y, &minx, &miny, &maxx, &maxy);
+  }
+
+  if (maxx >= minx) {
+    *x1 = minx;
+    *w = maxx - minx + 1;
+  }
+  if (maxy >= miny) {
+    *y1 = miny;
+    *h = maxy - miny + 1;
+  }
+}
+
+void Adafruit_GFX::getTextBounds(const String &str, int16_t x, int16_t y,
+                                 int16_t *x1, int16_t *y1, uint16_t *w,
+                                 uint16_t *h) {
+  if (str.length() != 0) {
+    getTextBounds(const_cast<char *>(str.c_str()), x, y, x1, y1, w, h);
+  }
+}
+
+GFXcanvas1::GFXcanvas1(uint16_t w, uint16_t h) : Adafruit_GFX(w, h) {
+  uint32_t bytes = ((w + 7) / 8) * h;
+  if ((buffer = (uint8_t *)malloc(bytes))) {
+    memset(buffer, 0, bytes);
+  }
+}
+
+GFXcanvas1::~GFXcanvas1(void) { free(buffer); }
+
+void GFXcanvas1::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (buffer) {
+    if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) return;
+    uint8_t *ptr = &buffer[(x / 8) + y * ((WIDTH + 7) / 8)];
+    if (color)
+      *ptr |= 0x80 >> (x & 7);
+    else
+      *ptr &= ~(0x80 >> (x & 7));
+  }
+}
+
+bool GFXcanvas1::getPixel(int16_t x, int16_t y) const {
+  if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) return 0;
+  uint8_t *ptr = &buffer[(x / 8) + y * ((WIDTH + 7) / 8)];
+  return ((*ptr) & (0x80 >> (x & 7))) != 0;
+}
+
+void GFXcanvas1::fillScreen(uint16_t color) {
+  if (buffer) {
+    uint32_t bytes = ((WIDTH + 7) / 8) * HEIGHT;
+    memset(buffer, color ? 0xFF : 0x00, bytes);
+  }
+}
+
+GFXcanvas16::GFXcanvas16(uint16_t w, uint16_t h) : Adafruit_GFX(w, h) {
+  uint32_t bytes = w * h * 2;
+  if ((buffer = (uint16_t *)malloc(bytes))) {
+    memset(buffer, 0, bytes);
+  }
+}
+
+GFXcanvas16::~GFXcanvas16(void) { free(buffer); }
+
+void GFXcanvas16::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (buffer) {
+    if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) return;
+    buffer[x + y * WIDTH] = color;
+  }
+}
+
+uint16_t GFXcanvas16::getPixel(int16_t x, int16_t y) const {
+  if ((x < 0) || (y < 0) || (x >= _width) || (y >= _height)) return 0;
+  return buffer[x + y * WIDTH];
+}
+
+void GFXcanvas16::fillScreen(uint16_t color) {
+  if (buffer) {
+    uint8_t hi = color >> 8, lo = color & 0xFF;
+    if (hi == lo) {
+      memset(buffer, lo, WIDTH * HEIGHT * 2);
+    } else {
+      uint32_t i, pixels = WIDTH * HEIGHT;
+      for (i = 0; i < pixels; i++) buffer[i] = color;
+    }
+  }
+}
+
+void GFXcanvas16::drawFastVLine(int16_t x, int16_t y, int16_t h,
+                                uint16_t color) {
+  if (h < 0) {
+    h *= -1;
+    y -= h - 1;
+    if (y < 0) {
+      h += y;
+      y = 0;
+    }
+  }
+  if ((x < 0) || (x >= width()) || (y >= height()) || ((y + h - 1) < 0)) {
+    return;
+  }
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (y + h > height()) {
+    h = height() - y;
+  }
+  uint16_t *buffer_ptr = buffer + y * WIDTH + x;
+  for (int16_t i = 0; i < h; i++) {
+    *buffer_ptr = color;
+    buffer_ptr += WIDTH;
+  }
+}
+
+void GFXcanvas16::drawFastHLine(int16_t x, int16_t y, int16_t w,
+                                uint16_t color) {
+  if (w < 0) {
+    w *= -1;
+    x -= w - 1;
+    if (x < 0) {
+      w += x;
+      x = 0;
+    }
+  }
+  if ((y < 0) || (y >= height()) || (x >= width()) || ((x + w - 1) < 0)) {
+    return;
+  }
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (x + w >= width()) {
+    w = width() - x;
+  }
+  uint16_t *buffer_ptr = buffer + y * WIDTH + x;
+  for (int16_t i = 0; i < w; i++) {
+    *buffer_ptr++ = color;
+  }
+}
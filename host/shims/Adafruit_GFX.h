@@ -0,0 +1,153 @@
+// Host stand-in for Adafruit GFX Library 1.11.9.
+//
+// The drawing primitives mirror the upstream implementation, so pixel output
+// and text metrics match the device. Only the classic 5x7 font bitmap differs:
+// see glcdfont.cpp.
+
+#ifndef LMS_HOST_ADAFRUIT_GFX_H
+#define LMS_HOST_ADAFRUIT_GFX_H
+
+#include "Arduino.h"
+#include "gfxfont.h"
+
+class Adafruit_GFX : public Print {
+ public:
+  Adafruit_GFX(int16_t w, int16_t h);
+  virtual ~Adafruit_GFX() {}
+
+  // This MUST be defined by the subclass:
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  // TRANSACTION API / CORE DRAW API
+  virtual void startWrite(void) {}
+  virtual void writePixel(int16_t x, int16_t y, uint16_t color) {
+    drawPixel(x, y, color);
+  }
+  virtual void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                             uint16_t color) {
+    fillRect(x, y, w, h, color);
+  }
+  virtual void writeFastVLine(int16_t x, int16_t y, int16_t h,
+                              uint16_t color) {
+    drawFastVLine(x, y, h, color);
+  }
+  virtual void writeFastHLine(int16_t x, int16_t y, int16_t w,
+                              uint16_t color) {
+    drawFastHLine(x, y, w, color);
+  }
+  virtual void writeLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                         uint16_t color);
+  virtual void endWrite(void) {}
+
+  // CONTROL API
+  virtual void setRotation(uint8_t r) { rotation = r & 3; }
+  virtual void invertDisplay(bool i) {}
+
+  // BASIC DRAW API
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                        uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                        uint16_t color);
+  virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                        uint16_t color);
+
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
+                  int16_t h, uint16_t color);
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w,
+                  int16_t h, uint16_t color, uint16_t bg);
+  void drawRGBBitmap(int16_t x, int16_t y, const uint16_t bitmap[], int16_t w,
+                     int16_t h);
+  void drawRGBBitmap(int16_t x, int16_t y, const uint16_t bitmap[],
+                     const uint8_t mask[], int16_t w, int16_t h);
+  void drawRGBBitmap(int16_t x, int16_t y, uint16_t *bitmap, int16_t w,
+                     int16_t h) {
+    drawRGBBitmap(x, y, (const uint16_t *)bitmap, w, h);
+  }
+  void drawRGBBitmap(int16_t x, int16_t y, uint16_t *bitmap, uint8_t *mask,
+                     int16_t w, int16_t h) {
+    drawRGBBitmap(x, y, (const uint16_t *)bitmap, (const uint8_t *)mask, w, h);
+  }
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                uint16_t bg, uint8_t size_x, uint8_t size_y);
+  void getTextBounds(const char *string, int16_t x, int16_t y, int16_t *x1,
+                     int16_t *y1, uint16_t *w, uint16_t *h);
+  void getTextBounds(const String &str, int16_t x, int16_t y, int16_t *x1,
+                     int16_t *y1, uint16_t *w, uint16_t *h);
+  void setTextSize(uint8_t s) { setTextSize(s, s); }
+  void setTextSize(uint8_t sx, uint8_t sy) {
+    textsize_x = (sx > 0) ? sx : 1;
+    textsize_y = (sy > 0) ? sy : 1;
+  }
+  void setFont(const GFXfont *f = NULL);
+  void setCursor(int16_t x, int16_t y) {
+    cursor_x = x;
+    cursor_y = y;
+  }
+  void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+  void setTextColor(uint16_t c, uint16_t bg) {
+    textcolor = c;
+    textbgcolor = bg;
+  }
+  void setTextWrap(bool w) { wrap = w; }
+  void cp437(bool x = true) { _cp437 = x; }
+
+  using Print::write;
+  virtual size_t write(uint8_t);
+
+  int16_t width(void) const { return _width; }
+  int16_t height(void) const { return _height; }
+  uint8_t getRotation(void) const { return rotation; }
+  int16_t getCursorX(void) const { return cursor_x; }
+  int16_t getCursorY(void) const { return cursor_y; }
+
+ protected:
+  void charBounds(unsigned char c, int16_t *x, int16_t *y, int16_t *minx,
+                  int16_t *miny, int16_t *maxx, int16_t *maxy);
+  int16_t WIDTH;
+  int16_t HEIGHT;
+  int16_t _width;
+  int16_t _height;
+  int16_t cursor_x;
+  int16_t cursor_y;
+  uint16_t textcolor;
+  uint16_t textbgcolor;
+  uint8_t textsize_x;
+  uint8_t textsize_y;
+  uint8_t rotation;
+  bool wrap;
+  bool _cp437;
+  GFXfont *gfxFont;
+};
+
+class GFXcanvas1 : public Adafruit_GFX {
+ public:
+  GFXcanvas1(uint16_t w, uint16_t h);
+  ~GFXcanvas1(void);
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillScreen(uint16_t color);
+  bool getPixel(int16_t x, int16_t y) const;
+  uint8_t *getBuffer(void) const { return buffer; }
+
+ protected:
+  uint8_t *buffer;
+};
+
+class GFXcanvas16 : public Adafruit_GFX {
+ public:
+  GFXcanvas16(uint16_t w, uint16_t h);
+  ~GFXcanvas16(void);
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void fillScreen(uint16_t color);
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  uint16_t getPixel(int16_t x, int16_t y) const;
+  uint16_t *getBuffer(void) const { return buffer; }
+
+ protected:
+  uint16_t *buffer;
+};
+
+#endif /* LMS_HOST_ADAFRUIT_GFX_H */
@@ -0,0 +1,146 @@
+#include "Arduino.h"
+
+#include <freertos/task.h>
+#include <unistd.h>
+
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "host.h"
+
+namespace {
+
+const std::chrono::steady_clock::time_point start_time =
+    std::chrono::steady_clock::now();
+bool serial_enabled = false;
+std::atomic<time_t> stopped_wall_clock(0);
+
+}  // namespace
+
+namespace lms_host {
+
+uint32_t now_ms() { return (uint32_t)(now_us() / 1000); }
+
+uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start_time)
+      .count();
+}
+
+void set_serial_enabled(bool enabled) { serial_enabled = enabled; }
+
+void set_wall_clock(time_t now) { stopped_wall_clock = now; }
+
+bool read_file(const std::string &path, std::string *dst) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  *dst = buffer.str();
+  return true;
+}
+
+std::string shift_timestamps(const std::string &body, long offset_sec) {
+  // matches YYYY-MM-DDTHH:MM:SS followed by a +HH:MM/-HH:MM offset
+  std::string out = body;
+  for (size_t i = 0; i + 25 <= out.size(); i++) {
+    const char *p = out.c_str() + i;
+    if (!(isdigit(p[0]) && isdigit(p[3]) && p[4] == '-' && p[7] == '-' &&
+          p[10] == 'T' && p[13] == ':' && p[16] == ':' &&
+          (p[19] == '-' || p[19] == '+') && p[22] == ':')) {
+      continue;
+    }
+    struct tm t = {};
+    if (!strptime(p, "%Y-%m-%dT%H:%M:%S", &t)) {
+      continue;
+    }
+    // shift the wall clock time, the zone offset is kept as is
+    time_t wall = timegm(&t) + offset_sec;
+    struct tm shifted;
+    gmtime_r(&wall, &shifted);
+    char buf[20];
+    strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &shifted);
+    memcpy(&out[i], buf, 19);
+    i += 24;
+  }
+  return out;
+}
+
+}  // namespace lms_host
+
+unsigned long millis() { return lms_host::now_ms(); }
+
+unsigned long micros() { return (unsigned long)lms_host::now_us(); }
+
+// vTaskDelay, as in the ESP32 core
+void delay(uint32_t ms) { vTaskDelay(ms); }
+
+void configTzTime(const char *tz, const char *server1, const char *server2,
+                  const char *server3) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+// Replaces the C library's time(), so the firmware, the routes and
+// getLocalTime() all see the wall clock set by set_wall_clock().
+extern "C" time_t time(time_t *t) {
+  time_t now = stopped_wall_clock;
+  if (now == 0) {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = ts.tv_sec;
+  }
+  if (t) {
+    *t = now;
+  }
+  return now;
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms) {
+  time_t now = time(nullptr);
+  localtime_r(&now, info);
+  return true;
+}
+
+size_t Print::print(const struct tm *timeinfo, const char *format) {
+  char buf[64];
+  size_t n = strftime(buf, sizeof(buf), format ? format : "%c", timeinfo);
+  return write((const uint8_t *)buf, n);
+}
+
+size_t Print::printf(const char *format, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  if ((size_t)len >= sizeof(buf)) {
+    std::string big(len + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&big[0], big.size(), format, args);
+    va_end(args);
+    return write((const uint8_t *)big.data(), len);
+  }
+  return write((const uint8_t *)buf, len);
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (serial_enabled) {
+    fwrite(buffer, 1, size, stderr);
+  }
+  return size;
+}
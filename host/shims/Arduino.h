@@ -0,0 +1,191 @@
+// Host stand-in for the subset of the Arduino/ESP32 core used by the sign.
+//
+// Only what the firmware actually touches is implemented here. Behaviour
+// follows arduino-esp32 2.0.14 closely enough for the firmware to run
+// unmodified on Linux; it is not a general purpose Arduino emulation.
+
+#ifndef LMS_HOST_ARDUINO_H
+#define LMS_HOST_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+
+// as in arduino-esp32, where esp32-hal.h pulls in the FreeRTOS API
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+using std::max;
+using std::min;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_pointer(addr) (*(void *const *)(addr))
+
+// newlib extension used by the firmware
+#define sniprintf snprintf
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+// esp32-hal-time
+void configTzTime(const char *tz, const char *server1,
+                  const char *server2 = nullptr,
+                  const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+class String {
+  std::string s;
+
+ public:
+  String() {}
+  String(const char *str) : s(str ? str : "") {}
+  String(const std::string &str) : s(str) {}
+  String(char c) : s(1, c) {}
+  String(int value) : s(std::to_string(value)) {}
+  String(unsigned int value) : s(std::to_string(value)) {}
+  String(long value) : s(std::to_string(value)) {}
+  String(unsigned long value) : s(std::to_string(value)) {}
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  void toCharArray(char *buf, unsigned int size,
+                   unsigned int index = 0) const {
+    if (!buf || size == 0) return;
+    if (index >= s.length()) {
+      buf[0] = '\0';
+      return;
+    }
+    size_t n = std::min<size_t>(size - 1, s.length() - index);
+    memcpy(buf, s.data() + index, n);
+    buf[n] = '\0';
+  }
+  bool equals(const String &other) const { return s == other.s; }
+  bool equals(const char *other) const { return s == (other ? other : ""); }
+  void toLowerCase() {
+    for (char &c : s) c = tolower((unsigned char)c);
+  }
+  int indexOf(const char *str) const {
+    size_t i = s.find(str);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  int indexOf(char c) const {
+    size_t i = s.find(c);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned int from) const {
+    return from >= s.length() ? String() : String(s.substr(from));
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from >= s.length() || to <= from) return String();
+    return String(s.substr(from, to - from));
+  }
+  long toInt() const { return atol(s.c_str()); }
+  char operator[](unsigned int i) const { return i < s.length() ? s[i] : 0; }
+
+  String &operator+=(const String &rhs) {
+    s += rhs.s;
+    return *this;
+  }
+  friend String operator+(const String &lhs, const String &rhs) {
+    return String(lhs.s + rhs.s);
+  }
+  friend String operator+(const char *lhs, const String &rhs) {
+    return String(std::string(lhs) + rhs.s);
+  }
+  friend String operator+(const String &lhs, const char *rhs) {
+    return String(lhs.s + rhs);
+  }
+  bool operator==(const String &rhs) const { return s == rhs.s; }
+  bool operator==(const char *rhs) const { return equals(rhs); }
+  bool operator!=(const String &rhs) const { return s != rhs.s; }
+  explicit operator bool() const { return true; }
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char *str) {
+    return str ? write((const uint8_t *)str, strlen(str)) : 0;
+  }
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(const String &str) { return write(str.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n) { return printf("%d", n); }
+  size_t print(unsigned int n) { return printf("%u", n); }
+  size_t print(long n) { return printf("%ld", n); }
+  size_t print(unsigned long n) { return printf("%lu", n); }
+  size_t print(double n) { return printf("%.2f", n); }
+  size_t print(const struct tm *timeinfo, const char *format = nullptr);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(T value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  size_t println(const struct tm *timeinfo, const char *format = nullptr) {
+    size_t n = print(timeinfo, format);
+    return n + println();
+  }
+
+  size_t printf(const char *format, ...)
+      __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(uint8_t *buffer, size_t length) {
+    size_t n = 0;
+    while (n < length) {
+      int c = read();
+      if (c < 0) break;
+      buffer[n++] = (uint8_t)c;
+    }
+    return n;
+  }
+  size_t readBytes(char *buffer, size_t length) {
+    return readBytes((uint8_t *)buffer, length);
+  }
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) {}
+  explicit operator bool() const { return true; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* LMS_HOST_ARDUINO_H */
@@ -0,0 +1,435 @@
+#include "ArduinoJson.h"
+
+namespace lms_host_json {
+
+Node *Node::member(const char *key, bool create) {
+  if (type == Object) {
+    for (auto &m : members) {
+      if (m.first == key) return m.second.get();
+    }
+  } else if (type == Null && create) {
+    type = Object;
+  } else {
+    return nullptr;
+  }
+  if (!create) return nullptr;
+  members.emplace_back(key, std::unique_ptr<Node>(new Node));
+  return members.back().second.get();
+}
+
+Node *Node::element(size_t index, bool create) {
+  if (type == Array) {
+    if (index < items.size()) return items[index].get();
+  } else if (type == Null && create) {
+    type = Array;
+  } else {
+    return nullptr;
+  }
+  if (!create) return nullptr;
+  while (items.size() <= index) {
+    items.emplace_back(new Node);
+  }
+  return items[index].get();
+}
+
+bool equals(const Node *a, const Node *b) {
+  bool a_null = !a || a->type == Node::Null;
+  bool b_null = !b || b->type == Node::Null;
+  if (a_null || b_null) return a_null && b_null;
+  if ((a->type == Node::Int || a->type == Node::Float) &&
+      (b->type == Node::Int || b->type == Node::Float)) {
+    return as_double(a) == as_double(b);
+  }
+  if (a->type != b->type) return false;
+  switch (a->type) {
+    case Node::Bool:
+      return a->b == b->b;
+    case Node::Str:
+      return a->s == b->s;
+    case Node::Array:
+      if (a->items.size() != b->items.size()) return false;
+      for (size_t i = 0; i < a->items.size(); i++) {
+        if (!equals(a->items[i].get(), b->items[i].get())) return false;
+      }
+      return true;
+    case Node::Object:
+      if (a->members.size() != b->members.size()) return false;
+      for (auto &m : a->members) {
+        if (!equals(m.second.get(), const_cast<Node *>(b)->member(
+                                        m.first.c_str(), false))) {
+          return false;
+        }
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+double as_double(const Node *n) {
+  if (!n) return 0;
+  switch (n->type) {
+    case Node::Bool:
+      return n->b;
+    case Node::Int:
+      return (double)n->i;
+    case Node::Float:
+      return n->f;
+    default:
+      return 0;
+  }
+}
+
+int64_t as_int(const Node *n) {
+  if (!n) return 0;
+  switch (n->type) {
+    case Node::Bool:
+      return n->b;
+    case Node::Int:
+      return n->i;
+    case Node::Float:
+      return (int64_t)n->f;
+    default:
+      return 0;
+  }
+}
+
+namespace {
+
+class Reader {
+ public:
+  virtual ~Reader() {}
+  virtual int read() = 0;
+  int peek_char = -2;
+  int next() {
+    if (peek_char != -2) {
+      int c = peek_char;
+      peek_char = -2;
+      return c;
+    }
+    return read();
+  }
+  int peek() {
+    if (peek_char == -2) peek_char = read();
+    return peek_char;
+  }
+  int skip_space() {
+    int c;
+    while ((c = peek()) == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      next();
+    }
+    return c;
+  }
+};
+
+class StreamReader : public Reader {
+  Stream &stream;
+
+ public:
+  explicit StreamReader(Stream &stream) : stream(stream) {}
+  int read() override { return stream.read(); }
+};
+
+class StringReader : public Reader {
+  const char *p;
+
+ public:
+  explicit StringReader(const char *p) : p(p) {}
+  int read() override { return *p ? (uint8_t)*p++ : -1; }
+};
+
+typedef DeserializationError Error;
+
+void append_utf8(std::string &s, uint32_t cp) {
+  if (cp < 0x80) {
+    s.push_back((char)cp);
+  } else if (cp < 0x800) {
+    s.push_back((char)(0xC0 | (cp >> 6)));
+    s.push_back((char)(0x80 | (cp & 0x3F)));
+  } else {
+    s.push_back((char)(0xE0 | (cp >> 12)));
+    s.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+    s.push_back((char)(0x80 | (cp & 0x3F)));
+  }
+}
+
+Error::Code parse_string(Reader &in, std::string *dst) {
+  in.next();  // opening quote
+  while (true) {
+    int c = in.next();
+    if (c < 0) return Error::IncompleteInput;
+    if (c == '"') return Error::Ok;
+    if (c == '\\') {
+      c = in.next();
+      switch (c) {
+        case 'n':
+          c = '\n';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case 'r':
+          c = '\r';
+          break;
+        case 'b':
+          c = '\b';
+          break;
+        case 'f':
+          c = '\f';
+          break;
+        case 'u': {
+          uint32_t cp = 0;
+          for (int k = 0; k < 4; k++) {
+            int h = in.next();
+            if (h < 0) return Error::IncompleteInput;
+            cp = cp * 16 + (isdigit(h) ? h - '0' : (tolower(h) - 'a' + 10));
+          }
+          if (dst) append_utf8(*dst, cp);
+          continue;
+        }
+        case -1:
+          return Error::IncompleteInput;
+        default:
+          break;
+      }
+    }
+    if (dst) dst->push_back((char)c);
+  }
+}
+
+// Filter semantics: a null filter drops the value, a true filter keeps all of
+// it, an object filter keeps the listed members and an array filter applies
+// its first element to every element.
+bool keeps_all(const Node *filter) {
+  return filter && filter->type == Node::Bool && filter->b;
+}
+
+Error::Code parse_value(Reader &in, Node *dst, const Node *filter, int depth);
+
+Error::Code parse_object(Reader &in, Node *dst, const Node *filter,
+                         int depth) {
+  in.next();  // {
+  if (dst) dst->type = Node::Object;
+  if (in.skip_space() == '}') {
+    in.next();
+    return Error::Ok;
+  }
+  while (true) {
+    if (in.skip_space() != '"') return Error::InvalidInput;
+    std::string key;
+    Error::Code err = parse_string(in, &key);
+    if (err) return err;
+    if (in.skip_space() != ':') return Error::InvalidInput;
+    in.next();
+    const Node *member_filter = nullptr;
+    if (keeps_all(filter)) {
+      member_filter = filter;
+    } else if (filter && filter->type == Node::Object) {
+      member_filter = const_cast<Node *>(filter)->member(key.c_str(), false);
+    }
+    Node *member = nullptr;
+    if (dst && member_filter && member_filter->type != Node::Null) {
+      dst->members.emplace_back(key, std::unique_ptr<Node>(new Node));
+      member = dst->members.back().second.get();
+    }
+    err = parse_value(in, member, member ? member_filter : nullptr, depth + 1);
+    if (err) return err;
+    int c = in.skip_space();
+    in.next();
+    if (c == '}') return Error::Ok;
+    if (c != ',') return c < 0 ? Error::IncompleteInput : Error::InvalidInput;
+  }
+}
+
+Error::Code parse_array(Reader &in, Node *dst, const Node *filter, int depth) {
+  in.next();  // [
+  if (dst) dst->type = Node::Array;
+  const Node *element_filter = nullptr;
+  if (keeps_all(filter)) {
+    element_filter = filter;
+  } else if (filter && filter->type == Node::Array && !filter->items.empty()) {
+    element_filter = filter->items[0].get();
+  }
+  if (in.skip_space() == ']') {
+    in.next();
+    return Error::Ok;
+  }
+  while (true) {
+    Node *element = nullptr;
+    if (dst && element_filter && element_filter->type != Node::Null) {
+      dst->items.emplace_back(new Node);
+      element = dst->items.back().get();
+    }
+    Error::Code err =
+        parse_value(in, element, element ? element_filter : nullptr, depth + 1);
+    if (err) return err;
+    int c = in.skip_space();
+    in.next();
+    if (c == ']') return Error::Ok;
+    if (c != ',') return c < 0 ? Error::IncompleteInput : Error::InvalidInput;
+  }
+}
+
+Error::Code parse_literal(Reader &in, Node *dst) {
+  std::string token;
+  int c;
+  while ((c = in.peek()) >= 0 &&
+         (isalnum(c) || c == '-' || c == '+' || c == '.')) {
+    token.push_back((char)in.next());
+  }
+  if (token.empty()) return c < 0 ? Error::IncompleteInput : Error::InvalidInput;
+  if (!dst) return Error::Ok;
+  if (token == "null") {
+    dst->type = Node::Null;
+  } else if (token == "true" || token == "false") {
+    dst->type = Node::Bool;
+    dst->b = token == "true";
+  } else if (token.find_first_of(".eE") != std::string::npos) {
+    dst->type = Node::Float;
+    dst->f = strtod(token.c_str(), nullptr);
+  } else {
+    dst->type = Node::Int;
+    dst->i = strtoll(token.c_str(), nullptr, 10);
+  }
+  return Error::Ok;
+}
+
+Error::Code parse_value(Reader &in, Node *dst, const Node *filter,
+                        int depth) {
+  if (depth > 10) return Error::InvalidInput;  // ArduinoJson nesting limit
+  int c = in.skip_space();
+  if (c < 0) return depth == 0 ? Error::EmptyInput : Error::IncompleteInput;
+  if (c == '{') return parse_object(in, dst, filter, depth);
+  if (c == '[') return parse_array(in, dst, filter, depth);
+  if (c == '"') {
+    if (dst) dst->type = Node::Str;
+    return parse_string(in, dst ? &dst->s : nullptr);
+  }
+  return parse_literal(in, dst);
+}
+
+DeserializationError deserialize(JsonDocument &doc, Reader &in,
+                                 const Node *filter) {
+  doc.clear();
+  return DeserializationError(
+      parse_value(in, doc.host_root(), filter, 0));
+}
+
+Node keep_everything() {
+  Node n;
+  n.type = Node::Bool;
+  n.b = true;
+  return n;
+}
+
+const Node keep_all_filter = keep_everything();
+
+}  // namespace
+}  // namespace lms_host_json
+
+JsonVariant &JsonVariant::operator=(bool value) {
+  if (node) {
+    node->clear();
+    node->type = lms_host_json::Node::Bool;
+    node->b = value;
+  }
+  return *this;
+}
+
+JsonVariant &JsonVariant::operator=(int value) {
+  if (node) {
+    node->clear();
+    node->type = lms_host_json::Node::Int;
+    node->i = value;
+  }
+  return *this;
+}
+
+JsonVariant &JsonVariant::operator=(const char *value) {
+  if (node) {
+    node->clear();
+    node->type = lms_host_json::Node::Str;
+    node->s = value;
+  }
+  return *this;
+}
+
+JsonVariant::operator bool() const {
+  if (!node) return false;
+  if (node->type == lms_host_json::Node::Bool) return node->b;
+  return lms_host_json::as_double(node) != 0;
+}
+
+JsonVariant::operator const char *() const {
+  return node && node->type == lms_host_json::Node::Str ? node->s.c_str()
+                                                         : nullptr;
+}
+
+JsonVariant::operator String() const {
+  using lms_host_json::Node;
+  if (!node || node->type == Node::Null) return String("null");
+  switch (node->type) {
+    case Node::Str:
+      return String(node->s);
+    case Node::Bool:
+      return String(node->b ? "true" : "false");
+    case Node::Int:
+      return String(std::to_string(node->i));
+    case Node::Float: {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%g", node->f);
+      return String(buf);
+    }
+    default:
+      return String("");
+  }
+}
+
+JsonVariant::operator JsonObject() const {
+  return JsonObject(node && node->type == lms_host_json::Node::Object
+                        ? node
+                        : nullptr);
+}
+
+JsonVariant::operator JsonArray() const {
+  return JsonArray(node && node->type == lms_host_json::Node::Array ? node
+                                                                    : nullptr);
+}
+
+const char *DeserializationError::c_str() const {
+  switch (code) {
+    case Ok:
+      return "Ok";
+    case EmptyInput:
+      return "EmptyInput";
+    case IncompleteInput:
+      return "IncompleteInput";
+    case InvalidInput:
+      return "InvalidInput";
+    case NoMemory:
+      return "NoMemory";
+  }
+  return "???";
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input) {
+  lms_host_json::StreamReader in(input);
+  return lms_host_json::deserialize(doc, in, &lms_host_json::keep_all_filter);
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input,
+                                     DeserializationOption::Filter filter) {
+  lms_host_json::StreamReader in(input);
+  return lms_host_json::deserialize(doc, in, filter.node);
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input) {
+  lms_host_json::StringReader in(input);
+  return lms_host_json::deserialize(doc, in, &lms_host_json::keep_all_filter);
+}
+
+DeserializationError deserializeJson(JsonDocument &doc, const char *input,
+                                     DeserializationOption::Filter filter) {
+  lms_host_json::StringReader in(input);
+  return lms_host_json::deserialize(doc, in, filter.node);
+}
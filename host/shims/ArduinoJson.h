@@ -0,0 +1,193 @@
+// Host stand-in for the subset of ArduinoJson 6.19 used by the sign.
+//
+// Documents are trees of heap allocated nodes rather than a fixed memory
+// pool, so document capacity is not enforced. Looking up a missing member or
+// element creates it as null, which is how filters are built with
+// doc["a"][0]["b"] = true; reads of missing values still behave as null.
+
+#ifndef LMS_HOST_ARDUINOJSON_H
+#define LMS_HOST_ARDUINOJSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+
+namespace lms_host_json {
+
+struct Node {
+  enum Type { Null, Bool, Int, Float, Str, Array, Object } type = Null;
+  bool b = false;
+  int64_t i = 0;
+  double f = 0;
+  std::string s;
+  std::vector<std::unique_ptr<Node>> items;
+  std::vector<std::pair<std::string, std::unique_ptr<Node>>> members;
+
+  void clear() {
+    type = Null;
+    s.clear();
+    items.clear();
+    members.clear();
+  }
+  Node *member(const char *key, bool create);
+  Node *element(size_t index, bool create);
+  size_t size() const {
+    return type == Array ? items.size()
+                         : type == Object ? members.size() : 0;
+  }
+};
+
+bool equals(const Node *a, const Node *b);
+double as_double(const Node *n);
+int64_t as_int(const Node *n);
+
+}  // namespace lms_host_json
+
+class JsonObject;
+class JsonArray;
+
+class JsonVariant {
+ protected:
+  lms_host_json::Node *node;
+
+ public:
+  JsonVariant(lms_host_json::Node *node = nullptr) : node(node) {}
+
+  JsonVariant operator[](const char *key) const {
+    return JsonVariant(node ? node->member(key, true) : nullptr);
+  }
+  JsonVariant operator[](const String &key) const {
+    return (*this)[key.c_str()];
+  }
+  JsonVariant operator[](int index) const {
+    return JsonVariant(node ? node->element(index, true) : nullptr);
+  }
+  JsonVariant operator[](size_t index) const {
+    return (*this)[(int)index];
+  }
+
+  bool isNull() const {
+    return !node || node->type == lms_host_json::Node::Null;
+  }
+  size_t size() const { return node ? node->size() : 0; }
+
+  JsonVariant &operator=(bool value);
+  JsonVariant &operator=(int value);
+  JsonVariant &operator=(const char *value);
+
+  operator bool() const;
+  operator int() const { return (int)lms_host_json::as_int(node); }
+  operator unsigned int() const {
+    return (unsigned int)lms_host_json::as_int(node);
+  }
+  operator long() const { return (long)lms_host_json::as_int(node); }
+  operator unsigned long() const {
+    return (unsigned long)lms_host_json::as_int(node);
+  }
+  operator double() const { return lms_host_json::as_double(node); }
+  operator const char *() const;
+  operator String() const;
+  operator JsonObject() const;
+  operator JsonArray() const;
+
+  friend bool operator==(const JsonVariant &a, const JsonVariant &b) {
+    return lms_host_json::equals(a.node, b.node);
+  }
+  friend bool operator!=(const JsonVariant &a, const JsonVariant &b) {
+    return !(a == b);
+  }
+  friend bool operator<(const JsonVariant &a, const JsonVariant &b) {
+    return lms_host_json::as_double(a.node) < lms_host_json::as_double(b.node);
+  }
+
+  lms_host_json::Node *host_node() const { return node; }
+};
+
+class JsonObject : public JsonVariant {
+ public:
+  JsonObject(lms_host_json::Node *node = nullptr) : JsonVariant(node) {}
+};
+
+class JsonArray : public JsonVariant {
+ public:
+  JsonArray(lms_host_json::Node *node = nullptr) : JsonVariant(node) {}
+
+  class iterator {
+    lms_host_json::Node *array;
+    size_t index;
+
+   public:
+    iterator(lms_host_json::Node *array, size_t index)
+        : array(array), index(index) {}
+    JsonVariant operator*() const {
+      return JsonVariant(array->items[index].get());
+    }
+    iterator &operator++() {
+      index++;
+      return *this;
+    }
+    bool operator!=(const iterator &other) const {
+      return index != other.index;
+    }
+  };
+
+  iterator begin() const { return iterator(node, 0); }
+  iterator end() const { return iterator(node, size()); }
+};
+
+class JsonDocument : public JsonVariant {
+  lms_host_json::Node root;
+
+ public:
+  JsonDocument() : JsonVariant(&root) {}
+  JsonDocument(const JsonDocument &) = delete;
+  JsonDocument &operator=(const JsonDocument &) = delete;
+  void clear() { root.clear(); }
+  lms_host_json::Node *host_root() { return &root; }
+};
+
+class DynamicJsonDocument : public JsonDocument {
+ public:
+  explicit DynamicJsonDocument(size_t capacity) {}
+};
+
+template <size_t N>
+class StaticJsonDocument : public JsonDocument {};
+
+class DeserializationError {
+ public:
+  enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory };
+  DeserializationError(Code code = Ok) : code(code) {}
+  explicit operator bool() const { return code != Ok; }
+  const char *c_str() const;
+  const char *f_str() const { return c_str(); }
+
+ private:
+  Code code;
+};
+
+namespace DeserializationOption {
+
+class Filter {
+ public:
+  explicit Filter(const JsonDocument &filter)
+      : node(filter.host_node()) {}
+  lms_host_json::Node *node;
+};
+
+}  // namespace DeserializationOption
+
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input);
+DeserializationError deserializeJson(JsonDocument &doc, Stream &input,
+                                     DeserializationOption::Filter filter);
+DeserializationError deserializeJson(JsonDocument &doc, const char *input);
+DeserializationError deserializeJson(JsonDocument &doc, const char *input,
+                                     DeserializationOption::Filter filter);
+
+#endif /* LMS_HOST_ARDUINOJSON_H */
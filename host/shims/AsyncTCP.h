@@ -0,0 +1,3 @@
+#ifndef LMS_HOST_ASYNCTCP_H
+#define LMS_HOST_ASYNCTCP_H
+#endif /* LMS_HOST_ASYNCTCP_H */
@@ -0,0 +1,19 @@
+#ifndef LMS_HOST_BUTTON2_H
+#define LMS_HOST_BUTTON2_H
+
+#include <stdint.h>
+
+// Taps are injected with lms_host::tap_button().
+class Button2 {
+ public:
+  typedef void (*CallbackFunction)(Button2 &);
+  void begin(uint8_t pin) { this->pin = pin; }
+  void setTapHandler(CallbackFunction f) { tap_handler = f; }
+  void loop();
+
+ private:
+  uint8_t pin = 0;
+  CallbackFunction tap_handler = nullptr;
+};
+
+#endif /* LMS_HOST_BUTTON2_H */
@@ -0,0 +1,195 @@
+#include "ESP32-HUB75-MatrixPanel-I2S-DMA.h"
+
+#include <atomic>
+
+namespace {
+
+std::atomic<uint64_t> pixel_writes(0);
+std::atomic<uint64_t> full_fills(0);
+
+}  // namespace
+
+// CIE 1931, L* = i / 255 * 100 mapped to 16 bit luminance
+const uint16_t lumConvTab[256] = {
+    0, 28, 57, 85, 114, 142, 171, 199, 228, 256,
+    285, 313, 341, 370, 398, 427, 455, 484, 512, 541,
+    569, 598, 627, 658, 689, 721, 755, 789, 825, 861,
+    899, 937, 977, 1018, 1060, 1103, 1147, 1192, 1239, 1287,
+    1336, 1386, 1437, 1490, 1544, 1599, 1656, 1714, 1773, 1834,
+    1896, 1959, 2024, 2090, 2157, 2226, 2297, 2369, 2442, 2517,
+    2593, 2671, 2751, 2832, 2914, 2999, 3085, 3172, 3261, 3352,
+    3444, 3538, 3634, 3732, 3831, 3932, 4035, 4139, 4245, 4354,
+    4464, 4575, 4689, 4804, 4922, 5041, 5162, 5285, 5410, 5537,
+    5666, 5797, 5930, 6065, 6202, 6341, 6482, 6626, 6771, 6918,
+    7068, 7220, 7373, 7529, 7687, 7848, 8010, 8175, 8342, 8512,
+    8683, 8857, 9033, 9212, 9393, 9576, 9762, 9949, 10140, 10333,
+    10528, 10725, 10926, 11128, 11333, 11541, 11751, 11963, 12179, 12396,
+    12617, 12840, 13065, 13293, 13524, 13757, 13993, 14232, 14474, 14718,
+    14965, 15215, 15467, 15722, 15980, 16241, 16505, 16771, 17041, 17313,
+    17588, 17866, 18147, 18431, 18717, 19007, 19300, 19596, 19894, 20196,
+    20501, 20809, 21119, 21433, 21750, 22071, 22394, 22720, 23050, 23383,
+    23719, 24058, 24400, 24746, 25095, 25447, 25802, 26161, 26523, 26888,
+    27257, 27629, 28004, 28383, 28765, 29151, 29540, 29932, 30328, 30728,
+    31131, 31537, 31947, 32360, 32777, 33198, 33622, 34050, 34481, 34916,
+    35355, 35797, 36243, 36693, 37146, 37603, 38064, 38529, 38997, 39469,
+    39945, 40425, 40908, 41396, 41887, 42382, 42881, 43384, 43891, 44401,
+    44916, 45435, 45957, 46484, 47015, 47549, 48088, 48631, 49178, 49728,
+    50283, 50843, 51406, 51973, 52545, 53120, 53700, 54284, 54873, 55465,
+    56062, 56663, 57269, 57878, 58492, 59111, 59733, 60360, 60992, 61627,
+    62268, 62912, 63561, 64215, 64873, 65535,
+};
+
+namespace lms_host {
+
+PanelStats panel_stats() { return {pixel_writes.load(), full_fills.load()}; }
+
+void reset_panel_stats() {
+  pixel_writes = 0;
+  full_fills = 0;
+}
+
+}  // namespace lms_host
+
+MatrixPanel_I2S_DMA::MatrixPanel_I2S_DMA(const HUB75_I2S_CFG &opts)
+    : Adafruit_GFX(opts.mx_width * opts.chain_length, opts.mx_height),
+      m_cfg(opts),
+      PIXELS_PER_ROW(opts.mx_width * opts.chain_length),
+      ROWS_PER_FRAME(opts.mx_height / 2) {}
+
+MatrixPanel_I2S_DMA::~MatrixPanel_I2S_DMA() {
+  for (rowBitStruct *row : dma_buff.rowBits) {
+    delete row;
+  }
+}
+
+bool MatrixPanel_I2S_DMA::begin() {
+  if (initialized) {
+    return true;
+  }
+  dma_buff.rows = ROWS_PER_FRAME;
+  for (int r = 0; r < ROWS_PER_FRAME; r++) {
+    dma_buff.rowBits.push_back(new rowBitStruct(
+        PIXELS_PER_ROW, PIXEL_COLOR_DEPTH_BITS, m_cfg.double_buff));
+  }
+  setupControlBits();
+  initialized = true;
+  return true;
+}
+
+// Row address, latch and output enable bits. The address lines select the
+// previous row while the current one is shifted in, and OE blanks the columns
+// outside the brightness window, as the library does.
+void MatrixPanel_I2S_DMA::setupControlBits() {
+  for (int r = 0; r < ROWS_PER_FRAME; r++) {
+    int row_prev = r == 0 ? ROWS_PER_FRAME - 1 : r - 1;
+    uint16_t address = (row_prev << 8) & (BIT_A | BIT_B | BIT_C | BIT_D |
+                                          BIT_E);
+    for (int buff = 0; buff < (m_cfg.double_buff ? 2 : 1); buff++) {
+      for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+        ESP32_I2S_DMA_STORAGE_TYPE *row = getRowDataPtr(r, d, buff);
+        int lit = (PIXELS_PER_ROW * brightness) >> 8;
+        for (int x = 0; x < PIXELS_PER_ROW; x++) {
+          uint16_t v = row[x] & ~BITMASK_RGB12_CLEAR;
+          v |= address;
+          if (x < m_cfg.latch_blanking || x >= lit) v |= BIT_OE;
+          if (x == PIXELS_PER_ROW - 1) v |= BIT_LAT;
+          row[x] = v;
+        }
+      }
+    }
+  }
+}
+
+void MatrixPanel_I2S_DMA::setBrightness8(const uint8_t b) {
+  brightness = b;
+  if (initialized) {
+    setupControlBits();
+  }
+}
+
+void MatrixPanel_I2S_DMA::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  uint8_t r, g, b;
+  color565to888(color, r, g, b);
+  updateMatrixDMABuffer(x, y, r, g, b);
+}
+
+void MatrixPanel_I2S_DMA::fillScreen(uint16_t color) {
+  uint8_t r, g, b;
+  color565to888(color, r, g, b);
+  updateMatrixDMABuffer(r, g, b);
+}
+
+void MatrixPanel_I2S_DMA::drawPixelRGB888(int16_t x, int16_t y, uint8_t r,
+                                          uint8_t g, uint8_t b) {
+  updateMatrixDMABuffer(x, y, r, g, b);
+}
+
+void MatrixPanel_I2S_DMA::updateMatrixDMABuffer(int16_t x_coord,
+                                                int16_t y_coord, uint8_t red,
+                                                uint8_t green, uint8_t blue) {
+  if (!initialized) return;
+  if (x_coord < 0 || y_coord < 0 || x_coord >= PIXELS_PER_ROW ||
+      y_coord >= m_cfg.mx_height) {
+    return;
+  }
+  pixel_writes.fetch_add(1, std::memory_order_relaxed);
+
+#if defined(ESP32_THE_ORIG)
+  // the original ESP32 sends 16 bit words out of the I2S FIFO pairwise
+  // swapped, so even and odd columns trade places in the buffer
+  x_coord = (x_coord & 1U) ? x_coord - 1 : x_coord + 1;
+#endif
+
+  uint16_t red16 = lumConvTab[red];
+  uint16_t green16 = lumConvTab[green];
+  uint16_t blue16 = lumConvTab[blue];
+
+  uint16_t _colourbitclear = BITMASK_RGB1_CLEAR, _colourbitoffset = 0;
+  if (y_coord >= ROWS_PER_FRAME) {
+    y_coord -= ROWS_PER_FRAME;
+    _colourbitoffset = BITS_RGB2_OFFSET;
+    _colourbitclear = BITMASK_RGB2_CLEAR;
+  }
+
+  uint8_t colour_depth_idx = PIXEL_COLOR_DEPTH_BITS;
+  do {
+    --colour_depth_idx;
+    uint16_t mask = PIXEL_COLOR_MASK_BIT(colour_depth_idx);
+    uint16_t RGB_output_bits = 0;
+    if (blue16 & mask) RGB_output_bits |= BIT_B1;
+    if (green16 & mask) RGB_output_bits |= BIT_G1;
+    if (red16 & mask) RGB_output_bits |= BIT_R1;
+    RGB_output_bits <<= _colourbitoffset;
+    ESP32_I2S_DMA_STORAGE_TYPE *p =
+        getRowDataPtr(y_coord, colour_depth_idx, back_buffer_id);
+    p[x_coord] &= _colourbitclear;
+    p[x_coord] |= RGB_output_bits;
+  } while (colour_depth_idx);
+}
+
+void MatrixPanel_I2S_DMA::updateMatrixDMABuffer(uint8_t red, uint8_t green,
+                                                uint8_t blue) {
+  if (!initialized) return;
+  full_fills.fetch_add(1, std::memory_order_relaxed);
+
+  uint16_t red16 = lumConvTab[red];
+  uint16_t green16 = lumConvTab[green];
+  uint16_t blue16 = lumConvTab[blue];
+
+  for (uint8_t colour_depth_idx = 0; colour_depth_idx < PIXEL_COLOR_DEPTH_BITS;
+       colour_depth_idx++) {
+    uint16_t mask = PIXEL_COLOR_MASK_BIT(colour_depth_idx);
+    uint16_t RGB_output_bits = 0;
+    if (blue16 & mask) RGB_output_bits |= BIT_B1;
+    if (green16 & mask) RGB_output_bits |= BIT_G1;
+    if (red16 & mask) RGB_output_bits |= BIT_R1;
+    RGB_output_bits |= RGB_output_bits << BITS_RGB2_OFFSET;
+    for (int row = 0; row < ROWS_PER_FRAME; row++) {
+      ESP32_I2S_DMA_STORAGE_TYPE *p =
+          getRowDataPtr(row, colour_depth_idx, back_buffer_id);
+      for (int x = 0; x < PIXELS_PER_ROW; x++) {
+        p[x] = (p[x] & BITMASK_RGB12_CLEAR) | RGB_output_bits;
+      }
+    }
+  }
+}
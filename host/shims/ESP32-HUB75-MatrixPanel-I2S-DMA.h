@@ -0,0 +1,168 @@
+// Host stand-in for ESP32 HUB75 LED MATRIX PANEL DMA Display 3.0.10.
+//
+// Instead of streaming over I2S, the panel keeps the same bit-plane DMA
+// buffer layout in memory: one 16-bit word per column for every (row pair,
+// colour depth bit), holding R1 G1 B1 R2 G2 B2 plus the latch, output enable
+// and row address bits. Pixel writes go through the same gamma lookup and bit
+// packing as updateMatrixDMABuffer() on the device, so the cost of drawing
+// to the panel can be measured on the host.
+
+#ifndef LMS_HOST_ESP32_HUB75_MATRIXPANEL_I2S_DMA_H
+#define LMS_HOST_ESP32_HUB75_MATRIXPANEL_I2S_DMA_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Adafruit_GFX.h"
+
+// the buffer layout of the original ESP32, which the sign runs on
+#define ESP32_THE_ORIG
+
+#define ESP32_I2S_DMA_STORAGE_TYPE uint16_t
+#define PIXEL_COLOR_DEPTH_BITS 8
+
+#define BIT_R1 (1 << 0)
+#define BIT_G1 (1 << 1)
+#define BIT_B1 (1 << 2)
+#define BIT_R2 (1 << 3)
+#define BIT_G2 (1 << 4)
+#define BIT_B2 (1 << 5)
+#define BIT_LAT (1 << 6)
+#define BIT_OE (1 << 7)
+#define BIT_A (1 << 8)
+#define BIT_B (1 << 9)
+#define BIT_C (1 << 10)
+#define BIT_D (1 << 11)
+#define BIT_E (1 << 12)
+
+#define BITS_RGB2_OFFSET 3
+#define BITMASK_RGB1_CLEAR (0b1111111111111000)
+#define BITMASK_RGB2_CLEAR (0b1111111111000111)
+#define BITMASK_RGB12_CLEAR (0b1111111111000000)
+
+// gamma values are 16 bit, the colour depth bits are the topmost ones
+#define PIXEL_COLOR_MASK_BIT(colour_depth_index) \
+  (1 << ((colour_depth_index) + 16 - PIXEL_COLOR_DEPTH_BITS))
+
+// CIE 1931 luminance correction, 8 bit input to 16 bit output
+extern const uint16_t lumConvTab[256];
+
+struct HUB75_I2S_CFG {
+  struct i2s_pins {
+    int8_t r1, g1, b1, r2, g2, b2, a, b, c, d, e, lat, oe, clk;
+  };
+
+  uint16_t mx_width;
+  uint16_t mx_height;
+  uint16_t chain_length;
+  i2s_pins gpio;
+  bool double_buff;
+  bool clkphase;
+  uint8_t latch_blanking;
+
+  HUB75_I2S_CFG(uint16_t w = 64, uint16_t h = 32, uint16_t chain = 1,
+                i2s_pins pinmap = {25, 26, 27, 14, 12, 13, 23, 19, 5, 17, -1,
+                                   4, 15, 16},
+                bool dbuff = false, bool clk_phase = true)
+      : mx_width(w),
+        mx_height(h),
+        chain_length(chain),
+        gpio(pinmap),
+        double_buff(dbuff),
+        clkphase(clk_phase),
+        latch_blanking(2) {}
+};
+
+// One row pair of the DMA buffer: colour_depth bit planes of width words.
+struct rowBitStruct {
+  const size_t width;
+  const uint8_t colour_depth;
+  const bool double_buff;
+  ESP32_I2S_DMA_STORAGE_TYPE *data;
+
+  rowBitStruct(size_t w, uint8_t depth, bool dbuff)
+      : width(w), colour_depth(depth), double_buff(dbuff) {
+    data = new ESP32_I2S_DMA_STORAGE_TYPE[width * colour_depth *
+                                          (double_buff ? 2 : 1)]();
+  }
+  ~rowBitStruct() { delete[] data; }
+  ESP32_I2S_DMA_STORAGE_TYPE *getDataPtr(const uint8_t _dpth = 0,
+                                         const bool buff_id = 0) {
+    return &(data[_dpth * width + buff_id * (width * colour_depth)]);
+  }
+};
+
+struct frameStruct {
+  uint8_t rows = 0;
+  std::vector<rowBitStruct *> rowBits;
+};
+
+class MatrixPanel_I2S_DMA : public Adafruit_GFX {
+ public:
+  MatrixPanel_I2S_DMA(const HUB75_I2S_CFG &opts);
+  ~MatrixPanel_I2S_DMA();
+
+  bool begin();
+  void setBrightness8(const uint8_t brightness);
+  void setPanelBrightness(const uint8_t brightness) {
+    setBrightness8(brightness);
+  }
+  void clearScreen() { updateMatrixDMABuffer(0, 0, 0); }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+  void drawPixelRGB888(int16_t x, int16_t y, uint8_t r, uint8_t g,
+                       uint8_t b);
+  void fillScreenRGB888(uint8_t r, uint8_t g, uint8_t b) {
+    updateMatrixDMABuffer(r, g, b);
+  }
+
+  static uint16_t color444(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF) << 12) | ((g & 0xF) << 7) | ((b & 0xF) << 1);
+  }
+  static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+  }
+  static void color565to888(const uint16_t color, uint8_t &r, uint8_t &g,
+                            uint8_t &b) {
+    r = (color >> 8) & 0xf8;
+    g = (color >> 3) & 0xfc;
+    b = (color << 3);
+    r |= r >> 5;
+    g |= g >> 6;
+    b |= b >> 5;
+  }
+
+ protected:
+  void updateMatrixDMABuffer(int16_t x, int16_t y, uint8_t red, uint8_t green,
+                             uint8_t blue);
+  void updateMatrixDMABuffer(uint8_t red, uint8_t green, uint8_t blue);
+  ESP32_I2S_DMA_STORAGE_TYPE *getRowDataPtr(int row, uint8_t colour_depth_idx,
+                                            uint8_t buff_id) {
+    return dma_buff.rowBits[row]->getDataPtr(colour_depth_idx, buff_id);
+  }
+
+  HUB75_I2S_CFG m_cfg;
+  frameStruct dma_buff;
+  const int16_t PIXELS_PER_ROW;
+  const uint8_t ROWS_PER_FRAME;
+  uint8_t back_buffer_id = 0;
+  uint8_t brightness = 128;
+  bool initialized = false;
+
+ private:
+  void setupControlBits();
+};
+
+namespace lms_host {
+
+struct PanelStats {
+  uint64_t pixel_writes;  // calls to updateMatrixDMABuffer(x, y, ...)
+  uint64_t full_fills;    // calls to updateMatrixDMABuffer(r, g, b)
+};
+PanelStats panel_stats();
+void reset_panel_stats();
+
+}  // namespace lms_host
+
+#endif /* LMS_HOST_ESP32_HUB75_MATRIXPANEL_I2S_DMA_H */
@@ -0,0 +1,63 @@
+#ifndef LMS_HOST_ESPASYNCWEBSERVER_H
+#define LMS_HOST_ESPASYNCWEBSERVER_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+class AsyncWebParameter {
+  String _value;
+
+ public:
+  explicit AsyncWebParameter(const String &value) : _value(value) {}
+  const String &value() const { return _value; }
+};
+
+// Requests are never received on the host; handlers are only registered.
+class AsyncWebServerRequest {
+  std::map<std::string, AsyncWebParameter> params;
+
+ public:
+  bool hasParam(const String &name) const {
+    return params.count(name.c_str()) > 0;
+  }
+  AsyncWebParameter *getParam(const String &name) {
+    auto it = params.find(name.c_str());
+    return it == params.end() ? nullptr : &it->second;
+  }
+  void send(int code, const String &content_type = String(),
+            const String &content = String()) {}
+  void send_P(int code, const String &content_type, const char *content) {}
+  void redirect(const String &url) {}
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)>
+    ArRequestHandlerFunction;
+
+class AsyncWebServer {
+  struct Handler {
+    String uri;
+    WebRequestMethod method;
+    ArRequestHandlerFunction handler;
+  };
+  std::vector<Handler> handlers;
+
+ public:
+  explicit AsyncWebServer(uint16_t port) {}
+  void on(const char *uri, WebRequestMethod method,
+          ArRequestHandlerFunction handler) {
+    handlers.push_back({uri, method, handler});
+  }
+  void begin() {}
+};
+
+#endif /* LMS_HOST_ESPASYNCWEBSERVER_H */
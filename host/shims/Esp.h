@@ -0,0 +1,16 @@
+#ifndef LMS_HOST_ESP_H
+#define LMS_HOST_ESP_H
+
+#include <stdint.h>
+
+class EspClass {
+ public:
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  // The host has nothing to reboot into, so the process exits instead.
+  void restart();
+};
+
+extern EspClass ESP;
+
+#endif /* LMS_HOST_ESP_H */
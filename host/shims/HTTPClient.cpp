@@ -0,0 +1,235 @@
+#include "HTTPClient.h"
+
+#include <stdlib.h>
+#include <strings.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "WiFi.h"
+#include "host.h"
+
+WiFiClass WiFi;
+
+namespace {
+
+std::mutex routes_mutex;
+std::map<std::string, lms_host::HttpHandler> routes;
+uint32_t latency_ms = 0;
+bool gzip_enabled = true;
+lms_host::HttpStats stats = {};
+std::atomic<uint32_t> connection_generation(0);
+
+}  // namespace
+
+namespace lms_host {
+
+void http_route(const std::string &url_prefix, HttpHandler handler) {
+  std::lock_guard<std::mutex> lock(routes_mutex);
+  routes[url_prefix] = handler;
+}
+
+void http_clear_routes() {
+  std::lock_guard<std::mutex> lock(routes_mutex);
+  routes.clear();
+}
+
+void http_set_latency_ms(uint32_t latency) { latency_ms = latency; }
+
+void http_set_gzip(bool enabled) { gzip_enabled = enabled; }
+
+void http_drop_connections() { connection_generation++; }
+
+uint32_t http_connection_generation() { return connection_generation; }
+
+std::string HttpRequest::header(const std::string &name) const {
+  for (const auto &header : this->headers) {
+    if (strcasecmp(header.first.c_str(), name.c_str()) == 0) {
+      return header.second;
+    }
+  }
+  return "";
+}
+
+bool http_serve(const HttpRequest &request, HttpResponse *response) {
+  HttpHandler handler;
+  uint32_t latency;
+  {
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    stats.requests++;
+    size_t best = 0;
+    for (auto const &route : routes) {
+      if (request.url.compare(0, route.first.size(), route.first) == 0 &&
+          route.first.size() >= best) {
+        best = route.first.size();
+        handler = route.second;
+      }
+    }
+    if (!handler) {
+      stats.unrouted++;
+    }
+    latency = latency_ms;
+  }
+  if (latency > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+  }
+  if (!handler) {
+    return false;
+  }
+  *response = handler(request);
+  bool gzipped = false;
+  if (gzip_enabled && response->chunks.empty() &&
+      response->content_type.find("json") != std::string::npos &&
+      request.header("Accept-Encoding").find("gzip") != std::string::npos) {
+    std::string body = gzip(response->body);
+    if (!body.empty()) {
+      response->body = body;
+      response->content_encoding = "gzip";
+      gzipped = true;
+    }
+  }
+  std::lock_guard<std::mutex> lock(routes_mutex);
+  stats.body_bytes += response->body.size();
+  stats.gzipped += gzipped;
+  return true;
+}
+
+HttpStats http_stats() {
+  std::lock_guard<std::mutex> lock(routes_mutex);
+  return stats;
+}
+
+}  // namespace lms_host
+
+// As on the esp32, the connection is closed with the client, even if it is
+// shared with another one
+HTTPClient::~HTTPClient() {
+  if (this->client) {
+    this->client->stop();
+  }
+}
+
+bool HTTPClient::begin(WiFiClient &client, String url) {
+  this->client = &client;
+  this->url = url.c_str();
+  this->headers.clear();
+  this->response_headers.clear();
+  this->size = -1;
+  size_t scheme = this->url.find("://");
+  if (scheme == std::string::npos || this->url.compare(0, 4, "http") != 0) {
+    return false;
+  }
+  size_t start = scheme + 3;
+  size_t end = this->url.find('/', start);
+  this->host = this->url.substr(start, end - start);
+  this->port = this->url.compare(0, scheme, "https") == 0 ? 443 : 80;
+  size_t colon = this->host.find(':');
+  if (colon != std::string::npos) {
+    this->port = atoi(this->host.c_str() + colon + 1);
+    this->host.resize(colon);
+  }
+  return true;
+}
+
+void HTTPClient::end() {
+  if (this->client && !this->reuse) {
+    this->client->stop();
+    this->client = nullptr;
+  }
+}
+
+void HTTPClient::addHeader(const String &name, const String &value,
+                           bool first, bool replace) {
+  this->headers.push_back({name.c_str(), value.c_str()});
+}
+
+void HTTPClient::collectHeaders(const char *keys[], const size_t count) {
+  this->collected.assign(keys, keys + count);
+}
+
+String HTTPClient::header(const char *name) {
+  for (const auto &header : this->response_headers) {
+    if (strcasecmp(header.first.c_str(), name) == 0) {
+      return String(header.second.c_str());
+    }
+  }
+  return String();
+}
+
+int HTTPClient::GET() { return this->sendRequest("GET"); }
+
+int HTTPClient::POST(const String &payload) {
+  return this->sendRequest("POST");
+}
+
+int HTTPClient::POST(const uint8_t *payload, size_t size) {
+  return this->sendRequest("POST");
+}
+
+bool HTTPClient::connected() { return this->client && this->client->connected(); }
+
+String HTTPClient::getString() {
+  std::string body;
+  int c;
+  while ((c = this->client->read()) >= 0) {
+    body.push_back((char)c);
+  }
+  return String(body);
+}
+
+int HTTPClient::sendRequest(const char *method) {
+  if (!this->client) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  // an open connection is reused, whichever host it went to, as on the esp32
+  if (!this->client->connected() &&
+      !this->client->connect(this->host.c_str(), this->port, 5000)) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  lms_host::HttpResponse response;
+  if (!lms_host::http_serve(lms_host::HttpRequest{this->url, this->headers},
+                            &response)) {
+    this->client->stop();
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  // as on the esp32, only the headers asked for are kept
+  this->response_headers.clear();
+  for (const std::string &key : this->collected) {
+    const char *value = nullptr;
+    if (strcasecmp(key.c_str(), "Content-Type") == 0) {
+      value = response.content_type.c_str();
+    } else if (strcasecmp(key.c_str(), "Content-Encoding") == 0) {
+      value = response.content_encoding.c_str();
+    }
+    if (value && value[0]) {
+      this->response_headers.push_back({key, value});
+    }
+  }
+  this->client->host_receive(response.body);
+  for (const lms_host::HttpChunk &chunk : response.chunks) {
+    this->client->host_receive_later(chunk);
+  }
+  this->size = response.chunks.empty() ? (int)response.body.size() : -1;
+  return response.code;
+}
+
+void WiFiClient::host_deliver() {
+  if (this->later.empty()) {
+    return;
+  }
+  time_t now = time(nullptr);
+  size_t bytes = 0;
+  while (!this->later.empty() && this->later.front().at <= now) {
+    // what was read is dropped, so a long-lived connection does not grow
+    this->rx.erase(0, this->rx_pos);
+    this->rx_pos = 0;
+    this->rx += this->later.front().data;
+    bytes += this->later.front().data.size();
+    this->later.pop_front();
+  }
+  std::lock_guard<std::mutex> lock(routes_mutex);
+  stats.body_bytes += bytes;
+}
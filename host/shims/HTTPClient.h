@@ -0,0 +1,63 @@
+#ifndef LMS_HOST_HTTPCLIENT_H
+#define LMS_HOST_HTTPCLIENT_H
+
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+typedef enum {
+  HTTP_CODE_OK = 200,
+  HTTP_CODE_NO_CONTENT = 204,
+  HTTP_CODE_MOVED_PERMANENTLY = 301,
+  HTTP_CODE_BAD_REQUEST = 400,
+  HTTP_CODE_UNAUTHORIZED = 401,
+  HTTP_CODE_NOT_FOUND = 404,
+  HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+} t_http_codes;
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Serves requests from the routes registered with lms_host::http_route().
+class HTTPClient {
+ public:
+  ~HTTPClient();
+  bool begin(WiFiClient &client, String url);
+  void end();
+  void setReuse(bool reuse) { this->reuse = reuse; }
+  void useHTTP10(bool use) { this->reuse = !use; }
+  void addHeader(const String &name, const String &value, bool first = false,
+                 bool replace = true);
+  void collectHeaders(const char *keys[], const size_t count);
+  // A response header named to collectHeaders(), or an empty string
+  String header(const char *name);
+  int GET();
+  int POST(const String &payload);
+  int POST(const uint8_t *payload, size_t size);
+  bool connected();
+  int getSize() { return size; }
+  WiFiClient &getStream() { return *client; }
+  WiFiClient *getStreamPtr() { return client; }
+  String getString();
+
+ private:
+  int sendRequest(const char *method);
+
+  WiFiClient *client = nullptr;
+  std::string url;
+  std::string host;
+  uint16_t port = 80;
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::vector<std::string> collected;
+  std::vector<std::pair<std::string, std::string>> response_headers;
+  bool reuse = true;
+  int size = -1;
+};
+
+#endif /* LMS_HOST_HTTPCLIENT_H */
@@ -0,0 +1,21 @@
+#ifndef LMS_HOST_PREFERENCES_H
+#define LMS_HOST_PREFERENCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Backed by a process wide in-memory store shared by every namespace.
+class Preferences {
+ public:
+  bool begin(const char *name, bool read_only = false) { return true; }
+  void end() {}
+  int32_t getInt(const char *key, int32_t default_value = 0);
+  size_t putInt(const char *key, int32_t value);
+  bool isKey(const char *key);
+  bool remove(const char *key);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t max_len);
+  size_t putBytes(const char *key, const void *value, size_t len);
+};
+
+#endif /* LMS_HOST_PREFERENCES_H */
@@ -0,0 +1,38 @@
+#ifndef LMS_HOST_WIFI_H
+#define LMS_HOST_WIFI_H
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+// The host associates lms_host::set_network_delays() after begin(), at once
+// by default, and stays associated.
+class WiFiClass {
+ public:
+  bool mode(wifi_mode_t mode) { return true; }
+  wl_status_t begin(const char *ssid, const char *password = nullptr);
+  wl_status_t status();
+  bool disconnect(bool wifioff = false) { return true; }
+  bool reconnect() { return true; }
+  String localIP() { return String("127.0.0.1"); }
+  int8_t RSSI() { return -50; }
+};
+
+extern WiFiClass WiFi;
+
+#endif /* LMS_HOST_WIFI_H */
@@ -0,0 +1,84 @@
+#ifndef LMS_HOST_WIFICLIENT_H
+#define LMS_HOST_WIFICLIENT_H
+
+#include <deque>
+#include <string>
+
+#include "Arduino.h"
+#include "host.h"
+
+// A connection whose receive side is an in-memory buffer filled by the
+// HTTPClient stand-in. Anything written to it is discarded. It goes down with
+// lms_host::http_drop_connections().
+class WiFiClient : public Stream {
+ public:
+  virtual ~WiFiClient() {}
+
+  virtual int connect(const char *host, uint16_t port) {
+    return this->connect(host, port, 0);
+  }
+  virtual int connect(const char *host, uint16_t port, int32_t timeout) {
+    this->is_connected = true;
+    this->connection = lms_host::http_connection_generation();
+    return 1;
+  }
+
+  int available() override {
+    host_deliver();
+    return rx.size() - rx_pos;
+  }
+  int read() override {
+    host_deliver();
+    return rx_pos < rx.size() ? (uint8_t)rx[rx_pos++] : -1;
+  }
+  int peek() override {
+    host_deliver();
+    return rx_pos < rx.size() ? (uint8_t)rx[rx_pos] : -1;
+  }
+  size_t readBytes(uint8_t *buffer, size_t length) override {
+    host_deliver();
+    size_t n = std::min(length, rx.size() - rx_pos);
+    memcpy(buffer, rx.data() + rx_pos, n);
+    rx_pos += n;
+    return n;
+  }
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 1; }
+  size_t write(const uint8_t *buffer, size_t size) override { return size; }
+
+  virtual uint8_t connected() {
+    return is_connected &&
+           connection == lms_host::http_connection_generation();
+  }
+  virtual void stop() {
+    is_connected = false;
+    rx.clear();
+    rx_pos = 0;
+    later.clear();
+  }
+
+  // host only: replaces the unread receive buffer
+  void host_receive(const std::string &data) {
+    rx = data;
+    rx_pos = 0;
+    is_connected = true;
+    later.clear();
+  }
+
+  // host only: data that arrives once the wall clock reaches chunk.at
+  void host_receive_later(const lms_host::HttpChunk &chunk) {
+    later.push_back(chunk);
+  }
+
+ protected:
+  std::string rx;
+  size_t rx_pos = 0;
+  bool is_connected = false;
+  uint32_t connection = 0;  // the generation it was opened in
+  std::deque<lms_host::HttpChunk> later;
+
+  // moves the chunks that are due into the receive buffer
+  void host_deliver();
+};
+
+#endif /* LMS_HOST_WIFICLIENT_H */
@@ -0,0 +1,63 @@
+#include "WiFiClientSecure.h"
+
+#include <stdio.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "host.h"
+
+namespace {
+
+std::mutex tls_mutex;
+// session id -> host
+std::map<std::string, std::string> sessions;
+uint32_t next_session = 1;
+lms_host::TlsServerStats stats = {};
+
+}  // namespace
+
+namespace lms_host {
+
+TlsServerStats tls_stats() {
+  std::lock_guard<std::mutex> lock(tls_mutex);
+  return stats;
+}
+
+void tls_forget_sessions() {
+  std::lock_guard<std::mutex> lock(tls_mutex);
+  sessions.clear();
+}
+
+int tls_handshake(const char *host, mbedtls_ssl_session *session,
+                  bool offer) {
+  std::lock_guard<std::mutex> lock(tls_mutex);
+  if (offer) {
+    std::string id((const char *)session->id, session->id_len);
+    auto found = sessions.find(id);
+    if (found != sessions.end() && found->second == host) {
+      stats.resumed_handshakes++;
+      return 1;
+    }
+  }
+  stats.full_handshakes++;
+  char id[32];
+  int length = snprintf(id, sizeof(id), "session-%u", next_session++);
+  sessions[std::string(id, length)] = host;
+  if (session) {
+    memcpy(session->id, id, length);
+    session->id_len = length;
+  }
+  return 0;
+}
+
+}  // namespace lms_host
+
+int WiFiClientSecure::host_handshake(const char *host, uint16_t port,
+                                     int32_t timeout,
+                                     mbedtls_ssl_session *session,
+                                     bool offer) {
+  WiFiClient::connect(host, port, timeout);
+  return lms_host::tls_handshake(host, session, offer);
+}
@@ -0,0 +1,29 @@
+#ifndef LMS_HOST_WIFICLIENTSECURE_H
+#define LMS_HOST_WIFICLIENTSECURE_H
+
+#include <mbedtls/ssl.h>
+
+#include "WiFiClient.h"
+
+// TLS is not emulated, certificates are accepted and ignored. Connecting
+// does a handshake with the TLS stand-in (see lms_host::tls_stats), a full
+// one, since the esp32 client does not resume sessions.
+class WiFiClientSecure : public WiFiClient {
+ public:
+  void setCACert(const char *root_ca) {}
+  void setInsecure() {}
+
+  using WiFiClient::connect;
+  int connect(const char *host, uint16_t port, int32_t timeout) override {
+    return this->host_handshake(host, port, timeout, nullptr, false) >= 0;
+  }
+
+  // host only: connects and does a handshake with the TLS stand-in, offering
+  // session if offer is set. session, if not NULL, is set to the session
+  // issued or resumed. Returns 1 if the session was resumed, 0 after a full
+  // handshake.
+  int host_handshake(const char *host, uint16_t port, int32_t timeout,
+                     mbedtls_ssl_session *session, bool offer);
+};
+
+#endif /* LMS_HOST_WIFICLIENTSECURE_H */
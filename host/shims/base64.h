@@ -0,0 +1,14 @@
+#ifndef LMS_HOST_BASE64_H
+#define LMS_HOST_BASE64_H
+
+#include "Arduino.h"
+
+class base64 {
+ public:
+  static String encode(const uint8_t *data, size_t length);
+  static String encode(const String &text) {
+    return encode((const uint8_t *)text.c_str(), text.length());
+  }
+};
+
+#endif /* LMS_HOST_BASE64_H */
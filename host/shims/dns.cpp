@@ -0,0 +1,58 @@
+// The lwip resolver stand-in, see lwip/dns.h.
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "host.h"
+#include "lwip/dns.h"
+
+namespace {
+
+std::atomic<uint32_t> latency_ms(0);
+std::atomic<uint32_t> lookups(0);
+
+bool resolves(const std::string &name) {
+  const std::string invalid = ".invalid";
+  return name.size() < invalid.size() ||
+         name.compare(name.size() - invalid.size(), invalid.size(),
+                      invalid) != 0;
+}
+
+}  // namespace
+
+namespace lms_host {
+
+void dns_set_latency_ms(uint32_t ms) { latency_ms = ms; }
+
+DnsStats dns_stats() { return {lookups}; }
+
+}  // namespace lms_host
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr,
+                        dns_found_callback found, void *callback_arg) {
+  if (!hostname || !hostname[0]) {
+    return ERR_ARG;
+  }
+  lookups++;
+  std::string name(hostname);
+  uint32_t ms = latency_ms;
+  if (ms == 0) {
+    if (!resolves(name)) {
+      return ERR_ARG;
+    }
+    addr->addr = htonl(INADDR_LOOPBACK);
+    return ERR_OK;
+  }
+  // answered later, as lwip does from its own thread
+  std::thread([name, ms, found, callback_arg] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    ip_addr_t resolved = {htonl(INADDR_LOOPBACK)};
+    found(name.c_str(), resolves(name) ? &resolved : nullptr, callback_arg);
+  }).detach();
+  return ERR_INPROGRESS;
+}
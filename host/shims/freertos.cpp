@@ -0,0 +1,551 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "host.h"
+
+namespace {
+
+// Thrown inside a task thread to unwind it after vTaskDelete().
+struct TaskDeleted {};
+
+std::chrono::steady_clock::time_point deadline_for(TickType_t ticks) {
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+}
+
+}  // namespace
+
+struct tskTaskControlBlock {
+  TaskFunction_t function;
+  void *params;
+  const char *name;
+  bool deleted;
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t notification_value = 0;
+  bool notification_pending = false;
+  lms_host::TaskStats stats = {};
+};
+
+namespace {
+
+thread_local tskTaskControlBlock *current_task = nullptr;
+
+void check_deleted() {
+  if (current_task && current_task->deleted) {
+    throw TaskDeleted();
+  }
+}
+
+// Counts the calling task waking from a call that blocked it
+void count_wakeup() {
+  if (current_task) {
+    std::lock_guard<std::mutex> lock(current_task->mutex);
+    current_task->stats.wakeups++;
+  }
+}
+
+}  // namespace
+
+/* Queues */
+
+struct QueueDefinition {
+  std::mutex mutex;
+  std::condition_variable changed;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  std::vector<uint8_t> items;
+  std::vector<uint64_t> sent_at_us;
+  UBaseType_t head = 0;
+  UBaseType_t count = 0;
+  lms_host::QueueStats stats = {};
+};
+
+namespace {
+
+std::mutex registry_mutex;
+std::vector<QueueDefinition *> queue_registry;
+
+bool wait_for(QueueDefinition *q, std::unique_lock<std::mutex> &lock,
+              TickType_t ticks, bool (*ready)(QueueDefinition *)) {
+  if (ready(q)) {
+    return true;
+  }
+  if (ticks == 0) {
+    return false;
+  }
+  if (ticks == portMAX_DELAY) {
+    while (!ready(q)) {
+      q->changed.wait_for(lock, std::chrono::milliseconds(10));
+      check_deleted();
+    }
+    count_wakeup();
+    return true;
+  }
+  auto deadline = deadline_for(ticks);
+  while (!ready(q)) {
+    if (q->changed.wait_until(lock, deadline) == std::cv_status::timeout) {
+      count_wakeup();
+      return ready(q);
+    }
+  }
+  count_wakeup();
+  return true;
+}
+
+bool has_space(QueueDefinition *q) { return q->count < q->length; }
+bool has_items(QueueDefinition *q) { return q->count > 0; }
+
+BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks,
+                      bool to_front) {
+  check_deleted();
+  std::unique_lock<std::mutex> lock(q->mutex);
+  if (!wait_for(q, lock, ticks, has_space)) {
+    q->stats.send_failures++;
+    return pdFALSE;
+  }
+  UBaseType_t slot;
+  if (to_front) {
+    q->head = (q->head + q->length - 1) % q->length;
+    slot = q->head;
+  } else {
+    slot = (q->head + q->count) % q->length;
+  }
+  memcpy(&q->items[slot * q->item_size], item, q->item_size);
+  q->sent_at_us[slot] = lms_host::now_us();
+  q->count++;
+  q->stats.sent++;
+  q->stats.high_water_mark = std::max(q->stats.high_water_mark, q->count);
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+}  // namespace
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  QueueDefinition *q = new QueueDefinition;
+  q->length = length;
+  q->item_size = item_size;
+  q->items.resize(length * item_size);
+  q->sent_at_us.resize(length);
+  q->stats.name = "";
+  q->stats.item_size = item_size;
+  q->stats.length = length;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  queue_registry.push_back(q);
+  return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    queue_registry.erase(
+        std::remove(queue_registry.begin(), queue_registry.end(), queue),
+        queue_registry.end());
+  }
+  delete queue;
+}
+
+void vQueueAddToRegistry(QueueHandle_t queue, const char *name) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->stats.name = name;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item,
+                            TickType_t ticks_to_wait) {
+  return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item,
+                             TickType_t ticks_to_wait) {
+  return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->head = 0;
+  queue->count = 1;
+  memcpy(&queue->items[0], item, queue->item_size);
+  queue->sent_at_us[0] = lms_host::now_us();
+  queue->stats.sent++;
+  queue->stats.high_water_mark = std::max(queue->stats.high_water_mark, 1u);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer,
+                         TickType_t ticks_to_wait) {
+  check_deleted();
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_for(queue, lock, ticks_to_wait, has_items)) {
+    return pdFALSE;
+  }
+  UBaseType_t slot = queue->head;
+  memcpy(buffer, &queue->items[slot * queue->item_size], queue->item_size);
+  uint32_t latency_us = lms_host::now_us() - queue->sent_at_us[slot];
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  queue->stats.received++;
+  queue->stats.total_latency_us += latency_us;
+  queue->stats.max_latency_us =
+      std::max(queue->stats.max_latency_us, latency_us);
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer,
+                      TickType_t ticks_to_wait) {
+  check_deleted();
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!wait_for(queue, lock, ticks_to_wait, has_items)) {
+    return pdFALSE;
+  }
+  memcpy(buffer, &queue->items[queue->head * queue->item_size],
+         queue->item_size);
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->length - queue->count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->head = 0;
+  queue->count = 0;
+  queue->changed.notify_all();
+  return pdPASS;
+}
+
+namespace lms_host {
+
+std::vector<QueueStats> queue_stats() {
+  std::vector<QueueStats> stats;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (QueueDefinition *q : queue_registry) {
+    std::lock_guard<std::mutex> queue_lock(q->mutex);
+    stats.push_back(q->stats);
+  }
+  return stats;
+}
+
+}  // namespace lms_host
+
+/* Tasks */
+
+namespace {
+
+std::mutex task_registry_mutex;
+std::vector<tskTaskControlBlock *> task_registry;
+
+void run_task(tskTaskControlBlock *task) {
+  current_task = task;
+  try {
+    task->function(task->params);
+  } catch (const TaskDeleted &) {
+  }
+  // FreeRTOS tasks must never return, but if one does it simply ends here.
+}
+
+}  // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name,
+                                   uint32_t stack_depth, void *params,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id) {
+  tskTaskControlBlock *task = new tskTaskControlBlock;
+  task->function = function;
+  task->params = params;
+  task->name = name;
+  task->deleted = false;
+  task->stats.name = name;
+  {
+    // tasks are never freed, so that a handle outlives its task
+    std::lock_guard<std::mutex> lock(task_registry_mutex);
+    task_registry.push_back(task);
+  }
+  if (handle) {
+    *handle = task;
+  }
+  std::thread(run_task, task).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name,
+                       uint32_t stack_depth, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(function, name, stack_depth, params, priority,
+                                 handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr) {
+    task = current_task;
+  }
+  if (task == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->deleted = true;
+    task->stats.deleted = true;
+  }
+  if (task == current_task) {
+    throw TaskDeleted();
+  }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return current_task; }
+
+void vTaskDelay(TickType_t ticks) {
+  check_deleted();
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+  count_wakeup();
+  check_deleted();
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment) {
+  check_deleted();
+  TickType_t wake_time = *previous_wake_time + increment;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(wake_time - now) > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(wake_time - now));
+    count_wakeup();
+  }
+  *previous_wake_time = wake_time;
+  check_deleted();
+}
+
+TickType_t xTaskGetTickCount() { return lms_host::now_ms(); }
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value,
+                       eNotifyAction action) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  bool was_pending = task->notification_pending;
+  switch (action) {
+    case eNoAction:
+      break;
+    case eSetBits:
+      task->notification_value |= value;
+      break;
+    case eIncrement:
+      task->notification_value++;
+      break;
+    case eSetValueWithOverwrite:
+      task->notification_value = value;
+      break;
+    case eSetValueWithoutOverwrite:
+      if (was_pending) {
+        return pdFAIL;
+      }
+      task->notification_value = value;
+      break;
+  }
+  task->notification_pending = true;
+  task->stats.notifications++;
+  task->notified.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry,
+                           uint32_t bits_to_clear_on_exit, uint32_t *value,
+                           TickType_t ticks_to_wait) {
+  check_deleted();
+  tskTaskControlBlock *task = current_task;
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (!task->notification_pending) {
+    task->notification_value &= ~bits_to_clear_on_entry;
+    if (ticks_to_wait == portMAX_DELAY) {
+      while (!task->notification_pending) {
+        task->notified.wait_for(lock, std::chrono::milliseconds(10));
+        if (task->deleted) {
+          throw TaskDeleted();
+        }
+      }
+    } else if (ticks_to_wait > 0) {
+      task->notified.wait_until(lock, deadline_for(ticks_to_wait),
+                                [task] { return task->notification_pending; });
+    }
+    if (ticks_to_wait > 0) {
+      task->stats.wakeups++;
+    }
+  }
+  if (value) {
+    *value = task->notification_value;
+  }
+  if (!task->notification_pending) {
+    return pdFALSE;
+  }
+  task->notification_pending = false;
+  task->notification_value &= ~bits_to_clear_on_exit;
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+  uint32_t value = 0;
+  xTaskNotifyWait(0, 0, &value, ticks_to_wait);
+  std::lock_guard<std::mutex> lock(current_task->mutex);
+  if (value > 0) {
+    current_task->notification_value = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+namespace lms_host {
+
+std::vector<TaskStats> task_stats() {
+  std::vector<TaskStats> stats;
+  std::lock_guard<std::mutex> lock(task_registry_mutex);
+  for (tskTaskControlBlock *task : task_registry) {
+    std::lock_guard<std::mutex> task_lock(task->mutex);
+    stats.push_back(task->stats);
+  }
+  return stats;
+}
+
+}  // namespace lms_host
+
+/* Timers */
+
+struct tmrTimerControl {
+  const char *name;
+  TickType_t period;
+  bool auto_reload;
+  void *id;
+  TimerCallbackFunction_t callback;
+  bool active;
+  bool deleted;
+  TickType_t expiry;
+};
+
+namespace {
+
+std::mutex timer_mutex;
+std::condition_variable timer_changed;
+std::list<tmrTimerControl *> timers;
+bool timer_service_started = false;
+
+void timer_service() {
+  std::unique_lock<std::mutex> lock(timer_mutex);
+  while (true) {
+    tmrTimerControl *next = nullptr;
+    for (tmrTimerControl *t : timers) {
+      if (t->active && (!next || (int32_t)(t->expiry - next->expiry) < 0)) {
+        next = t;
+      }
+    }
+    if (!next) {
+      timer_changed.wait(lock);
+      continue;
+    }
+    int32_t wait_ms = (int32_t)(next->expiry - xTaskGetTickCount());
+    if (wait_ms > 0) {
+      timer_changed.wait_for(lock, std::chrono::milliseconds(wait_ms));
+      continue;
+    }
+    if (next->auto_reload) {
+      next->expiry += next->period;
+      // don't try to catch up on expiries missed while a callback was busy
+      if ((int32_t)(next->expiry - xTaskGetTickCount()) < 0) {
+        next->expiry = xTaskGetTickCount() + next->period;
+      }
+    } else {
+      next->active = false;
+    }
+    lock.unlock();
+    next->callback(next);
+    lock.lock();
+  }
+}
+
+BaseType_t arm(TimerHandle_t timer, TickType_t period) {
+  if (!timer) {
+    return pdFAIL;
+  }
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  if (!timer_service_started) {
+    timer_service_started = true;
+    std::thread(timer_service).detach();
+  }
+  timer->period = period;
+  timer->expiry = xTaskGetTickCount() + period;
+  timer->active = true;
+  timer_changed.notify_all();
+  return pdPASS;
+}
+
+}  // namespace
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                           UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback) {
+  tmrTimerControl *timer = new tmrTimerControl{
+      name, period, auto_reload != 0, timer_id, callback, false, false, 0};
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  timers.push_back(timer);
+  return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  return arm(timer, timer ? timer->period : 0);
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  return arm(timer, timer ? timer->period : 0);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period,
+                              TickType_t ticks_to_wait) {
+  return arm(timer, new_period);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  if (!timer) {
+    return pdFAIL;
+  }
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  timer->active = false;
+  timer_changed.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  if (!timer) {
+    return pdFAIL;
+  }
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  // the timer is leaked rather than freed, a callback may still be running
+  timer->active = false;
+  timer->deleted = true;
+  timers.remove(timer);
+  timer_changed.notify_all();
+  return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  return timer->active ? pdTRUE : pdFALSE;
+}
+
+TickType_t xTimerGetPeriod(TimerHandle_t timer) {
+  std::lock_guard<std::mutex> lock(timer_mutex);
+  return timer->period;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) { return timer->id; }
@@ -0,0 +1,23 @@
+// Host stand-in for the ESP-IDF FreeRTOS port, backed by std::thread.
+
+#ifndef LMS_HOST_FREERTOS_H
+#define LMS_HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+// The host build runs with a 1ms tick, so ticks and milliseconds coincide.
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1)
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#endif /* LMS_HOST_FREERTOS_H */
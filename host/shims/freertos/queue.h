@@ -0,0 +1,28 @@
+#ifndef LMS_HOST_FREERTOS_QUEUE_H
+#define LMS_HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+struct QueueDefinition;
+typedef struct QueueDefinition *QueueHandle_t;
+typedef struct QueueDefinition *QueueSetHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+void vQueueAddToRegistry(QueueHandle_t queue, const char *name);
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item,
+                            TickType_t ticks_to_wait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item,
+                             TickType_t ticks_to_wait);
+#define xQueueSend xQueueSendToBack
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer,
+                         TickType_t ticks_to_wait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer,
+                      TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#endif /* LMS_HOST_FREERTOS_QUEUE_H */
@@ -0,0 +1,46 @@
+#ifndef LMS_HOST_FREERTOS_TASK_H
+#define LMS_HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+struct tskTaskControlBlock;
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY 0x7fffffff
+
+typedef enum {
+  eNoAction,
+  eSetBits,
+  eIncrement,
+  eSetValueWithOverwrite,
+  eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+// Tasks run on their own std::thread. Priorities and core affinity are
+// recorded but not enforced. Stack depth is in bytes, as in ESP-IDF.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name,
+                                   uint32_t stack_depth, void *params,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name,
+                       uint32_t stack_depth, void *params,
+                       UBaseType_t priority, TaskHandle_t *handle);
+// A task deleted from another task stops at its next blocking call.
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t increment);
+TickType_t xTaskGetTickCount();
+
+// Each task has one notification value, as in FreeRTOS.
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value,
+                       eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t bits_to_clear_on_entry,
+                           uint32_t bits_to_clear_on_exit, uint32_t *value,
+                           TickType_t ticks_to_wait);
+#define xTaskNotifyGive(task) xTaskNotify((task), 0, eIncrement)
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+
+#endif /* LMS_HOST_FREERTOS_TASK_H */
@@ -0,0 +1,25 @@
+#ifndef LMS_HOST_FREERTOS_TIMERS_H
+#define LMS_HOST_FREERTOS_TIMERS_H
+
+#include "FreeRTOS.h"
+
+struct tmrTimerControl;
+typedef struct tmrTimerControl *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+// Callbacks run one at a time on a single timer service thread, like the
+// FreeRTOS timer daemon task.
+TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                           UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period,
+                              TickType_t ticks_to_wait);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks_to_wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+TickType_t xTimerGetPeriod(TimerHandle_t timer);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif /* LMS_HOST_FREERTOS_TIMERS_H */
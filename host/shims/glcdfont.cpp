@@ -0,0 +1,30 @@
+// Stand-in for the classic Adafruit GFX 5x7 font.
+//
+// Each glyph keeps the upstream 5 columns x 8 rows cell (6px advance with
+// spacing), so text metrics and the amount of work per character match the
+// device. The glyph shapes themselves are generated rather than copied: they
+// are stable pseudo-random patterns, not readable letters.
+
+#include <stdint.h>
+
+namespace {
+
+struct ClassicFont {
+  unsigned char bitmap[256 * 5];
+  ClassicFont() {
+    for (int c = 0; c < 256; c++) {
+      uint32_t h = 2166136261u ^ (uint32_t)c;
+      for (int i = 0; i < 5; i++) {
+        h = (h ^ (h >> 13)) * 16777619u + 0x9e3779b9u;
+        // rows 0-6 only, the bottom row is the gap to the next line
+        bitmap[c * 5 + i] = (c <= ' ') ? 0 : (uint8_t)(h & 0x7f);
+      }
+    }
+  }
+};
+
+const ClassicFont classic_font;
+
+}  // namespace
+
+extern const unsigned char *const font = classic_font.bitmap;
@@ -0,0 +1,166 @@
+// Control surface of the host build.
+//
+// This header has no equivalent on the device. It lets the simulator and the
+// benchmarks drive the shims: canned HTTP responses, the serial console,
+// persisted preferences, the sign button, and the counters collected by the
+// FreeRTOS and HTTP stand-ins.
+
+#ifndef LMS_HOST_H
+#define LMS_HOST_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct mbedtls_ssl_session;
+
+namespace lms_host {
+
+// Milliseconds since the process started. This is also the FreeRTOS tick
+// count, since the host build runs with a 1ms tick.
+uint32_t now_ms();
+uint64_t now_us();
+
+// The firmware logs a lot over serial. Output is discarded unless enabled, so
+// that benchmark numbers do not include terminal I/O.
+void set_serial_enabled(bool enabled);
+
+// Stops the wall clock that time() reports at now, so a benchmark can step
+// through minutes without waiting. 0 lets it run again. Tick counts and
+// timers are not affected.
+void set_wall_clock(time_t now);
+
+// Canned HTTP responses. A request is served by the route with the longest
+// url prefix that matches. The body callback runs on every request, so it can
+// return time-dependent content.
+struct HttpRequest {
+  std::string url;
+  std::vector<std::pair<std::string, std::string>> headers;
+  // The value of a header, or an empty string. Names are not case sensitive.
+  std::string header(const std::string &name) const;
+};
+// Part of a response that arrives once the wall clock reaches at.
+struct HttpChunk {
+  time_t at;
+  std::string data;
+};
+struct HttpResponse {
+  int code;
+  std::string body;
+  std::string content_type;
+  // Sent after the body, on a connection that then stays open, as for an
+  // event stream.
+  std::vector<HttpChunk> chunks;
+  // "gzip" once http_serve() has compressed the body
+  std::string content_encoding;
+};
+typedef std::function<HttpResponse(const HttpRequest &request)> HttpHandler;
+void http_route(const std::string &url_prefix, HttpHandler handler);
+void http_clear_routes();
+// Artificial delay added to every request, to emulate network latency.
+void http_set_latency_ms(uint32_t latency_ms);
+// JSON responses to requests that accept gzip are gzipped, unless turned off
+// here, or the host build has no zlib.
+void http_set_gzip(bool enabled);
+// Finds the route for request and waits out the latency, then answers it.
+// Returns false, and counts the request as unrouted, if no route matches.
+bool http_serve(const HttpRequest &request, HttpResponse *response);
+
+// The HTTP stand-in server, started on the first call, which serves the
+// routes on a local port to clients with real sockets. Requests are taken as
+// https ones to the Host they name. Each connection is served on a thread of
+// its own, so the latency of requests on different connections overlaps. A
+// connection is closed on its next request once it has been dropped.
+// Response chunks are not sent.
+uint16_t http_server_port();
+
+// Closes every open connection, as when the sign's WiFi drops. Connections
+// opened since the last drop are of the current generation.
+void http_drop_connections();
+uint32_t http_connection_generation();
+
+// The TLS stand-in server. Every TLS connection the shims open does a
+// handshake with it. A full handshake issues a session, which is resumed when
+// it is offered again to the same host, until the sessions are forgotten, as
+// when the server rotates its keys.
+struct TlsServerStats {
+  uint32_t full_handshakes;
+  uint32_t resumed_handshakes;
+};
+TlsServerStats tls_stats();
+void tls_forget_sessions();
+// The handshake of a client connected to the TLS stand-in for host, offering
+// session if offer is set. session, if not NULL, is set to the session issued
+// or resumed. Returns 1 if it was resumed, 0 after a full handshake.
+int tls_handshake(const char *host, mbedtls_ssl_session *session, bool offer);
+
+// The resolver stand-in (lwip/dns.h). Lookups are answered after latency_ms,
+// at once by default.
+struct DnsStats {
+  uint32_t lookups;
+};
+void dns_set_latency_ms(uint32_t latency_ms);
+DnsStats dns_stats();
+
+struct HttpStats {
+  uint32_t requests;
+  uint32_t unrouted;
+  uint64_t body_bytes;  // as sent, after compression
+  uint32_t gzipped;
+};
+HttpStats http_stats();
+
+struct QueueStats {
+  const char *name;
+  uint32_t item_size;
+  uint32_t length;
+  uint32_t sent;
+  uint32_t received;
+  uint32_t send_failures;
+  uint32_t high_water_mark;
+  uint64_t total_latency_us;  // time between send and receive, summed
+  uint32_t max_latency_us;
+};
+std::vector<QueueStats> queue_stats();
+
+// Every task created, ended or not, in the order they were created
+struct TaskStats {
+  const char *name;
+  uint32_t wakeups;        // returns from a call that blocked the task
+  uint32_t notifications;  // sent to the task
+  bool deleted;
+};
+std::vector<TaskStats> task_stats();
+
+// Preferences are kept in memory. Seed them before calling setup().
+void preferences_put_int(const char *key, int32_t value);
+
+// How long WiFi takes to associate after WiFi.begin(), and SNTP to sync once
+// it has, so that the sign boots as it does on the device. Both are 0 by
+// default. Set them before calling setup().
+void set_network_delays(uint32_t wifi_ms, uint32_t ntp_ms);
+
+// Simulates a tap on the sign button, picked up by the next Button2::loop().
+void tap_button();
+
+// Reads a whole file, returns false if it cannot be opened.
+bool read_file(const std::string &path, std::string *dst);
+
+// Moves every ISO 8601 timestamp ("2024-05-01T08:15:42-04:00") in a recorded
+// payload by offset_sec, so that recorded MBTA responses look current.
+std::string shift_timestamps(const std::string &body, long offset_sec);
+
+// Compresses data into a gzip file. Returns an empty string when the host
+// build has no zlib.
+std::string gzip(const std::string &data);
+
+// Encodes a synthetic width x height album cover as JPEG. Returns an empty
+// string when the host build has no JPEG encoder.
+std::string make_test_jpeg(int width, int height, uint32_t seed);
+
+}  // namespace lms_host
+
+#endif /* LMS_HOST_H */
@@ -0,0 +1,181 @@
+// The HTTP stand-in server, see lms_host::http_server_port().
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "host.h"
+
+namespace {
+
+std::once_flag started;
+uint16_t port = 0;
+
+const char *reason(int code) {
+  switch (code) {
+    case 200:
+      return "OK";
+    case 204:
+      return "No Content";
+    case 301:
+      return "Moved Permanently";
+    case 400:
+      return "Bad Request";
+    case 401:
+      return "Unauthorized";
+    case 404:
+      return "Not Found";
+    default:
+      return "Error";
+  }
+}
+
+bool send_all(int fd, const std::string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// Reads one request off fd into request, with what was read past it left in
+// pending. Returns false once the client is gone.
+bool read_request(int fd, std::string *pending, lms_host::HttpRequest *request,
+                  bool *close) {
+  size_t end;
+  char buffer[1024];
+  while ((end = pending->find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return false;
+    }
+    pending->append(buffer, n);
+  }
+  std::string head = pending->substr(0, end + 2);
+  pending->erase(0, end + 4);
+
+  size_t line_end = head.find("\r\n");
+  std::string line = head.substr(0, line_end);
+  size_t path_start = line.find(' ');
+  size_t path_end = line.find(' ', path_start + 1);
+  if (path_start == std::string::npos || path_end == std::string::npos) {
+    return false;
+  }
+  std::string path = line.substr(path_start + 1, path_end - path_start - 1);
+  request->headers.clear();
+  size_t body_size = 0;
+  *close = false;
+  for (size_t pos = line_end + 2; pos < head.size();) {
+    size_t next = head.find("\r\n", pos);
+    std::string header = head.substr(pos, next - pos);
+    pos = next + 2;
+    size_t colon = header.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = header.substr(0, colon);
+    size_t value_start = header.find_first_not_of(' ', colon + 1);
+    std::string value = value_start == std::string::npos
+                            ? ""
+                            : header.substr(value_start);
+    if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+      body_size = strtoul(value.c_str(), NULL, 10);
+    } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+      *close = strcasecmp(value.c_str(), "close") == 0;
+    }
+    request->headers.push_back({name, value});
+  }
+  request->url = "https://" + request->header("Host") + path;
+
+  // the body is read and dropped, the routes do not look at it
+  while (pending->size() < body_size) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return false;
+    }
+    pending->append(buffer, n);
+  }
+  pending->erase(0, body_size);
+  return true;
+}
+
+void serve_connection(int fd) {
+  uint32_t generation = lms_host::http_connection_generation();
+  std::string pending;
+  lms_host::HttpRequest request;
+  bool close_after;
+  while (read_request(fd, &pending, &request, &close_after) &&
+         generation == lms_host::http_connection_generation()) {
+    lms_host::HttpResponse response;
+    if (!lms_host::http_serve(request, &response)) {
+      break;
+    }
+    char head[256];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %d %s\r\n"
+             "Content-Type: %s\r\n"
+             "Content-Length: %zu\r\n"
+             "%s"
+             "%s"
+             "\r\n",
+             response.code, reason(response.code),
+             response.content_type.c_str(), response.body.size(),
+             response.content_encoding.empty()
+                 ? ""
+                 : "Content-Encoding: gzip\r\n",
+             close_after ? "Connection: close\r\n" : "");
+    if (!send_all(fd, head + response.body) || close_after) {
+      break;
+    }
+  }
+  close(fd);
+}
+
+void serve(int listener) {
+  while (true) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      continue;
+    }
+    std::thread(serve_connection, fd).detach();
+  }
+}
+
+}  // namespace
+
+namespace lms_host {
+
+uint16_t http_server_port() {
+  std::call_once(started, [] {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0 ||
+        getsockname(listener, (struct sockaddr *)&address, &length) != 0) {
+      fprintf(stderr, "http stand-in server: cannot listen\n");
+      abort();
+    }
+    port = ntohs(address.sin_port);
+    std::thread(serve, listener).detach();
+  });
+  return port;
+}
+
+}  // namespace lms_host
@@ -0,0 +1,31 @@
+#ifndef LMS_HOST_LWIP_DNS_H
+#define LMS_HOST_LWIP_DNS_H
+
+#include <stdint.h>
+
+// The asynchronous resolver of lwip, as the firmware uses it. Every name
+// resolves to the loopback address, after lms_host::dns_set_latency_ms() on a
+// thread of its own, or at once from the cache when the latency is 0. Names
+// ending in ".invalid" fail to resolve.
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+typedef struct ip_addr {
+  uint32_t addr;  // in network order
+} ip_addr_t;
+
+#define ip_2_ip4(ipaddr) (ipaddr)
+#define ip4_addr_get_u32(ipaddr) ((ipaddr)->addr)
+
+// ipaddr is NULL if the name did not resolve
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr,
+                                   void *callback_arg);
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr,
+                        dns_found_callback found, void *callback_arg);
+
+#endif /* LMS_HOST_LWIP_DNS_H */
@@ -0,0 +1,22 @@
+#ifndef LMS_HOST_MBEDTLS_SSL_H
+#define LMS_HOST_MBEDTLS_SSL_H
+
+#include <stddef.h>
+#include <string.h>
+
+// The part of mbedtls the firmware touches on the host: the session it keeps
+// to resume TLS sessions. The TLS stand-in (WiFiClientSecure.h) fills it in.
+typedef struct mbedtls_ssl_session {
+  size_t id_len;
+  unsigned char id[32];
+} mbedtls_ssl_session;
+
+static inline void mbedtls_ssl_session_init(mbedtls_ssl_session *session) {
+  memset(session, 0, sizeof(*session));
+}
+
+static inline void mbedtls_ssl_session_free(mbedtls_ssl_session *session) {
+  memset(session, 0, sizeof(*session));
+}
+
+#endif /* LMS_HOST_MBEDTLS_SSL_H */
@@ -0,0 +1,122 @@
+#include "rom/miniz.h"
+
+#include <string>
+
+#include "host.h"
+
+#ifdef LMS_HOST_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef LMS_HOST_HAS_ZLIB
+
+namespace {
+
+voidpf arena_alloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (r->host_used + bytes > sizeof(r->host_arena)) {
+    return Z_NULL;
+  }
+  void *p = r->host_arena + r->host_used;
+  r->host_used += bytes;
+  return p;
+}
+
+// the arena goes with the decompressor
+void arena_free(voidpf opaque, voidpf address) {}
+
+}  // namespace
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r,
+                              const mz_uint8 *pIn_buf_next,
+                              size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags) {
+  z_stream *z;
+  if (r->m_state == 0) {
+    r->host_used = 0;
+    z = (z_stream *)arena_alloc(r, 1, sizeof(z_stream));
+    *z = {};
+    z->zalloc = arena_alloc;
+    z->zfree = arena_free;
+    z->opaque = r;
+    int bits = decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER ? 15 : -15;
+    if (inflateInit2(z, bits) != Z_OK) {
+      *pIn_buf_size = 0;
+      *pOut_buf_size = 0;
+      return TINFL_STATUS_FAILED;
+    }
+    r->host = z;
+    r->m_state = 1;
+  }
+  z = (z_stream *)r->host;
+  if (r->m_state == 2) {
+    *pIn_buf_size = 0;
+    *pOut_buf_size = 0;
+    return TINFL_STATUS_DONE;
+  }
+  z->next_in = (Bytef *)pIn_buf_next;
+  z->avail_in = *pIn_buf_size;
+  z->next_out = pOut_buf_next;
+  z->avail_out = *pOut_buf_size;
+  int ret = inflate(z, Z_NO_FLUSH);
+  *pIn_buf_size -= z->avail_in;
+  *pOut_buf_size -= z->avail_out;
+  if (ret == Z_STREAM_END) {
+    r->m_state = 2;
+    return TINFL_STATUS_DONE;
+  }
+  if (ret != Z_OK && ret != Z_BUF_ERROR) {
+    return TINFL_STATUS_FAILED;
+  }
+  if (z->avail_out == 0) {
+    return TINFL_STATUS_HAS_MORE_OUTPUT;
+  }
+  if (!(decomp_flags & TINFL_FLAG_HAS_MORE_INPUT)) {
+    return TINFL_STATUS_FAILED;
+  }
+  return TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+namespace lms_host {
+
+std::string gzip(const std::string &data) {
+  z_stream z = {};
+  // 15 bits of window, and 16 for a gzip wrapper rather than zlib's
+  if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return std::string();
+  }
+  std::string out(deflateBound(&z, data.size()), '\0');
+  z.next_in = (Bytef *)data.data();
+  z.avail_in = data.size();
+  z.next_out = (Bytef *)&out[0];
+  z.avail_out = out.size();
+  int ret = deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return ret == Z_STREAM_END ? out : std::string();
+}
+
+}  // namespace lms_host
+
+#else
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r,
+                              const mz_uint8 *pIn_buf_next,
+                              size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags) {
+  *pIn_buf_size = 0;
+  *pOut_buf_size = 0;
+  return TINFL_STATUS_FAILED;
+}
+
+namespace lms_host {
+
+std::string gzip(const std::string &data) { return std::string(); }
+
+}  // namespace lms_host
+
+#endif
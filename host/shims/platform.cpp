@@ -0,0 +1,143 @@
+// Host implementations of the small ESP32 platform libraries.
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Button2.h"
+#include "Esp.h"
+#include "Preferences.h"
+#include "WiFi.h"
+#include "base64.h"
+#include "host.h"
+#include "sntp.h"
+
+EspClass ESP;
+
+namespace {
+
+// Matches the internal heap of an ESP32-D0WD running the sign.
+const uint32_t heap_size = 320 * 1024;
+
+std::atomic<int> pending_taps(0);
+
+std::atomic<uint32_t> wifi_delay_ms(0);
+std::atomic<uint32_t> ntp_delay_ms(0);
+std::atomic<uint32_t> wifi_begin_ms(0);
+
+std::mutex preferences_mutex;
+std::map<std::string, std::vector<uint8_t>> preferences_store;
+
+}  // namespace
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *password) {
+  wifi_begin_ms = lms_host::now_ms();
+  return this->status();
+}
+
+wl_status_t WiFiClass::status() {
+  return lms_host::now_ms() - wifi_begin_ms >= wifi_delay_ms
+             ? WL_CONNECTED
+             : WL_DISCONNECTED;
+}
+
+sntp_sync_status_t sntp_get_sync_status() {
+  return lms_host::now_ms() - wifi_begin_ms >= wifi_delay_ms + ntp_delay_ms
+             ? SNTP_SYNC_STATUS_COMPLETED
+             : SNTP_SYNC_STATUS_IN_PROGRESS;
+}
+
+uint32_t EspClass::getHeapSize() { return heap_size; }
+
+uint32_t EspClass::getFreeHeap() { return heap_size; }
+
+void EspClass::restart() {
+  Serial.println("ESP.restart() called, exiting");
+  fflush(stderr);
+  _Exit(0);
+}
+
+String base64::encode(const uint8_t *data, size_t length) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < length; i += 3) {
+    uint32_t n = data[i] << 16;
+    if (i + 1 < length) n |= data[i + 1] << 8;
+    if (i + 2 < length) n |= data[i + 2];
+    out.push_back(alphabet[(n >> 18) & 63]);
+    out.push_back(alphabet[(n >> 12) & 63]);
+    out.push_back(i + 1 < length ? alphabet[(n >> 6) & 63] : '=');
+    out.push_back(i + 2 < length ? alphabet[n & 63] : '=');
+  }
+  return String(out);
+}
+
+void Button2::loop() {
+  int taps = pending_taps.exchange(0);
+  while (taps-- > 0 && tap_handler) {
+    tap_handler(*this);
+  }
+}
+
+int32_t Preferences::getInt(const char *key, int32_t default_value) {
+  int32_t value;
+  if (getBytes(key, &value, sizeof(value)) != sizeof(value)) {
+    return default_value;
+  }
+  return value;
+}
+
+size_t Preferences::putInt(const char *key, int32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+bool Preferences::isKey(const char *key) {
+  std::lock_guard<std::mutex> lock(preferences_mutex);
+  return preferences_store.count(key) > 0;
+}
+
+bool Preferences::remove(const char *key) {
+  std::lock_guard<std::mutex> lock(preferences_mutex);
+  return preferences_store.erase(key) > 0;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  std::lock_guard<std::mutex> lock(preferences_mutex);
+  auto it = preferences_store.find(key);
+  return it == preferences_store.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t max_len) {
+  std::lock_guard<std::mutex> lock(preferences_mutex);
+  auto it = preferences_store.find(key);
+  if (it == preferences_store.end() || it->second.size() > max_len) {
+    return 0;
+  }
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  std::lock_guard<std::mutex> lock(preferences_mutex);
+  const uint8_t *bytes = (const uint8_t *)value;
+  preferences_store[key] = std::vector<uint8_t>(bytes, bytes + len);
+  return len;
+}
+
+namespace lms_host {
+
+void set_network_delays(uint32_t wifi_ms, uint32_t ntp_ms) {
+  wifi_delay_ms = wifi_ms;
+  ntp_delay_ms = ntp_ms;
+}
+
+void preferences_put_int(const char *key, int32_t value) {
+  Preferences().putInt(key, value);
+}
+
+void tap_button() { pending_taps++; }
+
+}  // namespace lms_host
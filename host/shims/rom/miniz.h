@@ -0,0 +1,52 @@
+#ifndef LMS_HOST_ROM_MINIZ_H
+#define LMS_HOST_ROM_MINIZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The inflater of the miniz copy in the esp32 ROM, as the firmware uses it:
+// raw deflate into a wrapping 32 KB dictionary. It inflates with zlib when the
+// host build has it, and fails every stream otherwise.
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum {
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+  TINFL_FLAG_COMPUTE_ADLER32 = 8,
+};
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+typedef struct tinfl_decompressor_tag {
+  mz_uint32 m_state;
+  // host only: zlib's state, allocated from host_arena, so that it goes with
+  // the decompressor as the ROM's does
+  void *host;
+  size_t host_used;
+  alignas(16) unsigned char host_arena[48 * 1024];
+} tinfl_decompressor;
+
+#define tinfl_init(r) \
+  do {                \
+    (r)->m_state = 0; \
+  } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r,
+                              const mz_uint8 *pIn_buf_next,
+                              size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags);
+
+#endif /* LMS_HOST_ROM_MINIZ_H */
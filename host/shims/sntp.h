@@ -0,0 +1,15 @@
+#ifndef LMS_HOST_SNTP_H
+#define LMS_HOST_SNTP_H
+
+typedef enum {
+  SNTP_SYNC_STATUS_RESET,
+  SNTP_SYNC_STATUS_COMPLETED,
+  SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+// The host clock is already synchronised, but reports it
+// lms_host::set_network_delays() after WiFi associates, as SNTP would.
+inline void sntp_servermode_dhcp(int enable) {}
+sntp_sync_status_t sntp_get_sync_status();
+
+#endif /* LMS_HOST_SNTP_H */
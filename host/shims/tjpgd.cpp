@@ -0,0 +1,239 @@
+#include "tjpgd.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "host.h"
+
+#ifdef LMS_HOST_HAS_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#ifdef LMS_HOST_HAS_LIBJPEG
+
+namespace {
+
+// tjpgd reads its input 512 bytes at a time
+const uint16_t input_chunk = 512;
+
+struct Decoder {
+  jpeg_decompress_struct cinfo;
+  struct {
+    jpeg_error_mgr pub;
+    jmp_buf escape;
+  } err;
+  jpeg_source_mgr src;
+  JDEC *jd;
+  uint16_t (*infunc)(JDEC *, uint8_t *, uint16_t);
+  bool ended;  // infunc had nothing more
+  uint8_t buffer[input_chunk];
+};
+
+void on_error(j_common_ptr cinfo) {
+  longjmp(((Decoder *)cinfo)->err.escape, 1);
+}
+
+// tjpgd says nothing about the images it decodes
+void on_message(j_common_ptr cinfo) {}
+
+void init_source(j_decompress_ptr cinfo) {}
+
+// Pulls the next chunk through infunc. If there is none, the image is cut
+// short: an end of image marker is made up, as libjpeg suggests, and the
+// decode fails.
+boolean fill_input_buffer(j_decompress_ptr cinfo) {
+  Decoder *decoder = (Decoder *)cinfo;
+  uint16_t n = decoder->infunc(decoder->jd, decoder->buffer, input_chunk);
+  if (n == 0) {
+    decoder->ended = true;
+    decoder->buffer[0] = 0xFF;
+    decoder->buffer[1] = JPEG_EOI;
+    n = 2;
+  }
+  decoder->src.next_input_byte = decoder->buffer;
+  decoder->src.bytes_in_buffer = n;
+  return TRUE;
+}
+
+void skip_input_data(j_decompress_ptr cinfo, long num_bytes) {
+  Decoder *decoder = (Decoder *)cinfo;
+  while (num_bytes > (long)decoder->src.bytes_in_buffer) {
+    num_bytes -= decoder->src.bytes_in_buffer;
+    fill_input_buffer(cinfo);
+  }
+  decoder->src.next_input_byte += num_bytes;
+  decoder->src.bytes_in_buffer -= num_bytes;
+}
+
+void term_source(j_decompress_ptr cinfo) {}
+
+uint16_t to_rgb565(const uint8_t *rgb) {
+  return ((rgb[0] & 0xF8) << 8) | ((rgb[1] & 0xFC) << 3) | (rgb[2] >> 3);
+}
+
+void destroy(JDEC *jd) {
+  Decoder *decoder = (Decoder *)jd->host;
+  jpeg_destroy_decompress(&decoder->cinfo);
+  free(decoder);
+  jd->host = nullptr;
+}
+
+}  // namespace
+
+// The libjpeg state is allocated with malloc, so that it does not count
+// towards the heap the benchmarks see the firmware use; on the esp32 it lives
+// in pool. Every successful jd_prepare must be followed by jd_decomp, which
+// frees it.
+JRESULT jd_prepare(JDEC *jd, uint16_t (*infunc)(JDEC *, uint8_t *, uint16_t),
+                   void *pool, uint16_t sz_pool, void *dev) {
+  // cinfo comes first, so that the libjpeg callbacks can cast it back
+  Decoder *decoder = (Decoder *)calloc(1, sizeof(Decoder));
+  decoder->jd = jd;
+  decoder->infunc = infunc;
+  jd->device = dev;
+  jd->host = decoder;
+  decoder->cinfo.err = jpeg_std_error(&decoder->err.pub);
+  decoder->err.pub.error_exit = on_error;
+  decoder->err.pub.output_message = on_message;
+  if (setjmp(decoder->err.escape)) {
+    destroy(jd);
+    return JDR_FMT1;
+  }
+  jpeg_create_decompress(&decoder->cinfo);
+  decoder->src.init_source = init_source;
+  decoder->src.fill_input_buffer = fill_input_buffer;
+  decoder->src.skip_input_data = skip_input_data;
+  decoder->src.resync_to_restart = jpeg_resync_to_restart;
+  decoder->src.term_source = term_source;
+  decoder->cinfo.src = &decoder->src;
+  if (jpeg_read_header(&decoder->cinfo, TRUE) != JPEG_HEADER_OK ||
+      decoder->ended) {
+    destroy(jd);
+    return JDR_INP;
+  }
+  jd->width = decoder->cinfo.image_width;
+  jd->height = decoder->cinfo.image_height;
+  return JDR_OK;
+}
+
+JRESULT jd_decomp(JDEC *jd, uint16_t (*outfunc)(JDEC *, void *, JRECT *),
+                  uint8_t scale) {
+  Decoder *decoder = (Decoder *)jd->host;
+  jpeg_decompress_struct *cinfo = &decoder->cinfo;
+  uint8_t *rows = nullptr;
+  uint16_t *tile = nullptr;
+  if (setjmp(decoder->err.escape)) {
+    free(rows);
+    free(tile);
+    destroy(jd);
+    return JDR_FMT1;
+  }
+  cinfo->out_color_space = JCS_RGB;
+  cinfo->scale_num = 1;
+  cinfo->scale_denom = 1 << scale;
+  jpeg_start_decompress(cinfo);
+
+  const int block = std::max(16 >> scale, 1);
+  const int w = cinfo->output_width;
+  rows = (uint8_t *)malloc(block * w * 3);
+  tile = (uint16_t *)malloc(block * block * sizeof(uint16_t));
+  JRESULT result = JDR_OK;
+  while (cinfo->output_scanline < cinfo->output_height && result == JDR_OK) {
+    int top = cinfo->output_scanline;
+    int n = 0;
+    while (n < block && cinfo->output_scanline < cinfo->output_height) {
+      JSAMPROW row = &rows[n * w * 3];
+      n += jpeg_read_scanlines(cinfo, &row, 1);
+    }
+    if (decoder->ended) {
+      result = JDR_INP;
+      break;
+    }
+    for (int left = 0; left < w && result == JDR_OK; left += block) {
+      int tw = std::min(block, w - left);
+      for (int j = 0; j < n; j++) {
+        for (int i = 0; i < tw; i++) {
+          tile[j * tw + i] = to_rgb565(&rows[(j * w + left + i) * 3]);
+        }
+      }
+      JRECT rect = {(uint16_t)left, (uint16_t)(left + tw - 1), (uint16_t)top,
+                    (uint16_t)(top + n - 1)};
+      if (!outfunc(jd, tile, &rect)) {
+        result = JDR_INTR;
+      }
+    }
+  }
+  free(rows);
+  free(tile);
+  jpeg_abort_decompress(cinfo);
+  destroy(jd);
+  return result;
+}
+
+namespace lms_host {
+
+std::string make_test_jpeg(int width, int height, uint32_t seed) {
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char *out = nullptr;
+  unsigned long out_size = 0;
+  jpeg_mem_dest(&cinfo, &out, &out_size);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 85, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  std::vector<uint8_t> row(width * 3);
+  uint32_t state = seed * 2654435761u + 1;
+  while (cinfo.next_scanline < cinfo.image_height) {
+    int y = cinfo.next_scanline;
+    for (int x = 0; x < width; x++) {
+      // a gradient with some noise, so the encoder has real work to do
+      state = state * 1664525u + 1013904223u;
+      row[x * 3 + 0] = (uint8_t)(x * 255 / width + (seed & 0x3f));
+      row[x * 3 + 1] = (uint8_t)(y * 255 / height);
+      row[x * 3 + 2] = (uint8_t)((state >> 24) & 0x7f) + (seed & 0x3f);
+    }
+    JSAMPROW ptr = row.data();
+    jpeg_write_scanlines(&cinfo, &ptr, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  std::string jpg((const char *)out, out_size);
+  jpeg_destroy_compress(&cinfo);
+  free(out);
+  return jpg;
+}
+
+}  // namespace lms_host
+
+#else
+
+JRESULT jd_prepare(JDEC *jd, uint16_t (*infunc)(JDEC *, uint8_t *, uint16_t),
+                   void *pool, uint16_t sz_pool, void *dev) {
+  return JDR_FMT1;
+}
+
+JRESULT jd_decomp(JDEC *jd, uint16_t (*outfunc)(JDEC *, void *, JRECT *),
+                  uint8_t scale) {
+  return JDR_FMT1;
+}
+
+namespace lms_host {
+
+std::string make_test_jpeg(int width, int height, uint32_t seed) {
+  return std::string();
+}
+
+}  // namespace lms_host
+
+#endif
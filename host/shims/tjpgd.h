@@ -0,0 +1,41 @@
+#ifndef LMS_HOST_TJPGD_H
+#define LMS_HOST_TJPGD_H
+
+#include <stdint.h>
+
+// The tjpgd decoder that comes with the TJpg_Decoder library, as the firmware
+// uses it. It decodes with libjpeg when the host build has it: input is
+// pulled through infunc as tjpgd does, and the image is handed to outfunc in
+// 16x16 blocks of RGB565 (before scaling), like tjpgd's MCUs for 4:2:0
+// images.
+
+typedef enum {
+  JDR_OK = 0,
+  JDR_INTR,
+  JDR_INP,
+  JDR_MEM1,
+  JDR_MEM2,
+  JDR_PAR,
+  JDR_FMT1,
+  JDR_FMT2,
+  JDR_FMT3,
+} JRESULT;
+
+typedef struct {
+  uint16_t left, right, top, bottom;
+} JRECT;
+
+typedef struct JDEC JDEC;
+struct JDEC {
+  uint16_t width, height;
+  void *device;
+  // host only: the libjpeg state between jd_prepare and jd_decomp
+  void *host;
+};
+
+JRESULT jd_prepare(JDEC *jd, uint16_t (*infunc)(JDEC *, uint8_t *, uint16_t),
+                   void *pool, uint16_t sz_pool, void *dev);
+JRESULT jd_decomp(JDEC *jd, uint16_t (*outfunc)(JDEC *, void *, JRECT *),
+                  uint8_t scale);
+
+#endif /* LMS_HOST_TJPGD_H */
@@ -0,0 +1,229 @@
+// sign-sim: runs the whole sign on the host against canned API responses.
+//
+//   sign-sim [--mode test|mbta|clock|music] [--seconds N] [--latency-ms N]
+//            [--mbta-streaming] [--tap-every S] [--wifi-ms N] [--ntp-ms N]
+//            [--verbose]
+//
+// setup() runs exactly as on the device, then the FreeRTOS tasks and timers
+// run as threads for the given time, the button tapped every S seconds to
+// switch modes if asked. WiFi and NTP can be given the time they take on the
+// device. At the end the boot stages, and the queue, task, panel and HTTP
+// counters are printed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+
+#include "../common.h"
+#include "../src/client/http-engine.h"
+#include "../src/display/display.h"
+#include "../src/display/mailbox.h"
+#include "../src/executor/executor.h"
+#include "../src/mbta/mbta.h"
+#include "../src/spotify/spotify.h"
+#include "../src/spotify/cover-cache.h"
+#include "../src/spotify/cover-loader.h"
+#include "../src/storage/last-known.h"
+#include "ESP32-HUB75-MatrixPanel-I2S-DMA.h"
+#include "host.h"
+#include "routes.h"
+
+void setup();
+extern Display display;
+extern RenderMailbox render_mailbox;
+extern CoverCache cover_cache;
+extern CoverLoader cover_loader;
+extern LastKnown last_known;
+extern lms::HttpEngine http_engine;
+extern lms::Executor provider_executor;
+extern TaskHandle_t cover_task_handle;
+extern MBTA mbta;
+extern Spotify spotify;
+extern ModeSwitchStats mode_switch_stats;
+extern BootStats boot_stats;
+
+namespace {
+
+const char *mode_names[] = {"test", "mbta", "clock", "music"};
+
+void usage() {
+  fprintf(stderr,
+          "usage: sign-sim [--mode test|mbta|clock|music] [--seconds N] "
+          "[--latency-ms N] [--mbta-streaming] [--tap-every S] "
+          "[--wifi-ms N] [--ntp-ms N] [--verbose]\n");
+  exit(2);
+}
+
+void print_encoding_stats(const char *name, EncodingStats stats) {
+  printf("%s bodies: %u gzipped, %u plain, %u failed, %u bytes on the wire, "
+         "%u decoded\n",
+         name, stats.gzipped, stats.plain, stats.failed, stats.wire_bytes,
+         stats.decoded_bytes);
+}
+
+void print_boot_stats() {
+  printf("boot:");
+  for (int stage = 0; stage < BOOT_STAGE_MAX; stage++) {
+    if (boot_stats.reached[stage]) {
+      printf(" %s %u ms", boot_stage_to_str((BootStage)stage),
+             boot_stats.at_ms[stage]);
+    } else {
+      printf(" %s -", boot_stage_to_str((BootStage)stage));
+    }
+  }
+  printf("\n");
+}
+
+void print_stats(double seconds) {
+  print_boot_stats();
+  printf("\n%-16s %6s %6s %6s %5s %5s %14s %14s\n", "queue", "size", "sent",
+         "recv", "fail", "hwm", "avg_latency_us", "max_latency_us");
+  for (const lms_host::QueueStats &q : lms_host::queue_stats()) {
+    printf("%-16s %6u %6u %6u %5u %5u %14llu %14u\n", q.name, q.item_size,
+           q.sent, q.received, q.send_failures, q.high_water_mark,
+           (unsigned long long)(q.received ? q.total_latency_us / q.received
+                                           : 0),
+           q.max_latency_us);
+  }
+
+  printf("\n%-20s %8s %9s %8s\n", "task", "wakeups", "wakeups/s",
+         "notified");
+  for (const lms_host::TaskStats &t : lms_host::task_stats()) {
+    printf("%-20s %8u %9.1f %8u%s\n", t.name, t.wakeups, t.wakeups / seconds,
+           t.notifications, t.deleted ? " (ended)" : "");
+  }
+
+  lms_host::PanelStats panel = lms_host::panel_stats();
+  printf("\npanel: %llu pixel writes (%.0f/s), %llu full fills\n",
+         (unsigned long long)panel.pixel_writes, panel.pixel_writes / seconds,
+         (unsigned long long)panel.full_fills);
+
+  FlushStats flush = display.get_flush_stats();
+  printf("display: %u frames flushed, %llu pixels (%llu per frame)\n",
+         flush.frames, (unsigned long long)flush.total_pixels,
+         (unsigned long long)(flush.frames ? flush.total_pixels / flush.frames
+                                           : 0));
+
+  printf("render mailbox: %u frames coalesced (mbta %u, text %u, music %u, "
+         "animation %u)\n",
+         render_mailbox.get_coalesced_count(),
+         render_mailbox.get_coalesced_count(RENDER_TYPE_MBTA),
+         render_mailbox.get_coalesced_count(RENDER_TYPE_TEXT),
+         render_mailbox.get_coalesced_count(RENDER_TYPE_MUSIC),
+         render_mailbox.get_coalesced_count(RENDER_TYPE_ANIMATION));
+  printf("render content pool: peak %u of %u slots, %u frames dropped\n",
+         render_mailbox.get_pool_peak(), RENDER_CONTENT_POOL_SIZE,
+         render_mailbox.get_dropped_count());
+
+  CoverCacheStats covers = cover_cache.get_stats();
+  printf("cover cache: %u hits (%u from flash), %u misses, %u evictions\n",
+         covers.hits, covers.flash_hits, covers.misses, covers.evictions);
+  CoverLoaderStats loader = cover_loader.get_stats();
+  printf("cover loader: %u requests, %u dropped, %u loaded, %u published\n",
+         loader.requests, loader.dropped, loader.loaded, loader.published);
+
+  LastKnownStats saved = last_known.get_stats();
+  printf("last known: %u records written, %u bytes, %u saves coalesced\n",
+         saved.writes, saved.bytes, saved.coalesced);
+
+  lms_host::HttpStats http = lms_host::http_stats();
+  printf("http: %u requests, %u unrouted, %llu body bytes, %u gzipped\n",
+         http.requests, http.unrouted, (unsigned long long)http.body_bytes,
+         http.gzipped);
+  print_encoding_stats("mbta", mbta.get_encoding_stats());
+  print_encoding_stats("spotify", spotify.get_encoding_stats());
+  lms::ExecutorFootprint footprint = provider_executor.get_footprint();
+  lms::ExecutorStats executor = provider_executor.get_stats();
+  printf("provider executor: %u coroutines on one %u B stack (%u B as a "
+         "task each), %u B of state, %u wakeups, %u resumes\n",
+         footprint.coroutines, footprint.stack_bytes,
+         footprint.task_stack_bytes, footprint.state_bytes, executor.wakeups,
+         executor.resumes);
+  if (cover_task_handle != NULL) {
+    printf("cover task: %u B of stack besides the executor's\n",
+           COVER_LOADER_STACK_SIZE);
+  }
+  lms::HttpEngineStats engine = http_engine.get_stats();
+  printf("http engine: %u requests, %u failed (%u timed out), %u connections "
+         "opened, %u reused, up to %u in flight, %u lookups, %u full and %u "
+         "resumed handshakes\n",
+         engine.submitted, engine.failed, engine.timed_out,
+         engine.connections_opened, engine.connections_reused,
+         engine.max_in_flight, engine.lookups, engine.full_handshakes,
+         engine.resumed_handshakes);
+  lms_host::TlsServerStats tls = lms_host::tls_stats();
+  printf("tls: %u full and %u resumed handshakes\n", tls.full_handshakes,
+         tls.resumed_handshakes);
+  printf("mode switches: %u, last took %u ms, longest %u ms\n",
+         mode_switch_stats.switches, mode_switch_stats.last_ms,
+         mode_switch_stats.max_ms);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int mode = SIGN_MODE_MBTA;
+  double seconds = 10;
+  bool mbta_streaming = false;
+  double tap_every = 0;
+  uint32_t wifi_ms = 0;
+  uint32_t ntp_ms = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--mode") && i + 1 < argc) {
+      const char *name = argv[++i];
+      mode = -1;
+      for (int m = 0; m < SIGN_MODE_MAX; m++) {
+        if (!strcmp(name, mode_names[m])) mode = m;
+      }
+      if (mode < 0) usage();
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--latency-ms") && i + 1 < argc) {
+      lms_host::http_set_latency_ms(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--mbta-streaming")) {
+      mbta_streaming = true;
+    } else if (!strcmp(argv[i], "--tap-every") && i + 1 < argc) {
+      tap_every = atof(argv[++i]);
+      if (tap_every <= 0) usage();
+    } else if (!strcmp(argv[i], "--wifi-ms") && i + 1 < argc) {
+      wifi_ms = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--ntp-ms") && i + 1 < argc) {
+      ntp_ms = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--verbose")) {
+      lms_host::set_serial_enabled(true);
+    } else {
+      usage();
+    }
+  }
+
+  if (!lms_host::install_fixture_routes()) return 1;
+  lms_host::preferences_put_int(SIGN_MODE_KEY, mode);
+  lms_host::preferences_put_int(MBTA_STREAMING_KEY, mbta_streaming);
+  lms_host::set_network_delays(wifi_ms, ntp_ms);
+
+  uint32_t start = lms_host::now_ms();
+  setup();
+  printf("sign-sim: mode %s, setup took %u ms, running for %.1f s\n",
+         mode_names[mode], lms_host::now_ms() - start, seconds);
+  lms_host::reset_panel_stats();
+  if (tap_every > 0) {
+    double left = seconds;
+    while (left > tap_every) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(tap_every));
+      lms_host::tap_button();
+      left -= tap_every;
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(left));
+  } else {
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  }
+
+  print_stats(seconds);
+  fflush(stdout);
+  // the firmware tasks never return, so leave without running destructors
+  // under their feet
+  _Exit(0);
+}
@@ -0,0 +1,3 @@
+// The Arduino builder compiles the sketch as C++ after adding prototypes; the
+// prototypes are already in led-matrix-sign.h, so it can be included as is.
+#include "../led-matrix-sign.ino"
@@ -1,49 +1,104 @@
 #include <Button2.h>
 
 #include "common.h"
+#include "src/display/mailbox.h"
+#include "src/executor/executor.h"
 #include "src/mbta/mbta.h"
 #include "src/spotify/spotify.h"
 
 #ifndef LED_MATRIX_SIGN_H
 #define LED_MATRIX_SIGN_H
 
-struct ProviderRequest {
-  SignMode sign_mode;
+// How a sign mode is brought up and down. start creates what the mode runs
+// on, its clients, timers and tasks, and stop tears them down again, so the
+// sign switches modes without restarting. first_frame shows what the mode
+// has before the network is up, and warm_up connects to its API ahead of
+// start; either may be NULL.
+struct Provider {
+  void (*first_frame)();
+  void (*warm_up)();
+  void (*start)();
+  void (*stop)();
 };
 
 QueueHandle_t ui_queue;
-QueueHandle_t provider_queue;
-QueueHandle_t render_queue;
+RenderMailbox render_mailbox;
 
 TaskHandle_t system_task_handle;
 TaskHandle_t render_task_handle;
-TaskHandle_t test_provider_task_handle;
-TaskHandle_t mbta_provider_task_handle;
-TaskHandle_t clock_provider_task_handle;
-TaskHandle_t music_provider_task_handle;
+
+// The providers run as coroutines on one task, woken by their timers. The
+// covers are decoded on a task of their own, so that the providers never
+// wait on one.
+lms::Executor provider_executor;
+lms::Coroutine *network_coroutine_handle;
+lms::Coroutine *clock_coroutine_handle;
+TaskHandle_t cover_task_handle;
 
 TimerHandle_t mbta_provider_timer_handle;
 TimerHandle_t clock_provider_timer_handle;
 TimerHandle_t music_provider_timer_handle;
 TimerHandle_t wifi_reconnect_timer_handle;
 TimerHandle_t button_loop_timer_handle;
-TimerHandle_t animation_timer_handle;
+
+// Set while the cover task of the music mode winds down
+volatile bool cover_task_stopping;
+ModeSwitchStats mode_switch_stats;
+BootStats boot_stats;
 
 void system_task(void *params);
 void render_task(void *params);
-void test_provider_task(void *params);
-void mbta_provider_task(void *params);
-void clock_provider_task(void *params);
+bool test_coroutine(lms::Coroutine *co);
+bool network_coroutine(lms::Coroutine *co);
+bool clock_coroutine(lms::Coroutine *co);
+void cover_task(void *params);
+void send_test_text();
+void send_clock_text();
+
+void mbta_provider_tick();
+void music_provider_tick();
+void show_currently_playing(SpotifyResponse status, CurrentlyPlaying *song);
+void prefetch_next_cover(SpotifyResponse status, CurrentlyPlaying *song);
 
 void button_tapped(Button2 &btn);
 void mbta_provider_timer(TimerHandle_t timer);
 void clock_provider_timer(TimerHandle_t timer);
+void music_provider_timer(TimerHandle_t timer);
 void check_wifi_and_reconnect_timer(TimerHandle_t timer);
 
+void mark_boot_stage(BootStage stage);
+void boot_network(SignMode sign_mode);
+void start_wifi();
+void start_time_sync();
+bool check_time_synced();
+
+void start_test();
+void stop_test();
+void start_mbta();
+void stop_mbta();
+void start_clock();
+void stop_clock();
+void start_music();
+void stop_music();
+void show_mbta_first_frame();
+void show_music_first_frame();
+void warm_up_mbta();
+void warm_up_music();
+void switch_sign_mode(SignMode from, SignMode to);
+void start_provider_executor();
+
 SignMode shift_sign_mode(SignMode current_sign_mode);
 SignMode read_sign_mode();
 int write_sign_mode(SignMode sign_mode);
-bool draw_jpg_image(int16_t x, int16_t y, uint16_t w, uint16_t h,
-                    uint16_t *data);
+bool mbta_content_equal(const MBTARenderContent &a,
+                        const MBTARenderContent &b);
+
+// In the order of SignMode
+Provider providers[SIGN_MODE_MAX] = {
+    {NULL, NULL, start_test, stop_test},
+    {show_mbta_first_frame, warm_up_mbta, start_mbta, stop_mbta},
+    {NULL, NULL, start_clock, stop_clock},
+    {show_music_first_frame, warm_up_music, start_music, stop_music},
+};
 
 #endif /* LED_MATRIX_SIGN_H */
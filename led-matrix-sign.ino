@@ -1,10 +1,8 @@
-#include <ArduinoJson.h>
 #include <AsyncTCP.h>
 #include <Button2.h>
 #include <Esp.h>
 #include <ESPAsyncWebServer.h>
 #include <Preferences.h>
-#include <TJpg_Decoder.h>
 #include <WiFi.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
@@ -16,10 +14,14 @@
 #include "led-matrix-sign.h"
 #include "src/display/animation.h"
 #include "src/display/common.h"
+#include "src/client/http-engine.h"
 #include "src/display/display.h"
 #include "src/mbta/mbta.h"
 #include "src/server/server.h"
+#include "src/spotify/cover-cache.h"
+#include "src/spotify/cover-loader.h"
 #include "src/spotify/spotify.h"
+#include "src/storage/last-known.h"
 
 lms::Server server;
 Preferences preferences;
@@ -37,19 +39,17 @@ SignMode disabled_sign_modes[] = {
 Display display;
 Button2 button;
 Spotify spotify;
+CoverCache cover_cache;
+CoverLoader cover_loader;
+LastKnown last_known;
 MBTA mbta;
+lms::HttpEngine http_engine;
 
-void setup_wifi() {
+// Starts associating, without waiting for it; boot_network() does
+void start_wifi() {
   WiFi.mode(WIFI_STA);
   WiFi.begin(ssid, password);
-  Serial.print("Connecting to WiFi ..");
-  while (WiFi.status() != WL_CONNECTED) {
-    Serial.print('.');
-    delay(1000);
-  }
-  Serial.println(WiFi.localIP());
-  Serial.print("RRSI: ");
-  Serial.println(WiFi.RSSI());
+  Serial.println("Connecting to WiFi ..");
 }
 
 void check_wifi_and_reconnect_timer(TimerHandle_t timer) {
@@ -68,88 +68,72 @@ void print_ram_info() {
                 free_heap_percent);
 }
 
-void setup_time() {
+// Starts syncing with the NTP servers, once WiFi is up
+void start_time_sync() {
   sntp_servermode_dhcp(1);
   configTzTime(time_zone, ntp_server_1, ntp_server_2);
-  Serial.printf("Syncing time with NTP servers...");
-  while (sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED) {
-    Serial.printf(".");
-    delay(1000);
-  }
+  Serial.println("Syncing time with NTP servers...");
+}
+
+// Returns whether the clock is synced, without waiting. The time zone is set
+// once it is.
+bool check_time_synced() {
   struct tm timeinfo;
-  while (!getLocalTime(&timeinfo)) {
-    Serial.printf(".");
-    delay(1000);
+  if (sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED ||
+      !getLocalTime(&timeinfo, 0)) {
+    return false;
   }
-  Serial.println(" Done!");
   Serial.println("Setting timezone");
   setenv("TZ", time_zone, 1);
   tzset();
   Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S%z");
+  return true;
+}
+
+void mark_boot_stage(BootStage stage) {
+  boot_stats.at_ms[stage] = millis();
+  boot_stats.reached[stage] = true;
+  Serial.printf("boot: %s at %u ms\n", boot_stage_to_str(stage),
+                boot_stats.at_ms[stage]);
 }
 
 void setup() {
   Serial.begin(115200);
   while (!Serial) continue;
-  setup_wifi();
   display.setup();
-
-  display.log("Sync with NTP server");
-  setup_time();
+  mark_boot_stage(BOOT_STAGE_DISPLAY);
+  // Associating takes seconds. The rest of the boot goes on meanwhile, and
+  // the system task waits for it before starting the provider.
+  start_wifi();
 
   // Preferences setup
   preferences.begin("default");
   SignMode sign_mode = read_sign_mode();
+  // What the sign showed before it restarted, for the first frame
+  last_known.setup();
 
-  // API setup
-  if (sign_mode == SIGN_MODE_MBTA) {
-    display.log("Setup MBTA API");
-    mbta.setup();
-  }
-  if (sign_mode == SIGN_MODE_MUSIC) {
-    display.log("Setup Spotify API");
-    spotify.setup();
-  }
+  // Covers are cached across mode switches
+  cover_cache.setup();
+  cover_loader.setup(&spotify, &cover_cache, &display, &last_known);
+  provider_executor.setup(&http_engine);
 
   // Button setup
-  display.log("Setup button");
   button.begin(SIGN_MODE_BUTTON_PIN);
   button.setTapHandler(button_tapped);
 
-  // jpeg setup
-  TJpgDec.setJpgScale(2);
-  TJpgDec.setSwapBytes(false);
-  TJpgDec.setCallback(draw_jpg_image);
-
   // Queue setup
-  display.log("Setup RTOS queues");
   ui_queue = xQueueCreate(16, sizeof(UIMessage));
-  provider_queue = xQueueCreate(32, sizeof(ProviderRequest));
-  render_queue = xQueueCreate(32, sizeof(RenderMessage));
+  render_mailbox.setup();
+  vQueueAddToRegistry(ui_queue, "ui_queue");
+
+  // The provider's first frame waits in the mailbox for the render task, so
+  // it is on the panel within a frame of the task starting, while the
+  // network comes up
+  if (providers[sign_mode].first_frame) {
+    providers[sign_mode].first_frame();
+  }
 
   // Timer setup
-  display.log("Setup RTOS timers");
-  if (sign_mode == SIGN_MODE_MBTA) {
-    mbta_provider_timer_handle =
-        xTimerCreate("mbta_provider_timer",
-                     5000 / portTICK_PERIOD_MS,  // timer interval in millisec
-                     true,  // is an autoreload timer (repeats periodically)
-                     NULL, mbta_provider_timer);
-  }
-  if (sign_mode == SIGN_MODE_CLOCK) {
-    clock_provider_timer_handle =
-        xTimerCreate("clock_provider_timer",
-                     REFRESH_RATE,  // timer interval in millisec
-                     true,  // is an autoreload timer (repeats periodically)
-                     NULL, clock_provider_timer);
-  }
-  if (sign_mode == SIGN_MODE_MUSIC) {
-    music_provider_timer_handle =
-        xTimerCreate("music_provider_timer",
-                     1000 / portTICK_PERIOD_MS,  // timer interval in millisec
-                     true,  // is an autoreload timer (repeats periodically)
-                     NULL, music_provider_timer);
-  }
   wifi_reconnect_timer_handle =
       xTimerCreate("wifi_reconnect_timer",
                    30000 / portTICK_PERIOD_MS,  // timer interval in millisec
@@ -162,27 +146,24 @@ void setup() {
                    true,        // is an autoreload timer (repeats periodically)
                    NULL, [](TimerHandle_t t) { button.loop(); });
   xTimerStart(button_loop_timer_handle, TEN_MILLIS);
-  animation_timer_handle =
-      xTimerCreate("animation_timer",
-                   100 / portTICK_PERIOD_MS,  // timer interval in millisec
-                   true,  // is an autoreload timer (repeats periodically)
-                   NULL, animation_timer);
-  xTimerStart(animation_timer_handle, TEN_MILLIS);
 
   // Task setup
   //
   //  * The system task has highest priority (3)
   //  * The render task has medium priority (2)
-  //  * The provider tasks have low priority (1)
+  //  * The provider executor and the cover task have low priority (1)
   //
-  // The mbta_provider_task needs a deeper stack because it passes around a lot
-  // of JSON object as function arguments.
+  // The provider executor, the cover task, and the timers that drive them,
+  // are created when their mode starts, by the system task. The system task
+  // first brings the network up, see boot_network(). It needs a deeper stack
+  // because it does the TLS handshakes of the boot, and starting the music
+  // provider may fetch a Spotify token.
   //
   // The render_task has its own reserved core, because I always want the
-  // the display to be ready to draw when it receives a new message.
-  display.log("Setup RTOS tasks");
+  // the display to be ready to draw when it receives a new message. From
+  // here on only the render task draws.
   xTaskCreatePinnedToCore(system_task, "system_task",
-                          2048,  // stack size
+                          8192,  // stack size
                           NULL,  // task parameters
                           3,     // task priority
                           &system_task_handle, ESP32_CORE_0);
@@ -191,49 +172,14 @@ void setup() {
                           NULL,  // task parameters
                           2,     // task priority
                           &render_task_handle, ESP32_CORE_1);
-  if (sign_mode == SIGN_MODE_MBTA) {
-    xTaskCreatePinnedToCore(mbta_provider_task, "mbta_provider_task",
-                            8192,  // stack size
-                            NULL,  // task parameters
-                            1,     // task priority
-                            &mbta_provider_task_handle, ESP32_CORE_0);
-  }
-  if (sign_mode == SIGN_MODE_TEST) {
-    xTaskCreatePinnedToCore(test_provider_task, "test_provider_task",
-                            2048,  // stack size
-                            NULL,  // task parameters
-                            1,     // task priority
-                            &test_provider_task_handle, ESP32_CORE_0);
-  }
-  if (sign_mode == SIGN_MODE_CLOCK) {
-    xTaskCreatePinnedToCore(clock_provider_task, "clock_provider_task",
-                            2048,  // stack size
-                            NULL,  // task parameters
-                            1,     // task priority
-                            &clock_provider_task_handle, ESP32_CORE_0);
-  }
-  if (sign_mode == SIGN_MODE_MUSIC) {
-    xTaskCreatePinnedToCore(music_provider_task, "music_provider_task",
-                            8192,  // stack size
-                            NULL,  // task parameters
-                            1,     // task priority
-                            &music_provider_task_handle, ESP32_CORE_0);
-  }
-
-  // Webserver setup
-  // this needs to happen after the RTOS setup, so we can pass the queue handle
-  display.log("Setup webserver");
-  SignMode current_sign_mode = read_sign_mode();
-  server.setup(current_sign_mode, ui_queue);
-
-  display.log("Setup DONE!");
+  mark_boot_stage(BOOT_STAGE_TASKS);
 }
 
 void loop() {}
 
 void system_task(void *params) {
   SignMode current_sign_mode = read_sign_mode();
-  start_sign(current_sign_mode);
+  boot_network(current_sign_mode);
 
   while (1) {
     UIMessage ui_message;
@@ -243,211 +189,310 @@ void system_task(void *params) {
       // ui message says to change sign mode
       if (ui_message.type == UI_MESSAGE_TYPE_MODE_SHIFT ||
           ui_message.type == UI_MESSAGE_TYPE_MODE_CHANGE) {
+        SignMode next_sign_mode = current_sign_mode;
         if (ui_message.type == UI_MESSAGE_TYPE_MODE_SHIFT) {
-          current_sign_mode = shift_sign_mode(current_sign_mode);
+          next_sign_mode = shift_sign_mode(current_sign_mode);
         } else if (ui_message.type == UI_MESSAGE_TYPE_MODE_CHANGE) {
-          current_sign_mode = ui_message.next_sign_mode;
+          next_sign_mode = ui_message.next_sign_mode;
         }
-        write_sign_mode(current_sign_mode);
-        Serial.println("Rebooting ESP32");
-        ESP.restart();
+        write_sign_mode(next_sign_mode);
+        switch_sign_mode(current_sign_mode, next_sign_mode);
+        current_sign_mode = next_sign_mode;
       } else if (ui_message.type == UI_MESSAGE_TYPE_MBTA_CHANGE_STATION) {
         Serial.printf("updating mbta station to %s\n",
                       train_station_to_str(ui_message.next_station));
         mbta.set_station(ui_message.next_station);
         if (current_sign_mode == SIGN_MODE_MBTA) {
           RenderMessage message;
-          message.type = RENDER_TYPE_MBTA;
-          message.content.mbta.status =
-              PREDICTION_STATUS_OK_SHOW_STATION_BANNER;
-          strcpy(message.content.mbta.predictions[0].label,
-                 train_station_to_str(ui_message.next_station));
-          if (xQueueSend(render_queue, (void *)&message, TEN_MILLIS)) {
+          RenderContent *content =
+              render_mailbox.acquire(RENDER_TYPE_MBTA, &message);
+          if (content) {
+            content->mbta.status = PREDICTION_STATUS_OK_SHOW_STATION_BANNER;
+            strcpy(content->mbta.predictions[0].label,
+                   train_station_to_str(ui_message.next_station));
+            render_mailbox.send(message);
             Serial.println("show updated mbta station on display");
           }
           // manually request a new MBTA frame
           mbta_provider_timer(mbta_provider_timer_handle);
         }
+      } else if (ui_message.type == UI_MESSAGE_TYPE_MBTA_SET_STREAMING) {
+        Serial.printf("%s mbta predictions\n",
+                      ui_message.mbta_streaming ? "streaming" : "polling for");
+        preferences.putInt(MBTA_STREAMING_KEY, ui_message.mbta_streaming);
+        mbta.set_streaming(ui_message.mbta_streaming);
       }
     }
     vTaskDelay(TEN_MILLIS);
   }
 }
 
+// Renders the newest content of each type that arrived since the last frame,
+// then advances the running animations. Animations are evaluated here, once
+// per frame, so they move at the refresh rate. Content is rendered in place
+// in the mailbox's pool and released right after.
 void render_task(void *params) {
   TickType_t last_wake_time;
   last_wake_time = xTaskGetTickCount();
   while (1) {
     vTaskDelayUntil(&last_wake_time, REFRESH_RATE);
     RenderMessage message;
-    if (xQueueReceive(render_queue, &message, TEN_MILLIS)) {
-      if (message.type == RENDER_TYPE_MBTA) {
-        display.render_mbta_content(message.content.mbta);
-      } else if (message.type == RENDER_TYPE_TEXT) {
-        display.render_text_content(message.content.text);
-      } else if (message.type == RENDER_TYPE_MUSIC) {
-        display.render_music_content(message.content.music);
-      } else if (message.type == RENDER_TYPE_ANIMATION) {
-        display.render_animation_content(message.content.animation);
-      } else if (message.type == RENDER_TYPE_CANVAS_TO_DISPLAY) {
-        display.render_canvas_to_display();
-      }
+    bool rendered = false;
+    if (render_mailbox.receive(RENDER_TYPE_MBTA, &message)) {
+      display.render_mbta_content(render_mailbox.get_content(message).mbta);
+      render_mailbox.release(message);
+      rendered = true;
+    }
+    if (render_mailbox.receive(RENDER_TYPE_TEXT, &message)) {
+      display.render_text_content(render_mailbox.get_content(message).text);
+      render_mailbox.release(message);
+      rendered = true;
+    }
+    if (render_mailbox.receive(RENDER_TYPE_MUSIC, &message)) {
+      display.render_music_content(render_mailbox.get_content(message).music);
+      render_mailbox.release(message);
+      rendered = true;
+    }
+    if (render_mailbox.receive(RENDER_TYPE_ANIMATION, &message)) {
+      display.render_animation_content(
+          render_mailbox.get_content(message).animation);
+      render_mailbox.release(message);
+      rendered = true;
+    }
+    display.render_music_progress(last_wake_time * portTICK_PERIOD_MS);
+    display.render_album_image();
+    display.render_animations(last_wake_time * portTICK_PERIOD_MS);
+    if (rendered && !boot_stats.reached[BOOT_STAGE_FIRST_FRAME]) {
+      mark_boot_stage(BOOT_STAGE_FIRST_FRAME);
     }
   }
 }
 
-void test_provider_task(void *params) {
+// The text never changes, so it is sent once and the coroutine waits to be
+// stopped
+bool test_coroutine(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  send_test_text();
+  CO_WAIT_EVENTS(co, 0);
+  CO_END(co);
+}
+
+void send_test_text() {
   char test_text[] =
       "0123456789\n"
       "abcdefghijklmnopqrstuvwxyz\n"
       "ABCDEFGHIJKLMNOPQRSTUVWXYZ\n";
-  while (1) {
-    ProviderRequest request;
-    if (xQueuePeek(provider_queue, &request, TEN_MILLIS)) {
-      if (request.sign_mode == SIGN_MODE_TEST) {
-        xQueueReceive(provider_queue, &request, TEN_MILLIS);
-        RenderMessage message;
-        message.type = RENDER_TYPE_TEXT;
-        strcpy(message.content.text.text, test_text);
-        if (xQueueSend(render_queue, &message, TEN_MILLIS)) {
-          Serial.println("sending test render_message to render_queue");
-        }
-      }
+  RenderMessage message;
+  RenderContent *content = render_mailbox.acquire(RENDER_TYPE_TEXT, &message);
+  if (content) {
+    strcpy(content->text.text, test_text);
+    render_mailbox.send(message);
+    Serial.println("sending test render_message to render_mailbox");
+  }
+}
+
+// Runs the MBTA or the music provider, whichever sign mode co->state is,
+// a tick each time its timer wakes it. The executor waits on the engine's
+// connections meanwhile, so a response is handled as soon as it is in, and
+// the requests of a tick overlap.
+bool network_coroutine(lms::Coroutine *co) {
+  SignMode sign_mode = (SignMode)(intptr_t)co->state;
+  CO_BEGIN(co);
+  while (true) {
+    if (sign_mode == SIGN_MODE_MBTA) {
+      // new predictions are shown without waiting for the next tick
+      CO_WAIT_EVENTS(co, co->event | EXECUTOR_EVENT_ENGINE);
+      mbta_provider_tick();
+    } else {
+      CO_WAIT_EVENTS(co, co->event);
+      music_provider_tick();
     }
-    vTaskDelay(100 / portTICK_PERIOD_MS);
   }
+  CO_END(co);
 }
 
-void mbta_provider_task(void *params) {
-  while (1) {
-    ProviderRequest request;
-    if (xQueuePeek(provider_queue, &request, TEN_MILLIS)) {
-      if (request.sign_mode == SIGN_MODE_MBTA) {
-        xQueueReceive(provider_queue, &request, TEN_MILLIS);
-        RenderMessage message;
-        message.type = RENDER_TYPE_MBTA;
-        // Two predictions, one for southbound trains and one for northbound
-        // trains
-        Prediction predictions[2];
-        PredictionStatus status =
-            mbta.get_predictions_both_directions(predictions);
-        message.content.mbta.status = status;
-        if (status == PREDICTION_STATUS_OK ||
-            status == PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_1 ||
-            status == PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_2 ||
-            status == PREDICTION_STATUS_OK_SHOW_STATION_BANNER) {
-          message.content.mbta.predictions[0] = predictions[0];
-          message.content.mbta.predictions[1] = predictions[1];
-        } else if (status == PREDICTION_STATUS_ERROR_SHOW_CACHED) {
-          mbta.get_cached_predictions(message.content.mbta.predictions);
-        } else {
-          mbta.get_placeholder_predictions(message.content.mbta.predictions);
-        }
-        if (xQueueSend(render_queue, &message, TEN_MILLIS)) {
-          Serial.println("sending mbta render_message to render_queue");
-          print_ram_info();
-        }
-      }
+// What the sign shows of the MBTA. A station of TRAIN_STATION_MAX has the next
+// tick render, as when the provider starts.
+MBTARenderContent mbta_shown;
+TrainStation mbta_shown_station = TRAIN_STATION_MAX;
+// The predictions saved before the sign restarted are on the panel, until
+// this millis at most
+bool mbta_showing_saved = false;
+uint32_t mbta_saved_until_ms;
+
+// Runs every second, so the countdown follows the clock. A frame is only
+// rendered when what the sign shows changes.
+void mbta_provider_tick() {
+  // Two predictions, one for southbound trains and one for northbound trains
+  MBTARenderContent next;
+  next.status = mbta.get_predictions_both_directions(next.predictions);
+  if (next.status == PREDICTION_STATUS_ERROR_SHOW_CACHED) {
+    mbta.get_cached_predictions(next.predictions);
+  } else if (next.status != PREDICTION_STATUS_OK &&
+             next.status != PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_1 &&
+             next.status != PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_2 &&
+             next.status != PREDICTION_STATUS_OK_SHOW_STATION_BANNER) {
+    mbta.get_placeholder_predictions(next.predictions);
+  }
+  if (next.status == PREDICTION_STATUS_OK) {
+    last_known.save_predictions(mbta.get_station(), next.predictions);
+  }
+  last_known.flush(millis());
+  // placeholders would replace the saved predictions before the first answer
+  if (mbta_showing_saved) {
+    bool answered = next.status != PREDICTION_STATUS_ERROR_SHOW_CACHED &&
+                    next.status != PREDICTION_STATUS_ERROR &&
+                    next.status != PREDICTION_STATUS_ERROR_EMPTY;
+    if (!answered && (int32_t)(millis() - mbta_saved_until_ms) < 0) {
+      return;
+    }
+    mbta_showing_saved = false;
+  }
+  if (mbta_shown_station != mbta.get_station() ||
+      !mbta_content_equal(next, mbta_shown)) {
+    RenderMessage message;
+    RenderContent *content = render_mailbox.acquire(RENDER_TYPE_MBTA, &message);
+    if (content) {
+      content->mbta = next;
+      render_mailbox.send(message);
+      mbta_shown = next;
+      mbta_shown_station = mbta.get_station();
+      Serial.println("sending mbta render_message to render_mailbox");
     }
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+    print_ram_info();
   }
 }
 
-void clock_provider_task(void *params) {
-  TickType_t last_wake_time;
-  last_wake_time = xTaskGetTickCount();
-  while (1) {
-    vTaskDelayUntil(&last_wake_time, REFRESH_RATE);
-    ProviderRequest request;
-    if (xQueuePeek(provider_queue, &request, TEN_MILLIS)) {
-      if (request.sign_mode == SIGN_MODE_CLOCK) {
-        xQueueReceive(provider_queue, &request, TEN_MILLIS);
-        RenderMessage message;
-        message.type = RENDER_TYPE_TEXT;
-        struct tm timeinfo;
-        getLocalTime(&timeinfo);
-        strftime(message.content.text.text, 128, "%A, %B %d %Y\n%H:%M:%S",
-                 &timeinfo);
-        if (xQueueSend(render_queue, &message, TEN_MILLIS)) {
-          Serial.println("sending clock render_message to render_queue");
-        }
-      }
+bool mbta_content_equal(const MBTARenderContent &a,
+                        const MBTARenderContent &b) {
+  if (a.status != b.status) {
+    return false;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (strcmp(a.predictions[i].label, b.predictions[i].label) != 0 ||
+        strcmp(a.predictions[i].value, b.predictions[i].value) != 0) {
+      return false;
     }
   }
+  return true;
 }
 
-void music_provider_task(void *params) {
-  TickType_t last_wake_time;
-  last_wake_time = xTaskGetTickCount();
-  while (1) {
-    vTaskDelayUntil(&last_wake_time, REFRESH_RATE);
-    ProviderRequest request;
-    if (xQueuePeek(provider_queue, &request, TEN_MILLIS)) {
-      if (request.sign_mode == SIGN_MODE_MUSIC) {
-        xQueueReceive(provider_queue, &request, TEN_MILLIS);
-        RenderMessage message;
-        message.type = RENDER_TYPE_MUSIC;
-        CurrentlyPlaying currently_playing;
-        SpotifyResponse status =
-            spotify.get_currently_playing(&currently_playing);
-        message.content.music.status = status;
-        if (status == SPOTIFY_RESPONSE_OK) {
-          if (spotify.is_current_song_new(&currently_playing)) {
-            // new song is playing. Update animations to show new info
-            display.animations.stop_music_animations();
-            display.animations.start_music_animations(currently_playing);
-            spotify.update_current_song(&currently_playing);
-            // fetch new album cover
-            Serial.println("fetch new album cover");
-            status = spotify.get_album_cover(&currently_playing);
-            if (status == SPOTIFY_RESPONSE_OK) {
-              TJpgDec.drawJpg(0, 0, spotify.album_cover_jpg,
-                              ALBUM_COVER_IMG_BUF_SIZE);
-            }
-          }
-          message.content.music.data = currently_playing;
-        } else if (status == SPOTIFY_RESPONSE_OK_SHOW_CACHED) {
-          // If nothing is playing but we still have the last song in memory,
-          // let's keep showing that song
-          message.content.music.data = spotify.get_current_song();
-        } else {
-          display.animations.stop_music_animations();
-          spotify.clear_current_song();
-        }
-        if (xQueueSend(render_queue, &message, TEN_MILLIS)) {
-          Serial.println("sending music render_message to render_queue");
-        }
+bool clock_coroutine(lms::Coroutine *co) {
+  CO_BEGIN(co);
+  while (true) {
+    CO_WAIT_EVENTS(co, co->event);
+    send_clock_text();
+  }
+  CO_END(co);
+}
+
+void send_clock_text() {
+  RenderMessage message;
+  RenderContent *content = render_mailbox.acquire(RENDER_TYPE_TEXT, &message);
+  if (content) {
+    struct tm timeinfo;
+    getLocalTime(&timeinfo);
+    strftime(content->text.text, 128, "%A, %B %d %Y\n%H:%M:%S", &timeinfo);
+    render_mailbox.send(message);
+    Serial.println("sending clock render_message to render_mailbox");
+  }
+}
+
+// Runs every second, but only asks Spotify for what is playing when a poll is
+// due. The render task moves the progress on in between.
+void music_provider_tick() {
+  uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  if (spotify.is_poll_due(now_ms)) {
+    spotify.request_currently_playing(show_currently_playing);
+  }
+  last_known.flush(millis());
+}
+
+// Covers are left to the cover task: the cover of a new song is requested
+// and the song is rendered right away. The cover of the next song in the
+// queue is requested before the current song ends, so that it is ready when
+// the song starts.
+void show_currently_playing(SpotifyResponse status, CurrentlyPlaying *song) {
+  uint32_t now_ms = song->timestamp_ms;
+  CurrentlyPlaying currently_playing = *song;
+  if (status == SPOTIFY_RESPONSE_OK) {
+    if (spotify.is_current_song_new(&currently_playing)) {
+      cover_loader.request(COVER_REQUEST_SHOW, currently_playing.cover);
+      last_known.save_song(currently_playing);
+      // new song is playing. Update animations to show new info
+      RenderMessage animation_message;
+      RenderContent *animation_content =
+          render_mailbox.acquire(RENDER_TYPE_ANIMATION, &animation_message);
+      if (animation_content) {
+        animation_content->animation.action = ANIMATION_ACTION_START_MUSIC;
+        animation_content->animation.song = currently_playing;
+        render_mailbox.send(animation_message);
       }
     }
+    spotify.update_current_song(&currently_playing);
+    if (spotify.is_next_song_due(now_ms) &&
+        spotify.request_next_song(prefetch_next_cover)) {
+      Serial.println("prefetch album cover of the next song");
+    }
+  } else if (status == SPOTIFY_RESPONSE_OK_SHOW_CACHED) {
+    // If nothing is playing but we still have the last song in memory,
+    // let's keep showing that song, stopped where it was
+    currently_playing = spotify.get_current_song();
+    currently_playing.progress_ms = get_progress_ms(&currently_playing, now_ms);
+    currently_playing.timestamp_ms = now_ms;
+    currently_playing.is_playing = false;
+  } else {
+    RenderMessage animation_message;
+    RenderContent *animation_content =
+        render_mailbox.acquire(RENDER_TYPE_ANIMATION, &animation_message);
+    if (animation_content) {
+      animation_content->animation.action = ANIMATION_ACTION_STOP_MUSIC;
+      render_mailbox.send(animation_message);
+    }
+    spotify.clear_current_song();
+  }
+  RenderMessage message;
+  RenderContent *content = render_mailbox.acquire(RENDER_TYPE_MUSIC, &message);
+  if (content) {
+    content->music.status = status;
+    content->music.data = currently_playing;
+    render_mailbox.send(message);
+    Serial.println("sending music render_message to render_mailbox");
   }
 }
 
-void mbta_provider_timer(TimerHandle_t timer) {
-  // Request new render messages from the appropriate provider
-  ProviderRequest request{SIGN_MODE_MBTA};
-  if (xQueueSend(provider_queue, (void *)&request, TEN_MILLIS)) {
-    Serial.println("sending mbta provider_request to provider_queue");
+void prefetch_next_cover(SpotifyResponse status, CurrentlyPlaying *song) {
+  if (status == SPOTIFY_RESPONSE_OK) {
+    cover_loader.request(COVER_REQUEST_PREFETCH, song->cover);
   }
 }
 
-void clock_provider_timer(TimerHandle_t timer) {
-  // Request new render messages from the appropriate provider
-  ProviderRequest request{SIGN_MODE_CLOCK};
-  if (xQueueSend(provider_queue, (void *)&request, TEN_MILLIS)) {
-    Serial.println("sending clock provider_request to provider_queue");
+// Loads the covers the music provider asks for, one at a time, and hands
+// them to the render task. A cover that is not cached is downloaded and
+// decoded here, off the provider executor, so that the music poll and the
+// engine's requests go on meanwhile.
+void cover_task(void *params) {
+  while (!cover_task_stopping) {
+    // stop_music wakes it
+    cover_loader.process(portMAX_DELAY);
   }
+  cover_task_handle = NULL;
+  vTaskDelete(NULL);
 }
 
-void music_provider_timer(TimerHandle_t timer) {
-  // Request new render messages from the appropriate provider
-  ProviderRequest request{SIGN_MODE_MUSIC};
-  if (xQueueSend(provider_queue, (void *)&request, TEN_MILLIS)) {
-    Serial.println("sending music provider_request to provider_queue");
-  }
+void mbta_provider_timer(TimerHandle_t timer) {
+  // Wake the provider's coroutine to render
+  provider_executor.wake(network_coroutine_handle);
 }
 
-void animation_timer(TimerHandle_t timer) {
-  display.animations.draw(render_queue);
+void clock_provider_timer(TimerHandle_t timer) {
+  // Wake the provider's coroutine to render
+  provider_executor.wake(clock_coroutine_handle);
+}
+
+void music_provider_timer(TimerHandle_t timer) {
+  // Wake the provider's coroutine to render
+  provider_executor.wake(network_coroutine_handle);
 }
 
 void button_tapped(Button2 &btn) {
@@ -484,39 +529,249 @@ int write_sign_mode(SignMode sign_mode) {
   return 1;
 }
 
-void start_sign(SignMode current_sign_mode) {
-  if (current_sign_mode == SIGN_MODE_MBTA) {
-    if (xTimerReset(mbta_provider_timer_handle, TEN_MILLIS)) {
-      Serial.println("starting mbta provider timer");
+// Brings up what the provider of sign_mode needs while its first frame is
+// shown: WiFi, then the clock and a connection to the provider's API at
+// once, then the provider. Runs on the system task before it takes UI
+// messages, which wait in their queue meanwhile. It polls the HTTP engine
+// until the provider's network task takes it over.
+void boot_network(SignMode sign_mode) {
+  bool wifi = false;
+  bool time_synced = false;
+  bool warmed_up = providers[sign_mode].warm_up == NULL;
+  while (!wifi || !time_synced || !warmed_up) {
+    if (!wifi && WiFi.status() == WL_CONNECTED) {
+      wifi = true;
+      mark_boot_stage(BOOT_STAGE_WIFI);
+      Serial.println(WiFi.localIP());
+      Serial.print("RRSI: ");
+      Serial.println(WiFi.RSSI());
+      start_time_sync();
+      server.setup(sign_mode, ui_queue);
+      if (!warmed_up) {
+        providers[sign_mode].warm_up();
+      }
     }
-    // Send placeholder predictions while we wait for the real ones
-    RenderMessage message;
-    message.type = RENDER_TYPE_MBTA;
-    message.content.mbta.status = PREDICTION_STATUS_OK;
-    mbta.get_placeholder_predictions(
-        (Prediction *)&message.content.mbta.predictions);
-    xQueueSend(render_queue, (void *)&message, TEN_MILLIS);
-    // jumpstart timer
-    mbta_provider_timer(NULL);
-  } else if (current_sign_mode == SIGN_MODE_CLOCK) {
-    if (xTimerReset(clock_provider_timer_handle, TEN_MILLIS)) {
-      Serial.println("starting clock provider timer");
+    if (wifi && !time_synced && check_time_synced()) {
+      time_synced = true;
+      mark_boot_stage(BOOT_STAGE_TIME);
     }
-  } else if (current_sign_mode == SIGN_MODE_MUSIC) {
-    // Send placeholder music info while we wait for the real info
-    RenderMessage message;
-    message.type = RENDER_TYPE_MUSIC;
-    sprintf(message.content.text.text, "Nothing is playing");
-    xQueueSend(render_queue, (void *)&message, TEN_MILLIS);
-    if (xTimerReset(music_provider_timer_handle, TEN_MILLIS)) {
-      Serial.println("starting music provider timer");
+    // the handshake goes on while the clock syncs
+    http_engine.poll(10);
+    if (wifi && !warmed_up && http_engine.pending() == 0) {
+      warmed_up = true;
+      mark_boot_stage(BOOT_STAGE_TLS);
     }
   }
+  providers[sign_mode].start();
+  mark_boot_stage(BOOT_STAGE_PROVIDER);
 }
 
-bool draw_jpg_image(int16_t x, int16_t y, uint16_t w, uint16_t h,
-                    uint16_t *data) {
-  if (y >= SCREEN_HEIGHT) return 0;
-  display.image_canvas.drawRGBBitmap(x, y, data, w, h);
-  return 1;
+// Stops the provider of from and starts the one of to. WiFi, the clock, the
+// render task and the engine's TLS sessions are kept, so the sign switches
+// within a few ticks of its providers rather than a reboot.
+void switch_sign_mode(SignMode from, SignMode to) {
+  uint32_t start_ms = millis();
+  providers[from].stop();
+  if (providers[to].first_frame) {
+    providers[to].first_frame();
+  }
+  providers[to].start();
+  uint32_t elapsed_ms = millis() - start_ms;
+  mode_switch_stats.switches++;
+  mode_switch_stats.last_ms = elapsed_ms;
+  mode_switch_stats.max_ms = max(mode_switch_stats.max_ms, elapsed_ms);
+  Serial.printf("switched from %s to %s in %u ms\n", sign_mode_to_str(from),
+                sign_mode_to_str(to), elapsed_ms);
+  print_ram_info();
+}
+
+// Runs the coroutines the provider spawned. The executor's task gets the
+// largest stack they need, rather than a task and a stack each. stop() ends
+// it between two resumes, so no coroutine is stopped in the middle of a
+// request or holding a mailbox slot.
+void start_provider_executor() {
+  provider_executor.start("provider_task",
+                          1,  // task priority
+                          ESP32_CORE_0);
+  lms::ExecutorFootprint footprint = provider_executor.get_footprint();
+  Serial.printf("providers: %u coroutines on a %u B stack, %u B as tasks\n",
+                footprint.coroutines, footprint.stack_bytes,
+                footprint.task_stack_bytes);
+}
+
+void start_test() {
+  provider_executor.spawn("test", test_coroutine,
+                          2048);  // stack size as a task
+  start_provider_executor();
+}
+
+void stop_test() {
+  provider_executor.stop();
+  render_mailbox.discard(RENDER_TYPE_TEXT);
+}
+
+void start_mbta() {
+  mbta.setup();
+  mbta.use_engine(&http_engine);
+  mbta.set_streaming(preferences.getInt(MBTA_STREAMING_KEY, 0) == 1);
+  mbta_shown_station = TRAIN_STATION_MAX;
+  // the countdown is refreshed every second, MBTA decides when to request
+  mbta_provider_timer_handle =
+      xTimerCreate("mbta_provider_timer",
+                   1000 / portTICK_PERIOD_MS,  // timer interval in millisec
+                   true,  // is an autoreload timer (repeats periodically)
+                   NULL, mbta_provider_timer);
+  network_coroutine_handle = provider_executor.spawn(
+      "network", network_coroutine,
+      8192,  // stack size as a task
+      (void *)(intptr_t)SIGN_MODE_MBTA);
+  start_provider_executor();
+  if (xTimerReset(mbta_provider_timer_handle, TEN_MILLIS)) {
+    Serial.println("starting mbta provider timer");
+  }
+  // jumpstart timer
+  mbta_provider_timer(NULL);
+}
+
+// The predictions saved before the sign restarted, marked as cached, or
+// placeholders while we wait for the real ones
+void show_mbta_first_frame() {
+  RenderMessage message;
+  RenderContent *content = render_mailbox.acquire(RENDER_TYPE_MBTA, &message);
+  if (content) {
+    mbta_showing_saved = last_known.get_predictions(
+        mbta.get_station(), content->mbta.predictions);
+    if (mbta_showing_saved) {
+      content->mbta.status = PREDICTION_STATUS_ERROR_SHOW_CACHED;
+      mbta_saved_until_ms = millis() + LAST_KNOWN_HOLD_MS;
+      Serial.println("showing the saved predictions");
+    } else {
+      content->mbta.status = PREDICTION_STATUS_OK;
+      mbta.get_placeholder_predictions(content->mbta.predictions);
+    }
+    render_mailbox.send(message);
+  }
+}
+
+void warm_up_mbta() { mbta.warm_up(&http_engine); }
+
+void stop_mbta() {
+  xTimerDelete(mbta_provider_timer_handle, TEN_MILLIS);
+  mbta_provider_timer_handle = NULL;
+  provider_executor.stop();
+  // the requests left in the engine would answer into a torn down MBTA
+  http_engine.cancel();
+  mbta.teardown();
+  mbta_showing_saved = false;
+  last_known.flush(millis(), true);
+  render_mailbox.discard(RENDER_TYPE_MBTA);
+}
+
+void start_clock() {
+  clock_provider_timer_handle =
+      xTimerCreate("clock_provider_timer",
+                   REFRESH_RATE,  // timer interval in millisec
+                   true,  // is an autoreload timer (repeats periodically)
+                   NULL, clock_provider_timer);
+  clock_coroutine_handle = provider_executor.spawn(
+      "clock", clock_coroutine,
+      2048);  // stack size as a task
+  start_provider_executor();
+  if (xTimerReset(clock_provider_timer_handle, TEN_MILLIS)) {
+    Serial.println("starting clock provider timer");
+  }
+}
+
+void stop_clock() {
+  xTimerDelete(clock_provider_timer_handle, TEN_MILLIS);
+  clock_provider_timer_handle = NULL;
+  provider_executor.stop();
+  render_mailbox.discard(RENDER_TYPE_TEXT);
+}
+
+void start_music() {
+  spotify.setup();
+  spotify.use_engine(&http_engine);
+  music_provider_timer_handle =
+      xTimerCreate("music_provider_timer",
+                   1000 / portTICK_PERIOD_MS,  // timer interval in millisec
+                   true,  // is an autoreload timer (repeats periodically)
+                   NULL, music_provider_timer);
+  network_coroutine_handle = provider_executor.spawn(
+      "network", network_coroutine,
+      8192,  // stack size as a task
+      (void *)(intptr_t)SIGN_MODE_MUSIC);
+  start_provider_executor();
+  xTaskCreatePinnedToCore(cover_task, "cover_task",
+                          COVER_LOADER_STACK_SIZE,  // stack size
+                          NULL,                     // task parameters
+                          1,                        // task priority
+                          &cover_task_handle, ESP32_CORE_0);
+  Serial.printf("covers: a task of their own, on a %u B stack\n",
+                COVER_LOADER_STACK_SIZE);
+  if (xTimerReset(music_provider_timer_handle, TEN_MILLIS)) {
+    Serial.println("starting music provider timer");
+  }
+}
+
+// The song saved before the sign restarted, paused and with its cover, or
+// placeholder music info while we wait for the real info
+void show_music_first_frame() {
+  CurrentlyPlaying song;
+  bool saved = last_known.get_song(&song);
+  RenderMessage message;
+  RenderContent *content = render_mailbox.acquire(RENDER_TYPE_MUSIC, &message);
+  if (content) {
+    if (saved) {
+      song.is_playing = false;
+      song.timestamp_ms = millis();
+      content->music.status = SPOTIFY_RESPONSE_OK_SHOW_CACHED;
+      content->music.data = song;
+    } else {
+      // drawn as "Nothing is playing"
+      content->music.status = SPOTIFY_RESPONSE_EMPTY;
+    }
+    render_mailbox.send(message);
+  }
+  if (!saved) {
+    return;
+  }
+  Serial.println("showing the saved song");
+  content = render_mailbox.acquire(RENDER_TYPE_ANIMATION, &message);
+  if (content) {
+    content->animation.action = ANIMATION_ACTION_START_MUSIC;
+    content->animation.song = song;
+    render_mailbox.send(message);
+  }
+  // the cover task is not running yet
+  cover_loader.show_saved(song.cover);
+}
+
+void warm_up_music() { spotify.warm_up(&http_engine); }
+
+void stop_music() {
+  xTimerDelete(music_provider_timer_handle, TEN_MILLIS);
+  music_provider_timer_handle = NULL;
+  provider_executor.stop();
+  // a cover being fetched is finished first
+  cover_task_stopping = true;
+  cover_loader.wake();
+  while (cover_task_handle != NULL) {
+    vTaskDelay(TEN_MILLIS);
+  }
+  cover_task_stopping = false;
+  // the requests left in the engine would answer into a torn down Spotify
+  http_engine.cancel();
+  spotify.teardown();
+  last_known.flush(millis(), true);
+  render_mailbox.discard(RENDER_TYPE_MUSIC);
+  render_mailbox.discard(RENDER_TYPE_ANIMATION);
+  // the song's text would otherwise scroll on over the next mode
+  RenderMessage message;
+  RenderContent *content =
+      render_mailbox.acquire(RENDER_TYPE_ANIMATION, &message);
+  if (content) {
+    content->animation.action = ANIMATION_ACTION_STOP_MUSIC;
+    render_mailbox.send(message);
+  }
 }
@@ -2,10 +2,48 @@
 
 namespace lms {
 
-void Client::setup(int json_doc_size) {
-  this->data = new DynamicJsonDocument(json_doc_size);
-  this->wifi_client = new WiFiClientSecure;
+void Client::setup() {
+  this->wifi_client = new TlsClient;
+  this->engine = NULL;
+  this->encoding_stats = {};
 }
 
+void Client::teardown() {
+  // without reuse, end() closes the connection and lets go of the client
+  this->http_client.setReuse(false);
+  this->http_client.end();
+  this->http_client.setReuse(true);
+  delete this->wifi_client;
+  this->wifi_client = NULL;
+  this->engine = NULL;
+}
+
+void Client::use_engine(HttpEngine *engine) { this->engine = engine; }
+
+TlsStats Client::get_tls_stats() { return this->wifi_client->get_stats(); }
+
+EncodingStats Client::get_encoding_stats() { return this->encoding_stats; }
+
+void Client::accept_gzip(HTTPClient &http) {
+  static const char *headers[] = {"Content-Encoding"};
+  http.addHeader("Accept-Encoding", "gzip");
+  http.collectHeaders(headers, 1);
+}
+
+bool Client::is_gzipped(HTTPClient &http) {
+  return http.header("Content-Encoding") == "gzip";
+}
+
+bool Client::extract_json(Stream &stream, const char *const fields[],
+                          int num_fields, const JsonFieldHandler &handler) {
+  JsonExtractor extractor(fields, num_fields);
+  JsonStatus status = extractor.extract(stream, handler);
+  if (status != JSON_STATUS_OK) {
+    Serial.print(F("extracting json failed: "));
+    Serial.println(json_status_to_str(status));
+    return false;
+  }
+  return true;
+}
 
 } /* namespace lms */
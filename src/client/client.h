@@ -1,7 +1,11 @@
-#include <ArduinoJson.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
 
+#include "http-engine.h"
+#include "json.h"
+#include "response-body.h"
+#include "tls.h"
+
 #ifndef LMS_CLIENT_H
 #define LMS_CLIENT_H
 
@@ -9,12 +13,32 @@ namespace lms {
 
 class Client {
  protected:
-  DynamicJsonDocument *data;
-  WiFiClientSecure *wifi_client;
+  TlsClient *wifi_client;
   HTTPClient http_client;
+  // Requests the client can make without blocking go through it, if set
+  HttpEngine *engine;
+  EncodingStats encoding_stats;
+
+  // Streams a JSON response body through the extractor for fields, handing
+  // each value found to handler.
+  bool extract_json(Stream &stream, const char *const fields[], int num_fields,
+                    const JsonFieldHandler &handler);
+  // Asks for the next response of http to come gzipped, if the server will.
+  // Its body is then read through a ResponseBody.
+  void accept_gzip(HTTPClient &http);
+  static bool is_gzipped(HTTPClient &http);
 
  public:
-  void setup(int json_doc_size);
+  void setup();
+  // Closes the connection and frees what setup() allocated
+  void teardown();
+  // From here on, the requests that can go through engine do, and are
+  // answered on the task that polls it.
+  void use_engine(HttpEngine *engine);
+  // The handshakes of the client's own connections. Those of the requests
+  // that go through the engine are counted in HttpEngineStats.
+  TlsStats get_tls_stats();
+  EncodingStats get_encoding_stats();
 };
 
 } /* namespace lms */
@@ -0,0 +1,1125 @@
+#include "http-engine.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <lwip/dns.h>
+#include <strings.h>
+
+#ifdef LMS_HOST_BUILD
+#include <host.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace lms {
+
+int HttpBody::available() {
+  return this->engine->body_available(this->connection);
+}
+
+int HttpBody::read() {
+  uint8_t c;
+  return this->readBytes(&c, 1) ? c : -1;
+}
+
+bool HttpBody::gzipped() {
+  return this->connection >= 0 &&
+         this->engine->connections[this->connection].gzipped;
+}
+
+size_t HttpBody::readBytes(uint8_t *buffer, size_t length) {
+  return this->engine->body_read(this->connection, buffer, length);
+}
+
+HttpEngine::HttpEngine()
+    : order(0),
+      stats{},
+      sessions(new TlsSessionCache(HTTP_ENGINE_TLS_SESSIONS)) {
+  for (Request &request : this->requests) {
+    request.used = false;
+  }
+  for (Connection &connection : this->connections) {
+    connection.state = STATE_CLOSED;
+    connection.socket = -1;
+    connection.request = -1;
+    connection.tls_context = NULL;
+  }
+  for (Address &address : this->addresses) {
+    address.host[0] = '\0';
+    address.last_used = 0;
+    address.state = ADDRESS_NONE;
+  }
+  this->body.engine = this;
+  this->body.connection = -1;
+  // the network is not up yet, the first poll() opens them
+  this->wake_opened = false;
+  this->wake_socket = -1;
+  this->wake_sender = -1;
+  this->wake_port = 0;
+}
+
+HttpEngine::~HttpEngine() {
+  for (Connection &connection : this->connections) {
+    this->close(&connection);
+  }
+  if (this->wake_socket >= 0) {
+    ::close(this->wake_socket);
+  }
+  if (this->wake_sender >= 0) {
+    ::close(this->wake_sender);
+  }
+  delete this->sessions;
+}
+
+// Puts the request together as it is sent, so that one that does not fit
+// is turned down here rather than once it is on a connection.
+bool HttpEngine::submit(const HttpEngineRequest &request,
+                        HttpResponseHandler handler) {
+  Request *queued = NULL;
+  for (Request &slot : this->requests) {
+    if (!slot.used) {
+      queued = &slot;
+      break;
+    }
+  }
+  const char *scheme_end = strstr(request.url, "://");
+  if (!queued || !scheme_end) {
+    this->stats.rejected++;
+    return false;
+  }
+  queued->tls = scheme_end - request.url == 5 &&
+                strncmp(request.url, "https", 5) == 0;
+  queued->port = queued->tls ? 443 : 80;
+  const char *host = scheme_end + 3;
+  const char *path = strchr(host, '/');
+  size_t host_length = path ? path - host : strlen(host);
+  if (!path) {
+    path = "/";
+  }
+  const char *colon = (const char *)memchr(host, ':', host_length);
+  if (colon) {
+    queued->port = atoi(colon + 1);
+    host_length = colon - host;
+  }
+  if (host_length >= sizeof(queued->host)) {
+    this->stats.rejected++;
+    return false;
+  }
+  memcpy(queued->host, host, host_length);
+  queued->host[host_length] = '\0';
+
+  int length = 0;
+  if (request.method) {
+    length = snprintf(queued->text, sizeof(queued->text),
+                      "%s %s HTTP/1.1\r\n"
+                      "Host: %.*s\r\n"
+                      "%s",
+                      request.method, path, (int)host_length, host,
+                      request.headers ? request.headers : "");
+    if (length >= 0 && length < (int)sizeof(queued->text)) {
+      size_t room = sizeof(queued->text) - length;
+      int end = request.body
+                    ? snprintf(queued->text + length, room,
+                               "Content-Length: %u\r\n"
+                               "\r\n"
+                               "%s",
+                               (unsigned)strlen(request.body), request.body)
+                    : snprintf(queued->text + length, room, "\r\n");
+      length = end < 0 ? end : length + end;
+    }
+  }
+  if (length < 0 || length >= (int)sizeof(queued->text)) {
+    this->stats.rejected++;
+    return false;
+  }
+  queued->length = length;
+
+  queued->used = true;
+  queued->started = false;
+  queued->order = this->order++;
+  queued->deadline = millis() + request.timeout_ms;
+  queued->priority = request.priority;
+  queued->head = request.method && strcmp(request.method, "HEAD") == 0;
+  queued->ca_cert = request.ca_cert;
+  queued->handler = handler;
+  this->stats.submitted++;
+  return true;
+}
+
+bool HttpEngine::preconnect(const char *url, const char *ca_cert,
+                            uint32_t timeout_ms) {
+  HttpEngineRequest request = {
+      NULL, url, NULL, NULL, ca_cert, HTTP_PRIORITY_HIGH, timeout_ms};
+  return this->submit(request, [](int code, HttpBody &body) {});
+}
+
+int HttpEngine::pending() {
+  int count = 0;
+  for (const Request &request : this->requests) {
+    count += request.used;
+  }
+  return count;
+}
+
+HttpEngineStats HttpEngine::get_stats() { return this->stats; }
+
+void HttpEngine::cancel() {
+  for (Connection &connection : this->connections) {
+    this->close(&connection);
+  }
+  for (Request &request : this->requests) {
+    request.used = false;
+    request.handler = nullptr;
+  }
+}
+
+int HttpEngine::poll(uint32_t timeout_ms) {
+  if (!this->wake_opened) {
+    this->open_wake();
+  }
+  uint32_t done = this->stats.completed + this->stats.failed;
+  uint32_t now = millis();
+  uint32_t wait_ms = timeout_ms;
+  for (int i = 0; i < HTTP_ENGINE_QUEUE_LENGTH; i++) {
+    Request *request = &this->requests[i];
+    if (!request->used) {
+      continue;
+    }
+    int32_t left = request->deadline - now;
+    if (left > 0) {
+      wait_ms = min(wait_ms, (uint32_t)left);
+      continue;
+    }
+    for (Connection &connection : this->connections) {
+      if (connection.request == i) {
+        this->close(&connection);
+      }
+    }
+    this->stats.failed++;
+    this->stats.timed_out++;
+    this->finish(i, HTTPC_ERROR_READ_TIMEOUT);
+  }
+
+  // starts what the connections have room for
+  int index;
+  int connection;
+  while ((index = this->next_request()) >= 0 &&
+         (connection = this->find_connection(&this->requests[index])) >= 0) {
+    this->start(index, connection);
+  }
+
+  fd_set readable;
+  fd_set writable;
+  FD_ZERO(&readable);
+  FD_ZERO(&writable);
+  int max_socket = -1;
+  uint32_t in_flight = 0;
+  bool resolving = false;
+  for (Connection &connection : this->connections) {
+    State state = connection.state;
+    if (state == STATE_CLOSED || state == STATE_IDLE) {
+      continue;
+    }
+    in_flight++;
+    if (state == STATE_RESOLVING) {
+      resolving = true;
+      continue;
+    }
+    bool write = state == STATE_CONNECTING || state == STATE_SENDING ||
+                 (state == STATE_HANDSHAKING && connection.want_write);
+    FD_SET(connection.socket, write ? &writable : &readable);
+    max_socket = max(max_socket, connection.socket);
+  }
+  this->stats.max_in_flight = max(this->stats.max_in_flight, in_flight);
+  // the lookups answer on the resolver's task, so they are looked at again
+  // every few millis
+  if (resolving) {
+    wait_ms = min(wait_ms, (uint32_t)HTTP_ENGINE_RESOLVE_POLL_MS);
+  }
+  if ((max_socket >= 0 || resolving) && this->wake_socket >= 0) {
+    FD_SET(this->wake_socket, &readable);
+    max_socket = max(max_socket, this->wake_socket);
+  }
+  bool ready = false;
+  if (max_socket >= 0) {
+    struct timeval tv = {(time_t)(wait_ms / 1000),
+                         (suseconds_t)(wait_ms % 1000) * 1000};
+    ready = select(max_socket + 1, &readable, &writable, NULL, &tv) > 0;
+  } else if (resolving) {
+    delay(wait_ms);
+  }
+  if (ready && this->wake_socket >= 0 &&
+      FD_ISSET(this->wake_socket, &readable)) {
+    // wakes sent before this poll are seen along with it
+    uint8_t datagram;
+    while (recv(this->wake_socket, &datagram, 1, 0) > 0) {
+    }
+    this->stats.wakes++;
+  }
+  if (ready || resolving) {
+    for (int i = 0; i < HTTP_ENGINE_MAX_CONNECTIONS; i++) {
+      while (this->step(i)) {
+      }
+    }
+  }
+  // handlers may have queued more
+  while ((index = this->next_request()) >= 0 &&
+         (connection = this->find_connection(&this->requests[index])) >= 0) {
+    this->start(index, connection);
+  }
+  return this->stats.completed + this->stats.failed - done;
+}
+
+void HttpEngine::wake() {
+  int sender = this->wake_sender;
+  if (sender < 0) {
+    return;
+  }
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = this->wake_port;
+  uint8_t datagram = 0;
+  // one already on its way wakes it just as well
+  sendto(sender, &datagram, 1, 0, (struct sockaddr *)&address,
+         sizeof(address));
+}
+
+// Binds wake_socket to a port of the loopback, and opens wake_sender for
+// wake(). Without them, a poll() runs for as long as it was asked.
+void HttpEngine::open_wake() {
+  this->wake_opened = true;
+  int receiver = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  int sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (receiver < 0 || sender < 0 ||
+      bind(receiver, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      getsockname(receiver, (struct sockaddr *)&address, &length) < 0) {
+    if (receiver >= 0) {
+      ::close(receiver);
+    }
+    if (sender >= 0) {
+      ::close(sender);
+    }
+    return;
+  }
+  int flags = fcntl(receiver, F_GETFL, 0);
+  fcntl(receiver, F_SETFL, flags | O_NONBLOCK);
+  flags = fcntl(sender, F_GETFL, 0);
+  fcntl(sender, F_SETFL, flags | O_NONBLOCK);
+  this->wake_socket = receiver;
+  this->wake_port = address.sin_port;
+  // the port is set before wake() can see the sender
+  this->wake_sender = sender;
+}
+
+// The queued request to go next: by priority, then in the order they came
+int HttpEngine::next_request() {
+  int next = -1;
+  for (int i = 0; i < HTTP_ENGINE_QUEUE_LENGTH; i++) {
+    const Request *request = &this->requests[i];
+    if (!request->used || request->started) {
+      continue;
+    }
+    if (next < 0 || request->priority < this->requests[next].priority ||
+        (request->priority == this->requests[next].priority &&
+         (int32_t)(request->order - this->requests[next].order) < 0)) {
+      next = i;
+    }
+  }
+  return next;
+}
+
+// A connection left open to the host, else a closed one, else one left open
+// to another host. -1 if all are busy.
+int HttpEngine::find_connection(const Request *request) {
+  int closed = -1;
+  int idle = -1;
+  for (int i = 0; i < HTTP_ENGINE_MAX_CONNECTIONS; i++) {
+    const Connection *connection = &this->connections[i];
+    if (connection->state == STATE_IDLE) {
+      if (connection->port == request->port &&
+          strcmp(connection->host, request->host) == 0) {
+        return i;
+      }
+      idle = i;
+    } else if (connection->state == STATE_CLOSED) {
+      closed = i;
+    }
+  }
+  if (closed < 0 && idle >= 0) {
+    this->close(&this->connections[idle]);
+    closed = idle;
+  }
+  return closed;
+}
+
+void HttpEngine::start(int index, int connection_index) {
+  Request *request = &this->requests[index];
+  Connection *connection = &this->connections[connection_index];
+  request->started = true;
+  connection->request = index;
+  connection->deadline = request->deadline;
+  connection->sent = 0;
+  connection->buffer_pos = 0;
+  connection->buffer_length = 0;
+  connection->received = false;
+  connection->skipping_line = false;
+  connection->code = 0;
+  connection->chunked = false;
+  connection->keep_alive = false;
+  connection->remaining = -1;
+  connection->gzipped = false;
+  connection->body_done = false;
+
+  if (connection->state == STATE_IDLE) {
+    connection->reused = true;
+    connection->state = STATE_SENDING;
+    this->stats.connections_reused++;
+    if (request->length == 0) {
+      this->opened(connection_index);
+    }
+    return;
+  }
+  connection->reused = false;
+  memcpy(connection->host, request->host, strlen(request->host) + 1);
+  connection->port = request->port;
+  connection->tls = request->tls;
+  this->stats.connections_opened++;
+  // connects at once if the address of the host is known
+  connection->state = STATE_RESOLVING;
+  while (this->step(connection_index)) {
+  }
+}
+
+// The address kept for host, else the least recently used one that is not
+// being looked up, cleared for host. NULL if all of them are.
+HttpEngine::Address *HttpEngine::find_address(const char *host) {
+  Address *found = NULL;
+  for (Address &address : this->addresses) {
+    if (strcmp(address.host, host) == 0) {
+      return &address;
+    }
+    if (address.state != ADDRESS_RESOLVING &&
+        (!found || (int32_t)(address.last_used - found->last_used) < 0)) {
+      found = &address;
+    }
+  }
+  if (found) {
+    memcpy(found->host, host, strlen(host) + 1);
+    found->state = ADDRESS_NONE;
+  }
+  return found;
+}
+
+// Puts the address of host in ip. Returns 1 once it is known, 0 while it is
+// looked up and -1 if the lookup failed. The lookup is the one
+// WiFi.hostByName() makes, without waiting for lwip to answer it.
+int HttpEngine::resolve(const char *host, uint32_t *ip) {
+  Address *address = this->find_address(host);
+  if (!address) {
+    // one is free again once its lookup is answered
+    return 0;
+  }
+  uint32_t now = millis();
+  address->last_used = now;
+  uint8_t state = address->state;
+  if (state == ADDRESS_RESOLVING) {
+    return 0;
+  }
+  if (state == ADDRESS_FAILED) {
+    // the next request looks it up again
+    address->state = ADDRESS_NONE;
+    return -1;
+  }
+  if (state == ADDRESS_RESOLVED &&
+      now - address->resolved_at < HTTP_ENGINE_ADDRESS_TTL) {
+    *ip = address->ip;
+    return 1;
+  }
+  address->state = ADDRESS_RESOLVING;
+  this->stats.lookups++;
+  ip_addr_t found;
+  err_t err = dns_gethostbyname(
+      host, &found,
+      [](const char *name, const ip_addr_t *ipaddr, void *arg) {
+        Address *address = (Address *)arg;
+        if (ipaddr) {
+          address->ip = ip4_addr_get_u32(ip_2_ip4(ipaddr));
+          address->resolved_at = millis();
+        }
+        address->state = ipaddr ? ADDRESS_RESOLVED : ADDRESS_FAILED;
+      },
+      address);
+  if (err == ERR_INPROGRESS) {
+    return 0;
+  }
+  if (err != ERR_OK) {
+    address->state = ADDRESS_NONE;
+    return -1;
+  }
+  // lwip had it cached
+  address->ip = ip4_addr_get_u32(ip_2_ip4(&found));
+  address->resolved_at = now;
+  address->state = ADDRESS_RESOLVED;
+  *ip = address->ip;
+  return 1;
+}
+
+// Drops the address kept for host, as when connecting to it failed
+void HttpEngine::forget_address(const char *host) {
+  for (Address &address : this->addresses) {
+    if (strcmp(address.host, host) == 0 &&
+        address.state == ADDRESS_RESOLVED) {
+      address.state = ADDRESS_NONE;
+    }
+  }
+}
+
+// Starts connecting to ip without waiting for it
+bool HttpEngine::open(Connection *connection, uint32_t ip,
+                      const char *ca_cert) {
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+#ifdef LMS_HOST_BUILD
+  // every host is the stand-in server
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(lms_host::http_server_port());
+#else
+  address.sin_addr.s_addr = ip;
+  address.sin_port = htons(connection->port);
+#endif
+  connection->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (connection->socket < 0) {
+    return false;
+  }
+  int flags = fcntl(connection->socket, F_GETFL, 0);
+  fcntl(connection->socket, F_SETFL, flags | O_NONBLOCK);
+  int enable = 1;
+  setsockopt(connection->socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+             sizeof(enable));
+  int ret = connect(connection->socket, (struct sockaddr *)&address,
+                    sizeof(address));
+  if (ret < 0 && errno != EINPROGRESS) {
+    return false;
+  }
+  connection->state = STATE_CONNECTING;
+  if (connection->tls && !this->start_tls(connection, ca_cert)) {
+    return false;
+  }
+  return true;
+}
+
+void HttpEngine::close(Connection *connection) {
+  this->close_tls(connection);
+  if (connection->socket >= 0) {
+    ::close(connection->socket);
+    connection->socket = -1;
+  }
+  connection->state = STATE_CLOSED;
+  connection->request = -1;
+}
+
+// Moves a connection on as far as it goes without waiting. Returns true if it
+// got to another state, so that it can go on.
+bool HttpEngine::step(int index) {
+  Connection *connection = &this->connections[index];
+  switch (connection->state) {
+    case STATE_RESOLVING: {
+      uint32_t ip = 0;
+      int ret = this->resolve(connection->host, &ip);
+      if (ret == 0) {
+        return false;
+      }
+      const Request *request = &this->requests[connection->request];
+      if (ret < 0 || !this->open(connection, ip, request->ca_cert)) {
+        this->fail(index, HTTPC_ERROR_CONNECTION_REFUSED);
+        return false;
+      }
+      return true;
+    }
+    case STATE_CONNECTING: {
+      fd_set writable;
+      FD_ZERO(&writable);
+      FD_SET(connection->socket, &writable);
+      struct timeval tv = {0, 0};
+      if (select(connection->socket + 1, NULL, &writable, NULL, &tv) <= 0) {
+        return false;
+      }
+      int error = 0;
+      socklen_t length = sizeof(error);
+      if (getsockopt(connection->socket, SOL_SOCKET, SO_ERROR, &error,
+                     &length) < 0 ||
+          error != 0) {
+        // the host may have moved
+        this->forget_address(connection->host);
+        this->fail(index, HTTPC_ERROR_CONNECTION_REFUSED);
+        return false;
+      }
+      connection->want_write = false;
+      connection->state = connection->tls ? STATE_HANDSHAKING : STATE_SENDING;
+      return true;
+    }
+    case STATE_HANDSHAKING: {
+      int ret = this->handshake(connection);
+      if (ret < 0) {
+        this->stats.failed_handshakes++;
+        this->fail(index, HTTPC_ERROR_CONNECTION_REFUSED);
+        return false;
+      }
+      if (ret == 0) {
+        return false;
+      }
+      connection->state = STATE_SENDING;
+      return true;
+    }
+    case STATE_SENDING: {
+      const Request *request = &this->requests[connection->request];
+      if (request->length == 0) {
+        this->opened(index);
+        return false;
+      }
+      const uint8_t *text = (const uint8_t *)request->text;
+      int n = this->send(connection, text + connection->sent,
+                         request->length - connection->sent);
+      if (n < 0) {
+        this->fail(index, HTTPC_ERROR_SEND_HEADER_FAILED);
+        return false;
+      }
+      connection->sent += n;
+      if (connection->sent < request->length) {
+        return false;
+      }
+      connection->state = STATE_WAITING;
+      return true;
+    }
+    case STATE_WAITING: {
+      int n = this->fill(connection);
+      if (n < 0) {
+        this->fail(index, HTTPC_ERROR_CONNECTION_LOST);
+        return false;
+      }
+      if (n == 0) {
+        return false;
+      }
+      connection->received = true;
+      int ret = this->read_headers(connection);
+      if (ret < 0) {
+        this->fail(index, HTTPC_ERROR_NO_HTTP_SERVER);
+        return false;
+      }
+      if (ret > 0) {
+        this->respond(index);
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+// Reads the status line and headers that are in the buffer. Returns 1 once
+// the blank line ending them is read, leaving the buffer at the body, 0 if
+// more are to come and -1 if it is no HTTP response.
+int HttpEngine::read_headers(Connection *connection) {
+  while (true) {
+    uint8_t *start = connection->buffer + connection->buffer_pos;
+    size_t length = connection->buffer_length - connection->buffer_pos;
+    uint8_t *end = (uint8_t *)memchr(start, '\n', length);
+    if (!end) {
+      if (connection->buffer_pos == 0 &&
+          connection->buffer_length == sizeof(connection->buffer)) {
+        connection->skipping_line = true;
+        connection->buffer_length = 0;
+      } else {
+        memmove(connection->buffer, start, length);
+        connection->buffer_pos = 0;
+        connection->buffer_length = length;
+      }
+      return 0;
+    }
+    connection->buffer_pos += end - start + 1;
+    *end = '\0';
+    if (end > start && end[-1] == '\r') {
+      end[-1] = '\0';
+    }
+    const char *line = (const char *)start;
+    if (connection->skipping_line) {
+      connection->skipping_line = false;
+      continue;
+    }
+    if (connection->code == 0) {
+      // "HTTP/1.1 200 OK"; HTTP/1.0 closes after the response by default
+      if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+        return -1;
+      }
+      connection->keep_alive = line[7] == '1';
+      connection->code = atoi(line + 9);
+      if (connection->code <= 0) {
+        return -1;
+      }
+      continue;
+    }
+    if (line[0] == '\0') {
+      return 1;
+    }
+    const char *colon = strchr(line, ':');
+    if (!colon) {
+      continue;
+    }
+    const char *value = colon + 1;
+    while (*value == ' ') {
+      value++;
+    }
+    size_t name_length = colon - line;
+    if (name_length == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+      connection->remaining = atoi(value);
+    } else if (name_length == 17 &&
+               strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+      connection->chunked = strcasecmp(value, "chunked") == 0;
+    } else if (name_length == 16 &&
+               strncasecmp(line, "Content-Encoding", 16) == 0) {
+      connection->gzipped = strcasecmp(value, "gzip") == 0;
+    } else if (name_length == 10 &&
+               strncasecmp(line, "Connection", 10) == 0) {
+      if (strcasecmp(value, "close") == 0) {
+        connection->keep_alive = false;
+      } else if (strcasecmp(value, "keep-alive") == 0) {
+        connection->keep_alive = true;
+      }
+    }
+  }
+}
+
+// Hands the response to its handler, then leaves the connection open for the
+// next request to the host if the whole body was read.
+void HttpEngine::respond(int index) {
+  Connection *connection = &this->connections[index];
+  Request *request = &this->requests[connection->request];
+  connection->state = STATE_BODY;
+  if (connection->code == HTTP_CODE_NO_CONTENT || request->head) {
+    connection->chunked = false;
+    connection->remaining = 0;
+  }
+  if (connection->chunked) {
+    connection->remaining = 0;
+  } else if (connection->remaining < 0) {
+    // the body ends when the connection does
+    connection->keep_alive = false;
+  } else {
+    connection->body_done = connection->remaining == 0;
+  }
+
+  HttpResponseHandler handler = std::move(request->handler);
+  request->handler = nullptr;
+  request->used = false;
+  connection->request = -1;
+  this->stats.completed++;
+  this->body.connection = index;
+  handler(connection->code, this->body);
+  this->body.connection = -1;
+
+  if (connection->keep_alive && connection->body_done) {
+    connection->state = STATE_IDLE;
+  } else {
+    this->close(connection);
+  }
+}
+
+// Ends a request that got no response
+void HttpEngine::finish(int index, int code) {
+  Request *request = &this->requests[index];
+  HttpResponseHandler handler = std::move(request->handler);
+  request->handler = nullptr;
+  request->used = false;
+  this->body.connection = -1;
+  handler(code, this->body);
+}
+
+// Ends a request that only opened its connection, leaving it open
+void HttpEngine::opened(int index) {
+  Connection *connection = &this->connections[index];
+  int request = connection->request;
+  connection->state = STATE_IDLE;
+  connection->request = -1;
+  this->stats.completed++;
+  this->finish(request, HTTP_CODE_OK);
+}
+
+// A request on a connection left open fails if the server closed it in the
+// meantime. It is tried again on a new connection if nothing of the response
+// came.
+void HttpEngine::fail(int index, int code) {
+  Connection *connection = &this->connections[index];
+  int request = connection->request;
+  bool retry = connection->reused && !connection->received;
+  this->close(connection);
+  if (request < 0) {
+    return;
+  }
+  if (retry) {
+    this->requests[request].started = false;
+    this->stats.retries++;
+    return;
+  }
+  this->stats.failed++;
+  this->finish(request, code);
+}
+
+// Reads what the connection has into the buffer, without waiting
+int HttpEngine::fill(Connection *connection) {
+  if (connection->buffer_pos == connection->buffer_length) {
+    connection->buffer_pos = 0;
+    connection->buffer_length = 0;
+  }
+  size_t room = sizeof(connection->buffer) - connection->buffer_length;
+  if (room == 0) {
+    return 0;
+  }
+  int n = this->receive(connection,
+                        connection->buffer + connection->buffer_length, room);
+  if (n > 0) {
+    connection->buffer_length += n;
+  }
+  return n;
+}
+
+// Reads into the empty buffer, waiting for the connection until the deadline.
+// Returns -1 if it closed or the deadline passed.
+int HttpEngine::fill_waiting(Connection *connection) {
+  while (true) {
+    int n = this->fill(connection);
+    if (n != 0) {
+      return n;
+    }
+    if (!this->wait_readable(connection)) {
+      return -1;
+    }
+  }
+}
+
+bool HttpEngine::wait_readable(Connection *connection) {
+#ifndef LMS_HOST_BUILD
+  if (connection->tls &&
+      mbedtls_ssl_get_bytes_avail(
+          (mbedtls_ssl_context *)connection->tls_context) > 0) {
+    return true;
+  }
+#endif
+  int32_t left = connection->deadline - millis();
+  if (left <= 0) {
+    return false;
+  }
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(connection->socket, &readable);
+  struct timeval tv = {(time_t)(left / 1000),
+                       (suseconds_t)(left % 1000) * 1000};
+  return select(connection->socket + 1, &readable, NULL, NULL, &tv) > 0;
+}
+
+int HttpEngine::next_byte(Connection *connection) {
+  if (connection->buffer_pos == connection->buffer_length &&
+      this->fill_waiting(connection) < 0) {
+    return -1;
+  }
+  return connection->buffer[connection->buffer_pos++];
+}
+
+// Reads the line before a chunk, after the end of the one before. A chunk of
+// 0 ends the body, after the trailer.
+bool HttpEngine::read_chunk_size(Connection *connection) {
+  int32_t size = -1;
+  bool extension = false;
+  int c;
+  while ((c = this->next_byte(connection)) >= 0) {
+    if (c == '\n') {
+      if (size >= 0) {
+        break;
+      }
+      continue;  // the end of the chunk before
+    }
+    int digit = -1;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    }
+    if (digit >= 0 && !extension) {
+      size = (size < 0 ? 0 : size * 16) + digit;
+    } else if (c == ';') {
+      extension = true;
+    }
+  }
+  if (c < 0) {
+    return false;
+  }
+  if (size > 0) {
+    connection->remaining = size;
+    return true;
+  }
+  // the trailer ends with an empty line
+  int line_length = 0;
+  while ((c = this->next_byte(connection)) >= 0) {
+    if (c == '\n') {
+      if (line_length == 0) {
+        connection->body_done = true;
+        return true;
+      }
+      line_length = 0;
+    } else if (c != '\r') {
+      line_length++;
+    }
+  }
+  return false;
+}
+
+int HttpEngine::body_available(int index) {
+  if (index < 0) {
+    return 0;
+  }
+  Connection *connection = &this->connections[index];
+  if (connection->body_done || connection->remaining == 0) {
+    return 0;
+  }
+  int32_t buffered = connection->buffer_length - connection->buffer_pos;
+  if (connection->remaining > 0) {
+    return min(buffered, connection->remaining);
+  }
+  return buffered;
+}
+
+// Reads up to length bytes of the body, waiting for the first of them
+size_t HttpEngine::body_read(int index, uint8_t *buffer, size_t length) {
+  if (index < 0 || length == 0) {
+    return 0;
+  }
+  Connection *connection = &this->connections[index];
+  while (!connection->body_done) {
+    if (connection->chunked && connection->remaining == 0) {
+      if (!this->read_chunk_size(connection)) {
+        connection->keep_alive = false;
+        connection->body_done = true;
+      }
+      continue;
+    }
+    if (connection->buffer_pos == connection->buffer_length &&
+        this->fill_waiting(connection) < 0) {
+      // only a body without a length ends with the connection
+      connection->keep_alive = false;
+      connection->body_done = true;
+      break;
+    }
+    size_t n = min(length,
+                   connection->buffer_length - connection->buffer_pos);
+    if (connection->remaining >= 0) {
+      n = min(n, (size_t)connection->remaining);
+      connection->remaining -= n;
+      if (connection->remaining == 0 && !connection->chunked) {
+        connection->body_done = true;
+      }
+    }
+    memcpy(buffer, connection->buffer + connection->buffer_pos, n);
+    connection->buffer_pos += n;
+    return n;
+  }
+  return 0;
+}
+
+#ifdef LMS_HOST_BUILD
+
+// The handshake is made with the TLS stand-in, once connected, and the
+// connection then carries plain HTTP to the HTTP stand-in.
+struct TlsContext {
+  TlsSessionCache::CachedSession *session;
+};
+
+bool HttpEngine::start_tls(Connection *connection, const char *ca_cert) {
+  TlsContext *tls = new TlsContext;
+  connection->tls_context = tls;
+  tls->session = this->sessions->find(connection->host);
+  return true;
+}
+
+int HttpEngine::handshake(Connection *connection) {
+  TlsContext *tls = (TlsContext *)connection->tls_context;
+  bool resumed = lms_host::tls_handshake(connection->host,
+                                         &tls->session->session,
+                                         tls->session->valid) == 1;
+  tls->session->valid = true;
+  if (resumed) {
+    this->stats.resumed_handshakes++;
+  } else {
+    this->stats.full_handshakes++;
+  }
+  return 1;
+}
+
+void HttpEngine::close_tls(Connection *connection) {
+  delete (TlsContext *)connection->tls_context;
+  connection->tls_context = NULL;
+}
+
+#else
+
+struct TlsContext {
+  mbedtls_ssl_context ssl;  // first, see wait_readable
+  mbedtls_ssl_config conf;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_entropy_context entropy;
+  mbedtls_x509_crt ca_cert;
+  TlsSessionCache::CachedSession *session;
+  bool verify;
+  bool offered;  // the session kept for the host
+};
+
+// Sets up the TLS context of connection, offering the session kept for its
+// host, as TlsClient does.
+bool HttpEngine::start_tls(Connection *connection, const char *ca_cert) {
+  TlsContext *tls = new TlsContext;
+  connection->tls_context = tls;
+  mbedtls_ssl_init(&tls->ssl);
+  mbedtls_ssl_config_init(&tls->conf);
+  mbedtls_ctr_drbg_init(&tls->drbg);
+  mbedtls_entropy_init(&tls->entropy);
+  mbedtls_x509_crt_init(&tls->ca_cert);
+  tls->verify = ca_cert != NULL;
+  const char *pers = "lms-http-engine";
+  if (mbedtls_ctr_drbg_seed(&tls->drbg, mbedtls_entropy_func, &tls->entropy,
+                            (const unsigned char *)pers, strlen(pers)) != 0 ||
+      mbedtls_ssl_config_defaults(&tls->conf, MBEDTLS_SSL_IS_CLIENT,
+                                  MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    return false;
+  }
+  if (tls->verify) {
+    if (mbedtls_x509_crt_parse(&tls->ca_cert, (const unsigned char *)ca_cert,
+                               strlen(ca_cert) + 1) != 0) {
+      return false;
+    }
+    mbedtls_ssl_conf_ca_chain(&tls->conf, &tls->ca_cert, NULL);
+    mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    mbedtls_ssl_conf_authmode(&tls->conf, MBEDTLS_SSL_VERIFY_NONE);
+  }
+  mbedtls_ssl_conf_rng(&tls->conf, mbedtls_ctr_drbg_random, &tls->drbg);
+  if (mbedtls_ssl_setup(&tls->ssl, &tls->conf) != 0 ||
+      mbedtls_ssl_set_hostname(&tls->ssl, connection->host) != 0) {
+    return false;
+  }
+  tls->session = this->sessions->find(connection->host);
+  if (tls->session->valid &&
+      mbedtls_ssl_set_session(&tls->ssl, &tls->session->session) != 0) {
+    tls->session->valid = false;
+  }
+  tls->offered = tls->session->valid;
+  mbedtls_ssl_set_bio(&tls->ssl, &connection->socket, mbedtls_net_send,
+                      mbedtls_net_recv, NULL);
+  return true;
+}
+
+int HttpEngine::handshake(Connection *connection) {
+  TlsContext *tls = (TlsContext *)connection->tls_context;
+  int ret = mbedtls_ssl_handshake(&tls->ssl);
+  if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+    connection->want_write = ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+    return 0;
+  }
+  if (ret != 0 ||
+      (tls->verify && mbedtls_ssl_get_verify_result(&tls->ssl) != 0)) {
+    // it may be the session that was refused
+    tls->session->valid = false;
+    return -1;
+  }
+  // a server resuming the session answers with its id, as in TlsClient
+  mbedtls_ssl_session *offered = &tls->session->session;
+  const mbedtls_ssl_session *established = tls->ssl.session;
+  bool resumed = tls->offered && offered->id_len > 0 &&
+                 established->id_len == offered->id_len &&
+                 memcmp(established->id, offered->id, offered->id_len) == 0;
+  if (resumed) {
+    this->stats.resumed_handshakes++;
+  } else {
+    this->stats.full_handshakes++;
+  }
+  tls->session->valid = mbedtls_ssl_get_session(&tls->ssl, offered) == 0;
+  return 1;
+}
+
+void HttpEngine::close_tls(Connection *connection) {
+  TlsContext *tls = (TlsContext *)connection->tls_context;
+  if (!tls) {
+    return;
+  }
+  mbedtls_ssl_free(&tls->ssl);
+  mbedtls_ssl_config_free(&tls->conf);
+  mbedtls_ctr_drbg_free(&tls->drbg);
+  mbedtls_entropy_free(&tls->entropy);
+  mbedtls_x509_crt_free(&tls->ca_cert);
+  delete tls;
+  connection->tls_context = NULL;
+}
+
+#endif
+
+int HttpEngine::send(Connection *connection, const uint8_t *data,
+                     size_t length) {
+#ifndef LMS_HOST_BUILD
+  if (connection->tls) {
+    int ret = mbedtls_ssl_write(
+        &((TlsContext *)connection->tls_context)->ssl, data, length);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ ||
+        ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      return 0;
+    }
+    return ret < 0 ? -1 : ret;
+  }
+#endif
+  int n = ::send(connection->socket, data, length, MSG_NOSIGNAL);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+  }
+  return n;
+}
+
+int HttpEngine::receive(Connection *connection, uint8_t *data,
+                        size_t length) {
+#ifndef LMS_HOST_BUILD
+  if (connection->tls) {
+    int ret = mbedtls_ssl_read(
+        &((TlsContext *)connection->tls_context)->ssl, data, length);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ ||
+        ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      return 0;
+    }
+    return ret <= 0 ? -1 : ret;
+  }
+#endif
+  int n = ::recv(connection->socket, data, length, 0);
+  if (n < 0) {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+  }
+  return n == 0 ? -1 : n;
+}
+
+} /* namespace lms */
@@ -0,0 +1,256 @@
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+#include <atomic>
+#include <functional>
+
+#include "tls.h"
+
+#ifndef LMS_HTTP_ENGINE_H
+#define LMS_HTTP_ENGINE_H
+
+// Connections open at once. A TLS connection holds about 40 KB on the esp32.
+#define HTTP_ENGINE_MAX_CONNECTIONS 3
+// Requests waiting for a connection or in flight
+#define HTTP_ENGINE_QUEUE_LENGTH 8
+// Room callers leave for the headers of a request
+#define HTTP_ENGINE_MAX_HEADERS_LENGTH 384
+// The request as sent: request line, headers and body. A request that does
+// not fit is rejected by submit().
+#define HTTP_ENGINE_REQUEST_SIZE 1024
+// Response bytes read at a time. Longer header lines are skipped.
+#define HTTP_ENGINE_BUFFER_SIZE 512
+// Hosts the engine keeps the TLS session of
+#define HTTP_ENGINE_TLS_SESSIONS 4
+// Hosts the engine keeps the address of, and for how long
+#define HTTP_ENGINE_ADDRESSES 4
+#define HTTP_ENGINE_ADDRESS_TTL 5 * 60 * 1000  // millis
+// Longest poll() waits while a host is being looked up, in millis
+#define HTTP_ENGINE_RESOLVE_POLL_MS 10
+
+namespace lms {
+
+enum HttpPriority {
+  HTTP_PRIORITY_HIGH,  // what other requests need, like a token
+  HTTP_PRIORITY_NORMAL,
+  HTTP_PRIORITY_LOW,  // prefetches
+};
+
+struct HttpEngineRequest {
+  const char *method;   // "GET" or "POST"
+  const char *url;      // copied
+  const char *headers;  // lines ending in "\r\n", or NULL. Copied.
+  const char *body;     // or NULL. Copied.
+  const char *ca_cert;  // NULL to not verify the server. Must outlive it.
+  HttpPriority priority;
+  uint32_t timeout_ms;  // from submit to the end of the response
+};
+
+class HttpBody;
+
+// Called once when a request is done, with the status code and the body as
+// it streams in, or with an HTTPC_ERROR_ code and an empty body. The body can
+// only be read during the call.
+typedef std::function<void(int code, HttpBody &body)> HttpResponseHandler;
+
+struct HttpEngineStats {
+  uint32_t submitted;
+  uint32_t rejected;  // the queue was full, or the request too long
+  uint32_t completed;
+  uint32_t failed;
+  uint32_t timed_out;
+  uint32_t lookups;  // of host addresses, the others were known
+  uint32_t connections_opened;
+  uint32_t connections_reused;
+  // of the TLS connections opened, as TlsClient counts them
+  uint32_t full_handshakes;
+  uint32_t resumed_handshakes;
+  uint32_t failed_handshakes;
+  uint32_t retries;
+  uint32_t max_in_flight;
+  uint32_t wakes;  // polls cut short by wake()
+};
+
+class HttpEngine;
+
+// The body of a response, read off its connection. Reads wait for the rest of
+// the body until the request's deadline.
+class HttpBody : public Stream {
+  HttpEngine *engine;
+  int connection;
+
+  friend class HttpEngine;
+
+ public:
+  int available() override;
+  int read() override;
+  int peek() override { return -1; }
+  size_t readBytes(uint8_t *buffer, size_t length) override;
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 0; }
+  // Whether the body came with Content-Encoding: gzip. It is read as it came.
+  bool gzipped();
+};
+
+// Runs many HTTP requests at once over non-blocking sockets, from one task.
+//
+// Requests are queued with submit() and run by poll(), which waits on every
+// connection at once. The time a request spends looking up its host,
+// connecting, in the TLS handshake and waiting for the server is spent on the
+// others. Host addresses are looked up in the background and kept. Requests go
+// out by priority, then in the order they came, and a connection left open
+// by an earlier request to the same host is used again. A request that is
+// not done by its deadline ends with HTTPC_ERROR_READ_TIMEOUT.
+//
+// Once the headers of a response are in, its handler reads the body as it
+// streams in, as the providers parse their responses. The other responses
+// wait in their socket buffers meanwhile. All of it, handlers included, runs
+// on the task that calls poll(), and submit() is only called from that task.
+// Other tasks can cut a poll() short with wake().
+class HttpEngine {
+  enum State {
+    STATE_CLOSED,
+    STATE_IDLE,       // open, kept for the next request to the host
+    STATE_RESOLVING,  // waiting for the address of the host
+    STATE_CONNECTING,
+    STATE_HANDSHAKING,
+    STATE_SENDING,
+    STATE_WAITING,  // for the status line and headers
+    STATE_BODY,
+  };
+
+  struct Request {
+    bool used;
+    bool started;  // on a connection
+    uint32_t order;
+    uint32_t deadline;
+    HttpPriority priority;
+    bool head;  // the response has no body
+    const char *ca_cert;
+    char host[TLS_MAX_HOST_LENGTH];
+    uint16_t port;
+    bool tls;
+    // the request as sent, put together by submit(). Empty to only open a
+    // connection.
+    char text[HTTP_ENGINE_REQUEST_SIZE];
+    size_t length;
+    HttpResponseHandler handler;
+  };
+
+  struct Connection {
+    State state;
+    int socket;
+    char host[TLS_MAX_HOST_LENGTH];
+    uint16_t port;
+    bool tls;
+    bool reused;  // was open before the request
+    int request;  // into requests, or -1
+    uint32_t deadline;
+    void *tls_context;
+    // on a TLS connection, the handshake waits for the socket to be writable
+    bool want_write;
+    size_t sent;  // of the request text
+    uint8_t buffer[HTTP_ENGINE_BUFFER_SIZE];
+    size_t buffer_pos;
+    size_t buffer_length;
+    bool received;  // any of the response
+    bool skipping_line;
+    // from the response headers
+    int code;
+    bool chunked;
+    bool keep_alive;
+    int32_t remaining;  // of the body or of the chunk, -1 until it closes
+    bool gzipped;
+    bool body_done;
+  };
+
+  enum AddressState {
+    ADDRESS_NONE,
+    ADDRESS_RESOLVING,
+    ADDRESS_RESOLVED,
+    ADDRESS_FAILED,
+  };
+
+  // The address of a host. The resolver sets it from its own task.
+  struct Address {
+    char host[TLS_MAX_HOST_LENGTH];
+    uint32_t last_used;
+    uint32_t ip;  // in network order
+    uint32_t resolved_at;
+    std::atomic<uint8_t> state;
+  };
+
+  Request requests[HTTP_ENGINE_QUEUE_LENGTH];
+  Connection connections[HTTP_ENGINE_MAX_CONNECTIONS];
+  Address addresses[HTTP_ENGINE_ADDRESSES];
+  uint32_t order;
+  HttpEngineStats stats;
+  TlsSessionCache *sessions;
+  HttpBody body;
+  // A datagram to wake_port, on the loopback, has poll() return. poll()
+  // reads wake_socket, and wake() sends from wake_sender.
+  bool wake_opened;
+  int wake_socket;
+  std::atomic<int> wake_sender;
+  uint16_t wake_port;  // in network order
+
+  friend class HttpBody;
+
+  int next_request();
+  int find_connection(const Request *request);
+  void start(int request, int connection);
+  void open_wake();
+  Address *find_address(const char *host);
+  int resolve(const char *host, uint32_t *ip);
+  void forget_address(const char *host);
+  bool open(Connection *connection, uint32_t ip, const char *ca_cert);
+  void close(Connection *connection);
+  bool step(int connection);
+  int read_headers(Connection *connection);
+  void respond(int connection);
+  void finish(int request, int code);
+  void opened(int connection);
+  void fail(int connection, int code);
+  int fill(Connection *connection);
+  int fill_waiting(Connection *connection);
+  bool wait_readable(Connection *connection);
+  int next_byte(Connection *connection);
+  bool read_chunk_size(Connection *connection);
+  int body_available(int connection);
+  size_t body_read(int connection, uint8_t *buffer, size_t length);
+
+  // the transport, plain or TLS: bytes done, 0 if it would block, -1 once
+  // the connection is closed or failed
+  bool start_tls(Connection *connection, const char *ca_cert);
+  int handshake(Connection *connection);
+  int send(Connection *connection, const uint8_t *data, size_t length);
+  int receive(Connection *connection, uint8_t *data, size_t length);
+  void close_tls(Connection *connection);
+
+ public:
+  HttpEngine();
+  ~HttpEngine();
+  // Queues request. Returns false if the queue is full or the request does
+  // not fit in HTTP_ENGINE_REQUEST_SIZE.
+  bool submit(const HttpEngineRequest &request, HttpResponseHandler handler);
+  // Opens a connection to the host of url, TLS handshake included, and keeps
+  // it for the first request to the host, as if a request had used it.
+  // Returns false if the queue is full.
+  bool preconnect(const char *url, const char *ca_cert, uint32_t timeout_ms);
+  // Moves every request on, waiting up to timeout_ms for a connection to be
+  // ready. Returns how many requests were done.
+  int poll(uint32_t timeout_ms);
+  // Has a poll() waiting on the connections return at once, for the task
+  // calling it to see to something else. Safe from any task, or a timer.
+  void wake();
+  // Requests queued or in flight
+  int pending();
+  // Drops every request without calling its handler, and closes the
+  // connections. The TLS sessions are kept.
+  void cancel();
+  HttpEngineStats get_stats();
+};
+
+} /* namespace lms */
+
+#endif /* LMS_HTTP_ENGINE_H */
@@ -0,0 +1,61 @@
+#include "jpeg.h"
+
+namespace lms {
+
+// tjpgd asks for length bytes, or to skip them when buffer is NULL. Waits for
+// them as readBytes does, and returns less only once the image or stream has
+// ended.
+uint16_t JpegDecoder::input(JDEC *jd, uint8_t *buffer, uint16_t length) {
+  JpegDecoder *decoder = (JpegDecoder *)jd->device;
+  if (decoder->remaining >= 0 && length > decoder->remaining) {
+    length = decoder->remaining;
+  }
+  uint8_t skipped[64];
+  uint16_t n = 0;
+  while (n < length) {
+    uint8_t *dst = buffer ? buffer + n : skipped;
+    size_t wanted = length - n;
+    if (!buffer) {
+      wanted = min(wanted, sizeof(skipped));
+    }
+    size_t read = decoder->stream->readBytes(dst, wanted);
+    if (read == 0) {
+      break;
+    }
+    n += read;
+  }
+  if (decoder->remaining >= 0) {
+    decoder->remaining -= n;
+  }
+  return n;
+}
+
+uint16_t JpegDecoder::output(JDEC *jd, void *pixels, JRECT *rect) {
+  JpegDecoder *decoder = (JpegDecoder *)jd->device;
+  return (*decoder->handler)(rect->left, rect->top,
+                             rect->right - rect->left + 1,
+                             rect->bottom - rect->top + 1,
+                             (uint16_t *)pixels);
+}
+
+JRESULT JpegDecoder::decode(Stream &stream, int size, uint16_t max_width,
+                            uint16_t max_height,
+                            const JpegBlockHandler &handler) {
+  this->stream = &stream;
+  this->remaining = size;
+  this->handler = &handler;
+  JDEC jd;
+  JRESULT result = jd_prepare(&jd, JpegDecoder::input, this->workspace,
+                              sizeof(this->workspace), this);
+  if (result != JDR_OK) {
+    return result;
+  }
+  uint8_t scale = 0;
+  while (scale < 3 && ((jd.width >> scale) > max_width ||
+                       (jd.height >> scale) > max_height)) {
+    scale++;
+  }
+  return jd_decomp(&jd, JpegDecoder::output, scale);
+}
+
+} /* namespace lms */
@@ -0,0 +1,43 @@
+#include <Arduino.h>
+#include <tjpgd.h>
+
+#include <functional>
+
+#ifndef LMS_JPEG_H
+#define LMS_JPEG_H
+
+// Memory tjpgd works in, enough for baseline images with its 512 byte input
+// buffer
+#define JPEG_WORKSPACE_SIZE 3100
+
+namespace lms {
+
+// Called with each decoded block of RGB565 pixels, at its position in the
+// scaled image. Returning false stops the decode.
+typedef std::function<bool(int16_t x, int16_t y, uint16_t w, uint16_t h,
+                           uint16_t *pixels)>
+    JpegBlockHandler;
+
+// Decodes a JPEG as it is read off a stream, with tjpgd. Only tjpgd's
+// workspace is kept, never the image itself, so images of any size can be
+// decoded and the first blocks are drawn while the rest is still arriving.
+class JpegDecoder {
+  uint8_t workspace[JPEG_WORKSPACE_SIZE];
+  Stream *stream;
+  int remaining;  // bytes left in the image, or -1 if not known
+  const JpegBlockHandler *handler;
+
+  static uint16_t input(JDEC *jd, uint8_t *buffer, uint16_t length);
+  static uint16_t output(JDEC *jd, void *pixels, JRECT *rect);
+
+ public:
+  // Decodes the size bytes of stream (-1 to read until it ends), scaled down
+  // by the smallest of 1, 2, 4 or 8 that fits max_width by max_height, or by
+  // 8 if none does.
+  JRESULT decode(Stream &stream, int size, uint16_t max_width,
+                 uint16_t max_height, const JpegBlockHandler &handler);
+};
+
+} /* namespace lms */
+
+#endif /* LMS_JPEG_H */
@@ -0,0 +1,387 @@
+#include "json.h"
+
+namespace lms {
+
+static bool is_whitespace(int c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool is_delimiter(int c) {
+  return c < 0 || c == ',' || c == '}' || c == ']' || is_whitespace(c);
+}
+
+static JsonStatus unexpected(int c) {
+  return c < 0 ? JSON_STATUS_INCOMPLETE : JSON_STATUS_INVALID;
+}
+
+static int hex_digit(int c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+JsonExtractor::JsonExtractor(const char *const *fields, int num_fields)
+    : fields(fields), num_fields(num_fields) {}
+
+JsonStatus JsonExtractor::extract(Stream &stream,
+                                  const JsonFieldHandler &handler) {
+  this->stream = &stream;
+  this->buffer_pos = 0;
+  this->buffer_length = 0;
+  this->pending = -1;
+  this->path[0] = '\0';
+  this->path_length = 0;
+  this->depth = 0;
+  this->array_depth = 0;
+  return this->parse_value(this->next_token(), true, handler);
+}
+
+// Reads what the connection already has, up to the size of the buffer, so a
+// read never waits for bytes past the end of the document.
+int JsonExtractor::next() {
+  if (this->pending >= 0) {
+    int c = this->pending;
+    this->pending = -1;
+    return c;
+  }
+  if (this->buffer_pos == this->buffer_length) {
+    int available = this->stream->available();
+    size_t wanted = available > 0 ? min((size_t)available, sizeof(buffer)) : 1;
+    this->buffer_length = this->stream->readBytes(this->buffer, wanted);
+    this->buffer_pos = 0;
+    if (this->buffer_length == 0) {
+      return -1;
+    }
+  }
+  return this->buffer[this->buffer_pos++];
+}
+
+int JsonExtractor::next_token() {
+  int c;
+  do {
+    c = this->next();
+  } while (is_whitespace(c));
+  return c;
+}
+
+bool JsonExtractor::path_leads_to_field() {
+  if (this->path_length == 0) {
+    return true;
+  }
+  for (int i = 0; i < this->num_fields; i++) {
+    const char *field = this->fields[i];
+    if (strncmp(field, this->path, this->path_length) == 0) {
+      char c = field[this->path_length];
+      if (c == '\0' || c == '.' || c == '[') {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+int JsonExtractor::find_field() {
+  for (int i = 0; i < this->num_fields; i++) {
+    if (strcmp(this->fields[i], this->path) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+JsonStatus JsonExtractor::parse_value(int c, bool on_path,
+                                      const JsonFieldHandler &handler) {
+  if (c == '{' || c == '[') {
+    if (!on_path || !this->path_leads_to_field()) {
+      return this->skip_container();
+    }
+    if (this->depth == JSON_MAX_DEPTH) {
+      return JSON_STATUS_TOO_DEEP;
+    }
+    this->depth++;
+    JsonStatus status = c == '{' ? this->parse_object(handler)
+                                 : this->parse_array(handler);
+    this->depth--;
+    return status;
+  }
+  return this->parse_scalar(c, on_path ? this->find_field() : -1, handler);
+}
+
+JsonStatus JsonExtractor::parse_object(const JsonFieldHandler &handler) {
+  uint8_t base = this->path_length;
+  size_t start = base > 0 ? base + 1 : base;
+  int c = this->next_token();
+  if (c == '}') {
+    return JSON_STATUS_OK;
+  }
+  while (true) {
+    if (c != '"') {
+      return unexpected(c);
+    }
+    // the key goes straight into the path
+    size_t length;
+    JsonStatus status;
+    if (start < JSON_MAX_PATH_LENGTH) {
+      this->path[base] = '.';
+      status = this->read_string(this->path + start,
+                                 JSON_MAX_PATH_LENGTH - start, &length);
+    } else {
+      status = this->read_string(NULL, 0, &length);
+    }
+    if (status != JSON_STATUS_OK) {
+      return status;
+    }
+    bool on_path = start + length < JSON_MAX_PATH_LENGTH;
+    if (on_path) {
+      this->path_length = start + length;
+    }
+    c = this->next_token();
+    if (c != ':') {
+      return unexpected(c);
+    }
+    status = this->parse_value(this->next_token(), on_path, handler);
+    if (status != JSON_STATUS_OK) {
+      return status;
+    }
+    this->path_length = base;
+    this->path[base] = '\0';
+    c = this->next_token();
+    if (c == '}') {
+      return JSON_STATUS_OK;
+    }
+    if (c != ',') {
+      return unexpected(c);
+    }
+    c = this->next_token();
+  }
+}
+
+JsonStatus JsonExtractor::parse_array(const JsonFieldHandler &handler) {
+  uint8_t base = this->path_length;
+  bool on_path = base + 2 < JSON_MAX_PATH_LENGTH;
+  if (on_path) {
+    strcpy(this->path + base, "[]");
+    this->path_length = base + 2;
+  }
+  int *index = &this->indices[this->array_depth++];
+  *index = 0;
+  JsonStatus status = JSON_STATUS_OK;
+  int c = this->next_token();
+  if (c != ']') {
+    while (true) {
+      status = this->parse_value(c, on_path, handler);
+      if (status != JSON_STATUS_OK) {
+        break;
+      }
+      c = this->next_token();
+      if (c == ']') {
+        break;
+      }
+      if (c != ',') {
+        status = unexpected(c);
+        break;
+      }
+      (*index)++;
+      c = this->next_token();
+    }
+  }
+  this->array_depth--;
+  this->path_length = base;
+  this->path[base] = '\0';
+  return status;
+}
+
+JsonStatus JsonExtractor::parse_scalar(int c, int field,
+                                       const JsonFieldHandler &handler) {
+  JsonValue value;
+  value.text = this->value;
+  value.index = this->array_depth > 0 ? this->indices[this->array_depth - 1]
+                                      : -1;
+  value.outer_index = this->array_depth > 0 ? this->indices[0] : -1;
+  if (c == '"') {
+    size_t length;
+    JsonStatus status =
+        field >= 0
+            ? this->read_string(this->value, sizeof(this->value), &length)
+            : this->read_string(NULL, 0, &length);
+    if (status != JSON_STATUS_OK) {
+      return status;
+    }
+    value.type = JSON_VALUE_STRING;
+  } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' ||
+             c == 'n') {
+    size_t length = 0;
+    while (!is_delimiter(c)) {
+      if (length < sizeof(this->value) - 1) {
+        this->value[length++] = c;
+      }
+      c = this->next();
+    }
+    this->pending = c;
+    this->value[length] = '\0';
+    if (this->value[0] == 't' || this->value[0] == 'f') {
+      if (strcmp(this->value, "true") != 0 &&
+          strcmp(this->value, "false") != 0) {
+        return JSON_STATUS_INVALID;
+      }
+      value.type = JSON_VALUE_BOOL;
+    } else if (this->value[0] == 'n') {
+      if (strcmp(this->value, "null") != 0) {
+        return JSON_STATUS_INVALID;
+      }
+      value.type = JSON_VALUE_NULL;
+    } else {
+      if (strspn(this->value, "-+.eE0123456789") != length) {
+        return JSON_STATUS_INVALID;
+      }
+      value.type = JSON_VALUE_NUMBER;
+    }
+  } else {
+    return unexpected(c);
+  }
+  if (field >= 0) {
+    handler(field, value);
+  }
+  return JSON_STATUS_OK;
+}
+
+// Reads the rest of a string whose opening quote was consumed. Writes at most
+// size - 1 bytes and a terminator to dst, if given; length is set to the full
+// unescaped length.
+JsonStatus JsonExtractor::read_string(char *dst, size_t size, size_t *length) {
+  size_t n = 0;
+  auto append = [&](uint8_t b) {
+    if (dst && n + 1 < size) {
+      dst[n] = b;
+    }
+    n++;
+  };
+  while (true) {
+    int c = this->next();
+    if (c < 0) {
+      return JSON_STATUS_INCOMPLETE;
+    }
+    if (c == '"') {
+      break;
+    }
+    if (c != '\\') {
+      append(c);
+      continue;
+    }
+    c = this->next();
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        append(c);
+        break;
+      case 'b':
+        append('\b');
+        break;
+      case 'f':
+        append('\f');
+        break;
+      case 'n':
+        append('\n');
+        break;
+      case 'r':
+        append('\r');
+        break;
+      case 't':
+        append('\t');
+        break;
+      case 'u': {
+        uint32_t code = 0;
+        for (int i = 0; i < 4; i++) {
+          int digit = hex_digit(this->next());
+          if (digit < 0) {
+            return JSON_STATUS_INVALID;
+          }
+          code = code << 4 | digit;
+        }
+        // a surrogate pair is written as two escapes
+        if (code >= 0xD800 && code < 0xDC00) {
+          if (this->next() != '\\' || this->next() != 'u') {
+            return JSON_STATUS_INVALID;
+          }
+          uint32_t low = 0;
+          for (int i = 0; i < 4; i++) {
+            int digit = hex_digit(this->next());
+            if (digit < 0) {
+              return JSON_STATUS_INVALID;
+            }
+            low = low << 4 | digit;
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        if (code < 0x80) {
+          append(code);
+        } else if (code < 0x800) {
+          append(0xC0 | code >> 6);
+          append(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+          append(0xE0 | code >> 12);
+          append(0x80 | ((code >> 6) & 0x3F));
+          append(0x80 | (code & 0x3F));
+        } else {
+          append(0xF0 | code >> 18);
+          append(0x80 | ((code >> 12) & 0x3F));
+          append(0x80 | ((code >> 6) & 0x3F));
+          append(0x80 | (code & 0x3F));
+        }
+        break;
+      }
+      default:
+        return unexpected(c);
+    }
+  }
+  if (dst && size > 0) {
+    dst[min(n, size - 1)] = '\0';
+  }
+  *length = n;
+  return JSON_STATUS_OK;
+}
+
+// Skips an object or array whose opening bracket was consumed. Brackets are
+// only counted, not matched, so a malformed container may go unnoticed.
+JsonStatus JsonExtractor::skip_container() {
+  int nesting = 1;
+  while (nesting > 0) {
+    int c = this->next();
+    if (c < 0) {
+      return JSON_STATUS_INCOMPLETE;
+    }
+    if (c == '"') {
+      while ((c = this->next()) != '"') {
+        if (c < 0) {
+          return JSON_STATUS_INCOMPLETE;
+        }
+        if (c == '\\') {
+          this->next();
+        }
+      }
+    } else if (c == '{' || c == '[') {
+      nesting++;
+    } else if (c == '}' || c == ']') {
+      nesting--;
+    }
+  }
+  return JSON_STATUS_OK;
+}
+
+const char *json_status_to_str(JsonStatus status) {
+  switch (status) {
+    case JSON_STATUS_OK:
+      return "Ok";
+    case JSON_STATUS_INVALID:
+      return "InvalidInput";
+    case JSON_STATUS_INCOMPLETE:
+      return "IncompleteInput";
+    case JSON_STATUS_TOO_DEEP:
+      return "TooDeep";
+  }
+  return "Unknown";
+}
+
+} /* namespace lms */
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+
+#include <functional>
+
+#ifndef LMS_JSON_H
+#define LMS_JSON_H
+
+// Longest field path, key by key, e.g. "data[].attributes.arrival_time"
+#define JSON_MAX_PATH_LENGTH 96
+// Values longer than this are cut off
+#define JSON_MAX_VALUE_LENGTH 256
+#define JSON_MAX_DEPTH 16
+
+namespace lms {
+
+enum JsonStatus {
+  JSON_STATUS_OK,
+  JSON_STATUS_INVALID,
+  JSON_STATUS_INCOMPLETE,
+  JSON_STATUS_TOO_DEEP,
+};
+
+enum JsonValueType {
+  JSON_VALUE_STRING,
+  JSON_VALUE_NUMBER,
+  JSON_VALUE_BOOL,
+  JSON_VALUE_NULL,
+};
+
+struct JsonValue {
+  JsonValueType type;
+  // the unescaped string, or a number, true, false or null as written
+  const char *text;
+  // position in the innermost array on the path, or -1
+  int index;
+  // position in the outermost array on the path, or -1
+  int outer_index;
+};
+
+// Called with the index of the matched field and its value.
+typedef std::function<void(int field, const JsonValue &value)>
+    JsonFieldHandler;
+
+// Pulls selected fields out of a JSON document as it streams in, without
+// building a DOM.
+//
+// Fields are paths of object keys, with [] standing for every element of an
+// array: "item.name", "data[].attributes.arrival_time". Every scalar found
+// at one of the paths is passed to the handler. Containers that no field
+// path goes through are skipped without looking at their keys. Memory use is
+// fixed: a small read buffer, the current path and one value.
+class JsonExtractor {
+  const char *const *fields;
+  int num_fields;
+
+  Stream *stream;
+  uint8_t buffer[64];
+  uint8_t buffer_pos;
+  uint8_t buffer_length;
+  int pending;
+
+  char path[JSON_MAX_PATH_LENGTH];
+  uint8_t path_length;
+  uint8_t depth;
+  int indices[JSON_MAX_DEPTH];
+  int array_depth;
+  char value[JSON_MAX_VALUE_LENGTH];
+
+  int next();
+  int next_token();
+  bool path_leads_to_field();
+  int find_field();
+  JsonStatus parse_value(int c, bool on_path, const JsonFieldHandler &handler);
+  JsonStatus parse_object(const JsonFieldHandler &handler);
+  JsonStatus parse_array(const JsonFieldHandler &handler);
+  JsonStatus parse_scalar(int c, int field, const JsonFieldHandler &handler);
+  JsonStatus read_string(char *dst, size_t size, size_t *length);
+  JsonStatus skip_container();
+
+ public:
+  JsonExtractor(const char *const *fields, int num_fields);
+  JsonStatus extract(Stream &stream, const JsonFieldHandler &handler);
+};
+
+const char *json_status_to_str(JsonStatus status);
+
+} /* namespace lms */
+
+#endif /* LMS_JSON_H */
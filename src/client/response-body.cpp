@@ -0,0 +1,219 @@
+#include "response-body.h"
+
+// gzip header flags, RFC 1952
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+// CRC32 and size of the decoded body
+#define GZIP_TRAILER_SIZE 8
+
+namespace lms {
+
+ResponseBody::ResponseBody(Stream &source, bool gzipped, EncodingStats *stats)
+    : source(&source),
+      gzipped(gzipped),
+      stats(stats),
+      inflater(NULL),
+      window(NULL),
+      window_pos(0),
+      out_pos(0),
+      out_end(0),
+      input_pos(0),
+      input_length(0),
+      started(false),
+      done(false) {
+  if (!gzipped) {
+    this->stats->plain++;
+    return;
+  }
+  this->stats->gzipped++;
+  this->inflater = new tinfl_decompressor;
+  this->window = new uint8_t[TINFL_LZ_DICT_SIZE];
+  tinfl_init(this->inflater);
+}
+
+ResponseBody::~ResponseBody() {
+  if (this->gzipped) {
+    this->finish();
+    delete this->inflater;
+    delete[] this->window;
+  }
+}
+
+// Reads more compressed bytes once the ones read are used up, waiting for
+// them as readBytes does. Returns false once the body has ended.
+bool ResponseBody::fill() {
+  if (this->input_pos < this->input_length) {
+    return true;
+  }
+  // what the connection already has, so a read never waits for bytes past the
+  // end of the body
+  int available = this->source->available();
+  size_t wanted =
+      available > 0 ? min((size_t)available, sizeof(this->input)) : 1;
+  this->input_length = this->source->readBytes(this->input, wanted);
+  this->input_pos = 0;
+  this->stats->wire_bytes += this->input_length;
+  return this->input_length > 0;
+}
+
+// The next compressed byte, or -1 once the body has ended
+int ResponseBody::next_input() {
+  return this->fill() ? this->input[this->input_pos++] : -1;
+}
+
+// Skips the gzip header, leaving the deflate stream next
+bool ResponseBody::read_header() {
+  if (this->next_input() != 0x1f || this->next_input() != 0x8b ||
+      this->next_input() != 8) {
+    return false;
+  }
+  int flags = this->next_input();
+  // modification time, extra flags and OS
+  for (int i = 0; i < 6; i++) {
+    if (this->next_input() < 0) {
+      return false;
+    }
+  }
+  if (flags < 0) {
+    return false;
+  }
+  if (flags & GZIP_FLAG_EXTRA) {
+    int low = this->next_input();
+    int high = this->next_input();
+    if (low < 0 || high < 0) {
+      return false;
+    }
+    for (int length = low | high << 8; length > 0; length--) {
+      if (this->next_input() < 0) {
+        return false;
+      }
+    }
+  }
+  for (int flag : {GZIP_FLAG_NAME, GZIP_FLAG_COMMENT}) {
+    if (flags & flag) {
+      int c;
+      while ((c = this->next_input()) > 0) {
+      }
+      if (c < 0) {
+        return false;
+      }
+    }
+  }
+  if (flags & GZIP_FLAG_HCRC) {
+    if (this->next_input() < 0 || this->next_input() < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decodes more of the body if all that was decoded has been read. Unless
+// wait, only the compressed bytes that have arrived are used. Returns whether
+// there are decoded bytes to read.
+bool ResponseBody::inflate(bool wait) {
+  while (this->out_pos == this->out_end) {
+    if (this->done) {
+      return false;
+    }
+    if (!wait && this->input_pos == this->input_length &&
+        this->source->available() <= 0) {
+      return false;
+    }
+    if (!this->started) {
+      // the header is a few bytes, waited for whole
+      this->started = true;
+      if (!this->read_header()) {
+        this->stats->failed++;
+        this->done = true;
+        return false;
+      }
+      continue;
+    }
+    if (!this->fill()) {
+      // cut off
+      this->stats->failed++;
+      this->done = true;
+      return false;
+    }
+    size_t in_size = this->input_length - this->input_pos;
+    size_t out_size = TINFL_LZ_DICT_SIZE - this->window_pos;
+    tinfl_status status = tinfl_decompress(
+        this->inflater, this->input + this->input_pos, &in_size, this->window,
+        this->window + this->window_pos, &out_size,
+        TINFL_FLAG_HAS_MORE_INPUT);
+    this->input_pos += in_size;
+    this->out_pos = this->window_pos;
+    this->out_end = this->window_pos + out_size;
+    this->window_pos = (this->window_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+    this->stats->decoded_bytes += out_size;
+    if (status == TINFL_STATUS_DONE) {
+      this->done = true;
+    } else if (status < 0) {
+      this->stats->failed++;
+      this->done = true;
+      this->out_end = this->out_pos;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads the rest of a body the parser stopped short of, and the trailer, so
+// that the connection is left at the end of the response.
+void ResponseBody::finish() {
+  if (!this->started) {
+    return;
+  }
+  while (this->inflate(true)) {
+    this->out_pos = this->out_end;
+  }
+  // tinfl may have taken some of the trailer already, so only what has
+  // arrived is read
+  size_t left = this->input_length - this->input_pos;
+  for (; left < GZIP_TRAILER_SIZE && this->source->available() > 0; left++) {
+    if (this->source->read() < 0) {
+      break;
+    }
+    this->stats->wire_bytes++;
+  }
+}
+
+int ResponseBody::available() {
+  if (!this->gzipped) {
+    return this->source->available();
+  }
+  return this->inflate(false) ? this->out_end - this->out_pos : 0;
+}
+
+int ResponseBody::read() {
+  uint8_t c;
+  return this->readBytes(&c, 1) ? c : -1;
+}
+
+int ResponseBody::peek() {
+  if (!this->gzipped) {
+    return this->source->peek();
+  }
+  return this->inflate(true) ? this->window[this->out_pos] : -1;
+}
+
+size_t ResponseBody::readBytes(uint8_t *buffer, size_t length) {
+  if (!this->gzipped) {
+    size_t n = this->source->readBytes(buffer, length);
+    this->stats->wire_bytes += n;
+    this->stats->decoded_bytes += n;
+    return n;
+  }
+  size_t n = 0;
+  while (n < length && this->inflate(true)) {
+    size_t count = min(length - n, this->out_end - this->out_pos);
+    memcpy(buffer + n, this->window + this->out_pos, count);
+    this->out_pos += count;
+    n += count;
+  }
+  return n;
+}
+
+} /* namespace lms */
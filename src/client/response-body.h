@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <rom/miniz.h>
+
+#ifndef LMS_RESPONSE_BODY_H
+#define LMS_RESPONSE_BODY_H
+
+// Compressed bytes read off the connection at a time
+#define RESPONSE_BODY_INPUT_SIZE 256
+// Request header asking for a gzipped response
+#define ACCEPT_GZIP_HEADER "Accept-Encoding: gzip\r\n"
+
+// Bytes of the response bodies read by a client, as they came over the wire
+// and as the parsers read them
+struct EncodingStats {
+  uint32_t gzipped;  // responses
+  uint32_t plain;
+  uint32_t failed;  // gzipped ones that could not be inflated
+  uint32_t wire_bytes;
+  uint32_t decoded_bytes;
+};
+
+namespace lms {
+
+// The body of a response, as the parsers read it. A gzipped body is inflated
+// as it is read, any other is read as it is.
+//
+// Deflate refers back up to 32 KB into what it has decoded, so inflating
+// takes the last 32 KB of the body and tinfl's tables, about 43 KB, which are
+// only held while the body is read. The whole body never is, however large it
+// is. Once read, the gzip trailer is skipped so that the connection can take
+// the next request; the body is already checked by TLS, so its CRC is not.
+class ResponseBody : public Stream {
+  Stream *source;
+  bool gzipped;
+  EncodingStats *stats;
+  tinfl_decompressor *inflater;
+  uint8_t *window;  // TINFL_LZ_DICT_SIZE bytes
+  size_t window_pos;
+  // decoded bytes not read yet, in window
+  size_t out_pos;
+  size_t out_end;
+  uint8_t input[RESPONSE_BODY_INPUT_SIZE];
+  size_t input_pos;
+  size_t input_length;
+  bool started;  // the gzip header was read
+  bool done;
+
+  bool fill();
+  int next_input();
+  bool read_header();
+  bool inflate(bool wait);
+  void finish();
+
+ public:
+  // Reads source, inflating it if gzipped. The bytes read are counted into
+  // stats.
+  ResponseBody(Stream &source, bool gzipped, EncodingStats *stats);
+  ~ResponseBody();
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(uint8_t *buffer, size_t length) override;
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 0; }
+};
+
+} /* namespace lms */
+
+#endif /* LMS_RESPONSE_BODY_H */
@@ -0,0 +1,204 @@
+#include "sse.h"
+
+namespace lms {
+
+int EventData::available() {
+  if (this->ended) {
+    return 0;
+  }
+  if (this->value_pos < this->value_length) {
+    return this->value_length - this->value_pos;
+  }
+  if (!this->streamed) {
+    return 0;
+  }
+  EventStream *events = this->events;
+  if (events->buffer_pos < events->buffer_length) {
+    return events->buffer_length - events->buffer_pos;
+  }
+  return events->stream->available();
+}
+
+int EventData::read() {
+  if (this->ended) {
+    return -1;
+  }
+  if (this->value_pos < this->value_length) {
+    return (uint8_t)this->value[this->value_pos++];
+  }
+  int c = this->streamed ? this->events->next(true) : '\n';
+  if (c < 0 || c == '\n') {
+    this->cut = c < 0;
+    this->ended = true;
+    return -1;
+  }
+  return c;
+}
+
+int EventData::peek() {
+  if (this->ended) {
+    return -1;
+  }
+  if (this->value_pos < this->value_length) {
+    return (uint8_t)this->value[this->value_pos];
+  }
+  EventStream *events = this->events;
+  if (!this->streamed ||
+      (events->buffer_pos == events->buffer_length && !events->fill(true))) {
+    return -1;
+  }
+  int c = events->buffer[events->buffer_pos];
+  return c == '\n' ? -1 : c;
+}
+
+// Copies what was kept of the line first, then what is buffered up to the
+// end of the line, and only reads from the connection when nothing is.
+size_t EventData::readBytes(uint8_t *buffer, size_t length) {
+  EventStream *events = this->events;
+  if (this->ended || length == 0) {
+    return 0;
+  }
+  if (this->value_pos < this->value_length) {
+    size_t n = min(length, this->value_length - this->value_pos);
+    memcpy(buffer, this->value + this->value_pos, n);
+    this->value_pos += n;
+    return n;
+  }
+  if (!this->streamed) {
+    this->ended = true;
+    return 0;
+  }
+  if (events->buffer_pos == events->buffer_length && !events->fill(true)) {
+    this->cut = true;
+    this->ended = true;
+    return 0;
+  }
+  uint8_t *start = events->buffer + events->buffer_pos;
+  size_t n = min(length, (size_t)(events->buffer_length - events->buffer_pos));
+  uint8_t *newline = (uint8_t *)memchr(start, '\n', n);
+  if (newline) {
+    n = newline - start;
+    this->ended = true;
+    events->buffer_pos++;
+  }
+  memcpy(buffer, start, n);
+  events->buffer_pos += n;
+  return n;
+}
+
+void EventStream::begin(Stream &stream) {
+  this->stream = &stream;
+  this->buffer_pos = 0;
+  this->buffer_length = 0;
+  this->line_length = 0;
+  this->skipping = false;
+  strcpy(this->event, "message");
+  this->data.events = this;
+}
+
+// Reads what the connection already has, up to the size of the buffer. With
+// wait, it waits for more until the deadline of the event.
+bool EventStream::fill(bool wait) {
+  int available = this->stream->available();
+  while (available <= 0) {
+    if (!wait || (int32_t)(millis() - this->deadline_ms) >= 0) {
+      return false;
+    }
+    delay(1);
+    available = this->stream->available();
+  }
+  this->buffer_length =
+      this->stream->readBytes(this->buffer, min((size_t)available,
+                                                sizeof(this->buffer)));
+  this->buffer_pos = 0;
+  return this->buffer_length > 0;
+}
+
+int EventStream::next(bool wait) {
+  if (this->buffer_pos == this->buffer_length && !this->fill(wait)) {
+    return -1;
+  }
+  return this->buffer[this->buffer_pos++];
+}
+
+// Acts on the line kept, which is complete unless it is a long data line.
+// The data of an event is handed to handler, and true returned.
+bool EventStream::dispatch(const EventHandler &handler) {
+  size_t length = this->line_length;
+  if (!this->data.streamed && length > 0 && this->line[length - 1] == '\r') {
+    length--;
+  }
+  if (length == 0) {
+    // an empty line ends the event
+    strcpy(this->event, "message");
+    return false;
+  }
+  const char *line = this->line;
+  const char *colon = (const char *)memchr(line, ':', length);
+  size_t field_length = colon ? colon - line : length;
+  const char *value = colon ? colon + 1 : line + length;
+  size_t value_length = line + length - value;
+  // one space after the colon is not part of the value
+  if (value_length > 0 && *value == ' ') {
+    value++;
+    value_length--;
+  }
+  if (field_length == 5 && memcmp(line, "event", 5) == 0) {
+    length = min(value_length, sizeof(this->event) - 1);
+    memcpy(this->event, value, length);
+    this->event[length] = '\0';
+  } else if (field_length == 4 && memcmp(line, "data", 4) == 0) {
+    this->data.value = value;
+    this->data.value_length = value_length;
+    this->data.value_pos = 0;
+    this->data.ended = false;
+    this->data.cut = false;
+    handler(this->event, this->data);
+    while (this->data.read() >= 0) {
+    }
+    return true;
+  }
+  // anything else is a comment, id or retry
+  return false;
+}
+
+int EventStream::read_events(const EventHandler &handler) {
+  int count = 0;
+  while (this->buffer_pos < this->buffer_length || this->fill(false)) {
+    uint8_t c = this->buffer[this->buffer_pos++];
+    if (c == '\n') {
+      this->data.streamed = false;
+      if (!this->skipping && this->dispatch(handler)) {
+        count++;
+      }
+      this->line_length = 0;
+      this->skipping = false;
+      continue;
+    }
+    if (this->skipping) {
+      continue;
+    }
+    if (this->line_length < sizeof(this->line)) {
+      this->line[this->line_length++] = c;
+      continue;
+    }
+    if (memcmp(this->line, "data:", 5) != 0) {
+      this->skipping = true;
+      continue;
+    }
+    // too long to be kept, the rest is read as it arrives
+    this->buffer_pos--;
+    this->data.streamed = true;
+    this->deadline_ms = millis() + SSE_EVENT_TIMEOUT_MS;
+    this->dispatch(handler);
+    this->line_length = 0;
+    if (this->data.cut) {
+      this->skipping = true;
+      return -1;
+    }
+    count++;
+  }
+  return count;
+}
+
+} /* namespace lms */
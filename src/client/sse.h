@@ -0,0 +1,84 @@
+#include <Arduino.h>
+
+#include <functional>
+
+#ifndef LMS_SSE_H
+#define LMS_SSE_H
+
+// Event names longer than this are cut off
+#define SSE_MAX_EVENT_LENGTH 16
+// Lines up to this long are kept until they are complete, across calls
+#define SSE_MAX_LINE_LENGTH 512
+// Longest a data line that does not fit is waited for, in millis
+#define SSE_EVENT_TIMEOUT_MS 5000
+
+namespace lms {
+
+class EventStream;
+
+// The data of one event. It ends with the data line.
+class EventData : public Stream {
+  EventStream *events;
+  // the part of the line that was kept
+  const char *value;
+  size_t value_length;
+  size_t value_pos;
+  // the rest of the line is read off the connection
+  bool streamed;
+  bool ended;
+  // the connection did not send the rest of the line in time
+  bool cut;
+
+  friend class EventStream;
+
+ public:
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(uint8_t *buffer, size_t length) override;
+  using Stream::readBytes;
+  size_t write(uint8_t c) override { return 0; }
+};
+
+// Called with the name of an event and its data.
+typedef std::function<void(const char *event, Stream &data)> EventHandler;
+
+// Reads server-sent events (text/event-stream) off a response that stays
+// open.
+//
+// Only what the connection already has is read, and a line that has not
+// fully arrived is kept for the next call, so a slow event is not taken for
+// a dead connection. A data line longer than SSE_MAX_LINE_LENGTH is handed
+// over as it arrives instead, so that a large event can go straight into a
+// JsonExtractor, and its rest is waited for. The event name has to come
+// before the data, and only single line data is supported, which is how the
+// MBTA API sends its events. Comments, ids and retry times are skipped.
+class EventStream {
+  Stream *stream;
+  uint8_t buffer[64];
+  uint8_t buffer_pos;
+  uint8_t buffer_length;
+  char line[SSE_MAX_LINE_LENGTH];
+  uint16_t line_length;
+  // the line is too long to be kept and is not data
+  bool skipping;
+  char event[SSE_MAX_EVENT_LENGTH];
+  EventData data;
+  uint32_t deadline_ms;
+
+  friend class EventData;
+
+  bool fill(bool wait);
+  int next(bool wait);
+  bool dispatch(const EventHandler &handler);
+
+ public:
+  void begin(Stream &stream);
+  // Hands every event that has fully arrived to handler, returns how many
+  // there were. Returns -1 if a long data line was cut off.
+  int read_events(const EventHandler &handler);
+};
+
+} /* namespace lms */
+
+#endif /* LMS_SSE_H */
@@ -0,0 +1,205 @@
+#include "tls.h"
+
+#ifndef LMS_HOST_BUILD
+#include <WiFi.h>
+#include <lwip/sockets.h>
+#include <mbedtls/net_sockets.h>
+#include <ssl_client.h>
+#endif
+
+namespace lms {
+
+TlsSessionCache::TlsSessionCache(int size)
+    : sessions(new CachedSession[size]), size(size), clock(0) {
+  for (int i = 0; i < size; i++) {
+    this->sessions[i].host[0] = '\0';
+    this->sessions[i].last_used = 0;
+    this->sessions[i].valid = false;
+    mbedtls_ssl_session_init(&this->sessions[i].session);
+  }
+}
+
+TlsSessionCache::~TlsSessionCache() {
+  for (int i = 0; i < this->size; i++) {
+    mbedtls_ssl_session_free(&this->sessions[i].session);
+  }
+  delete[] this->sessions;
+}
+
+TlsSessionCache::CachedSession *TlsSessionCache::find(const char *host) {
+  CachedSession *found = &this->sessions[0];
+  for (int i = 0; i < this->size; i++) {
+    CachedSession *cached = &this->sessions[i];
+    if (strcmp(cached->host, host) == 0) {
+      found = cached;
+      break;
+    }
+    if (cached->last_used < found->last_used) {
+      found = cached;
+    }
+  }
+  if (strcmp(found->host, host) != 0) {
+    snprintf(found->host, sizeof(found->host), "%s", host);
+    found->valid = false;
+  }
+  found->last_used = ++this->clock;
+  return found;
+}
+
+TlsClient::TlsClient() : sessions(TLS_SESSION_CACHE_SIZE), stats{0, 0, 0} {}
+
+int TlsClient::connect(const char *host, uint16_t port, int32_t timeout) {
+  this->stop();
+  TlsSessionCache::CachedSession *cached = this->sessions.find(host);
+  int resumed =
+      this->handshake(host, port, timeout, &cached->session, cached->valid);
+  if (resumed < 0) {
+    this->stats.failed_handshakes++;
+    // it may be the session that was refused
+    cached->valid = false;
+    return 0;
+  }
+  cached->valid = true;
+  if (resumed) {
+    this->stats.resumed_handshakes++;
+  } else {
+    this->stats.full_handshakes++;
+    Serial.printf("full TLS handshake with %s\n", host);
+  }
+  return 1;
+}
+
+TlsStats TlsClient::get_stats() { return this->stats; }
+
+#ifdef LMS_HOST_BUILD
+
+int TlsClient::handshake(const char *host, uint16_t port, int32_t timeout,
+                         mbedtls_ssl_session *session, bool offer) {
+  return this->host_handshake(host, port, timeout, session, offer);
+}
+
+#else
+
+// What start_ssl_client in ssl_client.cpp does, which has no way to offer a
+// session, with the session set before the handshake and kept after it.
+// Returns 1 if the session was resumed, 0 after a full handshake and -1 if
+// the connection failed, in which case it is stopped.
+int TlsClient::handshake(const char *host, uint16_t port, int32_t timeout,
+                         mbedtls_ssl_session *session, bool offer) {
+  sslclient_context *ssl = this->sslclient;
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return -1;
+  }
+  if (timeout <= 0) {
+    timeout = 30000;
+  }
+  ssl_init(ssl);
+  mbedtls_entropy_init(&ssl->entropy_ctx);
+  ssl->socket = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (ssl->socket < 0) {
+    return -1;
+  }
+
+  // connect without blocking, so that it times out
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = ip;
+  address.sin_port = htons(port);
+  int flags = fcntl(ssl->socket, F_GETFL, 0);
+  fcntl(ssl->socket, F_SETFL, flags | O_NONBLOCK);
+  int ret = lwip_connect(ssl->socket, (struct sockaddr *)&address,
+                         sizeof(address));
+  if (ret < 0 && errno != EINPROGRESS) {
+    this->stop();
+    return -1;
+  }
+  fd_set fdset;
+  FD_ZERO(&fdset);
+  FD_SET(ssl->socket, &fdset);
+  struct timeval tv = {timeout / 1000, (timeout % 1000) * 1000};
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (select(ssl->socket + 1, NULL, &fdset, NULL, &tv) <= 0 ||
+      getsockopt(ssl->socket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 ||
+      error != 0) {
+    this->stop();
+    return -1;
+  }
+  fcntl(ssl->socket, F_SETFL, flags & ~O_NONBLOCK);
+  lwip_setsockopt(ssl->socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  lwip_setsockopt(ssl->socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  int enable = 1;
+  lwip_setsockopt(ssl->socket, IPPROTO_TCP, TCP_NODELAY, &enable,
+                  sizeof(enable));
+  lwip_setsockopt(ssl->socket, SOL_SOCKET, SO_KEEPALIVE, &enable,
+                  sizeof(enable));
+
+  const char *pers = "lms-tls-client";
+  if (mbedtls_ctr_drbg_seed(&ssl->drbg_ctx, mbedtls_entropy_func,
+                            &ssl->entropy_ctx, (const unsigned char *)pers,
+                            strlen(pers)) != 0 ||
+      mbedtls_ssl_config_defaults(&ssl->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                  MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    this->stop();
+    return -1;
+  }
+  if (this->_use_insecure) {
+    mbedtls_ssl_conf_authmode(&ssl->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+  } else if (this->_CA_cert) {
+    mbedtls_x509_crt_init(&ssl->ca_cert);
+    if (mbedtls_x509_crt_parse(&ssl->ca_cert,
+                               (const unsigned char *)this->_CA_cert,
+                               strlen(this->_CA_cert) + 1) != 0) {
+      mbedtls_x509_crt_free(&ssl->ca_cert);
+      this->stop();
+      return -1;
+    }
+    mbedtls_ssl_conf_ca_chain(&ssl->ssl_conf, &ssl->ca_cert, NULL);
+    mbedtls_ssl_conf_authmode(&ssl->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else {
+    // no way to verify the server
+    this->stop();
+    return -1;
+  }
+  mbedtls_ssl_conf_rng(&ssl->ssl_conf, mbedtls_ctr_drbg_random,
+                       &ssl->drbg_ctx);
+  if (mbedtls_ssl_setup(&ssl->ssl_ctx, &ssl->ssl_conf) != 0 ||
+      mbedtls_ssl_set_hostname(&ssl->ssl_ctx, host) != 0 ||
+      (offer && mbedtls_ssl_set_session(&ssl->ssl_ctx, session) != 0)) {
+    this->stop();
+    return -1;
+  }
+  mbedtls_ssl_set_bio(&ssl->ssl_ctx, &ssl->socket, mbedtls_net_send,
+                      mbedtls_net_recv, NULL);
+
+  unsigned long start = millis();
+  while ((ret = mbedtls_ssl_handshake(&ssl->ssl_ctx)) != 0) {
+    if ((ret != MBEDTLS_ERR_SSL_WANT_READ &&
+         ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+        millis() - start > ssl->handshake_timeout) {
+      this->stop();
+      return -1;
+    }
+    vTaskDelay(2 / portTICK_PERIOD_MS);
+  }
+  if (!this->_use_insecure &&
+      mbedtls_ssl_get_verify_result(&ssl->ssl_ctx) != 0) {
+    this->stop();
+    return -1;
+  }
+  // a server resuming the session answers with its id
+  const mbedtls_ssl_session *established = ssl->ssl_ctx.session;
+  bool resumed = offer && session->id_len > 0 &&
+                 established->id_len == session->id_len &&
+                 memcmp(established->id, session->id, session->id_len) == 0;
+  mbedtls_ssl_get_session(&ssl->ssl_ctx, session);
+  this->_connected = true;
+  return resumed ? 1 : 0;
+}
+
+#endif
+
+} /* namespace lms */
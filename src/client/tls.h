@@ -0,0 +1,67 @@
+#include <WiFiClientSecure.h>
+#include <mbedtls/ssl.h>
+
+#ifndef LMS_TLS_H
+#define LMS_TLS_H
+
+// Hosts a client keeps the TLS session of. Each client talks to one or two.
+#define TLS_SESSION_CACHE_SIZE 2
+#define TLS_MAX_HOST_LENGTH 64
+
+struct TlsStats {
+  uint32_t full_handshakes;
+  uint32_t resumed_handshakes;
+  uint32_t failed_handshakes;
+};
+
+namespace lms {
+
+// The TLS sessions of the last hosts connected to, least recently used first
+// to go.
+class TlsSessionCache {
+ public:
+  struct CachedSession {
+    char host[TLS_MAX_HOST_LENGTH];
+    uint32_t last_used;
+    bool valid;
+    mbedtls_ssl_session session;
+  };
+
+  explicit TlsSessionCache(int size);
+  ~TlsSessionCache();
+  // The session kept for host, or else the least recently used one, cleared
+  // for host. It counts as used.
+  CachedSession *find(const char *host);
+
+ private:
+  CachedSession *sessions;
+  int size;
+  uint32_t clock;
+};
+
+// A WiFiClientSecure that resumes TLS sessions.
+//
+// The session of the last hosts it connected to is kept, and offered again
+// when the client reconnects to one of them, which HTTPClient does whenever
+// the connection went down or was closed with another HTTPClient. A resumed
+// handshake skips the certificate chain and the key exchange, which are most
+// of the cost of a full one on the esp32. A server that no longer knows the
+// session does a full handshake, whose session then replaces it.
+class TlsClient : public WiFiClientSecure {
+  TlsSessionCache sessions;
+  TlsStats stats;
+
+  int handshake(const char *host, uint16_t port, int32_t timeout,
+                mbedtls_ssl_session *session, bool offer);
+
+ public:
+  TlsClient();
+  using WiFiClientSecure::connect;
+  // What HTTPClient connects with
+  int connect(const char *host, uint16_t port, int32_t timeout) override;
+  TlsStats get_stats();
+};
+
+} /* namespace lms */
+
+#endif /* LMS_TLS_H */
@@ -2,9 +2,14 @@
 
 #include "../../common.h"
 
-void Animations::setup(GFXcanvas16 *canvas) { this->canvas = canvas; }
+void Animations::setup() {
+  this->strips[ANIMATION_ID_MUSIC_TITLE] =
+      new GFXcanvas1(ANIMATION_STRIP_WIDTH, ANIMATION_FONT_HEIGHT);
+  this->strips[ANIMATION_ID_MUSIC_ARTIST] =
+      new GFXcanvas1(ANIMATION_STRIP_WIDTH, ANIMATION_FONT_HEIGHT);
+}
 
-void Animations::start_music_animations(CurrentlyPlaying song) {
+void Animations::start_music_animations(const CurrentlyPlaying &song) {
   int bbox_w = SCREEN_WIDTH - ANIMATION_IMAGE_WIDTH - 2;
   this->start_music_animation(ANIMATION_ID_MUSIC_TITLE, song.title, bbox_w,
                               song.timestamp_ms);
@@ -12,14 +17,20 @@ void Animations::start_music_animations(CurrentlyPlaying song) {
                               song.timestamp_ms);
 }
 
-void Animations::start_music_animation(AnimationId id, char *text,
+void Animations::start_music_animation(AnimationId id, const char *text,
                                        uint16_t bbox_width,
                                        uint32_t timestamp) {
   Animation animation;
   Rect text_bbox;
-  this->canvas->setFont(NULL);
-  this->canvas->getTextBounds(text, 0, 0, &text_bbox.x, &text_bbox.y,
-                              &text_bbox.w, &text_bbox.h);
+  GFXcanvas1 *strip = this->strips[id];
+  strip->fillScreen(0);
+  strip->setFont(NULL);
+  strip->setTextColor(1);
+  strip->setTextWrap(false);
+  strip->getTextBounds(text, 0, 0, &text_bbox.x, &text_bbox.y, &text_bbox.w,
+                       &text_bbox.h);
+  strip->setCursor(0, 0);
+  strip->print(text);
   if (text_bbox.w > bbox_width) {
     animation.speed = -10;
   } else {
@@ -37,6 +48,8 @@ void Animations::start_music_animation(AnimationId id, char *text,
   }
   animation.id = id;
   strncpy(animation.content.text_scroll.text, text, 128);
+  animation.content.text_scroll.width =
+      min(text_bbox.w, (uint16_t)ANIMATION_STRIP_WIDTH);
   animation.content.text_scroll.start_timestamp = timestamp;
   this->animations[id] = animation;
 }
@@ -46,17 +59,11 @@ void Animations::stop_music_animations() {
   this->animations.erase(ANIMATION_ID_MUSIC_ARTIST);
 }
 
-void Animations::draw(QueueHandle_t render_queue) {
-  if (animations.empty()) {
-    return;
-  }
-  for (auto const &[type, a] : this->animations) {
-    RenderMessage message;
-    message.type = RENDER_TYPE_ANIMATION;
-    message.content.animation = a;
-    xQueueSend(render_queue, (void *)&message, TEN_MILLIS);
-  }
-  RenderMessage message;
-  message.type = RENDER_TYPE_CANVAS_TO_DISPLAY;
-  xQueueSend(render_queue, (void *)&message, TEN_MILLIS);
-}
\ No newline at end of file
+const std::map<AnimationId, Animation> &Animations::get_animations() {
+  return this->animations;
+}
+
+GFXcanvas1 *Animations::get_strip(AnimationId id) {
+  auto strip = this->strips.find(id);
+  return strip == this->strips.end() ? NULL : strip->second;
+}
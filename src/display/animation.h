@@ -10,18 +10,23 @@
 
 #define ANIMATION_FONT_HEIGHT 8
 #define ANIMATION_IMAGE_WIDTH 32
+// wide enough for 128 characters of the default font
+#define ANIMATION_STRIP_WIDTH 768
 
 class Animations {
   std::map<AnimationId, Animation> animations;
-  GFXcanvas16 *canvas;
-  void start_music_animation(AnimationId id, char *text, uint16_t bbox_width,
-                             uint32_t timestamp);
+  // Scrolling text is rendered once, into a 1-bit strip per animation, when
+  // the animation starts. Frames copy a window of the strip.
+  std::map<AnimationId, GFXcanvas1 *> strips;
+  void start_music_animation(AnimationId id, const char *text,
+                             uint16_t bbox_width, uint32_t timestamp);
 
  public:
-  void setup(GFXcanvas16 *canvas);
-  void start_music_animations(CurrentlyPlaying song);
+  void setup();
+  void start_music_animations(const CurrentlyPlaying &song);
   void stop_music_animations();
-  void draw(QueueHandle_t render_queue);
+  const std::map<AnimationId, Animation> &get_animations();
+  GFXcanvas1 *get_strip(AnimationId id);
 };
 
 #endif
@@ -0,0 +1,202 @@
+#include "canvas.h"
+
+#include <string.h>
+
+TrackedCanvas::TrackedCanvas(uint16_t w, uint16_t h)
+    : GFXcanvas16(w, h),
+      tiles_x((w + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE),
+      tiles_y((h + CANVAS_TILE_SIZE - 1) / CANVAS_TILE_SIZE),
+      clip_depth(0) {
+  this->clips[0] = {0, 0, (int16_t)w, (int16_t)h};
+  this->dirty = new bool[tiles_x * tiles_y];
+  this->checksums = new uint32_t[tiles_x * tiles_y];
+  this->invalidate();
+}
+
+TrackedCanvas::~TrackedCanvas() {
+  delete[] this->dirty;
+  delete[] this->checksums;
+}
+
+void TrackedCanvas::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  const Clip &clip = this->clips[this->clip_depth];
+  if (x < clip.x0 || y < clip.y0 || x >= clip.x1 || y >= clip.y1) {
+    return;
+  }
+  this->dirty[(y / CANVAS_TILE_SIZE) * this->tiles_x + x / CANVAS_TILE_SIZE] =
+      true;
+  GFXcanvas16::drawPixel(x, y, color);
+}
+
+void TrackedCanvas::fillScreen(uint16_t color) {
+  if (this->clip_depth > 0) {
+    const Clip &clip = this->clips[this->clip_depth];
+    this->fillRect(clip.x0, clip.y0, clip.x1 - clip.x0, clip.y1 - clip.y0,
+                   color);
+    return;
+  }
+  this->mark(0, 0, this->width(), this->height());
+  GFXcanvas16::fillScreen(color);
+}
+
+void TrackedCanvas::drawFastVLine(int16_t x, int16_t y, int16_t h,
+                                  uint16_t color) {
+  if (h < 0) {
+    y += h + 1;
+    h = -h;
+  }
+  const Clip &clip = this->clips[this->clip_depth];
+  if (x < clip.x0 || x >= clip.x1) {
+    return;
+  }
+  int16_t y0 = max(y, clip.y0);
+  int16_t y1 = min((int16_t)(y + h), clip.y1);
+  if (y0 >= y1) {
+    return;
+  }
+  this->mark(x, y0, 1, y1 - y0);
+  GFXcanvas16::drawFastVLine(x, y0, y1 - y0, color);
+}
+
+void TrackedCanvas::drawFastHLine(int16_t x, int16_t y, int16_t w,
+                                  uint16_t color) {
+  if (w < 0) {
+    x += w + 1;
+    w = -w;
+  }
+  const Clip &clip = this->clips[this->clip_depth];
+  if (y < clip.y0 || y >= clip.y1) {
+    return;
+  }
+  int16_t x0 = max(x, clip.x0);
+  int16_t x1 = min((int16_t)(x + w), clip.x1);
+  if (x0 >= x1) {
+    return;
+  }
+  this->mark(x0, y, x1 - x0, 1);
+  GFXcanvas16::drawFastHLine(x0, y, x1 - x0, color);
+}
+
+void TrackedCanvas::write_row(int16_t x, int16_t y, const uint16_t *pixels,
+                              int16_t w) {
+  const Clip &clip = this->clips[this->clip_depth];
+  if (y < clip.y0 || y >= clip.y1) {
+    return;
+  }
+  if (x < clip.x0) {
+    pixels += clip.x0 - x;
+    w -= clip.x0 - x;
+    x = clip.x0;
+  }
+  if (x + w > clip.x1) {
+    w = clip.x1 - x;
+  }
+  if (w <= 0) {
+    return;
+  }
+  this->mark(x, y, w, 1);
+  memcpy(&this->getBuffer()[y * this->width() + x], pixels,
+         w * sizeof(uint16_t));
+}
+
+bool TrackedCanvas::push_clip(Rect bbox) {
+  if (this->clip_depth == CANVAS_MAX_CLIPS) {
+    return false;
+  }
+  const Clip &outer = this->clips[this->clip_depth];
+  Clip clip;
+  clip.x0 = max(bbox.x, outer.x0);
+  clip.y0 = max(bbox.y, outer.y0);
+  clip.x1 = max(clip.x0, min((int16_t)(bbox.x + bbox.w), outer.x1));
+  clip.y1 = max(clip.y0, min((int16_t)(bbox.y + bbox.h), outer.y1));
+  this->clips[++this->clip_depth] = clip;
+  return true;
+}
+
+void TrackedCanvas::pop_clip() {
+  if (this->clip_depth > 0) {
+    this->clip_depth--;
+  }
+}
+
+void TrackedCanvas::mark(int16_t x, int16_t y, int16_t w, int16_t h) {
+  int16_t x0 = max(x, (int16_t)0);
+  int16_t y0 = max(y, (int16_t)0);
+  int16_t x1 = min((int16_t)(x + w), this->width());
+  int16_t y1 = min((int16_t)(y + h), this->height());
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+  for (int ty = y0 / CANVAS_TILE_SIZE; ty <= (y1 - 1) / CANVAS_TILE_SIZE;
+       ty++) {
+    for (int tx = x0 / CANVAS_TILE_SIZE; tx <= (x1 - 1) / CANVAS_TILE_SIZE;
+         tx++) {
+      this->dirty[ty * this->tiles_x + tx] = true;
+    }
+  }
+}
+
+// FNV-1a over the pixels of a tile. A collision leaves a stale tile on the
+// panel until it is drawn to again, which at 32 bits is rare enough.
+uint32_t TrackedCanvas::tile_checksum(uint16_t tx, uint16_t ty) {
+  const uint16_t *buffer = this->getBuffer();
+  int16_t x0 = tx * CANVAS_TILE_SIZE;
+  int16_t y0 = ty * CANVAS_TILE_SIZE;
+  int16_t x1 = min((int16_t)(x0 + CANVAS_TILE_SIZE), this->width());
+  int16_t y1 = min((int16_t)(y0 + CANVAS_TILE_SIZE), this->height());
+  uint32_t hash = 2166136261u;
+  for (int16_t y = y0; y < y1; y++) {
+    const uint16_t *row = &buffer[y * this->width()];
+    for (int16_t x = x0; x < x1; x++) {
+      hash = (hash ^ row[x]) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+uint32_t TrackedCanvas::flush(Panel *panel) {
+  uint16_t *buffer = this->getBuffer();
+  uint32_t pixels = 0;
+  for (uint16_t ty = 0; ty < this->tiles_y; ty++) {
+    bool *row_dirty = &this->dirty[ty * this->tiles_x];
+    uint32_t *row_checksums = &this->checksums[ty * this->tiles_x];
+    // from here on, dirty means the tile has to be written
+    for (uint16_t tx = 0; tx < this->tiles_x; tx++) {
+      if (!row_dirty[tx] && this->flushed_valid) {
+        continue;
+      }
+      uint32_t checksum = this->tile_checksum(tx, ty);
+      row_dirty[tx] = !this->flushed_valid || checksum != row_checksums[tx];
+      row_checksums[tx] = checksum;
+    }
+    // write runs of neighbouring tiles one pixel row at a time
+    int16_t y0 = ty * CANVAS_TILE_SIZE;
+    int16_t y1 = min((int16_t)(y0 + CANVAS_TILE_SIZE), this->height());
+    uint16_t tx = 0;
+    while (tx < this->tiles_x) {
+      if (!row_dirty[tx]) {
+        tx++;
+        continue;
+      }
+      uint16_t run_start = tx;
+      while (tx < this->tiles_x && row_dirty[tx]) {
+        row_dirty[tx++] = false;
+      }
+      int16_t x0 = run_start * CANVAS_TILE_SIZE;
+      int16_t x1 = min((int16_t)(tx * CANVAS_TILE_SIZE), this->width());
+      for (int16_t y = y0; y < y1; y++) {
+        panel->draw_row(x0, y, &buffer[y * this->width() + x0], x1 - x0);
+      }
+      pixels += (x1 - x0) * (y1 - y0);
+    }
+  }
+  this->flushed_valid = true;
+  return pixels;
+}
+
+void TrackedCanvas::invalidate() {
+  this->flushed_valid = false;
+  for (int i = 0; i < this->tiles_x * this->tiles_y; i++) {
+    this->dirty[i] = true;
+  }
+}
@@ -0,0 +1,64 @@
+#include <Adafruit_GFX.h>
+
+#include "common.h"
+#include "panel.h"
+
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#define CANVAS_TILE_SIZE 8  // pixels, dirty regions are tracked in 8x8 tiles
+#define CANVAS_MAX_CLIPS 4
+
+// A GFXcanvas16 that keeps track of the regions that changed since it was
+// last flushed to the display, so that only those are pushed to the panel.
+//
+// Every draw marks the tiles it touches as dirty. On flush, the dirty tiles
+// are compared to what was last flushed by a checksum of their pixels, which
+// catches the common case of clearing the screen and redrawing mostly the
+// same content. Changed tiles are then written as one span per pixel row,
+// with Panel::draw_row.
+//
+// Drawing can be clipped to a rectangle. Clips nest: each pushed clip is
+// intersected with the one below it. Since all GFX drawing ends up in
+// drawPixel, drawFastVLine or drawFastHLine, the clip applies to text,
+// bitmaps and shapes alike.
+class TrackedCanvas : public GFXcanvas16 {
+  uint16_t tiles_x;
+  uint16_t tiles_y;
+  bool *dirty;          // tile was drawn to since the last flush
+  uint32_t *checksums;  // checksum of each tile when it was last flushed
+  bool flushed_valid;   // false when the display contents are unknown
+  struct Clip {
+    int16_t x0, y0, x1, y1;  // [x0, x1) x [y0, y1)
+  };
+  // clips[0] is the whole canvas, clips[clip_depth] is the active one
+  Clip clips[CANVAS_MAX_CLIPS + 1];
+  uint8_t clip_depth;
+
+  void mark(int16_t x, int16_t y, int16_t w, int16_t h);
+  uint32_t tile_checksum(uint16_t tx, uint16_t ty);
+
+ public:
+  TrackedCanvas(uint16_t w, uint16_t h);
+  ~TrackedCanvas();
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  // Copies w pixels into a row of the canvas, starting at (x, y).
+  void write_row(int16_t x, int16_t y, const uint16_t *pixels, int16_t w);
+
+  // Restricts drawing to bbox, intersected with the current clip. Returns
+  // false, and leaves the clip unchanged, if too many clips are pushed.
+  bool push_clip(Rect bbox);
+  void pop_clip();
+
+  // Writes the tiles that changed since the last flush to the panel. Returns
+  // the number of pixels written.
+  uint32_t flush(Panel *panel);
+  // Forgets what is on the display, so the next flush writes everything. Call
+  // this after drawing to the display directly.
+  void invalidate();
+};
+
+#endif /* CANVAS_H */
@@ -1,5 +1,6 @@
 #include "../mbta/mbta.h"
 #include "../spotify/spotify.h"
+#include "pool.h"
 
 #ifndef DISPLAY_COMMON_H
 #define DISPLAY_COMMON_H
@@ -23,6 +24,7 @@ enum AnimationId {
 
 struct TextAnimationContent {
   char text[128];
+  uint16_t width;  // of the rendered text, in pixels
   uint32_t start_timestamp;
 };
 
@@ -43,7 +45,7 @@ enum RenderType {
   RENDER_TYPE_TEXT,
   RENDER_TYPE_MUSIC,
   RENDER_TYPE_ANIMATION,
-  RENDER_TYPE_CANVAS_TO_DISPLAY,
+  RENDER_TYPE_MAX,
 };
 
 struct MBTARenderContent {
@@ -61,7 +63,17 @@ struct MusicRenderContent {
   CurrentlyPlaying data;
 };
 
-typedef Animation AnimationRenderContent;
+// Animations run on the render task, at the refresh rate. Providers only
+// start and stop them.
+enum AnimationAction {
+  ANIMATION_ACTION_START_MUSIC,  // scroll the title and artist of song
+  ANIMATION_ACTION_STOP_MUSIC,
+};
+
+struct AnimationRenderContent {
+  AnimationAction action;
+  CurrentlyPlaying song;
+};
 
 union RenderContent {
   MBTARenderContent mbta;
@@ -70,9 +82,11 @@ union RenderContent {
   AnimationRenderContent animation;
 };
 
+// What goes through the render mailbox. The content itself stays in the
+// mailbox's pool, so only the handle is copied.
 struct RenderMessage {
   RenderType type;
-  RenderContent content;
+  PoolHandle content;
 };
 
 #endif /* DISPLAY_COMMON_H */
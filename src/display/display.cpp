@@ -8,9 +8,8 @@
 
 Display::Display()
     : canvas(SCREEN_WIDTH, SCREEN_HEIGHT),
-      scratch_canvas(SCREEN_WIDTH, SCREEN_HEIGHT),
-      mask(SCREEN_WIDTH, SCREEN_HEIGHT),
-      image_canvas(32, 32) {
+      flush_stats{0, 0, 0},
+      music_shown(false) {
   this->AMBER = dma_display->color565(255, 191, 0);
   this->WHITE = dma_display->color565(255, 255, 255);
   this->BLACK = dma_display->color565(0, 0, 0);
@@ -30,11 +29,11 @@ void Display::setup() {
   // This is essential to avoid artifacts on the display
   mxconfig.clkphase = false;
 
-  this->dma_display = new MatrixPanel_I2S_DMA(mxconfig);
+  this->dma_display = new Panel(mxconfig);
   this->dma_display->begin();
   this->dma_display->setBrightness8(90);  // 0-255
   this->dma_display->clearScreen();
-  this->animations.setup(&this->canvas);
+  this->animations.setup();
 }
 
 void Display::log(char *message) {
@@ -43,15 +42,31 @@ void Display::log(char *message) {
   this->dma_display->setTextWrap(true);
   this->dma_display->print(message);
   this->dma_display->setTextWrap(false);
+  this->canvas.invalidate();
 }
 
 GFXcanvas16 *Display::get_canvas() { return &this->canvas; }
 
 void Display::render_canvas_to_display() {
-  this->dma_display->drawRGBBitmap(0, 0, this->canvas.getBuffer(),
-                                   this->canvas.width(), this->canvas.height());
+  uint32_t pixels = this->canvas.flush(this->dma_display);
+  this->flush_stats.frames++;
+  this->flush_stats.last_frame_pixels = pixels;
+  this->flush_stats.total_pixels += pixels;
 }
 
+FlushStats Display::get_flush_stats() { return this->flush_stats; }
+
+// The image the cover loader decodes into. It stays with the loader until it
+// is published, and only the loader may touch it.
+AlbumImage *Display::get_back_image() { return &this->images.get_back(); }
+
+// Hands the back image to the render task, which draws it from its next frame
+// on. The loader gets an older image back in its place.
+void Display::publish_image() { this->images.publish(); }
+
+// The album cover the render task draws. Only the render task may touch it.
+const AlbumImage &Display::get_image() { return this->images.get_front(); }
+
 Rect Display::get_text_bbox(char *text, int16_t x, int16_t y) {
   int16_t x0, y0;
   uint16_t w0, h0;
@@ -75,19 +90,20 @@ int Display::justify_center(char *str, int char_width) {
   return cursor_x;
 }
 
-void Display::render_text_content(TextRenderContent content) {
+void Display::render_text_content(const TextRenderContent &content) {
   Serial.println("Rendering text content");
+  this->music_shown = false;
   this->canvas.fillScreen(BLACK);
   this->canvas.setFont(NULL);
   this->canvas.setTextColor(content.color);
   this->canvas.setCursor(0, 0);
   this->canvas.print(content.text);
-  this->dma_display->drawRGBBitmap(0, 0, this->canvas.getBuffer(),
-                                   this->canvas.width(), this->canvas.height());
+  this->render_canvas_to_display();
 }
 
-void Display::render_mbta_content(MBTARenderContent content) {
+void Display::render_mbta_content(const MBTARenderContent &content) {
   Serial.println("Rendering mbta content");
+  this->music_shown = false;
   this->canvas.fillScreen(BLACK);
   this->canvas.setTextSize(1);
   this->canvas.setTextWrap(false);
@@ -96,7 +112,7 @@ void Display::render_mbta_content(MBTARenderContent content) {
   if (content.status == PREDICTION_STATUS_OK ||
       content.status == PREDICTION_STATUS_ERROR_SHOW_CACHED ||
       content.status == PREDICTION_STATUS_ERROR_EMPTY) {
-    Prediction *predictions = content.predictions;
+    const Prediction *predictions = content.predictions;
     this->canvas.setFont(&MBTASans);
 
     Prediction prediction_1 = predictions[0];
@@ -128,7 +144,7 @@ void Display::render_mbta_content(MBTARenderContent content) {
     }
   } else if (content.status == PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_1 ||
              content.status == PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_2) {
-    Prediction *predictions = content.predictions;
+    const Prediction *predictions = content.predictions;
     this->canvas.setFont(&MBTASans);
 
     Serial.printf("%s: %s\n", predictions[0].label, predictions[0].value);
@@ -149,7 +165,7 @@ void Display::render_mbta_content(MBTARenderContent content) {
     this->canvas.setCursor(cursor_x_2, 31);
     this->canvas.print(arr_banner_message_line2);
   } else if (content.status == PREDICTION_STATUS_OK_SHOW_STATION_BANNER) {
-    Prediction *predictions = content.predictions;
+    const Prediction *predictions = content.predictions;
     this->canvas.setFont(NULL);
     this->canvas.setCursor(0, 0);
     this->canvas.print(predictions[0].label);
@@ -159,11 +175,10 @@ void Display::render_mbta_content(MBTARenderContent content) {
     this->canvas.print("Failed to fetch MBTA data");
     Serial.println("Failed to fetch MBTA data");
   }
-  this->dma_display->drawRGBBitmap(0, 0, this->canvas.getBuffer(),
-                                   this->canvas.width(), this->canvas.height());
+  this->render_canvas_to_display();
 }
 
-void Display::render_music_content(MusicRenderContent content) {
+void Display::render_music_content(const MusicRenderContent &content) {
   Serial.println("Rendering music content");
   this->canvas.setFont(NULL);
   this->canvas.setTextColor(SPOTIFY_GREEN);
@@ -173,123 +188,187 @@ void Display::render_music_content(MusicRenderContent content) {
   this->dma_display->setTextColor(SPOTIFY_GREEN);
   this->dma_display->setTextWrap(false);
   this->dma_display->setCursor(0, 0);
-  if (content.status == SPOTIFY_RESPONSE_OK ||
-      content.status == SPOTIFY_RESPONSE_OK_SHOW_CACHED) {
-    CurrentlyPlaying playing = content.data;
-    int progress_bar_width = SCREEN_WIDTH - 32;
-    this->canvas.fillRect(32, SCREEN_HEIGHT - 2, progress_bar_width, 2,
-                          this->BLACK);
-    // draw progress bar
-    double progress = (double)playing.progress_ms / (double)playing.duration_ms;
-    int current_bar_width = progress_bar_width * progress;
-    this->canvas.drawRect(32, SCREEN_HEIGHT - 2, progress_bar_width, 2,
-                          this->WHITE);
-    if (current_bar_width > 0) {
-      this->canvas.drawRect(32, SCREEN_HEIGHT - 2, current_bar_width, 2,
-                            SPOTIFY_GREEN);
-    }
-    // draw time progress
-    Serial.printf("progress: %d\n", playing.progress_ms);
-    Serial.printf("duration: %d\n", playing.duration_ms);
-    Rect progress_time_bounds;
-    int16_t progress_time_x = SCREEN_HEIGHT + 1;
-    int16_t progress_time_y = SCREEN_HEIGHT - 4;
-    char progress_time[16];
-    uint32_t time_drift_ms =
-        xTaskGetTickCount() * portTICK_PERIOD_MS - playing.timestamp_ms;
-    if (time_drift_ms > 500) {
-      time_drift_ms = 0;
-    }
-    uint32_t progress_sec =
-        floor((playing.progress_ms + time_drift_ms) / 1000.0);
-    millis_to_timestring(progress_sec, progress_time, false);
-    this->canvas.setFont(&Picopixel);
-    this->canvas.getTextBounds(progress_time, progress_time_x, progress_time_y,
-                               &progress_time_bounds.x, &progress_time_bounds.y,
-                               &progress_time_bounds.w,
-                               &progress_time_bounds.h);
-    this->canvas.fillRect(progress_time_bounds.x, progress_time_bounds.y,
-                          progress_time_bounds.w + 8, progress_time_bounds.h,
-                          this->BLACK);
-    this->canvas.setCursor(progress_time_x, progress_time_y);
-    this->canvas.print(progress_time);
-    // draw time to end
-    uint32_t progress_ms =
-        min(playing.progress_ms + time_drift_ms, playing.duration_ms);
-    uint32_t time_to_end_millis = playing.duration_ms - progress_ms;
-    if (time_to_end_millis < 0) {
-      time_to_end_millis = 0;
-    }
-    uint32_t time_to_end_sec = ceil(time_to_end_millis / 1000.0);
-    Rect time_to_end_bounds;
-    int16_t time_to_end_x = 0;
-    int16_t time_to_end_y = progress_time_y;
-    char time_to_end[16];
-    millis_to_timestring(time_to_end_sec, time_to_end, true);
-    this->canvas.setFont(&Picopixel);
-    this->canvas.getTextBounds(time_to_end, time_to_end_x, time_to_end_y,
-                               &time_to_end_bounds.x, &time_to_end_bounds.y,
-                               &time_to_end_bounds.w, &time_to_end_bounds.h);
-    time_to_end_x = SCREEN_WIDTH - time_to_end_bounds.w - 1;
-    this->canvas.fillRect(time_to_end_x - 8, time_to_end_bounds.y,
-                          time_to_end_bounds.w + 16, time_to_end_bounds.h,
-                          this->BLACK);
-    this->canvas.setCursor(time_to_end_x, time_to_end_y);
-    this->canvas.print(time_to_end);
-    // draw image
-    this->canvas.drawRGBBitmap(0, 0, this->image_canvas.getBuffer(),
-                               this->image_canvas.width(),
-                               this->image_canvas.height());
-
+  this->music = content;
+  this->music_progress = {-1, 0, 0};
+  this->music_shown = content.status == SPOTIFY_RESPONSE_OK ||
+                      content.status == SPOTIFY_RESPONSE_OK_SHOW_CACHED;
+  if (this->music_shown) {
+    Serial.printf("progress: %d\n", content.data.progress_ms);
+    Serial.printf("duration: %d\n", content.data.duration_ms);
+    this->draw_music_progress(xTaskGetTickCount() * portTICK_PERIOD_MS);
+    this->images.update();
+    this->draw_album_image();
     this->render_canvas_to_display();
   } else if (content.status == SPOTIFY_RESPONSE_EMPTY) {
     this->dma_display->fillScreen(this->BLACK);
     this->dma_display->print("Nothing is playing");
+    this->canvas.invalidate();
   } else {
     this->dma_display->fillScreen(this->BLACK);
     this->dma_display->print("Error querying the spotify API");
+    this->canvas.invalidate();
   }
 }
 
-void Display::render_animation_content(AnimationRenderContent content) {
-  if (content.type == ANIMATION_TYPE_TEXT_SCROLL) {
-    this->render_text_scrolling(content, false);
+// Moves the progress bar and the time labels of the song on to now_ms. Called
+// by the render task on every refresh, so progress moves between polls; the
+// canvas is only flushed when one of them changed.
+void Display::render_music_progress(uint32_t now_ms) {
+  if (this->music_shown && this->draw_music_progress(now_ms)) {
+    this->render_canvas_to_display();
   }
 }
 
-void Display::render_text_scrolling(AnimationRenderContent content, bool draw) {
-  int16_t x0, y0;
-  uint16_t w0, h0;
-  char *text = content.content.text_scroll.text;
-  uint32_t start = content.content.text_scroll.start_timestamp;
-  Rect bbox = content.bbox;
-  int16_t speed = content.speed;
-  this->mask.fillScreen(this->BLACK);
-  this->mask.fillRect(bbox.x, bbox.y, bbox.w, bbox.h, this->WHITE);
-  this->scratch_canvas.setFont(NULL);
-  this->scratch_canvas.setTextColor(this->SPOTIFY_GREEN);
-  this->scratch_canvas.fillScreen(this->BLACK);
-  this->scratch_canvas.setTextWrap(false);
-  this->scratch_canvas.setCursor(0, 0);
-  this->scratch_canvas.getTextBounds(text, bbox.x, bbox.y, &x0, &y0, &w0, &h0);
-  uint32_t ticks_delta = xTaskGetTickCount() * portTICK_PERIOD_MS - start;
-  int wrap_width = max(bbox.w, w0) + 8;
-  int shift_x = (int)(floor(speed * ticks_delta / 1000.0)) % wrap_width;
-  int new_x = bbox.x + shift_x;
-  this->scratch_canvas.setCursor(new_x, bbox.y);
-  this->scratch_canvas.print(text);
-  this->scratch_canvas.setCursor(wrap_width + new_x, bbox.y);
-  this->scratch_canvas.print(text);
-  this->scratch_canvas.setCursor(-wrap_width + new_x, bbox.y);
-  this->scratch_canvas.print(text);
-  this->canvas.drawRGBBitmap(0, 0, this->scratch_canvas.getBuffer(),
-                             mask.getBuffer(), this->scratch_canvas.width(),
-                             this->scratch_canvas.height());
-  if (draw) {
+// Draws a cover the loader published since the last frame. Called by the
+// render task on every refresh, so the song is shown without waiting for its
+// cover, which follows once it is decoded.
+void Display::render_album_image() {
+  if (this->images.update() && this->music_shown) {
+    this->draw_album_image();
     this->render_canvas_to_display();
   }
 }
 
+// Draws the album cover next to the song, or leaves its place black while the
+// cover of the song is not there yet, rather than showing the last one.
+void Display::draw_album_image() {
+  const AlbumImage &image = this->images.get_front();
+  if (strcmp(image.url, this->music.data.cover.url) == 0) {
+    this->canvas.drawRGBBitmap(0, 0, image.image.getBuffer(),
+                               image.image.width(), image.image.height());
+  } else {
+    this->canvas.fillRect(0, 0, image.image.width(), image.image.height(),
+                          this->BLACK);
+  }
+}
+
+// Draws the progress bar and the elapsed and remaining time of the song shown,
+// as of now_ms. Returns false, without drawing, if none of them changed since
+// they were last drawn.
+bool Display::draw_music_progress(uint32_t now_ms) {
+  const CurrentlyPlaying &playing = this->music.data;
+  uint32_t progress_ms = get_progress_ms(&playing, now_ms);
+  int progress_bar_width = SCREEN_WIDTH - 32;
+  MusicProgress progress;
+  progress.bar_width =
+      playing.duration_ms > 0
+          ? (int)((uint64_t)progress_bar_width * progress_ms /
+                  playing.duration_ms)
+          : 0;
+  progress.progress_sec = progress_ms / 1000;
+  progress.time_to_end_sec =
+      ceil((playing.duration_ms - progress_ms) / 1000.0);
+  if (progress.bar_width == this->music_progress.bar_width &&
+      progress.progress_sec == this->music_progress.progress_sec &&
+      progress.time_to_end_sec == this->music_progress.time_to_end_sec) {
+    return false;
+  }
+  this->music_progress = progress;
+  // draw progress bar
+  this->canvas.fillRect(32, SCREEN_HEIGHT - 2, progress_bar_width, 2,
+                        this->BLACK);
+  this->canvas.drawRect(32, SCREEN_HEIGHT - 2, progress_bar_width, 2,
+                        this->WHITE);
+  if (progress.bar_width > 0) {
+    this->canvas.drawRect(32, SCREEN_HEIGHT - 2, progress.bar_width, 2,
+                          SPOTIFY_GREEN);
+  }
+  // draw time progress
+  this->canvas.setTextColor(SPOTIFY_GREEN);
+  Rect progress_time_bounds;
+  int16_t progress_time_x = SCREEN_HEIGHT + 1;
+  int16_t progress_time_y = SCREEN_HEIGHT - 4;
+  char progress_time[16];
+  millis_to_timestring(progress.progress_sec, progress_time, false);
+  this->canvas.setFont(&Picopixel);
+  this->canvas.getTextBounds(progress_time, progress_time_x, progress_time_y,
+                             &progress_time_bounds.x, &progress_time_bounds.y,
+                             &progress_time_bounds.w, &progress_time_bounds.h);
+  this->canvas.fillRect(progress_time_bounds.x, progress_time_bounds.y,
+                        progress_time_bounds.w + 8, progress_time_bounds.h,
+                        this->BLACK);
+  this->canvas.setCursor(progress_time_x, progress_time_y);
+  this->canvas.print(progress_time);
+  // draw time to end
+  Rect time_to_end_bounds;
+  int16_t time_to_end_x = 0;
+  int16_t time_to_end_y = progress_time_y;
+  char time_to_end[16];
+  millis_to_timestring(progress.time_to_end_sec, time_to_end, true);
+  this->canvas.getTextBounds(time_to_end, time_to_end_x, time_to_end_y,
+                             &time_to_end_bounds.x, &time_to_end_bounds.y,
+                             &time_to_end_bounds.w, &time_to_end_bounds.h);
+  time_to_end_x = SCREEN_WIDTH - time_to_end_bounds.w - 1;
+  this->canvas.fillRect(time_to_end_x - 8, time_to_end_bounds.y,
+                        time_to_end_bounds.w + 16, time_to_end_bounds.h,
+                        this->BLACK);
+  this->canvas.setCursor(time_to_end_x, time_to_end_y);
+  this->canvas.print(time_to_end);
+  return true;
+}
+
+void Display::render_animation_content(const AnimationRenderContent &content) {
+  if (content.action == ANIMATION_ACTION_START_MUSIC) {
+    this->animations.stop_music_animations();
+    this->animations.start_music_animations(content.song);
+  } else if (content.action == ANIMATION_ACTION_STOP_MUSIC) {
+    this->animations.stop_music_animations();
+  }
+}
+
+// Draws the frame of every running animation at now_ms, then flushes the
+// canvas. Called by the render task on every refresh.
+void Display::render_animations(uint32_t now_ms) {
+  const std::map<AnimationId, Animation> &animations =
+      this->animations.get_animations();
+  if (animations.empty()) {
+    return;
+  }
+  for (auto const &[id, animation] : animations) {
+    if (animation.type == ANIMATION_TYPE_TEXT_SCROLL) {
+      this->render_text_scrolling(animation, now_ms);
+    }
+  }
+  this->render_canvas_to_display();
+}
+
+// Copies the window of the animation's text strip that is visible at now_ms
+// into its bbox. The strip wraps around with an 8 pixel gap.
+void Display::render_text_scrolling(const Animation &animation,
+                                    uint32_t now_ms) {
+  GFXcanvas1 *strip = this->animations.get_strip(animation.id);
+  if (strip == NULL) {
+    return;
+  }
+  const TextAnimationContent *text = &animation.content.text_scroll;
+  Rect bbox = animation.bbox;
+  uint16_t w = min(bbox.w, (uint16_t)(SCREEN_WIDTH));
+  uint16_t h = min(bbox.h, (uint16_t)strip->height());
+  uint32_t ticks_delta = now_ms - text->start_timestamp;
+  int wrap_width = max((int)bbox.w, (int)text->width) + 8;
+  int shift_x =
+      (int)(floor(animation.speed * ticks_delta / 1000.0)) % wrap_width;
+  // strip column shown in the first column of the bbox
+  int start = (wrap_width - shift_x) % wrap_width;
+  const uint8_t *bits = strip->getBuffer();
+  int stride = (strip->width() + 7) / 8;
+  uint16_t line[SCREEN_WIDTH];
+  this->canvas.push_clip(bbox);
+  for (uint16_t row = 0; row < h; row++) {
+    const uint8_t *strip_row = &bits[row * stride];
+    int s = start;
+    for (uint16_t col = 0; col < w; col++) {
+      bool lit = s < text->width && (strip_row[s >> 3] & (0x80 >> (s & 7)));
+      line[col] = lit ? this->SPOTIFY_GREEN : this->BLACK;
+      if (++s == wrap_width) {
+        s = 0;
+      }
+    }
+    this->canvas.write_row(bbox.x, bbox.y + row, line, w);
+  }
+  this->canvas.pop_clip();
+}
+
 void millis_to_timestring(uint32_t delta_sec, char *dst, bool is_negative) {
   int seconds = delta_sec;
   int hours = floor(seconds / 3600.0);
@@ -2,37 +2,75 @@
 
 #include "../../common.h"
 #include "animation.h"
+#include "canvas.h"
 #include "common.h"
+#include "triple-buffer.h"
 
 #ifndef RENDER_H
 #define RENDER_H
 
+struct FlushStats {
+  uint32_t frames;             // calls to render_canvas_to_display
+  uint32_t last_frame_pixels;  // pixels written to the panel by the last one
+  uint64_t total_pixels;
+};
+
+// What the music progress was last drawn as.
+struct MusicProgress {
+  int bar_width;  // in pixels
+  uint32_t progress_sec;
+  uint32_t time_to_end_sec;
+};
+
+// An album cover, decoded, and the url it came from. The url is empty until
+// the image is complete.
+struct AlbumImage {
+  GFXcanvas16 image;
+  char url[sizeof(AlbumCover::url)];
+  AlbumImage() : image(32, 32), url("") {}
+};
+
 class Display {
-  MatrixPanel_I2S_DMA *dma_display;
+  Panel *dma_display;
   // Using a GFXcanvas reduces the flicker when redrawing the screen, but uses a
   // lot of memory. (160 * 32 * 2 = 10240 bytes)
   // https://learn.adafruit.com/adafruit-gfx-graphics-library/minimizing-redraw-flicker
-  GFXcanvas16 canvas;
-  GFXcanvas16 scratch_canvas;
-  GFXcanvas1 mask;
+  // Only the parts of the canvas that changed are written to the panel.
+  TrackedCanvas canvas;
+  FlushStats flush_stats;
+  // The song shown, whose progress is redrawn as it plays
+  MusicRenderContent music;
+  MusicProgress music_progress;
+  bool music_shown;
+  // Album covers. The cover loader decodes into the back image and publishes
+  // it, the render task draws the front one. Neither waits for the other.
+  TripleBuffer<AlbumImage> images;
 
   int justify_right(char *str, int char_width, int min_x);
   int justify_center(char *str, int char_width);
-  void render_text_scrolling(AnimationRenderContent content, bool draw);
+  void render_text_scrolling(const Animation &animation, uint32_t now_ms);
+  bool draw_music_progress(uint32_t now_ms);
+  void draw_album_image();
 
  public:
   Animations animations;
-  GFXcanvas16 image_canvas;
   Display();
   void setup();
   void log(char *message);
   GFXcanvas16 *get_canvas();
   Rect get_text_bbox(char *text, int16_t x, int16_t y);
   void render_canvas_to_display();
-  void render_text_content(TextRenderContent content);
-  void render_mbta_content(MBTARenderContent content);
-  void render_music_content(MusicRenderContent content);
-  void render_animation_content(AnimationRenderContent content);
+  FlushStats get_flush_stats();
+  AlbumImage *get_back_image();
+  void publish_image();
+  const AlbumImage &get_image();
+  void render_text_content(const TextRenderContent &content);
+  void render_mbta_content(const MBTARenderContent &content);
+  void render_music_content(const MusicRenderContent &content);
+  void render_music_progress(uint32_t now_ms);
+  void render_album_image();
+  void render_animation_content(const AnimationRenderContent &content);
+  void render_animations(uint32_t now_ms);
 
   uint16_t AMBER;
   uint16_t WHITE;
@@ -0,0 +1,76 @@
+#include "mailbox.h"
+
+static const char *slot_names[RENDER_TYPE_MAX] = {
+    "render_mbta",
+    "render_text",
+    "render_music",
+    "render_animation",
+};
+
+void RenderMailbox::setup() {
+  for (int type = 0; type < RENDER_TYPE_MAX; type++) {
+    this->slots[type] = xQueueCreate(1, sizeof(RenderMessage));
+    vQueueAddToRegistry(this->slots[type], slot_names[type]);
+    this->coalesced[type] = 0;
+  }
+  this->dropped = 0;
+}
+
+RenderContent *RenderMailbox::acquire(RenderType type, RenderMessage *message) {
+  message->type = type;
+  message->content = this->pool.acquire();
+  if (message->content == POOL_HANDLE_NONE) {
+    this->dropped++;
+    Serial.println("render content pool exhausted, dropping frame");
+    return NULL;
+  }
+  return &this->pool.get(message->content);
+}
+
+void RenderMailbox::send(const RenderMessage &message) {
+  QueueHandle_t slot = this->slots[message.type];
+  // Take the pending message out instead of overwriting it, so that its
+  // content can be released. If the render task takes it first, try again.
+  RenderMessage pending;
+  while (xQueueSend(slot, &message, 0) != pdTRUE) {
+    if (xQueueReceive(slot, &pending, 0)) {
+      this->pool.release(pending.content);
+      this->coalesced[message.type]++;
+    }
+  }
+}
+
+bool RenderMailbox::receive(RenderType type, RenderMessage *dst) {
+  return xQueueReceive(this->slots[type], dst, 0);
+}
+
+void RenderMailbox::discard(RenderType type) {
+  RenderMessage message;
+  if (this->receive(type, &message)) {
+    this->release(message);
+  }
+}
+
+const RenderContent &RenderMailbox::get_content(const RenderMessage &message) {
+  return this->pool.get(message.content);
+}
+
+void RenderMailbox::release(const RenderMessage &message) {
+  this->pool.release(message.content);
+}
+
+uint8_t RenderMailbox::get_pool_peak() { return this->pool.get_peak(); }
+
+uint32_t RenderMailbox::get_dropped_count() { return this->dropped; }
+
+uint32_t RenderMailbox::get_coalesced_count(RenderType type) {
+  return this->coalesced[type];
+}
+
+uint32_t RenderMailbox::get_coalesced_count() {
+  uint32_t total = 0;
+  for (int type = 0; type < RENDER_TYPE_MAX; type++) {
+    total += this->coalesced[type];
+  }
+  return total;
+}
@@ -0,0 +1,55 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <atomic>
+
+#include "common.h"
+#include "pool.h"
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+// The channel from the providers to the render task.
+//
+// Only the newest content of each type matters to the display, so instead of
+// a FIFO there is one slot per RenderType, a FreeRTOS queue of length one. A
+// send overwrites whatever is still pending in its slot and never blocks.
+// Overwritten frames are counted as coalesced.
+//
+// The content of a message lives in a preallocated pool and the queues only
+// carry its handle. A provider acquires content, fills it in place and sends
+// the message; the render task renders the content where it is and releases
+// it. Content of an overwritten message goes back to the pool on the spot.
+// At most one message per type is pending and one is being rendered, so the
+// rest of the pool covers the providers filling in the next frames.
+#define RENDER_CONTENT_POOL_SIZE 8
+
+class RenderMailbox {
+  QueueHandle_t slots[RENDER_TYPE_MAX];
+  SlabPool<RenderContent, RENDER_CONTENT_POOL_SIZE> pool;
+  std::atomic<uint32_t> coalesced[RENDER_TYPE_MAX];
+  std::atomic<uint32_t> dropped;
+
+ public:
+  void setup();
+  // Returns the content to fill in for message, or NULL when the pool is
+  // exhausted, in which case the frame is dropped.
+  RenderContent *acquire(RenderType type, RenderMessage *message);
+  // Hands the message and its content over to the render task.
+  void send(const RenderMessage &message);
+  // Takes the pending message of the given type, without waiting. Release it
+  // once its content is rendered.
+  bool receive(RenderType type, RenderMessage *dst);
+  // Drops the pending message of the given type, as when the provider that
+  // sent it has stopped.
+  void discard(RenderType type);
+  const RenderContent &get_content(const RenderMessage &message);
+  void release(const RenderMessage &message);
+  uint8_t get_pool_peak();
+  uint32_t get_dropped_count();
+  uint32_t get_coalesced_count(RenderType type);
+  uint32_t get_coalesced_count();
+};
+
+#endif /* MAILBOX_H */
@@ -0,0 +1,109 @@
+#include "panel.h"
+
+#include <string.h>
+
+// On the original ESP32 the I2S FIFO sends out the two 16-bit halves of every
+// 32-bit word swapped, so the library stores even and odd columns swapped.
+#if defined(ESP32_THE_ORIG)
+#define PANEL_COLUMNS_SWAPPED true
+#else
+#define PANEL_COLUMNS_SWAPPED false
+#endif
+
+// Spreads the gamma corrected value of a channel over the bit planes: bit
+// plane d gets the channel bit at position 3 * d + channel_bit, where
+// channel_bit is 0, 1 or 2 like BIT_R1, BIT_G1 and BIT_B1.
+static uint32_t spread_over_planes(uint8_t value, int channel_bit) {
+  uint16_t lum = lumConvTab[value];
+  uint32_t planes = 0;
+  for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+    if (lum & PIXEL_COLOR_MASK_BIT(d)) {
+      planes |= 1UL << (3 * d + channel_bit);
+    }
+  }
+  return planes;
+}
+
+Panel::Panel(const HUB75_I2S_CFG &config) : MatrixPanel_I2S_DMA(config) {
+  uint8_t r, g, b;
+  for (uint16_t i = 0; i < 64; i++) {
+    // expand each RGB565 channel exactly as drawPixel does
+    color565to888((i & 0x1F) << 11 | i << 5 | (i & 0x1F), r, g, b);
+    if (i < 32) {
+      this->red_planes[i] = spread_over_planes(r, 0);
+      this->blue_planes[i] = spread_over_planes(b, 2);
+    }
+    this->green_planes[i] = spread_over_planes(g, 1);
+  }
+}
+
+void Panel::draw_row(int16_t x, int16_t y, const uint16_t *pixels, int16_t w) {
+  if (y < 0 || y >= this->height() || this->dma_buff.rows == 0) {
+    return;
+  }
+  if (x < 0) {
+    pixels -= x;
+    w += x;
+    x = 0;
+  }
+  if (x + w > this->width()) {
+    w = this->width() - x;
+  }
+  if (w <= 0) {
+    return;
+  }
+
+  // the top and bottom half of the panel are shifted in in parallel, as the
+  // RGB1 and RGB2 bits of the same words
+  int16_t row = y;
+  uint8_t shift = 0;
+  uint16_t clear = BITMASK_RGB1_CLEAR;
+  if (row >= this->dma_buff.rows) {
+    row -= this->dma_buff.rows;
+    shift = BITS_RGB2_OFFSET;
+    clear = BITMASK_RGB2_CLEAR;
+  }
+  ESP32_I2S_DMA_STORAGE_TYPE *planes[PIXEL_COLOR_DEPTH_BITS];
+  for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+    planes[d] =
+        this->dma_buff.rowBits[row]->getDataPtr(d, this->back_buffer_id);
+  }
+
+  int16_t i = 0;
+  int16_t end = x + w;
+  int16_t col = x;
+  // a span starting on an odd column, or ending on an even one, shares its
+  // first or last word with a pixel outside the span
+  if (col & 1) {
+    uint32_t bits = this->to_planes(pixels[i++]);
+    int16_t index = PANEL_COLUMNS_SWAPPED ? col - 1 : col;
+    for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+      planes[d][index] =
+          (planes[d][index] & clear) | (((bits >> (3 * d)) & 0x7) << shift);
+    }
+    col++;
+  }
+  uint32_t clear_word = (uint32_t)clear << 16 | clear;
+  for (; col + 1 < end; col += 2, i += 2) {
+    uint32_t even = this->to_planes(pixels[i]);
+    uint32_t odd = this->to_planes(pixels[i + 1]);
+    uint32_t low = PANEL_COLUMNS_SWAPPED ? odd : even;
+    uint32_t high = PANEL_COLUMNS_SWAPPED ? even : odd;
+    for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+      uint32_t word;
+      memcpy(&word, &planes[d][col], sizeof(word));
+      word = (word & clear_word) |
+             ((((high >> (3 * d)) & 0x7) << 16 | ((low >> (3 * d)) & 0x7))
+              << shift);
+      memcpy(&planes[d][col], &word, sizeof(word));
+    }
+  }
+  if (col < end) {
+    uint32_t bits = this->to_planes(pixels[i]);
+    int16_t index = PANEL_COLUMNS_SWAPPED ? col + 1 : col;
+    for (int d = 0; d < PIXEL_COLOR_DEPTH_BITS; d++) {
+      planes[d][index] =
+          (planes[d][index] & clear) | (((bits >> (3 * d)) & 0x7) << shift);
+    }
+  }
+}
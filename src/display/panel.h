@@ -0,0 +1,34 @@
+#include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
+
+#ifndef PANEL_H
+#define PANEL_H
+
+// The HUB75 panel, with a bulk path for writing rows of RGB565 pixels.
+//
+// The library converts and packs one pixel at a time: a gamma lookup per
+// channel and a read-modify-write of one DMA word per colour depth bit. Here
+// the gamma lookups for every RGB565 channel value are folded, once, into
+// tables that give the bits of a pixel for all bit planes at once, and two
+// neighbouring pixels, which share a 32-bit DMA word, are written together.
+// The result is bit for bit the same as drawing the pixels one by one.
+class Panel : public MatrixPanel_I2S_DMA {
+  // bits of a channel value for each bit plane, three bits per plane, with
+  // red, green and blue already in their R1 G1 B1 positions
+  uint32_t red_planes[32];
+  uint32_t green_planes[64];
+  uint32_t blue_planes[32];
+
+  uint32_t to_planes(uint16_t color) {
+    return this->red_planes[color >> 11] |
+           this->green_planes[(color >> 5) & 0x3F] |
+           this->blue_planes[color & 0x1F];
+  }
+
+ public:
+  Panel(const HUB75_I2S_CFG &config);
+  // Writes w pixels of a row, starting at (x, y). Pixels outside the panel
+  // are skipped.
+  void draw_row(int16_t x, int16_t y, const uint16_t *pixels, int16_t w);
+};
+
+#endif /* PANEL_H */
@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include <atomic>
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef uint8_t PoolHandle;
+
+#define POOL_HANDLE_NONE 0xFF
+
+// A fixed number of preallocated T, handed out as small handles.
+//
+// Each slot has a single owner at a time: acquire() hands out a free slot and
+// the owner's release() frees it again. Ownership moves with the handle, as
+// from a provider to the render task, but is never shared. Nothing is
+// allocated after construction, and all calls are safe from any task.
+template <typename T, uint8_t N>
+class SlabPool {
+  T slots[N];
+  std::atomic<bool> used[N];
+  std::atomic<uint8_t> peak;
+
+ public:
+  SlabPool() {
+    for (uint8_t i = 0; i < N; i++) {
+      this->used[i] = false;
+    }
+    this->peak = 0;
+  }
+
+  // Returns POOL_HANDLE_NONE when every slot is in use.
+  PoolHandle acquire() {
+    for (uint8_t i = 0; i < N; i++) {
+      bool expected = false;
+      if (this->used[i].compare_exchange_strong(expected, true)) {
+        uint8_t in_use = this->in_use();
+        uint8_t seen = this->peak;
+        while (in_use > seen &&
+               !this->peak.compare_exchange_weak(seen, in_use)) {
+        }
+        return i;
+      }
+    }
+    return POOL_HANDLE_NONE;
+  }
+
+  void release(PoolHandle handle) { this->used[handle] = false; }
+
+  T &get(PoolHandle handle) { return this->slots[handle]; }
+
+  uint8_t in_use() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < N; i++) {
+      if (this->used[i]) count++;
+    }
+    return count;
+  }
+
+  uint8_t get_peak() const { return this->peak; }
+
+  static constexpr uint8_t size() { return N; }
+};
+
+#endif /* POOL_H */
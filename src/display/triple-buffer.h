@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include <atomic>
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+// Hands whole values of T from one writer task to one reader task, without
+// either of them waiting and without the reader ever seeing a value that is
+// half written.
+//
+// Of the three T, the writer owns one (the back) and the reader another (the
+// front). The third is spare. publish() swaps the back with the spare and
+// marks it fresh; update() swaps the front with the spare when it is fresh.
+// Each swap is one atomic exchange, so neither side ever touches a T the
+// other one owns. A value published before the reader took the one before
+// it replaces it, the newest wins.
+//
+// After publish() the writer gets an older value back, which it has to
+// overwrite completely.
+template <typename T>
+class TripleBuffer {
+  static const uint8_t FRESH = 0x80;
+
+  T slots[3];
+  uint8_t back;
+  uint8_t front;
+  std::atomic<uint8_t> spare;  // index, with FRESH set until taken
+
+ public:
+  TripleBuffer() : back(0), front(1), spare(2) {}
+
+  // Writer side
+  T &get_back() { return this->slots[this->back]; }
+  void publish() {
+    this->back = this->spare.exchange(this->back | FRESH) & ~FRESH;
+  }
+
+  // Reader side. Returns true if a newer value became the front.
+  bool update() {
+    if (!(this->spare.load() & FRESH)) {
+      return false;
+    }
+    this->front = this->spare.exchange(this->front) & ~FRESH;
+    return true;
+  }
+  T &get_front() { return this->slots[this->front]; }
+};
+
+#endif /* TRIPLE_BUFFER_H */
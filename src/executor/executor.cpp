@@ -0,0 +1,165 @@
+#include "executor.h"
+
+namespace lms {
+
+void Executor::setup(HttpEngine *engine) {
+  this->count = 0;
+  this->engine = engine;
+  this->task = NULL;
+  this->stopping = false;
+  this->polling = false;
+  this->stats = {0, 0};
+}
+
+Coroutine *Executor::spawn(const char *name, CoroutineFunction function,
+                           uint32_t stack_size, void *state) {
+  if (this->count == EXECUTOR_MAX_COROUTINES) {
+    return NULL;
+  }
+  Coroutine *co = &this->coroutines[this->count];
+  *co = {};
+  co->name = name;
+  co->function = function;
+  co->state = state;
+  co->stack_size = stack_size;
+  co->event = 1UL << this->count;
+  this->count++;
+  return co;
+}
+
+void Executor::start(const char *name, UBaseType_t priority,
+                     BaseType_t core_id) {
+  uint32_t stack_size = this->get_footprint().stack_bytes;
+  this->stopping = false;
+  xTaskCreatePinnedToCore(run_task, name, stack_size, this, priority,
+                          &this->task, core_id);
+}
+
+void Executor::stop() {
+  this->stopping = true;
+  TaskHandle_t task = this->task;
+  if (task != NULL) {
+    xTaskNotify(task, 0, eNoAction);
+    if (this->polling) {
+      this->engine->wake();
+    }
+  }
+  while (this->task != NULL) {
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+  }
+  this->count = 0;
+  this->stopping = false;
+}
+
+void Executor::wake(Coroutine *co) {
+  TaskHandle_t task = this->task;
+  if (co != NULL && task != NULL) {
+    xTaskNotify(task, co->event, eSetBits);
+    // select() does not see the notification
+    if (this->polling) {
+      this->engine->wake();
+    }
+  }
+}
+
+bool Executor::is_running() { return this->task != NULL; }
+
+ExecutorStats Executor::get_stats() { return this->stats; }
+
+ExecutorFootprint Executor::get_footprint() {
+  ExecutorFootprint footprint = {(uint32_t)this->count, 0, 0,
+                                 (uint32_t)(this->count * sizeof(Coroutine))};
+  for (int i = 0; i < this->count; i++) {
+    footprint.stack_bytes =
+        max(footprint.stack_bytes, this->coroutines[i].stack_size);
+    footprint.task_stack_bytes += this->coroutines[i].stack_size;
+  }
+  return footprint;
+}
+
+void Executor::run_task(void *params) {
+  Executor *executor = (Executor *)params;
+  executor->run();
+  // lets stop() know
+  executor->task = NULL;
+  vTaskDelete(NULL);
+}
+
+void Executor::run() {
+  while (!this->stopping) {
+    uint32_t now_ms = millis();
+    // what one coroutine did may have readied another
+    while (this->resume_ready(now_ms) && !this->stopping) {
+      now_ms = millis();
+    }
+    if (this->stopping) {
+      break;
+    }
+    uint32_t events = 0;
+    TickType_t wait = this->next_wait(now_ms);
+    if (this->engine && this->engine->pending() > 0) {
+      // set before the notification is looked at, so that a wake() after it
+      // has the poll return
+      this->polling = true;
+      xTaskNotifyWait(0, UINT32_MAX, &events, 0);
+      uint32_t wait_ms = EXECUTOR_ENGINE_POLL_MS;
+      if (wait != portMAX_DELAY) {
+        wait_ms = min(wait_ms, (uint32_t)(wait * portTICK_PERIOD_MS));
+      }
+      if (events == 0 && this->engine->poll(wait_ms) > 0) {
+        events |= EXECUTOR_EVENT_ENGINE;
+      }
+      this->polling = false;
+    } else {
+      xTaskNotifyWait(0, UINT32_MAX, &events, wait);
+    }
+    this->stats.wakeups++;
+    for (int i = 0; i < this->count; i++) {
+      Coroutine *co = &this->coroutines[i];
+      // an event of its own waits for it, the engine's only if it waits
+      co->pending |= events & (co->event | (co->wait_events &
+                                            EXECUTOR_EVENT_ENGINE));
+    }
+  }
+}
+
+// Resumes the coroutines with something to do. Returns whether any was.
+bool Executor::resume_ready(uint32_t now_ms) {
+  bool resumed = false;
+  for (int i = 0; i < this->count; i++) {
+    Coroutine *co = &this->coroutines[i];
+    if (co->line < 0) {
+      continue;
+    }
+    bool ready = co->line == 0 || (co->pending & co->wait_events) ||
+                 (co->has_deadline &&
+                  (int32_t)(now_ms - co->deadline_ms) >= 0) ||
+                 (co->ready && co->ready());
+    if (!ready) {
+      continue;
+    }
+    co->events = co->pending & co->wait_events;
+    co->pending &= ~co->wait_events;
+    co->function(co);
+    this->stats.resumes++;
+    resumed = true;
+  }
+  return resumed;
+}
+
+// Ticks until the nearest deadline, portMAX_DELAY if none
+TickType_t Executor::next_wait(uint32_t now_ms) {
+  TickType_t wait = portMAX_DELAY;
+  for (int i = 0; i < this->count; i++) {
+    const Coroutine *co = &this->coroutines[i];
+    if (co->line < 0 || !co->has_deadline) {
+      continue;
+    }
+    int32_t left_ms = co->deadline_ms - now_ms;
+    TickType_t ticks = left_ms > 0 ? left_ms / portTICK_PERIOD_MS : 0;
+    wait = min(wait, ticks);
+  }
+  return wait;
+}
+
+} /* namespace lms */
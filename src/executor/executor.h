@@ -0,0 +1,152 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "../client/http-engine.h"
+
+#ifndef LMS_EXECUTOR_H
+#define LMS_EXECUTOR_H
+
+// Coroutines an executor runs at once
+#define EXECUTOR_MAX_COROUTINES 4
+// Sent to the coroutines waiting on it when the engine finished requests
+#define EXECUTOR_EVENT_ENGINE (1UL << 31)
+// Longest the executor waits on the engine's connections before it looks at
+// its events again, in millis. wake() cuts the wait short, this is only for
+// an engine that cannot be woken.
+#define EXECUTOR_ENGINE_POLL_MS 100
+
+namespace lms {
+
+struct Coroutine;
+
+// The body of a coroutine. It is called again from where it last waited,
+// and returns true while it waits, false once it is done.
+typedef bool (*CoroutineFunction)(Coroutine *co);
+
+// A stackless coroutine, as in protothreads: its locals do not survive a
+// wait, only what it keeps in globals or in state.
+struct Coroutine {
+  const char *name;
+  CoroutineFunction function;
+  void *state;
+  // what its task would have reserved in the task-per-provider design
+  uint32_t stack_size;
+  // the line it waits on, 0 before it started and -1 once it is done
+  int line;
+  // its own event, sent by Executor::wake()
+  uint32_t event;
+  // what it waits for: any of wait_events, the deadline or ready()
+  uint32_t wait_events;
+  bool has_deadline;
+  uint32_t deadline_ms;
+  bool (*ready)();
+  // its events not yet handed to it, and those it was resumed with
+  uint32_t pending;
+  uint32_t events;
+};
+
+// Resumes co at the wait it returned from
+#define CO_BEGIN(co)     \
+  switch ((co)->line) {  \
+    case 0:
+
+#define CO_END(co) \
+  }                \
+  (co)->line = -1; \
+  return false;
+
+// Waits until any of events is sent to co, which finds them in co->events
+#define CO_WAIT_EVENTS(co, mask)        \
+  do {                                  \
+    (co)->wait_events = (mask);         \
+    (co)->has_deadline = false;         \
+    (co)->ready = NULL;                 \
+    (co)->line = __LINE__;              \
+    return true;                        \
+    case __LINE__:;                     \
+  } while (0)
+
+// Waits for ms millis
+#define CO_SLEEP(co, ms)                      \
+  do {                                        \
+    (co)->wait_events = 0;                    \
+    (co)->has_deadline = true;                \
+    (co)->deadline_ms = millis() + (ms);      \
+    (co)->ready = NULL;                       \
+    (co)->line = __LINE__;                    \
+    return true;                              \
+    case __LINE__:;                           \
+  } while (0)
+
+// Waits until is_ready() returns true. It is asked before the executor
+// sleeps, so it must be made true by a coroutine of the same executor, or
+// along with a wake().
+#define CO_WAIT_READY(co, is_ready)  \
+  do {                               \
+    (co)->wait_events = 0;           \
+    (co)->has_deadline = false;      \
+    (co)->ready = (is_ready);        \
+    (co)->line = __LINE__;           \
+    return true;                     \
+    case __LINE__:;                  \
+  } while (0)
+
+struct ExecutorStats {
+  uint32_t wakeups;  // the task woke, to resume coroutines or not
+  uint32_t resumes;
+};
+
+// RAM the executor takes against a task per coroutine
+struct ExecutorFootprint {
+  uint32_t coroutines;
+  uint32_t stack_bytes;       // of its one task, the largest stack_size
+  uint32_t task_stack_bytes;  // of a task per coroutine, stack_size each
+  uint32_t state_bytes;       // of the coroutines, kept in the executor
+};
+
+// Runs coroutines on one task, in place of a task each. The task sleeps
+// until a coroutine has something to do: an event sent to it, its deadline,
+// or the HTTP engine finishing a request. It waits on the engine's
+// connections while requests are in flight, so a response is handled as
+// soon as it is in, and wake() has the engine return from that wait.
+//
+// Coroutines are spawned before start() and dropped by stop(), which waits
+// for the task to end between two resumes.
+class Executor {
+  Coroutine coroutines[EXECUTOR_MAX_COROUTINES];
+  int count;
+  HttpEngine *engine;
+  TaskHandle_t task;
+  volatile bool stopping;
+  // set while the task may be waiting on the engine rather than its
+  // notification
+  volatile bool polling;
+  ExecutorStats stats;
+
+  static void run_task(void *params);
+  void run();
+  bool resume_ready(uint32_t now_ms);
+  TickType_t next_wait(uint32_t now_ms);
+
+ public:
+  // engine may be NULL, for coroutines that make no requests
+  void setup(HttpEngine *engine);
+  // Adds a coroutine, to run from start(). Returns NULL if there are
+  // EXECUTOR_MAX_COROUTINES already.
+  Coroutine *spawn(const char *name, CoroutineFunction function,
+                   uint32_t stack_size, void *state = NULL);
+  // Creates the task, with the stack the hungriest coroutine needs
+  void start(const char *name, UBaseType_t priority, BaseType_t core_id);
+  // Waits for the task to end and drops the coroutines
+  void stop();
+  // Sends co its event, waking the task from a wait on the engine too. Safe
+  // from any task, or a timer.
+  void wake(Coroutine *co);
+  bool is_running();
+  ExecutorStats get_stats();
+  ExecutorFootprint get_footprint();
+};
+
+} /* namespace lms */
+
+#endif /* LMS_EXECUTOR_H */
@@ -1,10 +1,14 @@
 #include "mbta.h"
 
+#include <strings.h>
 #include <time.h>
 
+#include <algorithm>
+
 #include "mbta-api-key.h"
 #include "mbta-cert.h"
 
+#define MBTA_API_URL "https://api-v3.mbta.com/"
 #define MBTA_REQUEST                                                    \
   "https://api-v3.mbta.com/predictions?"                                \
   "api_key=%s&"                                                         \
@@ -13,13 +17,409 @@
   "fields[prediction]=arrival_time,departure_time,status,direction_id&" \
   "include=trip"
 
-#define DEFAULT_TRAIN_STATION TRAIN_STATION_HARVARD
+// The fields of a resource, as read from a response or an event
+enum MBTAField {
+  MBTA_FIELD_TYPE,
+  MBTA_FIELD_ID,
+  MBTA_FIELD_ARRIVAL_TIME,
+  MBTA_FIELD_DEPARTURE_TIME,
+  MBTA_FIELD_DIRECTION_ID,
+  MBTA_FIELD_STATUS,
+  MBTA_FIELD_TRIP_ID,
+  MBTA_FIELD_ROUTE_ID,
+  MBTA_FIELD_HEADSIGN,
+  MBTA_FIELD_MAX,
+};
+
+// A response lists the predictions in data and their trips in included.
+static const char *const polled_fields[] = {
+    "data[].type",
+    "data[].id",
+    "data[].attributes.arrival_time",
+    "data[].attributes.departure_time",
+    "data[].attributes.direction_id",
+    "data[].attributes.status",
+    "data[].relationships.trip.data.id",
+    "data[].relationships.route.data.id",
+    "included[].type",
+    "included[].id",
+    "included[].attributes.headsign",
+};
+static const uint8_t polled_field_ids[] = {
+    MBTA_FIELD_TYPE,         MBTA_FIELD_ID,
+    MBTA_FIELD_ARRIVAL_TIME, MBTA_FIELD_DEPARTURE_TIME,
+    MBTA_FIELD_DIRECTION_ID, MBTA_FIELD_STATUS,
+    MBTA_FIELD_TRIP_ID,      MBTA_FIELD_ROUTE_ID,
+    MBTA_FIELD_TYPE,         MBTA_FIELD_ID,
+    MBTA_FIELD_HEADSIGN,
+};
+#define POLLED_FIELDS_INCLUDED 8
+#define NUM_POLLED_FIELDS (sizeof(polled_fields) / sizeof(polled_fields[0]))
+
+// A reset event is an array of predictions and trips, the other events are
+// a single one. Fields are in the order of MBTAField.
+static const char *const reset_fields[MBTA_FIELD_MAX] = {
+    "[].type",
+    "[].id",
+    "[].attributes.arrival_time",
+    "[].attributes.departure_time",
+    "[].attributes.direction_id",
+    "[].attributes.status",
+    "[].relationships.trip.data.id",
+    "[].relationships.route.data.id",
+    "[].attributes.headsign",
+};
+static const char *const event_fields[MBTA_FIELD_MAX] = {
+    "type",
+    "id",
+    "attributes.arrival_time",
+    "attributes.departure_time",
+    "attributes.direction_id",
+    "attributes.status",
+    "relationships.trip.data.id",
+    "relationships.route.data.id",
+    "attributes.headsign",
+};
+
+enum ResourceType {
+  RESOURCE_TYPE_OTHER,
+  RESOURCE_TYPE_PREDICTION,
+  RESOURCE_TYPE_TRIP,
+};
+
+// A prediction or a trip, while its fields come in. A trip only has an id and
+// a headsign.
+struct Resource {
+  uint8_t type;  // ResourceType
+  uint8_t headsign;
+  PredictionRecord record;
+};
+
+// A response or an event while it streams in. Fields come one resource after
+// the other, and each resource is applied to the table once the next one
+// starts.
+struct ResourceParse {
+  PredictionTable *dst;
+  // the MBTAField of each path, NULL if the paths are in that order
+  const uint8_t *field_ids;
+  // paths from this one on are in a second array
+  uint8_t second_array;
+  bool remove;
+  bool started;  // once the first field came in
+  int array;
+  int index;  // of the resource in its array, -1 outside of one
+  Resource resource;
+};
+
+static uint32_t hash_id(const char *id) {
+  uint32_t hash = 2166136261u;
+  for (; *id; id++) {
+    hash = (hash ^ (uint8_t)*id) * 16777619u;
+  }
+  return hash;
+}
+
+static uint8_t intern_name(PredictionTable *table, const char *name) {
+  for (uint8_t i = 0; i < table->num_names; i++) {
+    if (strcmp(table->names[i], name) == 0) {
+      return i;
+    }
+  }
+  if (table->num_names == MBTA_MAX_NAMES) {
+    return MBTA_NO_NAME;
+  }
+  snprintf(table->names[table->num_names], MBTA_MAX_NAME_LENGTH, "%s", name);
+  return table->num_names++;
+}
+
+static int parse_digits(const char *text, int n) {
+  int value = 0;
+  for (int i = 0; i < n; i++) {
+    if (text[i] < '0' || text[i] > '9') {
+      return -1;
+    }
+    value = value * 10 + text[i] - '0';
+  }
+  return value;
+}
+
+// source: https://howardhinnant.github.io/date_algorithms.html
+static int32_t days_from_civil(int year, int month, int day) {
+  year -= month <= 2;
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int year_of_era = year - era * 400;
+  int day_of_year =
+      (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+                   day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+// Epoch seconds of a time like 2024-05-14T08:14:20-04:00, or 0.
+static uint32_t parse_time(const char *text) {
+  if (strlen(text) < 19 || text[4] != '-' || text[7] != '-' ||
+      text[10] != 'T' || text[13] != ':' || text[16] != ':') {
+    return 0;
+  }
+  int year = parse_digits(text, 4);
+  int month = parse_digits(text + 5, 2);
+  int day = parse_digits(text + 8, 2);
+  int hour = parse_digits(text + 11, 2);
+  int minute = parse_digits(text + 14, 2);
+  int second = parse_digits(text + 17, 2);
+  if (year < 0 || month < 0 || day < 0 || hour < 0 || minute < 0 ||
+      second < 0) {
+    return 0;
+  }
+  int32_t offset = 0;
+  if ((text[19] == '+' || text[19] == '-') && strlen(text) >= 25) {
+    offset =
+        parse_digits(text + 20, 2) * 3600 + parse_digits(text + 23, 2) * 60;
+    if (text[19] == '-') {
+      offset = -offset;
+    }
+  }
+  return days_from_civil(year, month, day) * 86400 + hour * 3600 +
+         minute * 60 + second - offset;
+}
+
+static bool mentions_stopped(const char *status) {
+  for (; *status; status++) {
+    if (strncasecmp(status, "stopped", 7) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void start_resource(ResourceParse *parse, int array, int index) {
+  parse->started = true;
+  parse->array = array;
+  parse->index = index;
+  Resource *resource = &parse->resource;
+  memset(resource, 0, sizeof(Resource));
+  resource->headsign = MBTA_NO_NAME;
+  resource->record.direction = 0xFF;
+  resource->record.headsign = MBTA_NO_NAME;
+  resource->record.route = MBTA_NO_NAME;
+}
+
+// Adds, replaces or removes a prediction or trip by its id.
+static void apply_resource(PredictionTable *table, const Resource *resource,
+                           bool remove) {
+  if (resource->type == RESOURCE_TYPE_PREDICTION) {
+    uint8_t i = 0;
+    while (i < table->num_records &&
+           table->records[i].id != resource->record.id) {
+      i++;
+    }
+    if (remove) {
+      if (i < table->num_records) {
+        memmove(&table->records[i], &table->records[i + 1],
+                (table->num_records - i - 1) * sizeof(PredictionRecord));
+        table->num_records--;
+      }
+    } else if (i < MBTA_MAX_PREDICTIONS) {
+      table->records[i] = resource->record;
+      table->num_records = max(table->num_records, (uint8_t)(i + 1));
+    }
+  } else if (resource->type == RESOURCE_TYPE_TRIP) {
+    uint8_t i = 0;
+    while (i < table->num_trips && table->trip_ids[i] != resource->record.id) {
+      i++;
+    }
+    if (remove) {
+      if (i < table->num_trips) {
+        table->num_trips--;
+        table->trip_ids[i] = table->trip_ids[table->num_trips];
+        table->trip_headsigns[i] = table->trip_headsigns[table->num_trips];
+      }
+    } else if (i < MBTA_MAX_PREDICTIONS) {
+      table->trip_ids[i] = resource->record.id;
+      table->trip_headsigns[i] = resource->headsign;
+      table->num_trips = max(table->num_trips, (uint8_t)(i + 1));
+    }
+  }
+}
+
+static void finish_resource(ResourceParse *parse) {
+  if (parse->started) {
+    apply_resource(parse->dst, &parse->resource, parse->remove);
+  }
+}
+
+static void store_field(ResourceParse *parse, int path,
+                        const lms::JsonValue &value) {
+  int array = path >= parse->second_array;
+  if (!parse->started || array != parse->array ||
+      value.index != parse->index) {
+    finish_resource(parse);
+    start_resource(parse, array, value.index);
+  }
+  int field = parse->field_ids ? parse->field_ids[path] : path;
+  bool is_null = value.type == lms::JSON_VALUE_NULL;
+  Resource *resource = &parse->resource;
+  PredictionRecord *record = &resource->record;
+  switch (field) {
+    case MBTA_FIELD_TYPE:
+      if (strcmp(value.text, "prediction") == 0) {
+        resource->type = RESOURCE_TYPE_PREDICTION;
+      } else if (strcmp(value.text, "trip") == 0) {
+        resource->type = RESOURCE_TYPE_TRIP;
+      }
+      break;
+    case MBTA_FIELD_ID:
+      record->id = hash_id(value.text);
+      break;
+    case MBTA_FIELD_ARRIVAL_TIME:
+      record->arrival = is_null ? 0 : parse_time(value.text);
+      break;
+    case MBTA_FIELD_DEPARTURE_TIME:
+      record->departure = is_null ? 0 : parse_time(value.text);
+      break;
+    case MBTA_FIELD_DIRECTION_ID:
+      record->direction = atoi(value.text);
+      break;
+    case MBTA_FIELD_STATUS:
+      if (is_null || strlen(value.text) == 0) {
+        record->status = TRAIN_STATUS_NONE;
+      } else if (mentions_stopped(value.text)) {
+        record->status = TRAIN_STATUS_STOPPED;
+      } else {
+        record->status = TRAIN_STATUS_OTHER;
+        int i = 0;
+        for (; value.text[i] && i < 6; i++) {
+          record->status_text[i] = tolower(value.text[i]);
+        }
+        record->status_text[i] = '\0';
+      }
+      break;
+    case MBTA_FIELD_TRIP_ID:
+      record->trip = hash_id(value.text);
+      break;
+    case MBTA_FIELD_ROUTE_ID:
+      if (!is_null) {
+        record->route = intern_name(parse->dst, value.text);
+      }
+      break;
+    case MBTA_FIELD_HEADSIGN:
+      if (!is_null) {
+        resource->headsign = intern_name(parse->dst, value.text);
+      }
+      break;
+  }
+}
+
+// Streams a response or event into table. extract runs the extractor with
+// the handler it is given, so that the caller picks the fields and reports
+// failures.
+template <typename Extract>
+static bool parse_resources(PredictionTable *table, const uint8_t *field_ids,
+                            uint8_t second_array, bool remove,
+                            Extract extract) {
+  ResourceParse parse;
+  parse.dst = table;
+  parse.field_ids = field_ids;
+  parse.second_array = second_array;
+  parse.remove = remove;
+  parse.started = false;
+  if (!extract([&parse](int field, const lms::JsonValue &value) {
+        store_field(&parse, field, value);
+      })) {
+    return false;
+  }
+  finish_resource(&parse);
+  return true;
+}
+
+static void clear_table(PredictionTable *table) {
+  table->num_records = 0;
+  table->num_trips = 0;
+  table->num_names = 0;
+}
+
+static uint32_t record_time(const PredictionRecord *record) {
+  return record->arrival ? record->arrival : record->departure;
+}
+
+// Indexes the predictions still ahead at now by direction.
+static void index_by_direction(PredictionTable *table, uint32_t now) {
+  table->num_by_direction[0] = 0;
+  table->num_by_direction[1] = 0;
+  for (uint8_t i = 0; i < table->num_records; i++) {
+    const PredictionRecord *record = &table->records[i];
+    if (record->direction > 1) {
+      continue;
+    }
+    // trains that arrived more than 30s ago are still listed for a while,
+    // but not once they have left
+    if (record->departure > 0 && (int32_t)(record->departure - now) <= 0) {
+      continue;
+    }
+    if (record->status != TRAIN_STATUS_NONE ||
+        (record->arrival > 0 && (int32_t)(record->arrival - now) > -30)) {
+      uint8_t d = record->direction;
+      table->by_direction[d][table->num_by_direction[d]++] = i;
+    }
+  }
+}
+
+// Gives each prediction the headsign of its trip, sorts the predictions by
+// time and indexes the ones still ahead at now by direction.
+static void index_predictions(PredictionTable *table, uint32_t now) {
+  uint8_t trips[MBTA_MAX_PREDICTIONS];
+  for (uint8_t i = 0; i < table->num_trips; i++) {
+    trips[i] = i;
+  }
+  std::sort(trips, trips + table->num_trips, [table](uint8_t a, uint8_t b) {
+    return table->trip_ids[a] < table->trip_ids[b];
+  });
+  for (uint8_t i = 0; i < table->num_records; i++) {
+    PredictionRecord *record = &table->records[i];
+    uint8_t *trip = std::lower_bound(
+        trips, trips + table->num_trips, record->trip,
+        [table](uint8_t t, uint32_t id) { return table->trip_ids[t] < id; });
+    record->headsign = MBTA_NO_NAME;
+    if (trip != trips + table->num_trips &&
+        table->trip_ids[*trip] == record->trip) {
+      record->headsign = table->trip_headsigns[*trip];
+    }
+  }
+
+  // insertion sort: it keeps equal times in the order they came in, and
+  // after an event the records are already nearly sorted
+  for (uint8_t i = 1; i < table->num_records; i++) {
+    PredictionRecord record = table->records[i];
+    uint32_t time = record_time(&record);
+    int j = i - 1;
+    for (; j >= 0 && record_time(&table->records[j]) > time; j--) {
+      table->records[j + 1] = table->records[j];
+    }
+    table->records[j + 1] = record;
+  }
+  index_by_direction(table, now);
+}
 
 void MBTA::setup() {
-  lms::Client::setup(8192);
+  lms::Client::setup();
+  this->data = new PredictionTable;
   this->wifi_client->setCACert(mbta_certificate);
   this->get_placeholder_predictions(this->latest_predictions);
-  this->station = DEFAULT_TRAIN_STATION;
+  this->has_station_changed = true;
+  this->next_poll = 0;
+  this->request_pending = false;
+  this->streaming = false;
+}
+
+void MBTA::teardown() {
+  // an event stream is closed with the connection
+  lms::Client::teardown();
+  delete this->data;
+  this->data = NULL;
+}
+
+void MBTA::warm_up(lms::HttpEngine *engine) {
+  engine->preconnect(MBTA_API_URL, mbta_certificate, MBTA_REQUEST_TIMEOUT);
 }
 
 PredictionStatus MBTA::get_predictions(Prediction *dst, int num_predictions,
@@ -30,24 +430,45 @@ PredictionStatus MBTA::get_predictions(Prediction *dst, int num_predictions,
     strcpy(dst[1].value, "12 min");
     return PREDICTION_STATUS_OK;
   }
-  int status = this->fetch_predictions(this->data);
-  if (status != 0) {
-    this->error_count++;
+  uint32_t now = time(NULL);
+  if (this->streaming) {
+    // a stream waiting to be opened again is not another error
+    int result = this->read_events(this->data, now);
+    if (result == 0) {
+      this->error_count = 0;
+    } else if (result > 0) {
+      this->error_count++;
+    }
+  } else if (this->engine) {
+    this->request_predictions(now);
+    index_by_direction(this->data, now);
+  } else if (this->has_station_changed ||
+             (int32_t)(now - this->next_poll) >= 0) {
+    if (this->fetch_predictions(this->data) == 0) {
+      this->error_count = 0;
+      this->next_poll = now + this->get_poll_interval(this->data, now);
+    } else {
+      this->error_count++;
+      this->next_poll = now + MBTA_MIN_POLL_INTERVAL;
+    }
+  } else {
+    index_by_direction(this->data, now);
+  }
+  if (this->error_count > 0) {
     if (this->error_count <= MBTA_MAX_ERROR_COUNT) {
       return PREDICTION_STATUS_ERROR_SHOW_CACHED;
     } else {
       return PREDICTION_STATUS_ERROR;
     }
   }
-  this->error_count = 0;
-  if ((*this->data)["data"].size() == 0) {
+  if (this->data->num_records == 0) {
     return PREDICTION_STATUS_ERROR_EMPTY;
   }
   for (int i = 0; i < num_predictions; i++) {
-    JsonObject prediction = this->find_nth_prediction_for_direction(
-        this->data, directions[i], nth_positions[i]);
-    JsonObject trip = this->find_trip_for_prediction(this->data, prediction);
-    this->format_prediction(prediction, trip, &dst[i]);
+    const PredictionRecord *prediction =
+        this->find_nth_prediction_for_direction(this->data, directions[i],
+                                                nth_positions[i]);
+    this->format_prediction(this->data, prediction, now, &dst[i]);
   }
   PredictionStatus prediction_status = PREDICTION_STATUS_OK;
   if (this->show_arriving_banner(&dst[0], directions[0])) {
@@ -56,7 +477,6 @@ PredictionStatus MBTA::get_predictions(Prediction *dst, int num_predictions,
     prediction_status = PREDICITON_STATUS_OK_SHOW_ARR_BANNER_SLOT_2;
   }
   this->update_latest_predictions(dst, directions);
-  this->data->clear();
   return prediction_status;
 }
 
@@ -91,16 +511,28 @@ void MBTA::set_station(TrainStation station) {
   this->get_placeholder_predictions(this->latest_predictions);
 }
 
-int MBTA::fetch_predictions(JsonDocument *prediction_data) {
+TrainStation MBTA::get_station() { return this->station; }
+
+void MBTA::set_streaming(bool streaming) {
+  this->streaming = streaming;
+  // the next call connects again, in the new mode
+  this->has_station_changed = true;
+}
+
+int MBTA::fetch_predictions(PredictionTable *prediction_data) {
   if (this->wifi_client) {
     if (!this->http_client.connected() || this->has_station_changed) {
       Serial.println("Starting new http connection to mbta api");
+      // an event stream may still be open
+      this->http_client.end();
+      this->http_client.useHTTP10(false);
       char request_url[256];
       snprintf(request_url, 256, MBTA_REQUEST, MBTA_API_KEY,
                this->train_station_codes[this->station]);
       if (!this->http_client.begin(*this->wifi_client, request_url)) {
         return 1;
       }
+      this->accept_gzip(this->http_client);
       this->has_station_changed = false;
     }
     int httpCode = this->http_client.GET();
@@ -108,112 +540,226 @@ int MBTA::fetch_predictions(JsonDocument *prediction_data) {
     if (httpCode > 0) {
       // file found at server
       if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-        // filter down the response so less memory is used
-        StaticJsonDocument<1024> filter;
-        filter["data"][0]["attributes"]["arrival_time"] = true;
-        filter["data"][0]["attributes"]["departure_time"] = true;
-        filter["data"][0]["attributes"]["direction_id"] = true;
-        filter["data"][0]["attributes"]["status"] = true;
-        filter["data"][0]["relationships"]["trip"]["data"]["id"] = true;
-        filter["included"][0]["id"] = true;
-        filter["included"][0]["attributes"]["headsign"] = true;
-
-        DeserializationError error =
-            deserializeJson(*prediction_data, this->http_client.getStream(),
-                            DeserializationOption::Filter(filter));
-        if (error) {
-          Serial.print(F("deserializeJson() failed: "));
-          Serial.println(error.f_str());
-          return 1;
-        }
-        return 0;
+        lms::ResponseBody body(this->http_client.getStream(),
+                               is_gzipped(this->http_client),
+                               &this->encoding_stats);
+        return this->read_predictions(body, prediction_data);
       }
     }
   }
   return 1;
 }
 
-JsonObject MBTA::find_nth_prediction_for_direction(
-    JsonDocument *prediction_data_ptr, int direction, int n) {
-  JsonArray prediction_array = (*prediction_data_ptr)["data"];
-  JsonObject prediction;
-
-  for (int i = 0; i < prediction_array.size(); i++) {
-    prediction = prediction_array[i];
-    int d = prediction["attributes"]["direction_id"];
-    String arr_time = prediction["attributes"]["arrival_time"];
-    String dep_time = prediction["attributes"]["departure_time"];
-    String status = prediction["attributes"]["status"];
-    if (d == direction) {
-      if (!status.equals("null")) {
-        if (n == 0) {
-          return prediction;
-        } else {
-          n--;
+// Asks for the predictions through the engine when a poll is due, without
+// waiting. The table is filled when the response comes in; until then the
+// sign goes on from the one it has, or, after the station changed, from an
+// empty one.
+void MBTA::request_predictions(uint32_t now) {
+  if (this->request_pending ||
+      (!this->has_station_changed && (int32_t)(now - this->next_poll) < 0)) {
+    return;
+  }
+  if (this->has_station_changed) {
+    clear_table(this->data);
+    this->has_station_changed = false;
+  }
+  char request_url[256];
+  snprintf(request_url, 256, MBTA_REQUEST, MBTA_API_KEY,
+           this->train_station_codes[this->station]);
+  lms::HttpEngineRequest request = {"GET",
+                                    request_url,
+                                    ACCEPT_GZIP_HEADER,
+                                    NULL,
+                                    mbta_certificate,
+                                    lms::HTTP_PRIORITY_NORMAL,
+                                    MBTA_REQUEST_TIMEOUT};
+  TrainStation station = this->station;
+  this->request_pending = this->engine->submit(
+      request, [this, station](int code, lms::HttpBody &response) {
+        this->request_pending = false;
+        // a response for the station before is dropped, the next call asks
+        // for the new one
+        if (station != this->station || this->has_station_changed) {
+          return;
         }
-      } else {
-        int arr_diff = this->diff_with_local_time(arr_time);
-        if (arr_diff > -30) {
-          if (n == 0) {
-            return prediction;
-          } else {
-            n--;
-          }
+        uint32_t now = time(NULL);
+        lms::ResponseBody body(response, response.gzipped(),
+                               &this->encoding_stats);
+        if ((code == HTTP_CODE_OK || code == HTTP_CODE_MOVED_PERMANENTLY) &&
+            this->read_predictions(body, this->data) == 0) {
+          this->error_count = 0;
+          this->next_poll = now + this->get_poll_interval(this->data, now);
+        } else {
+          Serial.printf("[HTTPS] GET... code: %d\n", code);
+          this->error_count++;
+          this->next_poll = now + MBTA_MIN_POLL_INTERVAL;
         }
-      }
-    }
-  }
-  JsonObject null_prediction;
-  return null_prediction;
+      });
 }
 
-JsonObject MBTA::find_trip_for_prediction(JsonDocument *prediction_data_ptr,
-                                          JsonObject prediction) {
-  JsonArray trip_array = (*prediction_data_ptr)["included"];
-  JsonObject trip;
+// Only the fields the sign shows are kept, as the response streams in
+int MBTA::read_predictions(Stream &stream, PredictionTable *prediction_data) {
+  clear_table(prediction_data);
+  if (!parse_resources(
+          prediction_data, polled_field_ids, POLLED_FIELDS_INCLUDED, false,
+          [this, &stream](const lms::JsonFieldHandler &handler) {
+            return this->extract_json(stream, polled_fields,
+                                      NUM_POLLED_FIELDS, handler);
+          })) {
+    clear_table(prediction_data);
+    return 1;
+  }
+  index_predictions(prediction_data, time(NULL));
+  return 0;
+}
 
-  for (int i = 0; i < trip_array.size(); i++) {
-    trip = trip_array[i];
-    if (trip["id"] == prediction["relationships"]["trip"]["data"]["id"]) {
-      return trip;
-    }
+int MBTA::open_event_stream() {
+  Serial.println("Opening mbta event stream");
+  this->http_client.end();
+  char request_url[256];
+  snprintf(request_url, 256, MBTA_REQUEST, MBTA_API_KEY,
+           this->train_station_codes[this->station]);
+  // HTTP/1.0 keeps the body free of chunked transfer encoding
+  this->http_client.useHTTP10(true);
+  if (!this->http_client.begin(*this->wifi_client, request_url)) {
+    return 1;
+  }
+  this->http_client.addHeader("Accept", "text/event-stream");
+  int httpCode = this->http_client.GET();
+  Serial.printf("[HTTPS] GET... code: %d\n", httpCode);
+  if (httpCode != HTTP_CODE_OK) {
+    this->http_client.end();
+    return 1;
   }
-  return trip;
+  this->has_station_changed = false;
+  this->last_event = time(NULL);
+  this->events.begin(this->http_client.getStream());
+  return 0;
 }
 
-int MBTA::diff_with_local_time(String timestring) {
-  struct tm time;
-  struct tm local_time;
-  char timestring_char[32];
-  timestring.toCharArray(timestring_char, 32);
-  strptime(timestring_char, "%Y-%m-%dT%H:%M:%S", &time);
-  getLocalTime(&local_time);
-  return this->datetime_diff(local_time, time);
+// What an event does with the table
+struct EventParse {
+  MBTA *mbta;
+  PredictionTable *dst;
+  bool changed;
+  bool failed;
+};
+
+// Applies the events that came in since the last call. A reset replaces the
+// whole table, the other events change one prediction or trip. The
+// connection is opened again when it went down, and after an event that
+// could not be read, since the table may have missed a change. A stream that
+// could not be opened is tried again MBTA_MIN_POLL_INTERVAL later, as a
+// failed poll is, and -1 is returned until then. A new station is tried
+// right away.
+int MBTA::read_events(PredictionTable *prediction_data, uint32_t now) {
+  if (!this->wifi_client) {
+    return 1;
+  }
+  if (!this->http_client.connected() || this->has_station_changed ||
+      (int32_t)(now - this->last_event) > MBTA_STREAM_IDLE_TIMEOUT) {
+    if (!this->has_station_changed &&
+        (int32_t)(now - this->next_poll) < 0) {
+      return -1;
+    }
+    if (this->open_event_stream() != 0) {
+      // the station before is not shown while the new one is retried
+      if (this->has_station_changed) {
+        clear_table(prediction_data);
+        this->has_station_changed = false;
+      }
+      this->next_poll = now + MBTA_MIN_POLL_INTERVAL;
+      return 1;
+    }
+  }
+  EventParse parse = {this, prediction_data, false, false};
+  int count = this->events.read_events([&parse](const char *event,
+                                                Stream &data) {
+    bool reset = strcmp(event, "reset") == 0;
+    bool remove = strcmp(event, "remove") == 0;
+    if (!reset && !remove && strcmp(event, "add") != 0 &&
+        strcmp(event, "update") != 0) {
+      return;
+    }
+    if (reset) {
+      clear_table(parse.dst);
+    }
+    const char *const *fields = reset ? reset_fields : event_fields;
+    if (!parse_resources(parse.dst, NULL, MBTA_FIELD_MAX, remove,
+                         [&parse, &data, fields](
+                             const lms::JsonFieldHandler &handler) {
+                           return parse.mbta->extract_json(
+                               data, fields, MBTA_FIELD_MAX, handler);
+                         })) {
+      parse.failed = true;
+    }
+    parse.changed = true;
+  });
+  if (count != 0) {
+    this->last_event = now;
+  }
+  if (count < 0 || parse.failed) {
+    this->http_client.end();
+    clear_table(prediction_data);
+    return 1;
+  }
+  if (parse.changed) {
+    index_predictions(prediction_data, now);
+  } else {
+    index_by_direction(prediction_data, now);
+  }
+  return 0;
 }
 
-int MBTA::datetime_diff(struct tm time1, struct tm time2) {
-  return this->datetime_to_epoch(time2) - this->datetime_to_epoch(time1);
+// Between responses the sign runs on predicted times, and a prediction
+// matters most just before the sign acts on it: when the next train of a
+// direction is shown as arriving, and when it leaves. The next request comes
+// after half the time left until the sooner of those, so requests are spread
+// out while trains are far off and close in as one gets near. A status can
+// change at any time, so trains with one are polled for more often.
+uint32_t MBTA::get_poll_interval(const PredictionTable *prediction_data,
+                                 uint32_t now) {
+  int32_t until_next = MBTA_MAX_POLL_INTERVAL * 2;
+  int32_t max_interval = MBTA_MAX_POLL_INTERVAL;
+  for (int direction = 0; direction < 2; direction++) {
+    const PredictionRecord *prediction =
+        this->find_nth_prediction_for_direction(prediction_data, direction, 0);
+    if (prediction == NULL) {
+      continue;
+    }
+    if (prediction->status != TRAIN_STATUS_NONE) {
+      max_interval = MBTA_STATUS_POLL_INTERVAL;
+    }
+    int32_t until =
+        (int32_t)(prediction->arrival - now) - MBTA_ARRIVING_THRESHOLD;
+    if (until <= 0) {
+      until = (int32_t)(prediction->departure - now);
+    }
+    until_next = std::min(until_next, until);
+  }
+  return std::max(MBTA_MIN_POLL_INTERVAL,
+                  std::min(until_next / 2, max_interval));
 }
 
-// source:
-// https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap04.html#tag_04_15
-int MBTA::datetime_to_epoch(struct tm dt) {
-  return dt.tm_sec + dt.tm_min * 60 + dt.tm_hour * 3600 + dt.tm_yday * 86400 +
-         (dt.tm_year - 70) * 31536000 + ((dt.tm_year - 69) / 4) * 86400 -
-         ((dt.tm_year - 1) / 100) * 86400 + ((dt.tm_year + 299) / 400) * 86400;
+const PredictionRecord *MBTA::find_nth_prediction_for_direction(
+    const PredictionTable *prediction_data, int direction, int n) {
+  if (direction < 0 || direction > 1 ||
+      n >= prediction_data->num_by_direction[direction]) {
+    return NULL;
+  }
+  uint8_t record = prediction_data->by_direction[direction][n];
+  return &prediction_data->records[record];
 }
 
-void MBTA::determine_display_string(int arr_diff, int dep_diff, String status,
+void MBTA::determine_display_string(int arr_diff, int dep_diff,
+                                    const PredictionRecord *prediction,
                                     char *dst) {
-  if (!status.equals("null")) {
-    status.toLowerCase();
-    if (status.indexOf("stopped") != -1) {
-      strcpy(dst, "STOP");
-    } else {
-      status.substring(0, 6).toCharArray(dst, 16);
-    }
+  if (prediction->status == TRAIN_STATUS_STOPPED) {
+    strcpy(dst, "STOP");
+  } else if (prediction->status == TRAIN_STATUS_OTHER) {
+    strcpy(dst, prediction->status_text);
   } else if (arr_diff > 0) {
-    if (arr_diff > 60) {
+    if (arr_diff > MBTA_ARRIVING_THRESHOLD) {
       int minutes = floor(arr_diff / 60.0);
       sprintf(dst, "%d min", minutes);
     } else {
@@ -228,31 +774,23 @@ void MBTA::determine_display_string(int arr_diff, int dep_diff, String status,
   }
 }
 
-void MBTA::format_prediction(JsonObject prediction, JsonObject trip,
+void MBTA::format_prediction(const PredictionTable *prediction_data,
+                             const PredictionRecord *prediction, uint32_t now,
                              Prediction *dst) {
   char display_string[16];
-  char status_char[32];
-  struct tm local_time;
-  if (prediction.isNull() || trip.isNull()) {
+  if (prediction == NULL || prediction->headsign == MBTA_NO_NAME) {
     strcpy(dst->label, "");
     strcpy(dst->value, "");
     return;
   }
-  String headsign = trip["attributes"]["headsign"];
-  String arr_time = prediction["attributes"]["arrival_time"];
-  String dep_time = prediction["attributes"]["departure_time"];
-  String status = prediction["attributes"]["status"];
-  headsign.toCharArray(dst->label, 16);
-  status.toCharArray(status_char, 32);
-  getLocalTime(&local_time);
-  Serial.printf("status: %s\n", status_char);
-  if (!status.equals("null")) {
-    this->determine_display_string(-1, -1, status, display_string);
-  } else if (arr_time && arr_time.length() > 0 && dep_time &&
-             dep_time.length() > 0) {
-    int arr_diff = this->diff_with_local_time(arr_time);
-    int dep_diff = this->diff_with_local_time(dep_time);
-    this->determine_display_string(arr_diff, dep_diff, status, display_string);
+  snprintf(dst->label, 16, "%s", prediction_data->names[prediction->headsign]);
+  if (prediction->status != TRAIN_STATUS_NONE) {
+    this->determine_display_string(-1, -1, prediction, display_string);
+  } else if (prediction->arrival > 0 && prediction->departure > 0) {
+    int arr_diff = (int32_t)(prediction->arrival - now);
+    int dep_diff = (int32_t)(prediction->departure - now);
+    this->determine_display_string(arr_diff, dep_diff, prediction,
+                                   display_string);
   } else {
     strcpy(display_string, "ERROR");
   }
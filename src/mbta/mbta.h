@@ -1,6 +1,7 @@
 #include <map>
 
 #include "../client/client.h"
+#include "../client/sse.h"
 
 #ifndef MBTA_API_H
 #define MBTA_API_H
@@ -8,6 +9,25 @@
 #define DIRECTION_SOUTHBOUND 0
 #define DIRECTION_NORTHBOUND 1
 #define MBTA_MAX_ERROR_COUNT 3
+#define DEFAULT_TRAIN_STATION TRAIN_STATION_HARVARD
+// Predictions kept from a response, the rest is dropped
+#define MBTA_MAX_PREDICTIONS 32
+// Distinct headsigns and routes in a response
+#define MBTA_MAX_NAMES 16
+#define MBTA_MAX_NAME_LENGTH 32
+#define MBTA_NO_NAME 0xFF
+// A train closer than this, in seconds, is shown as "ARR"
+#define MBTA_ARRIVING_THRESHOLD 60
+// Bounds of the time between two requests, in seconds. Between requests the
+// countdown is worked out from the last response and the clock.
+#define MBTA_MIN_POLL_INTERVAL 5
+#define MBTA_MAX_POLL_INTERVAL 60
+#define MBTA_STATUS_POLL_INTERVAL 15
+// How long a request through the engine may take, in millis
+#define MBTA_REQUEST_TIMEOUT 10000
+// An event stream that has been quiet for this long, in seconds, is opened
+// again, in case the connection died without the sign noticing
+#define MBTA_STREAM_IDLE_TIMEOUT 300
 
 struct Prediction {
   char label[32];
@@ -39,6 +59,45 @@ enum TrainStation {
   TRAIN_STATION_MAX,
 };
 
+enum TrainStatus {
+  TRAIN_STATUS_NONE,  // no status, the countdown is shown
+  TRAIN_STATUS_STOPPED,
+  TRAIN_STATUS_OTHER,  // shown as the start of the status text
+};
+
+// A prediction as the sign uses it. Ids are hashes of the API's ids, times
+// are epoch seconds, 0 when missing.
+struct PredictionRecord {
+  uint32_t id;
+  uint32_t trip;
+  uint32_t arrival;
+  uint32_t departure;
+  uint8_t direction;
+  uint8_t status;    // TrainStatus
+  uint8_t headsign;  // into PredictionTable::names, or MBTA_NO_NAME
+  uint8_t route;     // into PredictionTable::names, or MBTA_NO_NAME
+  char status_text[8];
+};
+
+// The predictions and trips of a station, filled from a response or kept up
+// to date by events. Records are sorted by time. Each direction has its own
+// index of the records that are still ahead of the train, so the nth
+// prediction of a direction is a lookup. The index is brought up to date as
+// the clock moves on.
+struct PredictionTable {
+  PredictionRecord records[MBTA_MAX_PREDICTIONS];
+  uint8_t num_records;
+  uint8_t by_direction[2][MBTA_MAX_PREDICTIONS];
+  uint8_t num_by_direction[2];
+  // trips give the predictions their headsigns
+  uint32_t trip_ids[MBTA_MAX_PREDICTIONS];
+  uint8_t trip_headsigns[MBTA_MAX_PREDICTIONS];
+  uint8_t num_trips;
+  // headsigns and routes, each stored once
+  char names[MBTA_MAX_NAMES][MBTA_MAX_NAME_LENGTH];
+  uint8_t num_names;
+};
+
 class MBTA : lms::Client {
   Prediction latest_predictions[2];
   int error_count;
@@ -54,37 +113,53 @@ class MBTA : lms::Client {
       {TRAIN_STATION_DOWNTOWN_CROSSING, "place-dwnxg"},
       {TRAIN_STATION_SOUTH_STATION, "place-sstat"},
   };
-  TrainStation station;
+  // kept from one setup to the next, the station can be changed in any mode
+  TrainStation station = DEFAULT_TRAIN_STATION;
   bool has_station_changed;
+  PredictionTable *data;
+  // epoch second from which the next request is made, or the event stream
+  // opened again
+  uint32_t next_poll;
+  // a request through the engine is in flight
+  bool request_pending;
+  // in streaming mode, predictions come as events on a connection that
+  // stays open, instead of being polled for
+  bool streaming;
+  lms::EventStream events;
+  uint32_t last_event;
 
   PredictionStatus get_predictions(Prediction *dst, int num_predictions,
                                    int directions[], int nth_positions[]);
-  int fetch_predictions(JsonDocument *prediction_data);
-
-  JsonObject find_nth_prediction_for_direction(
-      JsonDocument *prediction_data_ptr, int direction, int n);
-
-  JsonObject find_trip_for_prediction(JsonDocument *prediction_data_ptr,
-                                      JsonObject prediction);
-
-  void format_prediction(JsonObject prediction, JsonObject trip,
+  int fetch_predictions(PredictionTable *prediction_data);
+  void request_predictions(uint32_t now);
+  int read_predictions(Stream &stream, PredictionTable *prediction_data);
+  uint32_t get_poll_interval(const PredictionTable *prediction_data,
+                             uint32_t now);
+  int open_event_stream();
+  int read_events(PredictionTable *prediction_data, uint32_t now);
+
+  const PredictionRecord *find_nth_prediction_for_direction(
+      const PredictionTable *prediction_data, int direction, int n);
+
+  void format_prediction(const PredictionTable *prediction_data,
+                         const PredictionRecord *prediction, uint32_t now,
                          Prediction *dst);
 
-  int diff_with_local_time(String timestring);
-
-  int datetime_diff(struct tm time1, struct tm time2);
-
-  int datetime_to_epoch(struct tm dt);
-
-  void determine_display_string(int arr_diff, int dep_diff, String status,
-                                char *dst);
+  void determine_display_string(int arr_diff, int dep_diff,
+                                const PredictionRecord *prediction, char *dst);
 
   void update_latest_predictions(Prediction latest[], int directions[]);
 
   bool show_arriving_banner(Prediction *prediction, int direction);
 
  public:
+  using lms::Client::get_encoding_stats;
+  using lms::Client::get_tls_stats;
+  using lms::Client::use_engine;
   void setup();
+  void teardown();
+  // Has engine open a connection to the API ahead of the first request
+  void warm_up(lms::HttpEngine *engine);
   PredictionStatus get_predictions_both_directions(Prediction dst[2]);
 
   PredictionStatus get_predictions_one_direction(Prediction dst[2],
@@ -93,6 +168,8 @@ class MBTA : lms::Client {
   void get_placeholder_predictions(Prediction dst[2]);
   void get_cached_predictions(Prediction dst[2]);
   void set_station(TrainStation station);
+  TrainStation get_station();
+  void set_streaming(bool streaming);
 };
 
 char *train_station_to_str(TrainStation station);
@@ -47,6 +47,15 @@ const char index_html[] PROGMEM = R"(
       </select>
       <input type="submit" value="Set station">
     </form>
+    <form method="GET" action="/set">
+      <h2>Set MBTA updates</h2>
+      <input name="key" type="hidden" value="mbta-streaming">
+      <select name="value">
+        <option value="0">Poll for predictions</option>
+        <option value="1">Stream predictions</option>
+      </select>
+      <input type="submit" value="Set updates">
+    </form>
   </body>
 )";
 
@@ -104,6 +113,14 @@ void Server::setup_set() {
         } else {
           request->send(500, "text/plain", "invalid station id: " + value);
         }
+      } else if (key == "mbta-streaming") {
+        UIMessage message;
+        message.type = UI_MESSAGE_TYPE_MBTA_SET_STREAMING;
+        message.mbta_streaming = value.toInt() == 1;
+        if (xQueueSend(this->ui_queue, (void *)&message, TEN_MILLIS)) {
+          request->redirect("/");
+          return;
+        }
       } else {
         request->send(500, "text/plain", "unknown key '" + key + "'");
       }
@@ -0,0 +1,142 @@
+#include "cover-cache.h"
+
+#define COVER_CACHE_INDEX_KEY "cover-index"
+
+// 32 bit FNV-1a
+static uint32_t hash_url(const char *url) {
+  uint32_t hash = 2166136261u;
+  for (const char *c = url; *c; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return hash;
+}
+
+// NVS keys are at most 15 characters
+static void flash_key_name(uint32_t key, char *dst) {
+  sprintf(dst, "c%08x", (unsigned int)key);
+}
+
+void CoverCache::setup(size_t ram_budget, int flash_entries) {
+  this->capacity = max((int)(ram_budget / COVER_BYTES), 1);
+  this->entries = new Entry[this->capacity];
+  this->num_entries = 0;
+  this->clock = 0;
+  this->stats = {0, 0, 0, 0};
+  this->flash_capacity = flash_entries;
+  this->flash_keys = NULL;
+  this->num_flash_keys = 0;
+  if (this->flash_capacity > 0) {
+    this->flash_keys = new uint32_t[this->flash_capacity];
+    this->flash.begin(COVER_CACHE_NAMESPACE);
+    size_t length =
+        this->flash.getBytes(COVER_CACHE_INDEX_KEY, this->flash_keys,
+                             this->flash_capacity * sizeof(uint32_t));
+    this->num_flash_keys = length / sizeof(uint32_t);
+  }
+}
+
+bool CoverCache::get(const char *url, GFXcanvas16 *dst) {
+  uint32_t key = hash_url(url);
+  Entry *entry = this->find(key);
+  if (entry) {
+    this->stats.hits++;
+    memcpy(dst->getBuffer(), entry->pixels, COVER_BYTES);
+  } else if (this->read_flash(key, dst->getBuffer())) {
+    this->stats.flash_hits++;
+    entry = this->insert(key);
+    memcpy(entry->pixels, dst->getBuffer(), COVER_BYTES);
+  } else {
+    this->stats.misses++;
+    return false;
+  }
+  entry->last_used = ++this->clock;
+  return true;
+}
+
+void CoverCache::put(const char *url, GFXcanvas16 *src) {
+  uint32_t key = hash_url(url);
+  Entry *entry = this->find(key);
+  if (!entry) {
+    entry = this->insert(key);
+  }
+  memcpy(entry->pixels, src->getBuffer(), COVER_BYTES);
+  entry->last_used = ++this->clock;
+}
+
+CoverCacheStats CoverCache::get_stats() { return this->stats; }
+
+CoverCache::Entry *CoverCache::find(uint32_t key) {
+  for (int i = 0; i < this->num_entries; i++) {
+    if (this->entries[i].key == key) {
+      return &this->entries[i];
+    }
+  }
+  return NULL;
+}
+
+// Takes a free entry while the budget allows, otherwise the least recently
+// used one, whose cover goes to flash.
+CoverCache::Entry *CoverCache::insert(uint32_t key) {
+  Entry *entry;
+  if (this->num_entries < this->capacity) {
+    entry = &this->entries[this->num_entries++];
+    entry->pixels = new uint16_t[COVER_WIDTH * COVER_HEIGHT];
+  } else {
+    entry = &this->entries[0];
+    for (int i = 1; i < this->num_entries; i++) {
+      if (this->entries[i].last_used < entry->last_used) {
+        entry = &this->entries[i];
+      }
+    }
+    this->spill(entry);
+    this->stats.evictions++;
+  }
+  entry->key = key;
+  return entry;
+}
+
+// Writes an evicted cover to flash, unless it is there already. The oldest
+// cover in flash makes room for it.
+void CoverCache::spill(const Entry *entry) {
+  if (this->flash_capacity == 0) {
+    return;
+  }
+  for (int i = 0; i < this->num_flash_keys; i++) {
+    if (this->flash_keys[i] == entry->key) {
+      return;
+    }
+  }
+  char name[16];
+  if (this->num_flash_keys == this->flash_capacity) {
+    flash_key_name(this->flash_keys[0], name);
+    this->flash.remove(name);
+    memmove(this->flash_keys, this->flash_keys + 1,
+            --this->num_flash_keys * sizeof(uint32_t));
+  }
+  flash_key_name(entry->key, name);
+  if (this->flash.putBytes(name, entry->pixels, COVER_BYTES) == COVER_BYTES) {
+    this->flash_keys[this->num_flash_keys++] = entry->key;
+  }
+  this->write_flash_index();
+}
+
+bool CoverCache::read_flash(uint32_t key, uint16_t *dst) {
+  for (int i = 0; i < this->num_flash_keys; i++) {
+    if (this->flash_keys[i] == key) {
+      char name[16];
+      flash_key_name(key, name);
+      return this->flash.getBytes(name, dst, COVER_BYTES) == COVER_BYTES;
+    }
+  }
+  return false;
+}
+
+void CoverCache::write_flash_index() {
+  if (this->num_flash_keys == 0) {
+    // an empty blob cannot be written
+    this->flash.remove(COVER_CACHE_INDEX_KEY);
+    return;
+  }
+  this->flash.putBytes(COVER_CACHE_INDEX_KEY, this->flash_keys,
+                       this->num_flash_keys * sizeof(uint32_t));
+}
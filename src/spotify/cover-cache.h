@@ -0,0 +1,62 @@
+#include <Adafruit_GFX.h>
+#include <Preferences.h>
+
+#ifndef COVER_CACHE_H
+#define COVER_CACHE_H
+
+#define COVER_WIDTH 32
+#define COVER_HEIGHT 32
+#define COVER_BYTES (COVER_WIDTH * COVER_HEIGHT * 2)  // RGB565
+// RAM for decoded covers, 8 of them by default
+#define COVER_CACHE_RAM_BUDGET (8 * COVER_BYTES)
+// Covers kept in flash once they are evicted from RAM, in their own NVS
+// namespace. Off by default: the default partition table only has 20KB of
+// NVS, so this needs a larger nvs partition.
+#define COVER_CACHE_FLASH_ENTRIES 0
+#define COVER_CACHE_NAMESPACE "covers"
+
+struct CoverCacheStats {
+  uint32_t hits;        // found in RAM
+  uint32_t flash_hits;  // found in flash, then moved back to RAM
+  uint32_t misses;
+  uint32_t evictions;  // from RAM
+};
+
+// Album covers as decoded, 32x32 RGB565, keyed by a hash of their url. The
+// least recently used cover is evicted when the RAM budget is used up, and,
+// if flash entries are configured, written to flash to be read back from
+// there instead of being fetched and decoded again.
+class CoverCache {
+  struct Entry {
+    uint32_t key;
+    uint32_t last_used;
+    uint16_t *pixels;
+  };
+  Entry *entries;
+  int num_entries;
+  int capacity;
+  uint32_t clock;
+  CoverCacheStats stats;
+
+  Preferences flash;
+  // in the order they were written, oldest first
+  uint32_t *flash_keys;
+  int num_flash_keys;
+  int flash_capacity;
+
+  Entry *find(uint32_t key);
+  Entry *insert(uint32_t key);
+  void spill(const Entry *entry);
+  bool read_flash(uint32_t key, uint16_t *dst);
+  void write_flash_index();
+
+ public:
+  void setup(size_t ram_budget = COVER_CACHE_RAM_BUDGET,
+             int flash_entries = COVER_CACHE_FLASH_ENTRIES);
+  // Copies the cover of url into dst, returns false if it is not cached.
+  bool get(const char *url, GFXcanvas16 *dst);
+  void put(const char *url, GFXcanvas16 *src);
+  CoverCacheStats get_stats();
+};
+
+#endif /* COVER_CACHE_H */
@@ -0,0 +1,96 @@
+#include "cover-loader.h"
+
+void CoverLoader::setup(Spotify *spotify, CoverCache *cache, Display *display,
+                        LastKnown *last_known) {
+  this->queue =
+      xQueueCreate(COVER_LOADER_QUEUE_LENGTH, sizeof(CoverRequest));
+  vQueueAddToRegistry(this->queue, "cover_queue");
+  this->spotify = spotify;
+  this->cache = cache;
+  this->display = display;
+  this->last_known = last_known;
+  this->shown_cover[0] = '\0';
+  this->stats = {0, 0, 0, 0};
+}
+
+bool CoverLoader::request(CoverRequestType type, const AlbumCover &cover) {
+  CoverRequest request{type, cover};
+  this->stats.requests++;
+  if (!xQueueSend(this->queue, &request, 0)) {
+    this->stats.dropped++;
+    Serial.println("cover queue full, dropping request");
+    return false;
+  }
+  return true;
+}
+
+bool CoverLoader::process(TickType_t wait) {
+  CoverRequest request;
+  if (!xQueueReceive(this->queue, &request, wait)) {
+    return false;
+  }
+  const char *url = request.cover.url;
+  if (request.type == COVER_REQUEST_WAKE ||
+      strcmp(url, this->shown_cover) == 0) {
+    return true;
+  }
+  AlbumImage *image = this->display->get_back_image();
+  // a prefetched cover is already there
+  if (strcmp(url, image->url) != 0 && !this->load(request.cover, image)) {
+    return true;
+  }
+  if (request.type == COVER_REQUEST_SHOW) {
+    if (this->last_known) {
+      this->last_known->save_cover(url, &image->image);
+    }
+    this->display->publish_image();
+    this->stats.published++;
+    strcpy(this->shown_cover, url);
+  }
+  return true;
+}
+
+void CoverLoader::wake() {
+  CoverRequest request{COVER_REQUEST_WAKE};
+  // a full queue wakes it just as well
+  xQueueSend(this->queue, &request, 0);
+}
+
+bool CoverLoader::show_saved(const AlbumCover &cover) {
+  AlbumImage *image = this->display->get_back_image();
+  image->url[0] = '\0';
+  if (!this->last_known ||
+      !this->last_known->get_cover(cover.url, &image->image)) {
+    return false;
+  }
+  strcpy(image->url, cover.url);
+  if (this->cache) {
+    this->cache->put(cover.url, &image->image);
+  }
+  this->display->publish_image();
+  this->stats.published++;
+  strcpy(this->shown_cover, cover.url);
+  return true;
+}
+
+// Puts cover into image, from the cover cache or else fetched and decoded.
+// The url of image is only set once it is complete.
+bool CoverLoader::load(const AlbumCover &cover, AlbumImage *image) {
+  image->url[0] = '\0';
+  CoverCache *cache = this->cache;
+  bool loaded = cache && cache->get(cover.url, &image->image);
+  if (!loaded && this->spotify->get_album_cover(&cover, &image->image) ==
+                     SPOTIFY_RESPONSE_OK) {
+    if (cache) {
+      cache->put(cover.url, &image->image);
+    }
+    loaded = true;
+  }
+  if (loaded) {
+    strcpy(image->url, cover.url);
+    this->stats.loaded++;
+  }
+  return loaded;
+}
+
+CoverLoaderStats CoverLoader::get_stats() { return this->stats; }
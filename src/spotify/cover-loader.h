@@ -0,0 +1,71 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include "../display/display.h"
+#include "../storage/last-known.h"
+#include "cover-cache.h"
+#include "spotify.h"
+
+#ifndef COVER_LOADER_H
+#define COVER_LOADER_H
+
+#define COVER_LOADER_QUEUE_LENGTH 4
+// Stack of the task that calls process(): the download and the JPEG decode
+#define COVER_LOADER_STACK_SIZE 8192
+
+enum CoverRequestType {
+  COVER_REQUEST_SHOW,      // the cover of the song that started
+  COVER_REQUEST_PREFETCH,  // the cover of the song up next
+  COVER_REQUEST_WAKE,      // none, process() returns at once
+};
+
+struct CoverRequest {
+  CoverRequestType type;
+  AlbumCover cover;
+};
+
+struct CoverLoaderStats {
+  uint32_t requests;
+  uint32_t dropped;    // the queue was full
+  uint32_t loaded;     // from the cover cache or fetched and decoded
+  uint32_t published;  // handed to the render task
+};
+
+// The decode stage between the music provider and the render task.
+//
+// The provider queues requests and moves on, so song changes are rendered
+// without waiting for a cover to download. The loader takes the cover from
+// the cover cache or fetches and decodes it into the display's back image,
+// and publishes it for the render task once it is complete. A prefetched
+// cover waits in the back image until its song starts.
+class CoverLoader {
+  QueueHandle_t queue;
+  Spotify *spotify;
+  CoverCache *cache;
+  Display *display;
+  LastKnown *last_known;
+  char shown_cover[sizeof(AlbumCover::url)];
+  CoverLoaderStats stats;
+
+  bool load(const AlbumCover &cover, AlbumImage *image);
+
+ public:
+  // cache may be NULL, to always fetch. The covers shown are saved to
+  // last_known, unless it is NULL.
+  void setup(Spotify *spotify, CoverCache *cache, Display *display,
+             LastKnown *last_known = NULL);
+  // Queues a request without waiting. Returns false if the queue is full.
+  bool request(CoverRequestType type, const AlbumCover &cover);
+  // Handles the next request, waiting up to wait ticks for one. Returns
+  // false if there was none.
+  bool process(TickType_t wait);
+  // Has a process() waiting for a request return, as when the task calling
+  // it is stopped
+  void wake();
+  // Shows the cover saved to last_known before the sign restarted, if it is
+  // the one asked for, without waiting. Only while nothing calls process().
+  bool show_saved(const AlbumCover &cover);
+  CoverLoaderStats get_stats();
+};
+
+#endif /* COVER_LOADER_H */
@@ -6,71 +6,179 @@
 #include "spotify-api-key.h"
 #include "spotify-cert.h"
 
+#define SPOTIFY_API_URL "https://api.spotify.com/"
 #define SPOTIFY_REFRESH_TOKEN_URL "https://accounts.spotify.com/api/token"
 #define SPOTIFY_CURRENTLY_PLAYING_URL \
   "https://api.spotify.com/v1/me/player/currently-playing"
+#define SPOTIFY_QUEUE_URL "https://api.spotify.com/v1/me/player/queue"
 #define SPOTIFY_REFRESH_TOKEN_PAYLOAD \
   "grant_type=refresh_token&"         \
   "refresh_token=" SPOTIFY_REFRESH_TOKEN
 
-void Spotify::setup() {
-  lms::Client::setup(2048);
-  this->wifi_client->setCACert(spotify_certificate);
-  this->refresh_token();
-  this->album_cover_jpg = new uint8_t[ALBUM_COVER_IMG_BUF_SIZE];
-  this->clear_current_song();
-}
+// The fields read from currently-playing, in the order of
+// currently_playing_fields. The queue has the ones before progress for each
+// song, in queue_fields.
+enum CurrentlyPlayingField {
+  CURRENTLY_PLAYING_FIELD_NAME,
+  CURRENTLY_PLAYING_FIELD_ARTIST_NAME,
+  CURRENTLY_PLAYING_FIELD_DURATION,
+  CURRENTLY_PLAYING_FIELD_IMAGE_URL,
+  CURRENTLY_PLAYING_FIELD_IMAGE_WIDTH,
+  CURRENTLY_PLAYING_FIELD_IMAGE_HEIGHT,
+  CURRENTLY_PLAYING_FIELD_PROGRESS,
+  CURRENTLY_PLAYING_FIELD_IS_PLAYING,
+  CURRENTLY_PLAYING_FIELD_MAX,
+};
 
-SpotifyResponse Spotify::get_currently_playing(CurrentlyPlaying *dst) {
-  dst->timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
-  SpotifyResponse status = this->fetch_currently_playing(data);
-  if (status == SPOTIFY_RESPONSE_EMPTY && this->current_song.timestamp_ms > 0) {
-    return SPOTIFY_RESPONSE_OK_SHOW_CACHED;
+static const char *const
+    currently_playing_fields[CURRENTLY_PLAYING_FIELD_MAX] = {
+        "item.name",
+        "item.artists[].name",
+        "item.duration_ms",
+        "item.album.images[].url",
+        "item.album.images[].width",
+        "item.album.images[].height",
+        "progress_ms",
+        "is_playing",
+};
+
+static const char *const queue_fields[CURRENTLY_PLAYING_FIELD_PROGRESS] = {
+    "queue[].name",
+    "queue[].artists[].name",
+    "queue[].duration_ms",
+    "queue[].album.images[].url",
+    "queue[].album.images[].width",
+    "queue[].album.images[].height",
+};
+
+static const char *const token_fields[] = {"access_token"};
+
+struct CurrentlyPlayingParse {
+  CurrentlyPlaying *dst;
+  AlbumCover images[SPOTIFY_MAX_ALBUM_IMAGES];
+  int num_images;
+};
+
+// Artists are joined as they stream in. Album images are collected, to pick
+// one once all are known.
+static void store_field(CurrentlyPlayingParse *parse, int field,
+                        const lms::JsonValue &value) {
+  CurrentlyPlaying *dst = parse->dst;
+  switch (field) {
+    case CURRENTLY_PLAYING_FIELD_NAME:
+      snprintf(dst->title, sizeof(dst->title), "%s", value.text);
+      return;
+    case CURRENTLY_PLAYING_FIELD_ARTIST_NAME: {
+      size_t length = strlen(dst->artist);
+      snprintf(dst->artist + length, sizeof(dst->artist) - length,
+               value.index > 0 ? ", %s" : "%s", value.text);
+      return;
+    }
+    case CURRENTLY_PLAYING_FIELD_DURATION:
+      dst->duration_ms = strtoul(value.text, NULL, 10);
+      return;
+    case CURRENTLY_PLAYING_FIELD_PROGRESS:
+      dst->progress_ms = strtoul(value.text, NULL, 10);
+      return;
+    case CURRENTLY_PLAYING_FIELD_IS_PLAYING:
+      dst->is_playing = strcmp(value.text, "true") == 0;
+      return;
   }
-  if (status != SPOTIFY_RESPONSE_OK) {
-    return status;
-  }
-  JsonObject currently_playing = (*this->data)["item"];
-  String name = currently_playing["name"];
-  this->format_artists(dst->artist, this->data);
-  name.toCharArray(dst->title, 128);
-  dst->duration_ms = currently_playing["duration_ms"];
-  dst->progress_ms = (*this->data)["progress_ms"];
-  this->format_album_cover(&dst->cover, this->data);
-  return SPOTIFY_RESPONSE_OK;
+  if (value.index < 0 || value.index >= SPOTIFY_MAX_ALBUM_IMAGES) {
+    return;
+  }
+  for (; parse->num_images <= value.index; parse->num_images++) {
+    memset(&parse->images[parse->num_images], 0, sizeof(AlbumCover));
+  }
+  AlbumCover *image = &parse->images[value.index];
+  if (field == CURRENTLY_PLAYING_FIELD_IMAGE_URL) {
+    snprintf(image->url, sizeof(image->url), "%s", value.text);
+  } else if (field == CURRENTLY_PLAYING_FIELD_IMAGE_WIDTH) {
+    image->width = atoi(value.text);
+  } else {
+    image->height = atoi(value.text);
+  }
+}
+
+static void start_parse(CurrentlyPlayingParse *parse, CurrentlyPlaying *dst) {
+  parse->dst = dst;
+  parse->num_images = 0;
+  dst->title[0] = '\0';
+  dst->artist[0] = '\0';
+  dst->duration_ms = 0;
+  dst->progress_ms = 0;
+  dst->is_playing = false;
+  memset(&dst->cover, 0, sizeof(dst->cover));
 }
 
-void Spotify::format_artists(char *dst, JsonDocument *data) {
-  JsonArray artists = (*data)["item"]["artists"];
-  char artist[128] = "";
-  if (artists.size() > 1) {
-    for (JsonObject a : artists) {
-      strncat(artist, a["name"], 128 - strlen(artist));
-      if (a != artists[artists.size() - 1]) {
-        strncat(artist, ", ", 128 - strlen(artist));
+// The smallest album image is shown
+static void finish_parse(CurrentlyPlayingParse *parse) {
+  if (parse->num_images > 0) {
+    AlbumCover *smallest = &parse->images[0];
+    for (int i = 1; i < parse->num_images; i++) {
+      if (parse->images[i].width < smallest->width) {
+        smallest = &parse->images[i];
       }
     }
-  } else {
-    strncpy(artist, artists[0]["name"], 128);
+    parse->dst->cover = *smallest;
   }
-  strncpy(dst, artist, 128);
 }
 
-void Spotify::format_album_cover(AlbumCover *dst, JsonDocument *data) {
-  JsonArray imgs = (*data)["item"]["album"]["images"];
-  if (imgs.size() == 0) {
-    return;
+void Spotify::setup() {
+  lms::Client::setup();
+  this->wifi_client->setCACert(spotify_certificate);
+  // the token outlives a switch to another mode and back. If it is due, the
+  // first poll refreshes it, so that setup() makes no request.
+  this->cover_client = new lms::TlsClient;
+  this->cover_client->setInsecure();
+  this->clear_current_song();
+  this->next_poll_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+  this->poll_pending = false;
+  this->token_pending = false;
+  this->poll_after_token = false;
+}
+
+void Spotify::teardown() {
+  lms::Client::teardown();
+  delete this->cover_client;
+  this->cover_client = NULL;
+  // the engine dropped the requests without calling their handlers
+  this->poll_pending = false;
+  this->token_pending = false;
+  this->poll_after_token = false;
+}
+
+void Spotify::warm_up(lms::HttpEngine *engine) {
+  engine->preconnect(SPOTIFY_API_URL, spotify_certificate,
+                     SPOTIFY_REQUEST_TIMEOUT);
+}
+
+bool Spotify::is_poll_due(uint32_t now_ms) {
+  return !this->poll_pending && (int32_t)(now_ms - this->next_poll_ms) >= 0;
+}
+
+SpotifyResponse Spotify::get_currently_playing(CurrentlyPlaying *dst,
+                                               uint32_t now_ms) {
+  dst->timestamp_ms = now_ms;
+  SpotifyResponse status = this->fetch_currently_playing(dst);
+  this->schedule_poll(status, dst);
+  if (status == SPOTIFY_RESPONSE_EMPTY && this->current_song.timestamp_ms > 0) {
+    return SPOTIFY_RESPONSE_OK_SHOW_CACHED;
   }
-  JsonObject smallest_img = imgs[0];
-  for (JsonObject img : imgs) {
-    if (img["width"] < smallest_img["width"]) {
-      smallest_img = img;
-    }
+  return status;
+}
+
+// The next poll is at the slow cadence, or just after the song ends if that
+// comes first.
+void Spotify::schedule_poll(SpotifyResponse status,
+                            const CurrentlyPlaying *song) {
+  uint32_t interval = SPOTIFY_POLL_INTERVAL;
+  if (status == SPOTIFY_RESPONSE_OK && song->is_playing &&
+      song->progress_ms < song->duration_ms) {
+    interval = min(interval, song->duration_ms - song->progress_ms +
+                                 SPOTIFY_END_OF_TRACK_DELAY);
   }
-  String url = smallest_img["url"];
-  url.toCharArray(dst->url, 128);
-  dst->width = smallest_img["width"];
-  dst->height = smallest_img["height"];
+  this->next_poll_ms = song->timestamp_ms + interval;
 }
 
 void Spotify::get_refresh_bearer_token(char *dst) {
@@ -84,6 +192,11 @@ void Spotify::get_api_bearer_token(char *dst) {
   sprintf(dst, "Bearer %s", this->access_token);
 }
 
+void Spotify::get_api_headers(char *dst, size_t size) {
+  snprintf(dst, size, "Authorization: Bearer %s\r\n" ACCEPT_GZIP_HEADER,
+           this->access_token);
+}
+
 SpotifyResponse Spotify::refresh_token() {
   SpotifyResponse status = this->fetch_refresh_token(access_token);
   if (status != SPOTIFY_RESPONSE_OK) {
@@ -104,27 +217,76 @@ SpotifyResponse Spotify::fetch_refresh_token(char *dst) {
       https.addHeader("content-type", "application/x-www-form-urlencoded");
       int http_code = https.POST(SPOTIFY_REFRESH_TOKEN_PAYLOAD);
       Serial.printf("[HTTPS] POST... code: %d\n", http_code);
-      if (http_code > 0) {
-        if (http_code == HTTP_CODE_OK ||
-            http_code == HTTP_CODE_MOVED_PERMANENTLY) {
-          DeserializationError error =
-              deserializeJson(*this->data, https.getStream());
-          if (error) {
-            Serial.print(F("deserializeJson() failed: "));
-            Serial.println(error.f_str());
-            return SPOTIFY_RESPONSE_ERROR;
-          }
-          String access_code_str = (*this->data)["access_token"];
-          access_code_str.toCharArray(dst, 256);
-          return SPOTIFY_RESPONSE_OK;
-        }
-      }
+      return this->read_token(http_code, https.getStream(), dst);
     }
   }
   return SPOTIFY_RESPONSE_ERROR;
 }
 
-SpotifyResponse Spotify::fetch_currently_playing(JsonDocument *dst) {
+SpotifyResponse Spotify::read_token(int http_code, Stream &body, char *dst) {
+  if (http_code != HTTP_CODE_OK && http_code != HTTP_CODE_MOVED_PERMANENTLY) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  dst[0] = '\0';
+  if (!this->extract_json(body, token_fields, 1,
+                          [dst](int field, const lms::JsonValue &value) {
+                            snprintf(dst, 256, "%s", value.text);
+                          })) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  return SPOTIFY_RESPONSE_OK;
+}
+
+// The token is refreshed through the engine ahead of the other requests,
+// which go on with the one before until it is in. A poll with no token to go
+// with is made once it is in.
+void Spotify::request_refresh_token() {
+  if (this->token_pending) {
+    return;
+  }
+  char bearer[256];
+  this->get_refresh_bearer_token(bearer);
+  char headers[HTTP_ENGINE_MAX_HEADERS_LENGTH];
+  snprintf(headers, sizeof(headers),
+           "Authorization: %s\r\n"
+           "content-type: application/x-www-form-urlencoded\r\n",
+           bearer);
+  lms::HttpEngineRequest request = {"POST",
+                                    SPOTIFY_REFRESH_TOKEN_URL,
+                                    headers,
+                                    SPOTIFY_REFRESH_TOKEN_PAYLOAD,
+                                    spotify_certificate,
+                                    lms::HTTP_PRIORITY_HIGH,
+                                    SPOTIFY_REQUEST_TIMEOUT};
+  this->token_pending =
+      this->engine->submit(request, [this](int code, Stream &body) {
+        this->token_pending = false;
+        this->last_refresh_time = millis();
+        char token[256];
+        SpotifyResponse status = this->read_token(code, body, token);
+        if (status == SPOTIFY_RESPONSE_OK) {
+          strcpy(this->access_token, token);
+        } else {
+          Serial.printf("Failed to refresh spotify token: %d\n", code);
+        }
+        if (!this->poll_after_token) {
+          return;
+        }
+        this->poll_after_token = false;
+        this->poll_pending = false;
+        if (status == SPOTIFY_RESPONSE_OK) {
+          this->request_currently_playing(this->playing_handler);
+          return;
+        }
+        // the poll fails with the token, and is tried again later
+        CurrentlyPlaying song = {};
+        song.timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        this->schedule_poll(SPOTIFY_RESPONSE_ERROR, &song);
+        this->playing_handler(SPOTIFY_RESPONSE_ERROR, &song);
+      });
+}
+
+SpotifyResponse Spotify::fetch_currently_playing(CurrentlyPlaying *dst) {
   this->check_refresh_token();
   if (this->wifi_client) {
     this->wifi_client->setCACert(spotify_certificate);
@@ -139,75 +301,190 @@ SpotifyResponse Spotify::fetch_currently_playing(JsonDocument *dst) {
                                    SPOTIFY_CURRENTLY_PLAYING_URL)) {
         return SPOTIFY_RESPONSE_ERROR;
       }
+      this->accept_gzip(this->http_client);
     }
     int http_code = this->http_client.GET();
     Serial.printf("[HTTPS] GET... code: %d\n", http_code);
-    if (http_code > 0) {
-      if (http_code == HTTP_CODE_OK ||
-          http_code == HTTP_CODE_MOVED_PERMANENTLY) {
-        StaticJsonDocument<1024> filter;
-        filter["item"]["type"] = true;
-        filter["item"]["name"] = true;
-        filter["item"]["duration_ms"] = true;
-        filter["item"]["artists"][0]["name"] = true;
-        filter["item"]["album"]["images"][0]["url"] = true;
-        filter["item"]["album"]["images"][0]["width"] = true;
-        filter["item"]["album"]["images"][0]["height"] = true;
-        filter["progress_ms"] = true;
-        filter["timestamp"] = true;
-        DeserializationError error =
-            deserializeJson(*dst, this->http_client.getStream(),
-                            DeserializationOption::Filter(filter));
-        if (error) {
-          Serial.print(F("deserializeJson() failed: "));
-          Serial.println(error.f_str());
-          return SPOTIFY_RESPONSE_ERROR;
+    lms::ResponseBody body(this->http_client.getStream(),
+                           is_gzipped(this->http_client),
+                           &this->encoding_stats);
+    return this->read_currently_playing(http_code, body, dst);
+  }
+  return SPOTIFY_RESPONSE_ERROR;
+}
+
+SpotifyResponse Spotify::read_currently_playing(int http_code, Stream &body,
+                                                CurrentlyPlaying *dst) {
+  if (http_code == HTTP_CODE_NO_CONTENT) {
+    return SPOTIFY_RESPONSE_EMPTY;
+  }
+  if (http_code != HTTP_CODE_OK && http_code != HTTP_CODE_MOVED_PERMANENTLY) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  CurrentlyPlayingParse parse;
+  start_parse(&parse, dst);
+  if (!this->extract_json(body, currently_playing_fields,
+                          CURRENTLY_PLAYING_FIELD_MAX,
+                          [&parse](int field, const lms::JsonValue &value) {
+                            store_field(&parse, field, value);
+                          })) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  finish_parse(&parse);
+  return SPOTIFY_RESPONSE_OK;
+}
+
+// The song is read as of the response, which is when its progress is from.
+void Spotify::request_currently_playing(SpotifyHandler handler) {
+  this->playing_handler = handler;
+  this->check_refresh_token();
+  if (this->token_pending && this->access_token[0] == '\0') {
+    this->poll_pending = true;
+    this->poll_after_token = true;
+    return;
+  }
+  char headers[HTTP_ENGINE_MAX_HEADERS_LENGTH];
+  this->get_api_headers(headers, sizeof(headers));
+  lms::HttpEngineRequest request = {"GET",
+                                    SPOTIFY_CURRENTLY_PLAYING_URL,
+                                    headers,
+                                    NULL,
+                                    spotify_certificate,
+                                    lms::HTTP_PRIORITY_NORMAL,
+                                    SPOTIFY_REQUEST_TIMEOUT};
+  this->poll_pending =
+      this->engine->submit(request, [this](int code, lms::HttpBody &response) {
+        this->poll_pending = false;
+        lms::ResponseBody body(response, response.gzipped(),
+                               &this->encoding_stats);
+        CurrentlyPlaying song = {};
+        song.timestamp_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        SpotifyResponse status =
+            this->read_currently_playing(code, body, &song);
+        this->schedule_poll(status, &song);
+        if (status == SPOTIFY_RESPONSE_EMPTY &&
+            this->current_song.timestamp_ms > 0) {
+          status = SPOTIFY_RESPONSE_OK_SHOW_CACHED;
         }
-        return SPOTIFY_RESPONSE_OK;
-      } else if (http_code == HTTP_CODE_NO_CONTENT) {
-        return SPOTIFY_RESPONSE_EMPTY;
-      }
+        this->playing_handler(status, &song);
+      });
+}
+
+// The next song is looked up once per song, close to its end, so that a
+// change to the queue in the meantime is still picked up.
+bool Spotify::is_next_song_due(uint32_t now_ms) {
+  const CurrentlyPlaying *song = &this->current_song;
+  return !this->next_song_fetched && song->is_playing &&
+         song->duration_ms - get_progress_ms(song, now_ms) <=
+             SPOTIFY_PREFETCH_LEAD;
+}
+
+SpotifyResponse Spotify::get_next_song(CurrentlyPlaying *dst) {
+  this->next_song_fetched = true;
+  return this->fetch_next_song(dst);
+}
+
+// Reads the first song of the queue. The queue holds many more, which are
+// skipped.
+SpotifyResponse Spotify::fetch_next_song(CurrentlyPlaying *dst) {
+  this->check_refresh_token();
+  if (this->wifi_client) {
+    this->wifi_client->setCACert(spotify_certificate);
+    HTTPClient https;
+    if (https.begin(*this->wifi_client, SPOTIFY_QUEUE_URL)) {
+      char bearer[256];
+      this->get_api_bearer_token(bearer);
+      https.addHeader("Authorization", bearer);
+      this->accept_gzip(https);
+      int http_code = https.GET();
+      Serial.printf("[HTTPS] GET... code: %d\n", http_code);
+      lms::ResponseBody body(https.getStream(), is_gzipped(https),
+                             &this->encoding_stats);
+      return this->read_next_song(http_code, body, dst);
     }
   }
   return SPOTIFY_RESPONSE_ERROR;
 }
 
-SpotifyResponse Spotify::get_album_cover(CurrentlyPlaying *src) {
-  return this->fetch_album_cover(src->cover.url, this->album_cover_jpg);
+SpotifyResponse Spotify::read_next_song(int http_code, Stream &body,
+                                        CurrentlyPlaying *dst) {
+  if (http_code != HTTP_CODE_OK) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  CurrentlyPlayingParse parse;
+  start_parse(&parse, dst);
+  if (!this->extract_json(body, queue_fields, CURRENTLY_PLAYING_FIELD_PROGRESS,
+                          [&parse](int field, const lms::JsonValue &value) {
+                            if (value.outer_index == 0) {
+                              store_field(&parse, field, value);
+                            }
+                          })) {
+    return SPOTIFY_RESPONSE_ERROR;
+  }
+  finish_parse(&parse);
+  return parse.dst->title[0] ? SPOTIFY_RESPONSE_OK : SPOTIFY_RESPONSE_EMPTY;
 }
 
-SpotifyResponse Spotify::fetch_album_cover(char *url, uint8_t *dst) {
-  memset(dst, 0, ALBUM_COVER_IMG_BUF_SIZE);
+// The next song goes after what is on screen, it is only for a prefetch. It
+// counts as fetched once the engine took the request, so that a full queue
+// has it asked for again on the next poll.
+bool Spotify::request_next_song(SpotifyHandler handler) {
+  this->check_refresh_token();
+  char headers[HTTP_ENGINE_MAX_HEADERS_LENGTH];
+  this->get_api_headers(headers, sizeof(headers));
+  this->next_song_handler = handler;
+  lms::HttpEngineRequest request = {"GET",
+                                    SPOTIFY_QUEUE_URL,
+                                    headers,
+                                    NULL,
+                                    spotify_certificate,
+                                    lms::HTTP_PRIORITY_LOW,
+                                    SPOTIFY_REQUEST_TIMEOUT};
+  this->next_song_fetched =
+      this->engine->submit(request, [this](int code, lms::HttpBody &response) {
+        lms::ResponseBody body(response, response.gzipped(),
+                               &this->encoding_stats);
+        CurrentlyPlaying song = {};
+        SpotifyResponse status = this->read_next_song(code, body, &song);
+        this->next_song_handler(status, &song);
+      });
+  return this->next_song_fetched;
+}
+
+SpotifyResponse Spotify::get_album_cover(const AlbumCover *cover,
+                                         GFXcanvas16 *dst) {
+  return this->fetch_album_cover(cover->url, dst);
+}
+
+SpotifyResponse Spotify::fetch_album_cover(const char *url,
+                                           GFXcanvas16 *dst) {
   Serial.printf("url: %s\n", url);
-  Serial.printf("img: %d %d %d %d\n", dst[0], dst[1], dst[2], dst[3]);
-  if (this->wifi_client) {
-    this->wifi_client->setInsecure();
+  if (this->cover_client) {
     HTTPClient https;
-    if (https.begin(*this->wifi_client, url)) {
+    if (https.begin(*this->cover_client, url)) {
       int http_code = https.GET();
       Serial.printf("[HTTPS] GET... code: %d\n", http_code);
       if (http_code > 0) {
         if (http_code == HTTP_CODE_OK ||
             http_code == HTTP_CODE_MOVED_PERMANENTLY) {
-          int size = https.getSize();
-          int i = 0;
-          uint8_t buff[128];
-          WiFiClient *stream = https.getStreamPtr();
-          while (https.connected() && (size > 0 || size == -1)) {
-            size_t stream_size = stream->available();
-            if (stream_size > 0) {
-              int c = stream->readBytes(
-                  buff, ((size > sizeof(buff)) ? sizeof(buff) : size));
-              memcpy(dst + i, buff, c);
-              if (size > 0) {
-                size -= c;
-                i += c;
-              }
-            }
-            delay(1);
+          // blocks below the image end the decode, the rest of a cover too
+          // large to fit is not needed
+          dst->fillScreen(0);
+          JRESULT result = this->jpeg_decoder.decode(
+              *https.getStreamPtr(), https.getSize(), dst->width(),
+              dst->height(),
+              [dst](int16_t x, int16_t y, uint16_t w, uint16_t h,
+                    uint16_t *pixels) {
+                if (y >= dst->height()) {
+                  return false;
+                }
+                dst->drawRGBBitmap(x, y, pixels, w, h);
+                return true;
+              });
+          Serial.printf("img: decoded %d\n", result);
+          if (result == JDR_OK || result == JDR_INTR) {
+            return SPOTIFY_RESPONSE_OK;
           }
-          Serial.printf("img: %d %d %d %d\n", dst[0], dst[1], dst[2], dst[3]);
-          return SPOTIFY_RESPONSE_OK;
         }
       }
     }
@@ -215,20 +492,33 @@ SpotifyResponse Spotify::fetch_album_cover(char *url, uint8_t *dst) {
   return SPOTIFY_RESPONSE_ERROR;
 }
 
+TlsStats Spotify::get_cover_tls_stats() {
+  return this->cover_client->get_stats();
+}
+
+// Refreshes the token every 30 min, and until there is one
 void Spotify::check_refresh_token() {
-  if (millis() - this->last_refresh_time > SPOTIFY_TOKEN_REFRESH_RATE) {
-    Serial.println("refreshing spotify token after 30min");
+  if (this->access_token[0] == '\0' ||
+      millis() - this->last_refresh_time > SPOTIFY_TOKEN_REFRESH_RATE) {
+    Serial.println("refreshing spotify token");
+    if (this->engine) {
+      this->request_refresh_token();
+      return;
+    }
     this->refresh_token();
   }
 }
 
 void Spotify::update_current_song(CurrentlyPlaying *src) {
+  if (this->is_current_song_new(src)) {
+    this->next_song_fetched = false;
+  }
   this->current_song = *src;
-  this->current_song.progress_ms = 0;
 }
 
 void Spotify::clear_current_song() {
   memset(&this->current_song, 0, sizeof(this->current_song));
+  this->next_song_fetched = false;
 }
 
 bool Spotify::is_current_song_new(const CurrentlyPlaying *cmp) {
@@ -236,4 +526,12 @@ bool Spotify::is_current_song_new(const CurrentlyPlaying *cmp) {
          strcmp(cmp->title, this->current_song.title) != 0;
 }
 
-CurrentlyPlaying Spotify::get_current_song() { return this->current_song; }
\ No newline at end of file
+CurrentlyPlaying Spotify::get_current_song() { return this->current_song; }
+
+uint32_t get_progress_ms(const CurrentlyPlaying *song, uint32_t now_ms) {
+  if (!song->is_playing) {
+    return song->progress_ms;
+  }
+  uint32_t elapsed_ms = now_ms - song->timestamp_ms;
+  return min(song->progress_ms + elapsed_ms, song->duration_ms);
+}
@@ -1,13 +1,24 @@
-#include <ArduinoJson.h>
+#include <Adafruit_GFX.h>
 #include <WiFiClientSecure.h>
 
 #include "../client/client.h"
+#include "../client/jpeg.h"
 
 #ifndef SPOTIFY_H
 #define SPOTIFY_H
 
 #define SPOTIFY_TOKEN_REFRESH_RATE 30 * 60 * 1000  // 30 min in millis
-#define ALBUM_COVER_IMG_BUF_SIZE 4096
+// Album images considered when picking the smallest one
+#define SPOTIFY_MAX_ALBUM_IMAGES 4
+// Progress is worked out locally between polls. Polls catch skips, pauses and
+// seeks, and one is made just after the song is expected to end.
+#define SPOTIFY_POLL_INTERVAL 10000      // millis
+#define SPOTIFY_END_OF_TRACK_DELAY 1000  // millis
+// How long before the end of a song the next one is looked up, so its cover
+// is ready when it starts
+#define SPOTIFY_PREFETCH_LEAD 30000  // millis
+// How long a request through the engine may take
+#define SPOTIFY_REQUEST_TIMEOUT 10000  // millis
 
 enum SpotifyResponse {
   SPOTIFY_RESPONSE_OK,
@@ -27,33 +38,81 @@ struct CurrentlyPlaying {
   char artist[128];
   uint32_t duration_ms;
   uint32_t progress_ms;
-  uint32_t timestamp_ms;
+  uint32_t timestamp_ms;  // tick count when progress_ms was current
+  bool is_playing;
   AlbumCover cover;
 };
 
+// Called with the outcome of a request through the engine, and the song read.
+typedef std::function<void(SpotifyResponse status, CurrentlyPlaying *song)>
+    SpotifyHandler;
+
 class Spotify : lms::Client {
   char access_token[256];
   unsigned long last_refresh_time;
   CurrentlyPlaying current_song;
-  SpotifyResponse fetch_currently_playing(JsonDocument *dst);
+  uint32_t next_poll_ms;
+  bool next_song_fetched;
+  // requests through the engine in flight
+  bool poll_pending;
+  bool token_pending;
+  // the poll waits for the token, there was none to make it with
+  bool poll_after_token;
+  SpotifyHandler playing_handler;
+  SpotifyHandler next_song_handler;
+  // Covers are fetched on a connection of their own, so that the cover
+  // loader can fetch one while the provider polls.
+  lms::TlsClient *cover_client;
+  lms::JpegDecoder jpeg_decoder;
+  SpotifyResponse fetch_currently_playing(CurrentlyPlaying *dst);
+  SpotifyResponse fetch_next_song(CurrentlyPlaying *dst);
   SpotifyResponse fetch_refresh_token(char *dst);
+  SpotifyResponse read_currently_playing(int http_code, Stream &body,
+                                         CurrentlyPlaying *dst);
+  SpotifyResponse read_next_song(int http_code, Stream &body,
+                                 CurrentlyPlaying *dst);
+  SpotifyResponse read_token(int http_code, Stream &body, char *dst);
   void check_refresh_token();
+  void request_refresh_token();
   void get_refresh_bearer_token(char *dst);
   void get_api_bearer_token(char *dst);
-  void format_artists(char *dst, JsonDocument *data);
-  void format_album_cover(AlbumCover *dst, JsonDocument *data);
-  SpotifyResponse fetch_album_cover(char *url, uint8_t *dst);
+  void get_api_headers(char *dst, size_t size);
+  SpotifyResponse fetch_album_cover(const char *url, GFXcanvas16 *dst);
+  void schedule_poll(SpotifyResponse status, const CurrentlyPlaying *song);
 
  public:
-  uint8_t *album_cover_jpg;
+  using lms::Client::get_encoding_stats;
+  using lms::Client::get_tls_stats;
+  using lms::Client::use_engine;
   void setup();
+  void teardown();
+  // Has engine open a connection to the API ahead of the first request
+  void warm_up(lms::HttpEngine *engine);
   SpotifyResponse refresh_token();
-  SpotifyResponse get_currently_playing(CurrentlyPlaying *dst);
-  SpotifyResponse get_album_cover(CurrentlyPlaying *src);
+  bool is_poll_due(uint32_t now_ms);
+  SpotifyResponse get_currently_playing(CurrentlyPlaying *dst,
+                                        uint32_t now_ms);
+  bool is_next_song_due(uint32_t now_ms);
+  SpotifyResponse get_next_song(CurrentlyPlaying *dst);
+  // What get_currently_playing and get_next_song do, through the engine:
+  // handler is called with the outcome on the task that polls it. The token
+  // is refreshed alongside when it is due.
+  void request_currently_playing(SpotifyHandler handler);
+  // Returns false, and leaves the next song due, if the engine's queue is
+  // full.
+  bool request_next_song(SpotifyHandler handler);
+  // Decodes cover into dst as it is downloaded, scaled to fit. Safe to call
+  // from another task than the rest, one task at a time.
+  SpotifyResponse get_album_cover(const AlbumCover *cover, GFXcanvas16 *dst);
+  TlsStats get_cover_tls_stats();
   void update_current_song(CurrentlyPlaying *src);
   void clear_current_song();
   CurrentlyPlaying get_current_song();
   bool is_current_song_new(const CurrentlyPlaying *cmp);
 };
 
+// The progress of song at now_ms, counted on from the last poll while it is
+// playing.
+uint32_t get_progress_ms(const CurrentlyPlaying *song, uint32_t now_ms);
+
 #endif /* SPOTIFY_H */
@@ -0,0 +1,280 @@
+#include "last-known.h"
+
+#include <time.h>
+
+#define LAST_KNOWN_PREDICTIONS_KEY "lk-predictions"
+#define LAST_KNOWN_SONG_KEY "lk-song"
+#define LAST_KNOWN_COVER_KEY "lk-cover"
+// Before this epoch second the clock is not set yet
+#define LAST_KNOWN_CLOCK_SET 1600000000
+
+namespace {
+
+// Builds a record, fields one after the other
+class RecordWriter {
+  uint8_t *data;
+  size_t size;
+  size_t length;
+
+ public:
+  RecordWriter(uint8_t *data, size_t size)
+      : data(data), size(size), length(0) {}
+  void put(const void *src, size_t n) {
+    n = min(n, this->size - this->length);
+    memcpy(this->data + this->length, src, n);
+    this->length += n;
+  }
+  void put_u8(uint8_t value) { this->put(&value, 1); }
+  void put_u16(uint16_t value) { this->put(&value, 2); }
+  void put_u32(uint32_t value) { this->put(&value, 4); }
+  void put_str(const char *str) {
+    uint8_t n = min(strlen(str), (size_t)255);
+    this->put_u8(n);
+    this->put(str, n);
+  }
+  size_t get_length() { return this->length; }
+};
+
+// Reads a record back. Once it reads past the end, ok() is false.
+class RecordReader {
+  const uint8_t *data;
+  size_t length;
+  size_t pos;
+
+ public:
+  RecordReader(const uint8_t *data, size_t length)
+      : data(data), length(length), pos(0) {}
+  bool get(void *dst, size_t n) {
+    if (this->pos + n > this->length) {
+      this->pos = this->length + 1;
+      return false;
+    }
+    memcpy(dst, this->data + this->pos, n);
+    this->pos += n;
+    return true;
+  }
+  uint8_t get_u8() {
+    uint8_t value = 0;
+    this->get(&value, 1);
+    return value;
+  }
+  uint16_t get_u16() {
+    uint16_t value = 0;
+    this->get(&value, 2);
+    return value;
+  }
+  uint32_t get_u32() {
+    uint32_t value = 0;
+    this->get(&value, 4);
+    return value;
+  }
+  // Into dst of size bytes, cut short if it does not fit
+  void get_str(char *dst, size_t size) {
+    uint8_t n = this->get_u8();
+    char str[256];
+    this->get(str, n);
+    n = min((size_t)n, size - 1);
+    memcpy(dst, str, n);
+    dst[n] = '\0';
+  }
+  bool ok() { return this->pos <= this->length; }
+};
+
+}  // namespace
+
+void LastKnown::setup() {
+  this->flash.begin(LAST_KNOWN_NAMESPACE);
+  this->station = TRAIN_STATION_MAX;
+  this->cover_length = 0;
+  this->cover_url[0] = '\0';
+  this->cover_busy = false;
+  this->predictions_record = {0, false, false};
+  this->song_record = {0, false, false};
+  this->cover_record = {0, false, false};
+  this->stats = {0, 0, 0};
+}
+
+bool LastKnown::get_predictions(TrainStation station, Prediction dst[2]) {
+  uint8_t data[LAST_KNOWN_MAX_RECORD_SIZE];
+  size_t length = this->read(LAST_KNOWN_PREDICTIONS_KEY, data,
+                             LAST_KNOWN_PREDICTIONS_MAX_AGE);
+  RecordReader record(data, length);
+  if (length == 0 || record.get_u8() != station) {
+    return false;
+  }
+  Prediction predictions[2];
+  for (Prediction &prediction : predictions) {
+    record.get_str(prediction.label, sizeof(prediction.label));
+    record.get_str(prediction.value, sizeof(prediction.value));
+  }
+  if (!record.ok()) {
+    return false;
+  }
+  dst[0] = predictions[0];
+  dst[1] = predictions[1];
+  return true;
+}
+
+bool LastKnown::get_song(CurrentlyPlaying *dst) {
+  uint8_t data[LAST_KNOWN_MAX_RECORD_SIZE];
+  size_t length =
+      this->read(LAST_KNOWN_SONG_KEY, data, LAST_KNOWN_SONG_MAX_AGE);
+  RecordReader record(data, length);
+  CurrentlyPlaying song = {};
+  record.get_str(song.title, sizeof(song.title));
+  record.get_str(song.artist, sizeof(song.artist));
+  song.duration_ms = record.get_u32();
+  song.progress_ms = record.get_u32();
+  record.get_str(song.cover.url, sizeof(song.cover.url));
+  song.cover.width = record.get_u16();
+  song.cover.height = record.get_u16();
+  if (length == 0 || !record.ok()) {
+    return false;
+  }
+  *dst = song;
+  return true;
+}
+
+bool LastKnown::get_cover(const char *url, GFXcanvas16 *dst) {
+  uint8_t data[LAST_KNOWN_MAX_RECORD_SIZE];
+  size_t length =
+      this->read(LAST_KNOWN_COVER_KEY, data, LAST_KNOWN_SONG_MAX_AGE);
+  RecordReader record(data, length);
+  char cover_url[sizeof(AlbumCover::url)];
+  record.get_str(cover_url, sizeof(cover_url));
+  uint8_t width = record.get_u8();
+  uint8_t height = record.get_u8();
+  if (length == 0 || strcmp(cover_url, url) != 0 ||
+      width != dst->width() || height != dst->height()) {
+    return false;
+  }
+  return record.get(dst->getBuffer(), width * height * 2);
+}
+
+void LastKnown::save_predictions(TrainStation station,
+                                 const Prediction src[2]) {
+  bool changed = station != this->station;
+  for (int i = 0; i < 2; i++) {
+    changed = changed ||
+              strcmp(src[i].label, this->predictions[i].label) != 0 ||
+              strcmp(src[i].value, this->predictions[i].value) != 0;
+  }
+  if (!changed) {
+    return;
+  }
+  this->stats.coalesced += this->predictions_record.dirty;
+  this->station = station;
+  this->predictions[0] = src[0];
+  this->predictions[1] = src[1];
+  this->predictions_record.dirty = true;
+}
+
+void LastKnown::save_song(const CurrentlyPlaying &song) {
+  this->stats.coalesced += this->song_record.dirty;
+  this->song = song;
+  this->song_record.dirty = true;
+}
+
+void LastKnown::save_cover(const char *url, GFXcanvas16 *src) {
+  // flush() only holds it while it writes the cover
+  while (this->cover_busy.exchange(true)) {
+    vTaskDelay(1);
+  }
+  this->stats.coalesced += this->cover_record.dirty;
+  RecordWriter record(this->cover, sizeof(this->cover));
+  record.put_u8(LAST_KNOWN_VERSION);
+  record.put_u32(time(NULL));
+  record.put_str(url);
+  record.put_u8(src->width());
+  record.put_u8(src->height());
+  record.put(src->getBuffer(), src->width() * src->height() * 2);
+  this->cover_length = record.get_length();
+  strcpy(this->cover_url, url);
+  this->cover_record.dirty = true;
+  this->cover_busy = false;
+}
+
+void LastKnown::flush(uint32_t now_ms, bool force) {
+  uint8_t data[LAST_KNOWN_MAX_RECORD_SIZE];
+  if (this->predictions_record.dirty) {
+    if (force || this->is_due(this->predictions_record, now_ms)) {
+      RecordWriter record(data, sizeof(data));
+      record.put_u8(LAST_KNOWN_VERSION);
+      record.put_u32(time(NULL));
+      record.put_u8(this->station);
+      for (const Prediction &prediction : this->predictions) {
+        record.put_str(prediction.label);
+        record.put_str(prediction.value);
+      }
+      this->write(LAST_KNOWN_PREDICTIONS_KEY, data, record.get_length(),
+                  &this->predictions_record, now_ms);
+    }
+  }
+  if (this->song_record.dirty) {
+    if (force || this->is_due(this->song_record, now_ms)) {
+      const CurrentlyPlaying &song = this->song;
+      RecordWriter record(data, sizeof(data));
+      record.put_u8(LAST_KNOWN_VERSION);
+      record.put_u32(time(NULL));
+      record.put_str(song.title);
+      record.put_str(song.artist);
+      record.put_u32(song.duration_ms);
+      record.put_u32(song.progress_ms);
+      record.put_str(song.cover.url);
+      record.put_u16(song.cover.width);
+      record.put_u16(song.cover.height);
+      this->write(LAST_KNOWN_SONG_KEY, data, record.get_length(),
+                  &this->song_record, now_ms);
+    }
+  }
+  // the cover waits for its song, and is written with it or just after if
+  // it comes in later. The cover of another song is of no use on its own.
+  // One being saved is written by the next flush.
+  if (this->cover_busy.exchange(true)) {
+    return;
+  }
+  if (this->cover_record.dirty) {
+    bool with_song = this->song_record.written && !this->song_record.dirty &&
+                     strcmp(this->cover_url, this->song.cover.url) == 0;
+    if (force || with_song) {
+      this->write(LAST_KNOWN_COVER_KEY, this->cover, this->cover_length,
+                  &this->cover_record, now_ms);
+    }
+  }
+  this->cover_busy = false;
+}
+
+LastKnownStats LastKnown::get_stats() { return this->stats; }
+
+bool LastKnown::is_due(const Record &record, uint32_t now_ms) {
+  return !record.written ||
+         now_ms - record.written_ms >= LAST_KNOWN_WRITE_INTERVAL;
+}
+
+void LastKnown::write(const char *key, const uint8_t *data, size_t length,
+                      Record *record, uint32_t now_ms) {
+  this->flash.putBytes(key, data, length);
+  record->written_ms = now_ms;
+  record->written = true;
+  record->dirty = false;
+  this->stats.writes++;
+  this->stats.bytes += length;
+}
+
+// Reads the record of key into dst, past its version and the time it was
+// saved at. Returns its length from there, or 0 if there is none, it is of
+// another version or older than max_age seconds.
+size_t LastKnown::read(const char *key, uint8_t *dst, time_t max_age) {
+  size_t length = this->flash.getBytes(key, dst, LAST_KNOWN_MAX_RECORD_SIZE);
+  RecordReader header(dst, length);
+  uint8_t version = header.get_u8();
+  time_t saved_at = header.get_u32();
+  time_t now = time(NULL);
+  if (!header.ok() || version != LAST_KNOWN_VERSION ||
+      (now > LAST_KNOWN_CLOCK_SET && saved_at > LAST_KNOWN_CLOCK_SET &&
+       now - saved_at > max_age)) {
+    return 0;
+  }
+  memmove(dst, dst + 5, length - 5);
+  return length - 5;
+}
@@ -0,0 +1,88 @@
+#include <Adafruit_GFX.h>
+#include <Preferences.h>
+
+#include <atomic>
+
+#include "../mbta/mbta.h"
+#include "../spotify/spotify.h"
+
+#ifndef LAST_KNOWN_H
+#define LAST_KNOWN_H
+
+// Layout of the records. A record of another version is ignored.
+#define LAST_KNOWN_VERSION 1
+#define LAST_KNOWN_NAMESPACE "last-known"
+// A record is written at most once in this long, in millis. What changes in
+// between is kept in RAM and written once the interval is up.
+#define LAST_KNOWN_WRITE_INTERVAL (5 * 60 * 1000)
+// Older records are not shown, in seconds. Their age is only known once the
+// clock is set, which it still is after a restart, but not after power on.
+#define LAST_KNOWN_PREDICTIONS_MAX_AGE (15 * 60)
+#define LAST_KNOWN_SONG_MAX_AGE (6 * 60 * 60)
+// A saved frame stays on the panel until the provider has something to show
+// or for this long at most, in millis
+#define LAST_KNOWN_HOLD_MS (60 * 1000)
+// Largest record: the cover, its url and the header
+#define LAST_KNOWN_MAX_RECORD_SIZE (2 * 32 * 32 + 160)
+
+struct LastKnownStats {
+  uint32_t writes;     // records written to flash
+  uint32_t coalesced;  // saves replaced by a later one before being written
+  uint32_t bytes;      // written to flash
+};
+
+// What the sign last showed, kept in NVS so that it can show it again as
+// soon as it boots, marked as cached, instead of placeholders.
+//
+// Each record is a version byte, the epoch second it was saved at, then its
+// fields, strings as a length byte and their characters. The predictions
+// and the song are saved by their providers, which flush them; the cover is
+// saved by the cover task, and kept until the song it is the cover of is
+// written, so that the two stay together. Flash sees a few hundred writes a
+// day at most.
+class LastKnown {
+  struct Record {
+    uint32_t written_ms;
+    bool written;
+    bool dirty;
+  };
+
+  Preferences flash;
+  TrainStation station;
+  Prediction predictions[2];
+  CurrentlyPlaying song;
+  // the cover record as written, and the url it is of. The cover task saves
+  // it while the provider flushes, whichever holds cover_busy has it.
+  uint8_t cover[LAST_KNOWN_MAX_RECORD_SIZE];
+  size_t cover_length;
+  char cover_url[sizeof(AlbumCover::url)];
+  std::atomic<bool> cover_busy;
+  Record predictions_record;
+  Record song_record;
+  Record cover_record;
+  LastKnownStats stats;
+
+  bool is_due(const Record &record, uint32_t now_ms);
+  void write(const char *key, const uint8_t *data, size_t length,
+             Record *record, uint32_t now_ms);
+  size_t read(const char *key, uint8_t *dst, time_t max_age);
+
+ public:
+  void setup();
+  // What was saved before the sign restarted, false if there is none or it
+  // is too old
+  bool get_predictions(TrainStation station, Prediction dst[2]);
+  bool get_song(CurrentlyPlaying *dst);
+  // The cover of url, 32x32, into dst
+  bool get_cover(const char *url, GFXcanvas16 *dst);
+  void save_predictions(TrainStation station, const Prediction src[2]);
+  void save_song(const CurrentlyPlaying &song);
+  // Safe to call from another task than the rest, one task at a time
+  void save_cover(const char *url, GFXcanvas16 *src);
+  // Writes the predictions and the song if they changed and their interval
+  // is up, or at once if force. The cover goes with its song.
+  void flush(uint32_t now_ms, bool force = false);
+  LastKnownStats get_stats();
+};
+
+#endif /* LAST_KNOWN_H */